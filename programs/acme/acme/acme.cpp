@@ -22,10 +22,14 @@
 #include "buttons.h"
 #include "conf.h"
 #include "hw.h"
+#include "rt.h"
 
 bool verbose = false;		// Chatter
 bool simulate = false;		// Do not do the work
 
+static bool real_time = false;		// Run real time (and so do the demos)
+static int rt_cpu = RT_NO_CPU;		// CPU to run on when real time
+
 static const int PASSWORD_TIMEOUT = (30 * 1000);	// 30 seconds to enter the password
 
 struct termios oldInfo;  // Old mode settings
@@ -156,9 +160,9 @@ static void toggle(bool on[], const enum RELAY_NAME relay_name)
 {
     on[relay_name] = ! on[relay_name];
     if (on[relay_name])
-	relay("diag", relay_name, RELAY_ON);
+	relay("diag", relay_name, RELAY_STATE::RELAY_ON);
     else
-	relay("diag", relay_name, RELAY_OFF);
+	relay("diag", relay_name, RELAY_STATE::RELAY_OFF);
 }
 
 /********************************************************
@@ -277,42 +281,47 @@ static pid_t start_demo_process()
     if (my_pid != 0)
 	return (my_pid);
 
+    const char* demo;	// The demo program
+    std::string demo_name = acme_config.get_demo_name();
+    switch (demo_name.at(0))
+    {
+	case 'l':
+	    demo = "long-demo";
+	    break;
+	case 's':
+	    demo = "short-demo";
+	    break;
+	case 'w':
+	    demo = "wind-demo";
+	    break;
+	default:
+	    die("Impossible demo type");
+    }
+    // Use the one here if there is one
+    std::string path = std::string("./") + demo;	// Where the demo is
+    if (access(path.c_str(), X_OK) != 0)
+	path = std::string("/home/garden/bin/") + demo;
+
     // The arguements to the demo
-    const char* args[3] = {NULL, NULL, NULL};
+    std::string rt_arg = "-R" + std::to_string(rt_cpu);	// Real time option
+    const char* args[5] = {NULL, NULL, NULL, NULL, NULL};
     int n_args = 0;
+    args[n_args] = demo;
+    ++n_args;
     if (verbose) {
 	args[n_args] = "-v";
 	++n_args;
     }
     if (simulate) {
-	args[n_args] = "-s";
+	args[n_args] = "-r";	// The demo's simulate option
 	++n_args;
     }
-
-    std::string demo_name = acme_config.get_demo_name();
-    switch (demo_name.at(0))
-    {
-	case 'l':
-	    if (access("./long-demo", X_OK) == 0)
-		execv("./long-demo", const_cast<char* const *>(args));
-	    else
-		execv("/home/garden/bin/long-demo", const_cast<char* const *>(args));
-	    die("execv failed");
-	case 's':
-	    if (access("./short-demo", X_OK) == 0)
-		execv("./short-demo", const_cast<char* const *>(args));
-	    else
-		execv("/home/garden/bin/short-demo", const_cast<char* const *>(args));
-	    die("execv failed");
-	case 'w':
-	    if (access("./wind-demo", X_OK) == 0)
-		execv("./wind-demo", const_cast<char* const *>(args));
-	    else
-		execv("/home/garden/bin/wind-demo", const_cast<char* const *>(args));
-	    die("execv failed");
-	default:
-	    die("Impossible demo type");
+    if (real_time) {
+	args[n_args] = rt_arg.c_str();
+	++n_args;
     }
+    execv(path.c_str(), const_cast<char* const *>(args));
+    die("execv failed");
 }
 
 /********************************************************
@@ -383,37 +392,42 @@ static void set_state(const MANUAL_STATE state)
     // Quick help text
     std::cout << "x-exit 1/2:En/Dis Br. 9/0:En/Dis Al. a/Alpine b/broadway O-Ding P-DDD ";
 
+    // Both heads move at once (wait_arms waits for the slower one)
     switch (state)
     {
 	case MANUAL_STATE::A_GO_B_STOP:
 	    std::cout << "Alpine GO, Broadway STOP\r" << std::endl;
 	    if (h2.is_go())
 		ding_and_flash_both();	
-	    h2.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h2_arms());
-	    h1.go(head::SIGNAL_HOW::AS_CONF,   acme_config.get_h2_arms());
+	    h2.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h2_arms(), false);
+	    h1.go(head::SIGNAL_HOW::AS_CONF,   acme_config.get_h1_arms(), false);
+	    wait_arms();
 	ding_and_flash_both();
 	    break;
 	case MANUAL_STATE::A_STOP_B_STOP:
 	    std::cout << "Alpine STOP, Broadway STOP\r" << std::endl;
 	    if (h1.is_go() || h2.is_go())
 		ding_and_flash_both();	
-	    h1.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h1_arms());
-	    h2.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h2_arms());
+	    h1.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h1_arms(), false);
+	    h2.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h2_arms(), false);
+	    wait_arms();
 	    break;
 	case MANUAL_STATE::A_STOP_B_GO:
 	    std::cout << "Alpine STOP, Broadway GO\r" << std::endl;
 	    if (h1.is_go())
 		ding_and_flash_both();	
-	    h1.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h1_arms());
-	    h2.go(head::SIGNAL_HOW::AS_CONF,   acme_config.get_h2_arms());
+	    h1.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h1_arms(), false);
+	    h2.go(head::SIGNAL_HOW::AS_CONF,   acme_config.get_h2_arms(), false);
+	    wait_arms();
 	    break;
 	case MANUAL_STATE::A_STOP_B_STOP2:
 	    std::cout << "Alpine STOP, Broadway GO\r" << std::endl;
 
 	    if (h1.is_go() || h2.is_go())
 		ding_and_flash_both();	
-	    h1.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h1_arms());
-	    h2.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h2_arms());
+	    h1.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h1_arms(), false);
+	    h2.stop(head::SIGNAL_HOW::AS_CONF, acme_config.get_h2_arms(), false);
+	    wait_arms();
 	    break;
 	default:
 	    abort();
@@ -446,8 +460,10 @@ static void manual()
 	set_state(cur_state);
 	cur_state = next_state[static_cast<unsigned int>(cur_state)];
     }
-    h1.fold_arms();
-    h2.fold_arms();
+    h1.fold_arms(false);
+    h2.fold_arms(false);
+    wait_arms();
+    motion.stats();
     relay_reset();
 }
 /********************************************************
@@ -678,7 +694,8 @@ static void main_loop()
  ********************************************************/
 static void usage(void)
 {
-    std::cout << "Usage acme [-s] [-v] " << std::endl;
+    std::cout << "Usage acme [-s] [-v] [-R<cpu>]" << std::endl;
+    std::cout << "	-R<cpu> Real time, pinned to <cpu> (-1 for any)" << std::endl;
     exit(8);
 }
 
@@ -686,7 +703,7 @@ int main(int argc, char* argv[])
 {
     openlog("acme", 0, LOG_USER); 
     while (true) {
-	int opt = getopt(argc, argv, "vs");
+	int opt = getopt(argc, argv, "vsR:");
 	if (opt < 0)
 	    break;
 	
@@ -698,6 +715,12 @@ int main(int argc, char* argv[])
 	    case 's':
 		simulate = true;
 		break;
+	    case 'R':
+		real_time = true;
+		rt_cpu = atoi(optarg);
+		rt_setup(rt_cpu);
+		rt_thread("acme");
+		break;
 	    default:
 		usage();
 	}
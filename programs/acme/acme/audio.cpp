@@ -0,0 +1,881 @@
+/********************************************************
+ * Play and mix the sound
+ *
+ * See audio.h
+ ********************************************************/
+#include <map>
+#include <string>
+#include <vector>
+
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "audio.h"
+#include "mixer.h"
+#include "rt.h"
+
+static const char* const SOUND_DIR = "acme.sound/";	// Where the MP3s are
+static const char* const PCM_DIR = "acme.sound/pcm/";	// Where the decoded clips are
+static const unsigned int PERIOD_FRAMES = AUDIO_RATE / 100;	// Frames we send at a time (10 ms)
+static const unsigned int BUFFER_US = 40000;	// Sound queued ahead of the speaker
+static const unsigned int BLOCK_FRAMES = 16;	// Frames between gain changes (fades)
+// Every voice at full gain must still fit in the mix (see mixer.h)
+static_assert(AUDIO_MAX_VOICES * AUDIO_MAX_GAIN <= MIX_MAX_VOICES, "Voices too loud for the mixer");
+static const unsigned int CUT_MS = 5;		// Fade when narration is cut off by more
+static const float DUCK_GAIN = 0.25;		// Background gain under narration (-12 dB)
+static const unsigned int DUCK_ATTACK_MS = 150;	// Time to duck
+static const unsigned int DUCK_RELEASE_MS = 600;	// Time to come back up
+
+// A clip in memory
+struct clip {
+    std::vector<int16_t> samples;	// The sound (AUDIO_RATE, AUDIO_CHANNELS)
+    bool loaded;			// The loader has been here
+    bool bad;				// Could not read it
+};
+static std::map<std::string, clip> clips;	// Every clip we know (by name)
+static std::vector<std::string> load_order;	// Order to load them (say order)
+static pthread_mutex_t audio_lock = PTHREAD_MUTEX_INITIALIZER;	// Protects everything below
+static pthread_cond_t clip_loaded = PTHREAD_COND_INITIALIZER;	// Signaled as each one loads
+static pthread_cond_t clip_done = PTHREAD_COND_INITIALIZER;	// Signaled when a clip ends
+
+// A clip being played
+struct voice {
+    int id;			// Handle (0 when the voice is free)
+    const clip* sound;		// What it plays
+    AUDIO_VOICE kind;		// What it's for
+    size_t position;		// Next sample
+    bool loop;			// Start over at the end
+    float gain;			// Volume now
+    float target;		// Volume it's fading to
+    float step;			// Change each block
+    bool release;		// Stop when it has faded out
+    int64_t start_us;		// When it was asked for
+    bool started;		// Has been sent to the sink
+};
+static voice voices[AUDIO_MAX_VOICES];	// What the playback thread is playing
+static int last_id = 0;			// Last voice handle given out
+static float duck = 1.0;		// Gain of the background (ducking)
+static int64_t heard_us = 0;		// When the last narration will have been heard
+static bool flush = false;		// Throw away what the sink has queued
+
+// Statistics
+static unsigned int plays = 0;		// Clips played
+static unsigned int starts = 0;		// Clips that got to the speaker
+static unsigned int waits = 0;		// Times we waited for the loader
+static unsigned int misses = 0;		// Clips not in the list
+static unsigned int cut_offs = 0;	// Clips stopped before the end
+static unsigned int underruns = 0;	// Times the sink ran dry
+static long int wait_us = 0;		// Time spent waiting
+static long int latency_us = 0;		// Time from audio_play() to the speaker
+static long int latency_max_us = 0;	// Longest of those
+static unsigned int voices_max = 0;	// Most voices at once
+static unsigned int periods = 0;	// Periods mixed
+static long int mix_us = 0;		// Time spent mixing
+static long int mix_max_us = 0;		// Longest period
+
+/*
+ * audio_sink -- Where the sound goes (base class of the sinks)
+ *
+ * Only the playback thread uses a sink.
+ */
+class audio_sink {
+    public:
+	audio_sink(void) {}
+	virtual ~audio_sink() {}
+    private:
+	audio_sink(const audio_sink&);			// No copy
+	audio_sink& operator = (const audio_sink&);	// No assignment
+    public:
+	// Play some frames (blocks while the buffer is full), false if it failed
+	virtual bool write(const int16_t* const samples, const unsigned int frames) = 0;
+	// Time until a frame written now is heard (us)
+	virtual int64_t queued_us(void) = 0;
+	// Throw away what is queued
+	virtual void flush(void) = 0;
+};
+
+/*
+ * null_sink -- Throw the sound away at the rate it would be played
+ *
+ * Acts like a sound card with a BUFFER_US buffer, so the
+ * timing is the same as the real thing.
+ */
+class null_sink: public audio_sink {
+    private:
+	int64_t end_us;		// When the last frame written would be heard
+    public:
+	null_sink(void): end_us(0) {}
+	virtual bool write(const int16_t* const, const unsigned int frames) {
+	    const int64_t now = now_us();	// The time
+	    if (end_us < now) {
+		if (end_us != 0)
+		    ++underruns;
+		end_us = now;
+	    }
+	    end_us += frames * 1000000LL / AUDIO_RATE;
+	    sleep_until(end_us - BUFFER_US);
+	    return (true);
+	}
+	virtual int64_t queued_us(void) {
+	    const int64_t left = end_us - now_us();	// Time left in the buffer
+	    return ((left > 0) ? left : 0);
+	}
+	virtual void flush(void) {
+	    end_us = 0;
+	}
+};
+
+/*
+ * file_sink -- Write the sound to a file (raw, 16 bit stereo
+ * 	little endian), paced like the null sink
+ */
+class file_sink: public null_sink {
+    private:
+	FILE* out_file;		// Where it goes
+    public:
+	file_sink(FILE* const the_file): out_file(the_file) {}
+	virtual ~file_sink() {
+	    fclose(out_file);
+	}
+	virtual bool write(const int16_t* const samples, const unsigned int frames) {
+	    if (fwrite(samples, sizeof(int16_t) * AUDIO_CHANNELS, frames, out_file) != frames) {
+		syslog(LOG_ERR, "ERROR: Unable to write the audio file");
+		return (false);
+	    }
+	    fflush(out_file);
+	    return (null_sink::write(samples, frames));
+	}
+};
+
+/*
+ * alsa_sink -- A sound card
+ */
+class alsa_sink: public audio_sink {
+    private:
+	snd_pcm_t* pcm;		// The device
+    public:
+	alsa_sink(snd_pcm_t* const the_pcm): pcm(the_pcm) {}
+	virtual ~alsa_sink() {
+	    snd_pcm_close(pcm);
+	}
+	virtual bool write(const int16_t* const samples, const unsigned int frames) {
+	    unsigned int done = 0;	// Frames written
+	    while (done < frames) {
+		snd_pcm_sframes_t result = snd_pcm_writei(pcm, samples + done * AUDIO_CHANNELS, frames - done);
+		if (result < 0) {
+		    if (result == -EPIPE)
+			++underruns;
+		    result = snd_pcm_recover(pcm, result, 1);
+		    if (result < 0) {
+			syslog(LOG_ERR, "ERROR: Audio write failed (%s)", snd_strerror(result));
+			return (false);
+		    }
+		    continue;
+		}
+		done += result;
+	    }
+	    return (true);
+	}
+	virtual int64_t queued_us(void) {
+	    snd_pcm_sframes_t delay;	// Frames queued
+	    if ((snd_pcm_delay(pcm, &delay) != 0) || (delay < 0))
+		return (0);
+	    return (delay * 1000000LL / AUDIO_RATE);
+	}
+	virtual void flush(void) {
+	    snd_pcm_drop(pcm);
+	    snd_pcm_prepare(pcm);
+	}
+};
+
+static audio_sink* sink = NULL;		// Where the sound goes
+
+/********************************************************
+ * open_sink -- Open the place the sound goes
+ *
+ * Parameters
+ * 	name -- "null", "file:<name>" or the ALSA device
+ *
+ * Returns
+ * 	The sink (the null one if the sound card won't open)
+ ********************************************************/
+static audio_sink* open_sink(const char* const name)
+{
+    if (strcmp(name, "null") == 0) {
+	syslog(LOG_INFO, "Audio is going nowhere");
+	return (new null_sink);
+    }
+    if (strncmp(name, "file:", 5) == 0) {
+	FILE* out_file = fopen(name + 5, "wb");
+	if (out_file == NULL) {
+	    syslog(LOG_ERR, "ERROR: Unable to open audio file %s", name + 5);
+	    die("Unable to open the audio file");
+	}
+	syslog(LOG_INFO, "Audio is going to %s", name + 5);
+	return (new file_sink(out_file));
+    }
+
+    snd_pcm_t* pcm;	// The sound card
+    int result = snd_pcm_open(&pcm, name, SND_PCM_STREAM_PLAYBACK, 0);	// Result of the open
+    if (result < 0) {
+	syslog(LOG_ERR, "ERROR: Unable to open sound device %s (%s) -- no sound", name, snd_strerror(result));
+	return (new null_sink);
+    }
+    result = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+	    AUDIO_CHANNELS, AUDIO_RATE, 1, BUFFER_US);
+    if (result < 0) {
+	syslog(LOG_ERR, "ERROR: Sound device %s can't play 16 bit stereo %u Hz (%s) -- no sound",
+		name, AUDIO_RATE, snd_strerror(result));
+	snd_pcm_close(pcm);
+	return (new null_sink);
+    }
+    syslog(LOG_INFO, "Audio is going to %s", name);
+    return (new alsa_sink(pcm));
+}
+/********************************************************
+ * get16, get32 -- Get little endian numbers from a file
+ ********************************************************/
+static inline unsigned int get16(const uint8_t* const data)
+{
+    return (data[0] | (data[1] << 8));
+}
+static inline uint32_t get32(const uint8_t* const data)
+{
+    return (data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24));
+}
+/********************************************************
+ * convert -- Convert sound to AUDIO_RATE stereo
+ *
+ * Mono is copied to both sides, extra channels dropped,
+ * and other rates resampled (linear, good enough for a
+ * voice.)
+ *
+ * Parameters
+ * 	data -- The 16 bit samples
+ * 	in_frames -- Frames in them
+ * 	channels, rate -- What they are
+ * 	samples -- Where the result goes
+ ********************************************************/
+static void convert(const uint8_t* const data, const size_t in_frames, const unsigned int channels,
+	const unsigned int rate, std::vector<int16_t>& samples)
+{
+    const size_t out_frames = static_cast<size_t>(static_cast<uint64_t>(in_frames) * AUDIO_RATE / rate);
+    samples.resize(out_frames * AUDIO_CHANNELS);
+    for (size_t out = 0; out < out_frames; ++out) {
+	const uint64_t where = static_cast<uint64_t>(out) * rate;	// Input position * AUDIO_RATE
+	const size_t in = where / AUDIO_RATE;			// Frame before it
+	const int fraction = where % AUDIO_RATE;		// How far to the next one
+	const size_t next = (in + 1 < in_frames) ? in + 1 : in;	// Frame after it
+	for (unsigned int side = 0; side < AUDIO_CHANNELS; ++side) {
+	    const unsigned int channel = (side < channels) ? side : 0;	// Channel we take it from
+	    const int before = static_cast<int16_t>(get16(data + (in * channels + channel) * 2));
+	    const int after = static_cast<int16_t>(get16(data + (next * channels + channel) * 2));
+	    samples[out * AUDIO_CHANNELS + side] =
+		before + static_cast<int>(static_cast<int64_t>(after - before) * fraction / AUDIO_RATE);
+	}
+    }
+}
+/********************************************************
+ * read_wav -- Read a .wav file (16 bit PCM)
+ *
+ * Parameters
+ * 	file -- File to read
+ * 	samples -- Where the sound goes (converted)
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_wav(const std::string& file, std::vector<int16_t>& samples)
+{
+    FILE* in_file = fopen(file.c_str(), "rb");
+    if (in_file == NULL)
+	return (false);
+    std::vector<uint8_t> data;	// The whole file
+    uint8_t block[64 * 1024];	// Part of it
+    size_t read_size;		// Size of the part
+    while ((read_size = fread(block, 1, sizeof(block), in_file)) > 0)
+	data.insert(data.end(), block, block + read_size);
+    fclose(in_file);
+
+    if ((data.size() < 12) || (memcmp(data.data(), "RIFF", 4) != 0) || (memcmp(data.data() + 8, "WAVE", 4) != 0)) {
+	syslog(LOG_ERR, "ERROR: %s is not a .wav file", file.c_str());
+	return (false);
+    }
+    unsigned int channels = 0;	// Format of the sound
+    unsigned int rate = 0;
+    unsigned int bits = 0;
+    size_t chunk = 12;		// Chunk we are looking at
+    while (chunk + 8 <= data.size()) {
+	const uint8_t* const header = data.data() + chunk;
+	const size_t size = get32(header + 4);	// Size of the chunk
+	const size_t left = data.size() - chunk - 8;	// Bytes after the header
+	if ((memcmp(header, "fmt ", 4) == 0) && (size >= 16) && (left >= 16)) {
+	    const unsigned int type = get16(header + 8);	// 1 is PCM, 0xFFFE is extensible
+	    channels = get16(header + 10);
+	    rate = get32(header + 12);
+	    bits = get16(header + 22);
+	    if (((type != 1) && (type != 0xFFFE)) || (bits != 16) || (channels == 0) || (rate == 0)) {
+		syslog(LOG_ERR, "ERROR: %s is not 16 bit PCM", file.c_str());
+		return (false);
+	    }
+	} else if (memcmp(header, "data", 4) == 0) {
+	    if (channels == 0)
+		break;
+	    // A file written to a pipe says it's huge
+	    const size_t bytes = (size < left) ? size : left;	// Bytes of sound
+	    convert(header + 8, bytes / (2 * channels), channels, rate, samples);
+	    return (true);
+	}
+	chunk += 8 + size + (size & 1);
+    }
+    syslog(LOG_ERR, "ERROR: %s has no sound in it", file.c_str());
+    return (false);
+}
+/********************************************************
+ * decode -- Decode an MP3 into a .wav file
+ *
+ * Parameters
+ * 	mp3_file -- The MP3
+ * 	wav_file -- Where the .wav goes
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool decode(const std::string& mp3_file, const std::string& wav_file)
+{
+    syslog(LOG_INFO, "Decoding %s (no %s)", mp3_file.c_str(), wav_file.c_str());
+    mkdir(PCM_DIR, 0755);
+    const std::string temp_file = wav_file + ".tmp";	// Where it goes until it's done
+    const pid_t pid = fork();
+    if (pid == 0) {
+	execlp("mpg321", "mpg321", "-q", "-w", temp_file.c_str(), mp3_file.c_str(), static_cast<char*>(NULL));
+	_exit(8);
+    }
+    int status = 0;	// How the decode went
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0) ||
+	    (rename(temp_file.c_str(), wav_file.c_str()) != 0)) {
+	syslog(LOG_ERR, "ERROR: Unable to decode %s", mp3_file.c_str());
+	unlink(temp_file.c_str());
+	return (false);
+    }
+    return (true);
+}
+/********************************************************
+ * read_clip -- Read a clip, decoding it if we have to
+ *
+ * Parameters
+ * 	name -- Name of the clip (the MP3)
+ * 	samples -- Where the sound goes
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_clip(const std::string& name, std::vector<int16_t>& samples)
+{
+    const std::string mp3_file = SOUND_DIR + name;	// Where it came from
+    const std::string wav_file = PCM_DIR + name.substr(0, name.rfind('.')) + ".wav";	// Decoded
+
+    struct stat mp3_info;	// When the MP3 was changed
+    struct stat wav_info;	// When the .wav was made
+    const bool have_mp3 = (stat(mp3_file.c_str(), &mp3_info) == 0);	// We can decode it
+    if (stat(wav_file.c_str(), &wav_info) != 0) {
+	if (!have_mp3) {
+	    syslog(LOG_ERR, "ERROR: No clip %s", mp3_file.c_str());
+	    return (false);
+	}
+	if (!decode(mp3_file, wav_file))
+	    return (false);
+    } else if (have_mp3 && (mp3_info.st_mtime > wav_info.st_mtime)) {
+	if (!decode(mp3_file, wav_file))
+	    return (false);
+    }
+    return (read_wav(wav_file, samples));
+}
+/********************************************************
+ * loader_thread -- Read all the clips, in say order
+ ********************************************************/
+static void* loader_thread(void*)
+{
+    const int64_t start = now_us();	// When we started
+    unsigned int count = 0;		// Clips loaded
+    size_t bytes = 0;			// Memory they take
+    for (auto& name: load_order) {
+	std::vector<int16_t> samples;	// The sound
+	const bool good = read_clip(name, samples);
+
+	if (pthread_mutex_lock(&audio_lock) != 0)
+	    die("Unable to obtain mutex");
+	clip& entry = clips[name];
+	entry.samples.swap(samples);
+	entry.loaded = true;
+	entry.bad = !good;
+	if (good) {
+	    ++count;
+	    bytes += entry.samples.size() * sizeof(int16_t);
+	}
+	pthread_cond_broadcast(&clip_loaded);
+	if (pthread_mutex_unlock(&audio_lock) != 0)
+	    die("Unable to release mutex");
+    }
+    syslog(LOG_INFO, "Loaded %u clips (%ld KB) in %ld ms", count,
+	    static_cast<long int>(bytes / 1024), static_cast<long int>((now_us() - start) / 1000));
+    return (NULL);
+}
+/********************************************************
+ * set_fade -- Start a voice fading
+ *
+ * Parameters
+ * 	sound -- The voice
+ * 	gain -- Where it's going
+ * 	ms -- How long it takes (0 for right now)
+ ********************************************************/
+static void set_fade(voice& sound, const float gain, const unsigned int ms)
+{
+    const float max_gain = AUDIO_MAX_GAIN;	// Loudest it can be
+    sound.target = (gain < 0.0) ? 0.0 : (gain > max_gain) ? max_gain : gain;
+    const unsigned int blocks = ms * (AUDIO_RATE / 1000) / BLOCK_FRAMES;	// Blocks the fade takes
+    if (blocks == 0) {
+	sound.gain = sound.target;
+	sound.step = 0.0;
+    } else {
+	sound.step = (sound.target - sound.gain) / blocks;
+    }
+}
+/********************************************************
+ * end_voice -- A voice is done
+ *
+ * Parameters
+ * 	sound -- The voice
+ * 	when -- When its last sample is heard
+ ********************************************************/
+static void end_voice(voice& sound, const int64_t when)
+{
+    if (sound.kind == AUDIO_VOICE::NARRATION) {
+	heard_us = when;
+	pthread_cond_broadcast(&clip_done);
+    }
+    sound.id = 0;
+}
+/********************************************************
+ * mix_voice -- Add a block of a voice to the mix
+ *
+ * Parameters
+ * 	sound -- The voice
+ * 	mix -- Where the block goes
+ * 	frames -- Frames in the block
+ * 	when -- When the block will be heard
+ ********************************************************/
+static void mix_voice(voice& sound, int32_t* mix, const unsigned int frames, const int64_t when)
+{
+    if (!sound.started) {
+	const long int latency = when - sound.start_us;	// Time to get it started
+	++starts;
+	latency_us += latency;
+	if (latency > latency_max_us)
+	    latency_max_us = latency;
+	sound.started = true;
+    }
+    if (sound.gain != sound.target) {
+	sound.gain += sound.step;
+	if ((sound.step > 0.0) ? (sound.gain >= sound.target) : (sound.gain <= sound.target))
+	    sound.gain = sound.target;
+    }
+    if (sound.release && (sound.gain <= 0.0)) {
+	end_voice(sound, when);
+	return;
+    }
+    const float level = sound.gain * ((sound.kind == AUDIO_VOICE::BACKGROUND) ? duck : 1.0);	// Gain now
+    const int gain = static_cast<int>(level * GAIN_UNITY + 0.5);	// Gain for the mixer
+
+    const std::vector<int16_t>& samples = sound.sound->samples;	// What we are playing
+    size_t want = frames * AUDIO_CHANNELS;	// Samples still to mix
+    while (want > 0) {
+	size_t count = samples.size() - sound.position;	// Samples we can do
+	if (count > want)
+	    count = want;
+	mix_add(mix, samples.data() + sound.position, count, gain);
+	mix += count;
+	want -= count;
+	sound.position += count;
+	if (sound.position >= samples.size()) {
+	    if (!sound.loop || samples.empty()) {
+		end_voice(sound, when + (frames - want / AUDIO_CHANNELS) * 1000000L / AUDIO_RATE);
+		return;
+	    }
+	    sound.position = 0;
+	}
+    }
+}
+/********************************************************
+ * playback_thread -- Mix the voices and keep the sink fed
+ ********************************************************/
+static void* playback_thread(void*)
+{
+    rt_thread("audio", -1);
+    const float attack = (1.0 - DUCK_GAIN) * BLOCK_FRAMES / (DUCK_ATTACK_MS * (AUDIO_RATE / 1000));	// Duck per block
+    const float release = (1.0 - DUCK_GAIN) * BLOCK_FRAMES / (DUCK_RELEASE_MS * (AUDIO_RATE / 1000));	// Unduck per block
+    int32_t mix[PERIOD_FRAMES * AUDIO_CHANNELS];	// The mix
+    int16_t buffer[PERIOD_FRAMES * AUDIO_CHANNELS];	// A period of sound
+    while (true) {
+	if (pthread_mutex_lock(&audio_lock) != 0)
+	    die("Unable to obtain mutex");
+	if (flush) {
+	    sink->flush();
+	    flush = false;
+	}
+	const int64_t start = now_us();		// When we started mixing
+	const int64_t heard = start + sink->queued_us();	// When this period will be heard
+
+	unsigned int active = 0;	// Voices playing
+	bool talking = false;		// Some of them are narration
+	for (auto& sound: voices) {
+	    if (sound.id == 0)
+		continue;
+	    ++active;
+	    if (sound.kind == AUDIO_VOICE::NARRATION)
+		talking = true;
+	}
+	if (active > voices_max)
+	    voices_max = active;
+
+	memset(mix, '\0', sizeof(mix));
+	for (unsigned int block = 0; block < PERIOD_FRAMES; block += BLOCK_FRAMES) {
+	    const unsigned int frames = (PERIOD_FRAMES - block < BLOCK_FRAMES) ? PERIOD_FRAMES - block : BLOCK_FRAMES;
+	    if (talking)
+		duck = (duck - attack > DUCK_GAIN) ? duck - attack : DUCK_GAIN;
+	    else
+		duck = (duck + release < 1.0) ? duck + release : 1.0;
+	    for (auto& sound: voices) {
+		if (sound.id != 0)
+		    mix_voice(sound, mix + block * AUDIO_CHANNELS, frames, heard + block * 1000000L / AUDIO_RATE);
+	    }
+	}
+	mix_out(buffer, mix, PERIOD_FRAMES * AUDIO_CHANNELS);
+
+	const long int took = now_us() - start;	// Time to mix the period
+	++periods;
+	mix_us += took;
+	if (took > mix_max_us)
+	    mix_max_us = took;
+	if (pthread_mutex_unlock(&audio_lock) != 0)
+	    die("Unable to release mutex");
+
+	if (!sink->write(buffer, PERIOD_FRAMES)) {
+	    syslog(LOG_ERR, "ERROR: Audio sink failed -- no more sound");
+	    delete sink;
+	    sink = new null_sink;
+	}
+    }
+    return (NULL);
+}
+/********************************************************
+ * audio_setup -- Start loading the clips and playing
+ *
+ * Parameters
+ * 	clip_list -- Clips the demo says (in order, NULL at the end)
+ * 	sink_name -- Where the sound goes (see audio.h)
+ ********************************************************/
+void audio_setup(const char* const* const clip_list, const char* const sink_name)
+{
+    for (unsigned int i = 0; clip_list[i] != NULL; ++i) {
+	if (clips.find(clip_list[i]) != clips.end())
+	    continue;	// Listed twice
+	clips[clip_list[i]].loaded = false;
+	load_order.push_back(clip_list[i]);
+    }
+    sink = open_sink(sink_name);
+
+    // The loader is an ordinary thread, even if we are real time
+    pthread_attr_t attr;	// Attributes of the loader
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    struct sched_param param;	// Priority (must be 0 for SCHED_OTHER)
+    memset(&param, '\0', sizeof(param));
+    pthread_attr_setschedparam(&attr, &param);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    pthread_t id;	// ID of the threads
+    if (pthread_create(&id, &attr, loader_thread, NULL) != 0)
+	die("Unable to start the clip loader");
+    pthread_attr_destroy(&attr);
+
+    // Playback runs real time (just under the relays) when we are
+    if (rt_thread_create(&id, playback_thread, NULL) != 0)
+	die("Unable to start audio playback");
+    pthread_detach(id);
+}
+/********************************************************
+ * get_clip -- Get a clip to play (audio_lock held)
+ *
+ * Waits for the loader if it hasn't got to it yet.
+ *
+ * Returns
+ * 	The clip (NULL if it can't be read)
+ ********************************************************/
+static const clip* get_clip(const char* const name)
+{
+    std::map<std::string, clip>::iterator entry = clips.find(name);
+    if (entry == clips.end()) {
+	++misses;
+	syslog(LOG_WARNING, "Clip %s is not in the clip list", name);
+	// Read it without the lock, so playback keeps going
+	if (pthread_mutex_unlock(&audio_lock) != 0)
+	    die("Unable to release mutex");
+	std::vector<int16_t> samples;	// The sound
+	const bool good = read_clip(name, samples);
+	if (pthread_mutex_lock(&audio_lock) != 0)
+	    die("Unable to obtain mutex");
+	clip& new_clip = clips[name];
+	new_clip.samples.swap(samples);
+	new_clip.bad = !good;
+	new_clip.loaded = true;
+	entry = clips.find(name);
+    }
+    if (!entry->second.loaded) {
+	const int64_t start = now_us();		// When we started waiting
+	++waits;
+	while (!entry->second.loaded)
+	    pthread_cond_wait(&clip_loaded, &audio_lock);
+	wait_us += now_us() - start;
+    }
+    if (entry->second.bad) {
+	syslog(LOG_ERR, "ERROR: Unable to play clip %s", name);
+	return (NULL);
+    }
+    return (&entry->second);
+}
+/********************************************************
+ * find_voice -- Find a voice by its handle (audio_lock held)
+ *
+ * Returns
+ * 	The voice (NULL if it's done)
+ ********************************************************/
+static voice* find_voice(const int id)
+{
+    for (auto& sound: voices) {
+	if ((id != 0) && (sound.id == id))
+	    return (&sound);
+    }
+    return (NULL);
+}
+/********************************************************
+ * audio_start -- Start playing a clip
+ *
+ * Starting narration cuts off the narration playing.  A
+ * clip that can't be read is logged and skipped (the show
+ * goes on without it.)
+ *
+ * Parameters
+ * 	name -- The clip
+ * 	kind -- What it's for
+ * 	gain -- How loud (1.0 is full volume)
+ * 	fade_ms -- Time to fade in (0 for none)
+ * 	loop -- Play it over and over (until released)
+ *
+ * Returns
+ * 	Handle of the voice (-1 if it isn't playing)
+ ********************************************************/
+int audio_start(const char* const name, const AUDIO_VOICE kind, const float gain,
+	const unsigned int fade_ms, const bool loop)
+{
+    if (pthread_mutex_lock(&audio_lock) != 0)
+	die("Unable to obtain mutex");
+    int id = -1;	// Handle of the voice
+    const clip* const sound = get_clip(name);	// What to play
+    voice* free_voice = NULL;	// Voice to play it on
+    if (sound != NULL) {
+	for (auto& other: voices) {
+	    if ((kind == AUDIO_VOICE::NARRATION) && (other.id != 0) &&
+		    (other.kind == AUDIO_VOICE::NARRATION) && !other.release) {
+		++cut_offs;
+		other.release = true;
+		set_fade(other, 0.0, CUT_MS);
+	    }
+	    if ((other.id == 0) && (free_voice == NULL))
+		free_voice = &other;
+	}
+	if (free_voice == NULL)
+	    syslog(LOG_WARNING, "No voice free for clip %s", name);
+    }
+    if (free_voice != NULL) {
+	++plays;
+	if (++last_id <= 0)
+	    last_id = 1;
+	id = last_id;
+	free_voice->id = id;
+	free_voice->sound = sound;
+	free_voice->kind = kind;
+	free_voice->position = 0;
+	free_voice->loop = loop;
+	free_voice->gain = 0.0;
+	free_voice->release = false;
+	free_voice->start_us = now_us();
+	free_voice->started = false;
+	set_fade(*free_voice, gain, fade_ms);
+    }
+    if (pthread_mutex_unlock(&audio_lock) != 0)
+	die("Unable to release mutex");
+    return (id);
+}
+/********************************************************
+ * audio_play -- Start the narration
+ *
+ * Parameters
+ * 	name -- The clip
+ ********************************************************/
+void audio_play(const char* const name)
+{
+    audio_start(name, AUDIO_VOICE::NARRATION);
+}
+/********************************************************
+ * audio_wait -- Wait until the narration has been heard
+ ********************************************************/
+void audio_wait(void)
+{
+    if (pthread_mutex_lock(&audio_lock) != 0)
+	die("Unable to obtain mutex");
+    while (true) {
+	bool talking = false;	// There is narration
+	for (auto& sound: voices) {
+	    if ((sound.id != 0) && (sound.kind == AUDIO_VOICE::NARRATION))
+		talking = true;
+	}
+	if (!talking)
+	    break;
+	pthread_cond_wait(&clip_done, &audio_lock);
+    }
+    const int64_t until = heard_us;	// When the speaker is done with it
+    if (pthread_mutex_unlock(&audio_lock) != 0)
+	die("Unable to release mutex");
+    if (until > now_us())
+	sleep_until(until);
+}
+/********************************************************
+ * audio_stop -- Cut off the narration
+ *
+ * If nothing else is playing what is queued is thrown
+ * away too, so it stops right now.
+ ********************************************************/
+void audio_stop(void)
+{
+    if (pthread_mutex_lock(&audio_lock) != 0)
+	die("Unable to obtain mutex");
+    const int64_t now = now_us();	// The time
+    bool others = false;	// Other voices are playing
+    for (auto& sound: voices) {
+	if (sound.id == 0)
+	    continue;
+	if (sound.kind != AUDIO_VOICE::NARRATION) {
+	    others = true;
+	    continue;
+	}
+	if (!sound.release)
+	    ++cut_offs;
+	end_voice(sound, now);
+    }
+    if (!others) {
+	flush = true;
+	heard_us = now;
+    }
+    if (pthread_mutex_unlock(&audio_lock) != 0)
+	die("Unable to release mutex");
+}
+/********************************************************
+ * audio_fade -- Fade a voice to a new gain
+ *
+ * Parameters
+ * 	id -- Handle from audio_start
+ * 	gain -- Where it's going (1.0 is full volume)
+ * 	ms -- How long it takes
+ ********************************************************/
+void audio_fade(const int id, const float gain, const unsigned int ms)
+{
+    if (pthread_mutex_lock(&audio_lock) != 0)
+	die("Unable to obtain mutex");
+    voice* const sound = find_voice(id);	// The voice
+    if ((sound != NULL) && !sound->release)
+	set_fade(*sound, gain, ms);
+    if (pthread_mutex_unlock(&audio_lock) != 0)
+	die("Unable to release mutex");
+}
+/********************************************************
+ * audio_release -- Fade a voice out and stop it
+ *
+ * Parameters
+ * 	id -- Handle from audio_start
+ * 	fade_ms -- How long it takes (0 for right now)
+ ********************************************************/
+void audio_release(const int id, const unsigned int fade_ms)
+{
+    if (pthread_mutex_lock(&audio_lock) != 0)
+	die("Unable to obtain mutex");
+    voice* const sound = find_voice(id);	// The voice
+    if (sound != NULL) {
+	sound->release = true;
+	set_fade(*sound, 0.0, fade_ms);
+    }
+    if (pthread_mutex_unlock(&audio_lock) != 0)
+	die("Unable to release mutex");
+}
+/********************************************************
+ * audio_silence -- Fade out every voice
+ *
+ * Parameters
+ * 	fade_ms -- How long it takes (0 stops everything
+ * 		right now, queued sound and all)
+ ********************************************************/
+void audio_silence(const unsigned int fade_ms)
+{
+    if (pthread_mutex_lock(&audio_lock) != 0)
+	die("Unable to obtain mutex");
+    const int64_t now = now_us();	// The time
+    for (auto& sound: voices) {
+	if (sound.id == 0)
+	    continue;
+	if (fade_ms == 0) {
+	    end_voice(sound, now);
+	} else {
+	    sound.release = true;
+	    set_fade(sound, 0.0, fade_ms);
+	}
+    }
+    if (fade_ms == 0) {
+	flush = true;
+	heard_us = now;
+    }
+    if (pthread_mutex_unlock(&audio_lock) != 0)
+	die("Unable to release mutex");
+}
+/********************************************************
+ * audio_stats -- Log how the sound has done
+ ********************************************************/
+void audio_stats(void)
+{
+    if (pthread_mutex_lock(&audio_lock) != 0)
+	die("Unable to obtain mutex");
+    if (starts != 0) {
+	syslog(LOG_INFO, "Audio: %u clips, start latency avg %ld max %ld ms, %u waits (%ld ms), "
+		"%u cut off, %u not in the list, %u underruns",
+		plays, latency_us / starts / 1000, latency_max_us / 1000, waits, wait_us / 1000,
+		cut_offs, misses, underruns);
+    }
+    if (periods != 0) {
+	syslog(LOG_INFO, "Mixer: %u voices at most, %ld us of mixing per second of sound, worst period %ld us",
+		voices_max, mix_us * (AUDIO_RATE / PERIOD_FRAMES) / periods, mix_max_us);
+    }
+    if (pthread_mutex_unlock(&audio_lock) != 0)
+	die("Unable to release mutex");
+}
@@ -0,0 +1,72 @@
+/********************************************************
+ * Play the narration and sounds (the demos)
+ *
+ * Every clip the demo says is decoded into memory when it
+ * starts, in the order the demo says them, by a loader
+ * thread.  The clips come from acme.sound/pcm/<clip>.wav,
+ * made from the MP3s by "make pcm" (part of install).  A
+ * clip without one is decoded with mpg321 the first time
+ * and the .wav kept.  Everything is converted to 16 bit
+ * stereo at 44.1 kHz when it's loaded.
+ *
+ * One playback thread mixes the voices playing (see
+ * mixer.h) and feeds the sink a period at a time (silence
+ * when nothing is playing), so a clip starts within one
+ * buffer of being asked for.  The time from asking to the
+ * first sample reaching the speaker, and what the mixing
+ * costs, are logged with the other statistics.
+ *
+ * Voices
+ * 	NARRATION -- One at a time (audio_play cuts off the
+ * 		last one).  audio_wait() waits for it.
+ * 	EFFECT -- Plays over everything
+ * 	BACKGROUND -- Music or ambience.  Ducked (turned down)
+ * 		while there is narration.
+ *
+ * Each voice has its own gain (1.0 is full volume, no more
+ * than AUDIO_MAX_GAIN) and can fade in, fade to a new gain,
+ * or fade out and stop.
+ *
+ * Sinks
+ * 	"default", "hw:0,0", ... -- ALSA device
+ * 	"null" -- Throw the sound away (at the real rate)
+ * 	"file:<name>" -- Write it to a file, silence and all
+ * 		(raw, play it with "aplay -f cd <name>")
+ *
+ * If the ALSA device can't be opened we log it and use
+ * the null sink, so the demo runs without a sound card.
+ *
+ * Usage
+ * 	audio_setup(clips, "default");	// NULL terminated list, in say order
+ * 	audio_play("yp.mp3");	// Cuts off the last narration
+ * 	audio_wait();		// Until it has been heard
+ * 	audio_stop();		// Cut it off now
+ *
+ * 	int wind = audio_start("wind.mp3", AUDIO_VOICE::BACKGROUND, 0.5, 2000, true);
+ * 	audio_fade(wind, 0.2, 1000);
+ * 	audio_release(wind, 3000);	// Fade out and stop
+ * 	audio_silence(500);	// Fade out everything
+ * 	audio_stats();		// Log how the sound did
+ ********************************************************/
+#ifndef __AUDIO_H__
+#define __AUDIO_H__
+
+static const unsigned int AUDIO_RATE = 44100;	// Samples per second
+static const unsigned int AUDIO_CHANNELS = 2;	// Stereo
+static const unsigned int AUDIO_MAX_VOICES = 8;	// Voices playing at once
+static const unsigned int AUDIO_MAX_GAIN = 2;	// Loudest a voice can be (louder is cut to this)
+
+// What a voice is for
+enum class AUDIO_VOICE {NARRATION, EFFECT, BACKGROUND};
+
+extern void audio_setup(const char* const* const clip_list, const char* const sink_name);
+extern void audio_play(const char* const name);
+extern void audio_wait(void);
+extern void audio_stop(void);
+extern int audio_start(const char* const name, const AUDIO_VOICE kind = AUDIO_VOICE::EFFECT,
+	const float gain = 1.0, const unsigned int fade_ms = 0, const bool loop = false);
+extern void audio_fade(const int id, const float gain, const unsigned int ms);
+extern void audio_release(const int id, const unsigned int fade_ms);
+extern void audio_silence(const unsigned int fade_ms);
+extern void audio_stats(void);
+#endif // __AUDIO_H__
@@ -1,2 +1,3 @@
-static const int GPIO_START_BUTTON = 6;	// This is used to start the button
-static const int GPIO_ACTIVE_PIN = 26;	// This tells us we are active
+// BCM GPIO numbers (wiringPi 6 and 26)
+static const int GPIO_START_BUTTON = 25;	// This is used to start the button
+static const int GPIO_ACTIVE_PIN = 12;	// This tells us we are active
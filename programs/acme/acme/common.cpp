@@ -1,6 +1,8 @@
 #include <iostream>
 
+#include <errno.h>
 #include <syslog.h>
+#include <time.h>
 
 #include "common.h"
 
@@ -25,6 +27,29 @@ void sleep_10(unsigned int sleep_time)
 	to_sleep = remain;
     }
 }
+/********************************************************
+ * now_us -- Get the CLOCK_MONOTONIC time in us
+ ********************************************************/
+int64_t now_us(void)
+{
+    struct timespec now;	// The time
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (static_cast<int64_t>(now.tv_sec) * 1000000LL + now.tv_nsec / 1000);
+}
+/********************************************************
+ * sleep_until -- Sleep until a CLOCK_MONOTONIC time (us)
+ *
+ * Only a signal starts the sleep over.  Any other error
+ * (a bad time) returns right away.
+ ********************************************************/
+void sleep_until(const int64_t when)
+{
+    struct timespec wake;	// When we wake up
+    wake.tv_sec = when / 1000000LL;
+    wake.tv_nsec = (when % 1000000LL) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR)
+	continue;
+}
 /********************************************************
  * Perform a system command verbosely
  *
@@ -4,6 +4,7 @@
 #ifndef __COMMON_H__
 #define __COMMON_H__
 
+#include <stdint.h>
 #include <unistd.h>
 
 #include "relay.h"
@@ -12,6 +13,9 @@
 extern void die(const char* const msg) __attribute__((noreturn));
 extern void sleep_10(unsigned int sleep_time);
 
+extern int64_t now_us(void);
+extern void sleep_until(const int64_t when);
+
 extern void tv_on(void);
 extern void tv_off(void);
 
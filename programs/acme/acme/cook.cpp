@@ -0,0 +1,514 @@
+/********************************************************
+ * cook -- Turn the pictures in raw into slides (.fb files)
+ *
+ * Usage: cook [-j <jobs>] [-d <device>] [-g <width>x<height>]
+ * 		[-b <bpp>] [-l <line bytes>] [-o <dir>] [<file> ...]
+ *
+ * 	-j <jobs> Pictures to cook at once (default one per core)
+ * 	-d <device> Frame buffer to get the slide format from
+ * 		(default /dev/fb0)
+ * 	-g <width>x<height> Size of the screen (don't ask the
+ * 		frame buffer, for cooking without a display)
+ * 	-b <bpp> Bits per pixel with -g: 16 (RGB565, default),
+ * 		24 (RGB888) or 32 (XRGB8888)
+ * 	-l <line bytes> Bytes in a screen line with -g (default
+ * 		width * bpp / 8)
+ * 	-o <dir> Where the slides go (default cooked)
+ * 	<file> Pictures to cook (default everything in raw)
+ *
+ * Reads PNG, JPEG and binary PPM (P6).  The picture is made
+ * as big as it can be and still fit on the screen (like
+ * fbi --autozoom), centered on black.  It is scaled with a
+ * Lanczos filter in linear light and dithered down to the
+ * frame buffer format.
+ *
+ * The slide is a dump of the screen (line bytes * height),
+ * the same as a copy of /dev/fb0.  The format is written to
+ * slides.format in the slide directory.
+ ********************************************************/
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include "slide-format.h"
+
+static const char* const RAW_DIR = "raw";	// Where the pictures are
+
+static slide_format format;	// The format we are cooking
+
+static std::vector<std::string> files;	// The pictures to cook
+static size_t next_file = 0;		// Next one to cook
+static unsigned int failed = 0;		// Ones that didn't cook
+static pthread_mutex_t cook_lock = PTHREAD_MUTEX_INITIALIZER;	// Protects the above and cout
+static std::string out_dir = "cooked";	// Where the slides go
+
+/********************************************************
+ * usage -- Tell the user how to use us
+ ********************************************************/
+static void usage(void)
+{
+    std::cout << "Usage is cook [-j <jobs>] [-d <device>] [-g <width>x<height>] [-b <bpp>] [-l <line bytes>] [-o <dir>] [<file> ...]" << std::endl;
+    std::cout << "	-j <jobs> Pictures to cook at once (default one per core)" << std::endl;
+    std::cout << "	-d <device> Frame buffer to get the slide format from (default /dev/fb0)" << std::endl;
+    std::cout << "	-g <width>x<height> Size of the screen (don't ask the frame buffer)" << std::endl;
+    std::cout << "	-b <bpp> Bits per pixel with -g: 16 (RGB565, default), 24 or 32 (XRGB8888)" << std::endl;
+    std::cout << "	-l <line bytes> Bytes in a screen line with -g (default width * bpp / 8)" << std::endl;
+    std::cout << "	-o <dir> Where the slides go (default cooked)" << std::endl;
+    std::cout << "	<file> Pictures to cook (default everything in " << RAW_DIR << ")" << std::endl;
+    exit(8);
+}
+/********************************************************
+ * report -- Say something (one thread at a time)
+ ********************************************************/
+static void report(const std::string& message)
+{
+    pthread_mutex_lock(&cook_lock);
+    std::cout << message << std::endl;
+    pthread_mutex_unlock(&cook_lock);
+}
+/********************************************************
+ * now_ms -- Get the CLOCK_MONOTONIC time in ms
+ ********************************************************/
+static long int now_ms(void)
+{
+    struct timespec now;	// The time
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000L + now.tv_nsec / 1000000);
+}
+/********************************************************
+ * set_format -- Make the format from the command line
+ *
+ * Parameters
+ * 	geometry -- <width>x<height>
+ * 	bpp -- Bits per pixel
+ * 	line_length -- Bytes in a line (0 for no padding)
+ ********************************************************/
+static void set_format(const char* const geometry, const unsigned int bpp,
+	const unsigned int line_length)
+{
+    if (sscanf(geometry, "%ux%u", &format.width, &format.height) != 2 ||
+	    (format.width == 0) || (format.height == 0)) {
+	std::cout << "ERROR: Bad geometry " << geometry << std::endl;
+	usage();
+    }
+    memset(&format.red, '\0', sizeof(format.red));
+    memset(&format.green, '\0', sizeof(format.green));
+    memset(&format.blue, '\0', sizeof(format.blue));
+    format.bpp = bpp;
+    switch (bpp) {
+	case 16:
+	    format.red.offset = 11;	format.red.length = 5;
+	    format.green.offset = 5;	format.green.length = 6;
+	    format.blue.offset = 0;	format.blue.length = 5;
+	    break;
+	case 24:
+	case 32:
+	    format.red.offset = 16;	format.red.length = 8;
+	    format.green.offset = 8;	format.green.length = 8;
+	    format.blue.offset = 0;	format.blue.length = 8;
+	    break;
+	default:
+	    std::cout << "ERROR: Can't cook " << bpp << " bits per pixel" << std::endl;
+	    usage();
+    }
+    format.line_length = (line_length != 0) ? line_length : format.width * bpp / 8;
+    if (format.line_length < format.width * bpp / 8) {
+	std::cout << "ERROR: Line is shorter than the screen" << std::endl;
+	usage();
+    }
+}
+/********************************************************
+ * query_format -- Get the format from the frame buffer
+ *
+ * Parameters
+ * 	device -- The frame buffer
+ ********************************************************/
+static void query_format(const char* const device)
+{
+    const int fb_fd = open(device, O_RDONLY);
+    if (fb_fd < 0) {
+	std::cout << "ERROR: Could not open " << device << " (use -g to cook without a display)" << std::endl;
+	exit(8);
+    }
+    if (!format_query(fb_fd, format)) {
+	std::cout << "ERROR: Can't cook for " << device << " (use -g to cook without a display)" << std::endl;
+	exit(8);
+    }
+    close(fb_fd);
+}
+/********************************************************
+ * read_ppm_number -- Read a number from a PPM header
+ *
+ * Skips white space and comments.  Eats the one white
+ * space character after the number.
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_ppm_number(FILE* const in_file, unsigned int& value)
+{
+    int ch = getc(in_file);	// Character we are looking at
+    while (true) {
+	if (ch == '#') {
+	    while ((ch != '\n') && (ch != EOF))
+		ch = getc(in_file);
+	} else if (isspace(ch)) {
+	    ch = getc(in_file);
+	} else {
+	    break;
+	}
+    }
+    if (!isdigit(ch))
+	return (false);
+    value = 0;
+    while (isdigit(ch)) {
+	value = value * 10 + (ch - '0');
+	ch = getc(in_file);
+    }
+    return (true);
+}
+/********************************************************
+ * read_ppm -- Read a binary PPM (P6) file
+ *
+ * Parameters
+ * 	name -- File to read
+ * 	image -- Where to put it
+ * 	error -- What went wrong
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_ppm(const std::string& name, picture& image, std::string& error)
+{
+    FILE* in_file = fopen(name.c_str(), "rb");
+    if (in_file == NULL) {
+	error = "can't open";
+	return (false);
+    }
+    unsigned int max_value;	// Biggest sample
+    if ((getc(in_file) != 'P') || (getc(in_file) != '6') ||
+	    !read_ppm_number(in_file, image.width) || !read_ppm_number(in_file, image.height) ||
+	    !read_ppm_number(in_file, max_value) || (max_value == 0) || (max_value > 65535) ||
+	    (image.width == 0) || (image.height == 0)) {
+	fclose(in_file);
+	error = "bad PPM header";
+	return (false);
+    }
+    const size_t samples = static_cast<size_t>(image.width) * image.height * 3;	// Samples in the file
+    const size_t sample_size = (max_value < 256) ? 1 : 2;	// Bytes in a sample
+    std::vector<uint8_t> data(samples * sample_size);		// Samples from the file
+    const size_t size = fread(data.data(), 1, data.size(), in_file);
+    fclose(in_file);
+    if (size != data.size()) {
+	error = "PPM file is short";
+	return (false);
+    }
+    image.rgb.resize(samples);
+    for (size_t i = 0; i < samples; ++i) {
+	const unsigned int value = (sample_size == 1) ? data[i] : (data[i * 2] << 8) | data[i * 2 + 1];
+	image.rgb[i] = (value * 255 + max_value / 2) / max_value;
+    }
+    return (true);
+}
+/********************************************************
+ * read_png -- Read a PNG file
+ *
+ * Transparent parts come out black.
+ *
+ * Parameters
+ * 	name -- File to read
+ * 	image -- Where to put it
+ * 	error -- What went wrong
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_png(const std::string& name, picture& image, std::string& error)
+{
+    png_image png;	// The PNG decoder
+    memset(&png, '\0', sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (png_image_begin_read_from_file(&png, name.c_str()) == 0) {
+	error = png.message;
+	return (false);
+    }
+    png.format = PNG_FORMAT_RGB;
+    image.width = png.width;
+    image.height = png.height;
+    image.rgb.resize(PNG_IMAGE_SIZE(png));
+
+    png_color background;	// What shows through
+    memset(&background, '\0', sizeof(background));
+    if (png_image_finish_read(&png, &background, image.rgb.data(), 0, NULL) == 0) {
+	error = png.message;
+	png_image_free(&png);
+	return (false);
+    }
+    return (true);
+}
+
+// JPEG error handler that gets us out instead of exiting
+struct jpeg_error {
+    struct jpeg_error_mgr manager;	// The standard handler
+    jmp_buf escape;			// Where to go on an error
+};
+/********************************************************
+ * jpeg_error_exit -- Get out of the JPEG decoder
+ ********************************************************/
+static void jpeg_error_exit(j_common_ptr info)
+{
+    longjmp(reinterpret_cast<jpeg_error*>(info->err)->escape, 1);
+}
+/********************************************************
+ * read_jpeg -- Read a JPEG file
+ *
+ * Parameters
+ * 	name -- File to read
+ * 	image -- Where to put it
+ * 	error -- What went wrong
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_jpeg(const std::string& name, picture& image, std::string& error)
+{
+    FILE* in_file = fopen(name.c_str(), "rb");
+    if (in_file == NULL) {
+	error = "can't open";
+	return (false);
+    }
+    struct jpeg_decompress_struct info;	// The JPEG decoder
+    struct jpeg_error errors;		// Its error handler
+    info.err = jpeg_std_error(&errors.manager);
+    errors.manager.error_exit = jpeg_error_exit;
+    if (setjmp(errors.escape) != 0) {
+	char message[JMSG_LENGTH_MAX];	// What went wrong
+	(*info.err->format_message)(reinterpret_cast<j_common_ptr>(&info), message);
+	error = message;
+	jpeg_destroy_decompress(&info);
+	fclose(in_file);
+	return (false);
+    }
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, in_file);
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&info);
+
+    image.width = info.output_width;
+    image.height = info.output_height;
+    image.rgb.resize(static_cast<size_t>(image.width) * image.height * 3);
+    while (info.output_scanline < info.output_height) {
+	JSAMPROW row = &image.rgb[static_cast<size_t>(info.output_scanline) * image.width * 3];
+	jpeg_read_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    fclose(in_file);
+    return (true);
+}
+/********************************************************
+ * read_picture -- Read a picture (any type we know)
+ *
+ * Parameters
+ * 	name -- File to read
+ * 	image -- Where to put it
+ * 	error -- What went wrong
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_picture(const std::string& name, picture& image, std::string& error)
+{
+    FILE* in_file = fopen(name.c_str(), "rb");
+    if (in_file == NULL) {
+	error = "can't open";
+	return (false);
+    }
+    uint8_t magic[4];	// Start of the file
+    const size_t size = fread(magic, 1, sizeof(magic), in_file);
+    fclose(in_file);
+
+    // Go by what is in the file, not the name
+    if ((size == 4) && (magic[0] == 0x89) && (magic[1] == 'P') && (magic[2] == 'N') && (magic[3] == 'G'))
+	return (read_png(name, image, error));
+    if ((size >= 2) && (magic[0] == 0xFF) && (magic[1] == 0xD8))
+	return (read_jpeg(name, image, error));
+    if ((size >= 2) && (magic[0] == 'P') && (magic[1] == '6'))
+	return (read_ppm(name, image, error));
+    error = "not a PNG, JPEG or PPM file";
+    return (false);
+}
+/********************************************************
+ * cook_picture -- Make a slide from a picture
+ *
+ * Parameters
+ * 	name -- The picture
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool cook_picture(const std::string& name)
+{
+    picture image;		// The picture
+    std::string error;		// What went wrong
+    if (!read_picture(name, image, error)) {
+	report("ERROR: " + name + ": " + error);
+	return (false);
+    }
+
+    std::vector<uint8_t> slide;	// The slide
+    slide_make(image, format, slide);
+
+    // Name is the picture without the directory and extension
+    std::string base = name.substr(name.rfind('/') + 1);	// Name of the slide
+    const size_t dot = base.rfind('.');
+    if ((dot != std::string::npos) && (dot != 0))
+	base.erase(dot);
+    const std::string slide_name = out_dir + "/" + base + ".fb";
+    const std::string temp_name = slide_name + ".tmp";
+
+    // Write it next to the old one and swap, so nobody sees half a slide
+    FILE* out_file = fopen(temp_name.c_str(), "wb");
+    if (out_file == NULL) {
+	report("ERROR: Could not create " + temp_name);
+	return (false);
+    }
+    const bool good = (fwrite(slide.data(), 1, slide.size(), out_file) == slide.size());
+    if ((fclose(out_file) != 0) || !good || (rename(temp_name.c_str(), slide_name.c_str()) != 0)) {
+	report("ERROR: Could not write " + slide_name);
+	unlink(temp_name.c_str());
+	return (false);
+    }
+    report(name + " (" + std::to_string(image.width) + "x" + std::to_string(image.height) +
+	    ") -> " + slide_name);
+    return (true);
+}
+/********************************************************
+ * cook_thread -- Cook pictures until there are none left
+ ********************************************************/
+static void* cook_thread(void*)
+{
+    while (true) {
+	pthread_mutex_lock(&cook_lock);
+	if (next_file >= files.size()) {
+	    pthread_mutex_unlock(&cook_lock);
+	    return (NULL);
+	}
+	const std::string name = files[next_file++];	// Picture to cook
+	pthread_mutex_unlock(&cook_lock);
+
+	if (!cook_picture(name)) {
+	    pthread_mutex_lock(&cook_lock);
+	    ++failed;
+	    pthread_mutex_unlock(&cook_lock);
+	}
+    }
+}
+/********************************************************
+ * list_raw -- Get the names of all the pictures in raw
+ ********************************************************/
+static void list_raw(void)
+{
+    DIR* dir = opendir(RAW_DIR);
+    if (dir == NULL) {
+	std::cout << "ERROR: Could not open " << RAW_DIR << std::endl;
+	exit(8);
+    }
+    struct dirent* entry;	// Entry in the directory
+    while ((entry = readdir(dir)) != NULL) {
+	if (entry->d_name[0] == '.')
+	    continue;
+	files.push_back(std::string(RAW_DIR) + "/" + entry->d_name);
+    }
+    closedir(dir);
+}
+
+int main(int argc, char* argv[])
+{
+    long int jobs = sysconf(_SC_NPROCESSORS_ONLN);	// Pictures at once
+    const char* device = "/dev/fb0";	// Frame buffer with the format
+    const char* geometry = NULL;	// Screen size (-g)
+    unsigned int bpp = 16;		// Bits per pixel (-b)
+    unsigned int line_length = 0;	// Bytes in a line (-l)
+
+    while (true) {
+	int opt = getopt(argc, argv, "j:d:g:b:l:o:");
+	if (opt < 0)
+	    break;
+	switch (opt)
+	{
+	    case 'j':
+		jobs = atol(optarg);
+		break;
+	    case 'd':
+		device = optarg;
+		break;
+	    case 'g':
+		geometry = optarg;
+		break;
+	    case 'b':
+		bpp = atoi(optarg);
+		break;
+	    case 'l':
+		line_length = atoi(optarg);
+		break;
+	    case 'o':
+		out_dir = optarg;
+		break;
+	    default:
+		usage();
+	}
+    }
+    if (geometry != NULL)
+	set_format(geometry, bpp, line_length);
+    else
+	query_format(device);
+
+    for (int i = optind; i < argc; ++i)
+	files.push_back(argv[i]);
+    if (files.empty())
+	list_raw();
+
+    std::cout << "Cooking " << files.size() << " pictures for " << format.width << "x" <<
+	format.height << " " << format.bpp << " bpp (" << format.line_length << " bytes a line)" << std::endl;
+    const std::string format_name = out_dir + "/" + FORMAT_FILE;	// Where the format goes
+    if (!format_write(format_name.c_str(), format)) {
+	std::cout << "ERROR: Could not write " << format_name << std::endl;
+	exit(8);
+    }
+
+    if (jobs < 1)
+	jobs = 1;
+    if (static_cast<size_t>(jobs) > files.size())
+	jobs = files.size();
+    const long int start = now_ms();	// When we started
+    std::vector<pthread_t> threads(jobs);	// The cooks
+    for (auto& id: threads) {
+	if (pthread_create(&id, NULL, cook_thread, NULL) != 0) {
+	    std::cout << "ERROR: Unable to start a cook" << std::endl;
+	    exit(8);
+	}
+    }
+    for (auto& id: threads)
+	pthread_join(id, NULL);
+
+    std::cout << "Cooked " << files.size() - failed << " of " << files.size() << " pictures in " <<
+	(now_ms() - start) / 1000.0 << " s (" << jobs << " at once)" << std::endl;
+    return ((failed == 0) ? 0 : 8);
+}
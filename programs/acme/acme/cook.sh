@@ -1,17 +1,10 @@
 #
-# Cook all the images in raw into .fb names
+# Cook all the images in raw into .fb names (and pack them)
 #
-TTY=`tty`
-FILES=`(cd raw;echo *)`
-for i in $FILES; do
-    echo $i
-    #setterm -term linux -blank poke >/dev/tty1 </dev/tty1
-    name=`echo $i | sed -e 's/\.[^\.]*$//'`
-    #fbi --autozoom --noverbose raw/$i --device /dev/fb0 --noedit </dev/tty1 >/dev/tty1 &
-    fbi --autozoom --noverbose raw/$i --device /dev/fb0 --noedit  <$TTY >$TTY&
-    sleep 10
-    cp /dev/fb0 cooked/$name.fb
-    killall fbi
-    sleep 1
-done
+# Uses the format of the screen.  To cook without a display
+# give the size:  cook.sh -g 592x448
+#
+make cook make-pack || exit 8
+./cook "$@" || exit 8
+./make-pack || exit 8
 chown pi:pi cooked/*
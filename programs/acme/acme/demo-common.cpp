@@ -6,6 +6,8 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include <syslog.h>
 #include <signal.h>
@@ -22,25 +24,29 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 
-#include <wiringPi.h>
-
 #include "relay.h"
 #include "hw.h"
 #include "buttons.h"
+#include "gpio.h"
 #include "demo-common.h"
+#include "display.h"
+#include "audio.h"
+#include "timeline.h"
+#include "rt.h"
 
 bool verbose = false;		// Chatter
 bool simulate = false;		// Do not do the work
 static bool no_button = false;	// Do not wait for button
+static const char* gpio_script = NULL;	// Mock GPIO script (NULL for the real pins)
+static const char* audio_sink = "default";	// Where the sound goes (see audio.h)
+static std::string timeline_file;	// The show (<DEMO_NAME>.timeline by default)
+static timeline show;			// What the demo does
+static gpio* pins;			// Our GPIO pins
+static const unsigned int START_DEBOUNCE = 50;	// Start button debounce (ms)
+static const unsigned int TRANSITION_MS = 500;	// Time for a slide to come in (ms)
 
 config acme_config;	// The configuraiton
 
-static const ssize_t FB_SIZE = 530432;	// Size of the frame buffer
-
-static int fb_fd;	// Frame buffer fd
-static void* fb_ptr;	// The FB data
-
-static pid_t last_pid = 0;
 /********************************************************
  * die -- Output a message and die
  *
@@ -52,79 +58,35 @@ void die(const char* const msg)
     std::cout << msg << std::endl;
     exit(8);
 }
-/********************************************************
- * Stop saying things
- ********************************************************/
-void stop_say(void)
-{
-    if (last_pid >= 0)
-    {
-	waitpid(last_pid, NULL, 0);
-    }
-    last_pid = -1;
-}
 /********************************************************
  * Display an image on the screen
  *
  * Parameters
  * 	image The image to display
+ * 	how How it replaces the one there (crossfade by default)
  *********************************************************/
-void image(const char* const image)
+void image(const char* const image, const TRANSITION how)
 {
-    stop_say();
+    audio_wait();	// Let the narration finish first
     if (verbose)
 	std::cout << "Image " << image << std::endl;
-    std::ostringstream file;	// Command to execute
-    file << "cooked/" << image;
-
-    int in_fd = open(file.str().c_str(), O_RDONLY);
-    if (in_fd < 0)
-	die("Unable to open image file ");
-
-    if (read(in_fd, fb_ptr, FB_SIZE) != FB_SIZE)
-	die("Read of input file failed");
-
-    int code = msync(fb_ptr, FB_SIZE, 0);
-    if (code != 0)
-	die("msync failure");
-
-    close(in_fd);
-}
-
-/********************************************************
- * Send sound to the speaker
- *
- * Parameters
- * 	words -- File containing the words
- *********************************************************/
-void say(const char* const words)
-{
-    std::ostringstream cmd;	// Command to execute
-    stop_say();
-    cmd << "mpg321 -q acme.sound/" << words << " 2>&1 >/dev/null";
-    if (verbose)
-	std::cout << "Say " << cmd.str() << std::endl;
-    last_pid = fork();	// Fork, get pid
-
-    if (last_pid == 0)
-    {
-	// Could do an exec here
-	system(cmd.str().c_str());
-	_exit(0);
-    }
+    display_show(image, how, TRANSITION_MS);
 }
-    
 
 /********************************************************
  * Tell user how to use us
  ********************************************************/
 static void usage(void)
 {
-    std::cout << "Usage is " << DEMO_NAME << " [-s] [-v] [-r] [-n]" << std::endl;
+    std::cout << "Usage is " << DEMO_NAME << " [-s] [-v] [-r] [-n] [-R<cpu>] [-g <script>] [-a <sink>] [-t <timeline>]" << std::endl;
     std::cout << "	-r Simulate " << std::endl;
     std::cout << "	-v Verbose " << std::endl;
     std::cout << "	-s syslog -> stdout " << std::endl;
     std::cout << " 	-n Start demo (and loop demo) with no button press" << std::endl;
+    std::cout << "	-R<cpu> Real time, pinned to <cpu> (-1 for any)" << std::endl;
+    std::cout << "	-g <script> Play a GPIO script (see gpio.h) instead of reading the pins" << std::endl;
+    std::cout << "	-a <sink> Where the sound goes: ALSA device, null or file:<name> (see audio.h)" << std::endl;
+    std::cout << "	-t <timeline> Run this show (default " << DEMO_NAME << ".timeline, see timeline.h)" << std::endl;
     exit(8);
 }
 
@@ -136,18 +98,25 @@ static void main_loop()
     image("idle.fb");
     while (true)
     {
-	if (! no_button)
-	    waitForInterrupt(GPIO_START_BUTTON, -1);
-
-	bool button  = (digitalRead(GPIO_START_BUTTON) != 0);
-	if (button || (no_button))
-	{
-	    //##tv_on();
-	    do_demo();
-	    //##tv_off();
-	    relay_reset();	// Clear everything just in case
-	    image("idle.fb");
+	if (! no_button) {
+	    gpio_event event;	// Start button event
+	    pins->wait(event);
+	    if (event.type != GPIO_EVENT::ON)
+		continue;
 	}
+	//##tv_on();
+	timeline_run(show);
+	//##tv_off();
+	relay_reset();	// Clear everything just in case
+	image("idle.fb");
+	audio_silence(TRANSITION_MS);	// Anything the demo left playing
+	display_stats();
+	audio_stats();
+	timeline_stats();
+	motion.stats();
+
+	// Presses during the demo don't start another one
+	pins->discard();
     }
 }
 /********************************************************
@@ -155,21 +124,19 @@ static void main_loop()
  ********************************************************/
 static void setup_gpio(void)
 {
-    if (wiringPiSetup() != 0) {
-	std::cerr << "ERROR: wiringPiSetup failed" << std::endl;
-	exit(8);
-    }
-    pinMode(GPIO_START_BUTTON, INPUT);	// Start button is an input
-
-    // Add in the pull up resistor
-    pullUpDnControl(GPIO_START_BUTTON, PUD_UP);
+    pins = gpio_open(gpio_script);
+    // Start button is an input (with the pull up resistor)
+    pins->add_input(GPIO_START_BUTTON, START_DEBOUNCE);
+    pins->start();
 }
 
 int main(int argc, char* argv[])
 {
     bool stdout_log = false;	// Standard out to debug
+    bool real_time = false;	// Run real time
+    int rt_cpu = RT_NO_CPU;	// CPU to run on when real time
     while (true) {
-	int opt = getopt(argc, argv, "svrn");
+	int opt = getopt(argc, argv, "svrnR:g:a:t:");
 	if (opt < 0)
 	    break;
 	switch (opt)
@@ -186,26 +153,42 @@ int main(int argc, char* argv[])
 	    case 'n':
 		no_button = true;
 		break;
+	    case 'R':
+		real_time = true;
+		rt_cpu = atoi(optarg);
+		break;
+	    case 'g':
+		gpio_script = optarg;
+		break;
+	    case 'a':
+		audio_sink = optarg;
+		break;
+	    case 't':
+		timeline_file = optarg;
+		break;
 	    default:
 		usage();
 	}
     }
     // Open up the syslog system
     openlog(DEMO_NAME, stdout_log ? LOG_PERROR : 0, LOG_USER); 
+    if (real_time) {
+	rt_setup(rt_cpu);
+	rt_thread(DEMO_NAME);
+    }
 
     relay_setup();
     relay_reset();
-    fb_fd = open("/dev/fb0", O_RDWR);	// Open the frame buffer
-    if (fb_fd < 0)
-	die("Could not open /dev/fb0");
-
-    ssize_t length = (FB_SIZE + sysconf(_SC_PAGE_SIZE)-1) / sysconf(_SC_PAGE_SIZE);
-    length *= sysconf(_SC_PAGE_SIZE);
 
-    // Length is the size of the fame buffer
-    fb_ptr = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_SHARED, fb_fd, 0);
-    if (fb_ptr == MAP_FAILED)
-	die("Unable to mmap frame buffer");
+    if (timeline_file.empty())
+	timeline_file = std::string(DEMO_NAME) + ".timeline";
+    if (!timeline_load(timeline_file.c_str(), show))
+	die("Unable to read the timeline");
+    // The idle slide is up between shows
+    std::vector<const char*> slides = {"idle.fb"};	// Slides in the order we show them
+    slides.insert(slides.end(), show.slide_list.begin(), show.slide_list.end());
+    display_setup(slides.data());
+    audio_setup(show.clip_list.data(), audio_sink);
 
     setup_gpio();
     main_loop();
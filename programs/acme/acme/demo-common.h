@@ -1,13 +1,11 @@
 #ifndef __DEMO_COMMON_H__
 #define __DEMO_COMMON_H__
-// Different for each demo
-extern void do_demo(void);
+#include "display.h"
 
+// Different for each demo (the show is in <DEMO_NAME>.timeline)
 extern const char* const DEMO_NAME;
 
 // Common functions
-extern void image(const char* const image);
-extern void say(const char* const words);
-extern void stop_say(void);
+extern void image(const char* const image, const TRANSITION how = TRANSITION::FADE);
 #endif // __DEMO_COMMON_H__
 
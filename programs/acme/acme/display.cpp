@@ -0,0 +1,514 @@
+/********************************************************
+ * Show the slides on the frame buffer
+ *
+ * See display.h
+ ********************************************************/
+#include <map>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "display.h"
+#include "slide-format.h"
+#include "slide-pack.h"
+#include "transition.h"
+
+static const char* const SLIDE_DIR = "cooked/";	// Where the slides are
+static const char* const SLIDE_PACK = "cooked/slides.pack";	// The slides, compressed
+static const long int FRAME_US = 1000000 / 60;	// Frame time (when we can't wait for the vertical blank)
+
+static int fb_fd = -1;		// Frame buffer fd
+static uint8_t* fb_ptr;		// The FB data
+
+static slide_format screen;	// Format of the screen
+static slide_format cooked;	// Format the slides were cooked in
+static size_t screen_size;	// Bytes in a screen
+static size_t cooked_size;	// Bytes in a cooked slide
+static bool fitting = false;	// Slides must be fit to the screen
+static std::string fit_dir;	// Where slides fit to this screen are kept
+
+// Double buffering (the frame buffer is two screens high)
+static bool panning = false;		// We are double buffered
+static bool have_vsync = true;		// FBIO_WAITFORVSYNC works
+static unsigned int front = 0;		// Buffer on the screen (0 or 1)
+static struct fb_var_screeninfo pan_var;	// Screen info used to pan
+static struct fb_var_screeninfo saved_var;	// Screen info before we changed it
+
+// A slide in the cache
+struct slide {
+    std::vector<uint8_t> data;	// The pixels
+    bool loaded;		// The loader has been through it
+    bool bad;			// Could not read it
+};
+static std::map<std::string, slide> slides;	// Every slide we know (by name)
+static std::vector<std::string> load_order;	// Order to load them (show order)
+static pthread_mutex_t slide_lock = PTHREAD_MUTEX_INITIALIZER;	// Protects slides
+static pthread_cond_t slide_loaded = PTHREAD_COND_INITIALIZER;	// Signaled as each one loads
+static const std::vector<uint8_t>* showing = NULL;	// Slide on the screen
+
+// Statistics
+static unsigned int shows = 0;		// Slides shown
+static unsigned int waits = 0;		// Times we waited for the loader
+static unsigned int misses = 0;		// Slides not in the list
+static long int wait_us = 0;		// Time spent waiting
+static long int copy_us = 0;		// Time spent copying
+static long int copy_max_us = 0;	// Longest copy
+static unsigned int transitions = 0;	// Transitions done
+static unsigned int frames = 0;		// Frames in them
+static unsigned int late_frames = 0;	// Frames that came more than 1.5 frame times late
+static long int frame_us = 0;		// Time between frames
+static long int frame_max_us = 0;	// Longest time between frames
+static long int draw_us = 0;		// Time drawing frames
+
+/********************************************************
+ * read_file -- Read a slide file
+ *
+ * Parameters
+ * 	file -- File to read
+ * 	size -- Size it should be
+ * 	data -- Where to put it
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_file(const std::string& file, const size_t size, std::vector<uint8_t>& data)
+{
+    int in_fd = open(file.c_str(), O_RDONLY);
+    if (in_fd < 0)
+	return (false);
+    data.resize(size);
+    size_t done = 0;	// Bytes read so far
+    while (done < size) {
+	ssize_t read_size = read(in_fd, data.data() + done, size - done);
+	if (read_size <= 0)
+	    break;
+	done += read_size;
+    }
+    char extra;		// There shouldn't be any more
+    const bool good = (done == size) && (read(in_fd, &extra, 1) == 0);
+    close(in_fd);
+    if (!good) {
+	syslog(LOG_ERR, "ERROR: Image file %s is not %ld bytes", file.c_str(), static_cast<long int>(size));
+	data.clear();
+    }
+    return (good);
+}
+/********************************************************
+ * read_cooked -- Read a slide from the pack or the SD card
+ *
+ * Parameters
+ * 	name -- Name of the slide
+ * 	data -- Where to put it (in the cooked format)
+ * 	when -- When the slide was last changed (returned)
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_cooked(const std::string& name, std::vector<uint8_t>& data, time_t& when)
+{
+    struct stat info;		// When the file changed
+    size_t packed_size;		// Size of the slide in the pack
+    const uint8_t* const packed = pack_find(name.c_str(), packed_size);
+    if (packed != NULL) {
+	when = (stat(SLIDE_PACK, &info) == 0) ? info.st_mtime : 0;
+	data.resize(cooked_size);
+	if (pack_decode(packed, packed_size, data.data(), cooked_size))
+	    return (true);
+	syslog(LOG_ERR, "ERROR: Slide %s is bad in %s", name.c_str(), SLIDE_PACK);
+	data.clear();
+	return (false);
+    }
+    const std::string file = SLIDE_DIR + name;	// File to read
+    if (stat(file.c_str(), &info) != 0) {
+	syslog(LOG_ERR, "ERROR: Unable to open image file %s", file.c_str());
+	return (false);
+    }
+    when = info.st_mtime;
+    return (read_file(file, cooked_size, data));
+}
+/********************************************************
+ * read_slide -- Get a slide ready for the screen
+ *
+ * If the slides weren't cooked for this screen they are
+ * fit to it, and the result kept in fit_dir so it only
+ * happens once.
+ *
+ * Parameters
+ * 	name -- Name of the slide
+ * 	data -- Where to put it
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_slide(const std::string& name, std::vector<uint8_t>& data)
+{
+    time_t when;	// When the cooked slide changed
+    if (!fitting)
+	return (read_cooked(name, data, when));
+
+    std::vector<uint8_t> slide;	// The slide as cooked
+    if (!read_cooked(name, slide, when))
+	return (false);
+
+    // Fit before (since the slide changed)?
+    const std::string fit_file = fit_dir + name;	// Where the fit slide is
+    struct stat info;		// When it was fit
+    if ((stat(fit_file.c_str(), &info) == 0) && (info.st_mtime >= when) &&
+	    read_file(fit_file, screen_size, data))
+	return (true);
+
+    picture image;		// The slide as a picture
+    slide_unpack(slide.data(), cooked, image);
+    slide_make(image, screen, data);
+
+    const std::string temp_file = fit_file + ".tmp";	// Where we write it
+    int out_fd = open(temp_file.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if ((out_fd < 0) || (write(out_fd, data.data(), screen_size) != static_cast<ssize_t>(screen_size)) ||
+	    (close(out_fd) != 0) || (rename(temp_file.c_str(), fit_file.c_str()) != 0)) {
+	syslog(LOG_WARNING, "Could not keep %s", fit_file.c_str());
+	unlink(temp_file.c_str());
+    }
+    return (true);
+}
+/********************************************************
+ * loader_thread -- Read all the slides, in show order
+ ********************************************************/
+static void* loader_thread(void*)
+{
+    const int64_t start = now_us();	// When we started
+    unsigned int count = 0;		// Slides loaded
+    for (auto& name: load_order) {
+	std::vector<uint8_t> data;	// The slide
+	const bool good = read_slide(name, data);
+
+	if (pthread_mutex_lock(&slide_lock) != 0)
+	    die("Unable to obtain mutex");
+	slide& entry = slides[name];
+	entry.data.swap(data);
+	entry.loaded = true;
+	entry.bad = !good;
+	if (good)
+	    ++count;
+	pthread_cond_broadcast(&slide_loaded);
+	if (pthread_mutex_unlock(&slide_lock) != 0)
+	    die("Unable to release mutex");
+    }
+    syslog(LOG_INFO, "Loaded %u slides (%ld KB) in %ld ms", count,
+	    static_cast<long int>(count * screen_size / 1024), static_cast<long int>((now_us() - start) / 1000));
+    return (NULL);
+}
+/********************************************************
+ * restore_screen -- Put the screen back the way we found it
+ ********************************************************/
+static void restore_screen(void)
+{
+    ioctl(fb_fd, FBIOPUT_VSCREENINFO, &saved_var);
+}
+/********************************************************
+ * setup_panning -- Make the frame buffer two screens high
+ *
+ * A slide is drawn in the screen we can't see, then we pan
+ * to it during the vertical blank, so nobody sees it drawn.
+ * If the driver won't do it we copy straight to the screen.
+ ********************************************************/
+static void setup_panning(void)
+{
+    struct fb_fix_screeninfo fix;	// Fixed screen information
+    if ((ioctl(fb_fd, FBIOGET_FSCREENINFO, &fix) != 0) ||
+	    (ioctl(fb_fd, FBIOGET_VSCREENINFO, &saved_var) != 0)) {
+	syslog(LOG_INFO, "No screen information -- copying slides to the screen");
+	return;
+    }
+    pan_var = saved_var;
+    pan_var.yres_virtual = saved_var.yres * 2;
+    pan_var.yoffset = 0;
+    if ((ioctl(fb_fd, FBIOPUT_VSCREENINFO, &pan_var) != 0) ||
+	    (ioctl(fb_fd, FBIOGET_VSCREENINFO, &pan_var) != 0) ||
+	    (ioctl(fb_fd, FBIOGET_FSCREENINFO, &fix) != 0) ||
+	    (pan_var.yres_virtual < saved_var.yres * 2) || (fix.smem_len < 2 * screen_size)) {
+	syslog(LOG_INFO, "Frame buffer can't be double buffered -- copying slides to the screen");
+	restore_screen();
+	return;
+    }
+    panning = true;
+    atexit(restore_screen);
+    syslog(LOG_INFO, "Slides are double buffered");
+}
+/********************************************************
+ * flip -- Show the buffer we just drew
+ *
+ * Waits for the vertical blank (when the driver can) so the
+ * whole slide changes at once.
+ *
+ * Returns
+ * 	false if the pan failed
+ ********************************************************/
+static bool flip(void)
+{
+    if (have_vsync) {
+	int screen = 0;	// Screen to wait for
+	if (ioctl(fb_fd, FBIO_WAITFORVSYNC, &screen) != 0) {
+	    syslog(LOG_INFO, "No vertical blank wait -- panning without it");
+	    have_vsync = false;
+	}
+    }
+    pan_var.yoffset = (1 - front) * pan_var.yres;
+    if (ioctl(fb_fd, FBIOPAN_DISPLAY, &pan_var) != 0)
+	return (false);
+    front = 1 - front;
+    return (true);
+}
+/********************************************************
+ * check_fit_dir -- Make sure the slides in fit_dir were fit
+ * to this screen
+ *
+ * The name of the directory only has the size and depth.
+ * The format of the screen they were fit to is kept in it,
+ * and if it isn't this screen (another line length or color
+ * order) the slides there are thrown away.
+ ********************************************************/
+static void check_fit_dir(void)
+{
+    const std::string format_file = fit_dir + FORMAT_FILE;	// Format they were fit to
+    slide_format kept;		// What that format is
+    if (format_read(format_file.c_str(), kept) && format_same(kept, screen))
+	return;
+
+    DIR* dir = opendir(fit_dir.c_str());	// The old slides
+    if (dir != NULL) {
+	struct dirent* entry;	// A slide in it
+	while ((entry = readdir(dir)) != NULL) {
+	    if (entry->d_name[0] != '.')
+		unlink((fit_dir + entry->d_name).c_str());
+	}
+	closedir(dir);
+    }
+    if (!format_write(format_file.c_str(), screen))
+	syslog(LOG_WARNING, "Could not write %s", format_file.c_str());
+}
+/********************************************************
+ * display_setup -- Open the frame buffer and start loading
+ *
+ * Parameters
+ * 	slide_list -- Slides we'll show (NULL terminated, in
+ * 		the order they are shown)
+ ********************************************************/
+void display_setup(const char* const* const slide_list)
+{
+    fb_fd = open("/dev/fb0", O_RDWR);	// Open the frame buffer
+    if (fb_fd < 0)
+	die("Could not open /dev/fb0");
+
+    // The slides are cooked in the format of the pack, slides.format, or
+    // the one fbi used
+    if (!pack_open(SLIDE_PACK)) {
+	const std::string format_file = std::string(SLIDE_DIR) + FORMAT_FILE;
+	if (!format_read(format_file.c_str(), cooked))
+	    format_default(cooked);
+    } else {
+	pack_format(cooked);
+	syslog(LOG_INFO, "Reading slides from %s", SLIDE_PACK);
+    }
+    if (!format_query(fb_fd, screen)) {
+	syslog(LOG_INFO, "Unknown screen -- assuming the slides fit");
+	screen = cooked;
+    }
+    screen_size = format_size(screen);
+    cooked_size = format_size(cooked);
+    if (!format_same(screen, cooked)) {
+	char dir[64];	// Name of the fit directory
+	snprintf(dir, sizeof(dir), "%ux%u-%u/", screen.width, screen.height, screen.bpp);
+	fit_dir = std::string(SLIDE_DIR) + dir;
+	mkdir(fit_dir.c_str(), 0755);
+	check_fit_dir();
+	fitting = true;
+	syslog(LOG_INFO, "Slides are %ux%u %u bpp, screen is %ux%u %u bpp -- fitting them in %s",
+		cooked.width, cooked.height, cooked.bpp, screen.width, screen.height, screen.bpp,
+		fit_dir.c_str());
+    }
+
+    setup_panning();
+    ssize_t length = (panning ? 2 : 1) * screen_size;	// What we use of the frame buffer
+    length = (length + sysconf(_SC_PAGE_SIZE)-1) / sysconf(_SC_PAGE_SIZE);
+    length *= sysconf(_SC_PAGE_SIZE);
+
+    // Length is the size of the fame buffer
+    void* map = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_SHARED, fb_fd, 0);
+    if (map == MAP_FAILED)
+	die("Unable to mmap frame buffer");
+    fb_ptr = static_cast<uint8_t*>(map);
+
+    for (int i = 0; (slide_list != NULL) && (slide_list[i] != NULL); ++i) {
+	if (slides.find(slide_list[i]) != slides.end())
+	    continue;	// Listed twice
+	slides[slide_list[i]].loaded = false;
+	load_order.push_back(slide_list[i]);
+    }
+
+    // The loader is an ordinary thread, even if we are real time
+    pthread_attr_t attr;	// Attributes of the loader
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    struct sched_param param;	// Priority (must be 0 for SCHED_OTHER)
+    memset(&param, '\0', sizeof(param));
+    pthread_attr_setschedparam(&attr, &param);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    pthread_t id;	// ID of the loader
+    if (pthread_create(&id, &attr, loader_thread, NULL) != 0)
+	die("Unable to start the slide loader");
+    pthread_attr_destroy(&attr);
+}
+/********************************************************
+ * put -- Put a whole slide on the screen
+ ********************************************************/
+static void put(const std::vector<uint8_t>& data)
+{
+    const int64_t start = now_us();	// Start of the copy
+    if (panning) {
+	// Draw in the hidden screen, then show it
+	memcpy(fb_ptr + (1 - front) * screen_size, data.data(), screen_size);
+	if (!flip()) {
+	    syslog(LOG_ERR, "ERROR: Frame buffer pan failed -- copying slides to the screen");
+	    panning = false;
+	}
+    }
+    if (!panning)
+	memcpy(fb_ptr + front * screen_size, data.data(), screen_size);
+    const long int copy_time = now_us() - start;	// Time for the copy
+    ++shows;
+    copy_us += copy_time;
+    if (copy_time > copy_max_us)
+	copy_max_us = copy_time;
+}
+/********************************************************
+ * transition -- Go from the slide on the screen to another
+ *
+ * How far along each frame is comes from the clock, so a
+ * slow frame makes the next one jump ahead rather than
+ * making the transition late.  Frames go up on the vertical
+ * blank when we are double buffered (and the driver can wait
+ * for it), otherwise every FRAME_US.
+ *
+ * Parameters
+ * 	to -- The new slide
+ * 	how -- FADE or WIPE
+ * 	ms -- How long it takes
+ ********************************************************/
+static void transition(const std::vector<uint8_t>& to, const TRANSITION how, const unsigned int ms)
+{
+    const std::vector<uint8_t>& from = *showing;	// The old slide
+    const int64_t start = now_us();		// When we started
+    const long int length = ms * 1000L;		// How long it takes (us)
+    int64_t last = start;			// When the last frame went up
+    int64_t next = start;			// When the next frame is due
+
+    ++transitions;
+    while (true) {
+	const int64_t now = now_us();	// Time for this frame
+	if (now - start >= length)
+	    break;
+	uint8_t* const frame = fb_ptr + (panning ? 1 - front : front) * screen_size;	// Where we draw
+	if (how == TRANSITION::WIPE)
+	    transition_wipe(frame, from.data(), to.data(), screen, (now - start) * screen.width / length);
+	else
+	    transition_blend(frame, from.data(), to.data(), screen, (now - start) * BLEND_MAX / length);
+	draw_us += now_us() - now;
+
+	if (panning && !flip()) {
+	    syslog(LOG_ERR, "ERROR: Frame buffer pan failed -- copying slides to the screen");
+	    panning = false;
+	}
+	if (!panning || !have_vsync) {
+	    next += FRAME_US;
+	    if (next > now_us())
+		sleep_until(next);
+	    else
+		next = now_us();	// Behind, don't try to catch up
+	}
+
+	const int64_t shown = now_us();	// When the frame went up
+	const long int interval = shown - last;	// Time since the last one
+	last = shown;
+	++frames;
+	frame_us += interval;
+	if (interval > frame_max_us)
+	    frame_max_us = interval;
+	if (interval > FRAME_US * 3 / 2)
+	    ++late_frames;
+    }
+    put(to);
+}
+/********************************************************
+ * display_show -- Put a slide on the screen
+ *
+ * If the loader hasn't got to the slide yet we wait for
+ * it.  A slide that isn't in the list is read now.
+ *
+ * Parameters
+ * 	name -- Name of the slide (in cooked)
+ * 	how -- How to get there from the slide on the screen
+ * 	ms -- How long the transition takes
+ ********************************************************/
+void display_show(const char* const name, const TRANSITION how, const unsigned int ms)
+{
+    if (pthread_mutex_lock(&slide_lock) != 0)
+	die("Unable to obtain mutex");
+    std::map<std::string, slide>::iterator entry = slides.find(name);
+    if (entry == slides.end()) {
+	++misses;
+	syslog(LOG_WARNING, "Slide %s is not in the slide list", name);
+	slide& new_slide = slides[name];
+	new_slide.bad = !read_slide(name, new_slide.data);
+	new_slide.loaded = true;
+	entry = slides.find(name);
+    }
+    if (!entry->second.loaded) {
+	const int64_t start = now_us();	// When we started waiting
+	++waits;
+	while (!entry->second.loaded)
+	    pthread_cond_wait(&slide_loaded, &slide_lock);
+	wait_us += now_us() - start;
+    }
+    if (pthread_mutex_unlock(&slide_lock) != 0)
+	die("Unable to release mutex");
+
+    // Once loaded a slide never changes, so we can use it without the lock
+    if (entry->second.bad)
+	die("Unable to open image file ");
+
+    if ((how == TRANSITION::CUT) || (ms == 0) || (showing == NULL))
+	put(entry->second.data);
+    else
+	transition(entry->second.data, how, ms);
+    showing = &entry->second.data;
+}
+/********************************************************
+ * display_stats -- Log how the slides have done
+ ********************************************************/
+void display_stats(void)
+{
+    if (shows == 0)
+	return;
+    syslog(LOG_INFO, "Slides: %u shown, copy avg %ld max %ld us, %u waits (%ld ms), %u not in the list",
+	    shows, copy_us / shows, copy_max_us, waits, wait_us / 1000, misses);
+    if (frames == 0)
+	return;
+    syslog(LOG_INFO, "Transitions: %u, %u frames at %ld fps (draw avg %ld us), worst frame %ld ms, %u late",
+	    transitions, frames, frames * 1000000L / frame_us, draw_us / frames, frame_max_us / 1000, late_frames);
+}
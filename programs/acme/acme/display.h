@@ -0,0 +1,47 @@
+/********************************************************
+ * Show the slides on the frame buffer (master and the demos)
+ *
+ * Every slide the program will show is read into memory when
+ * it starts, in the order the demo shows them, by a loader
+ * thread.  Showing a slide is then a memory copy into the
+ * frame buffer (no SD card reads while the demo runs.)
+ * The slides come from cooked/slides.pack (see slide-pack.h)
+ * when there is one, the .fb files in cooked when there isn't
+ * or a slide isn't in it.
+ *
+ * The size and pixel format of the screen are read from the
+ * frame buffer.  Slides cooked for another screen are fit to
+ * it (see slide-format.h) when they are loaded, and the fit
+ * slides kept in cooked/<width>x<height>-<bpp>/, so a new
+ * monitor only costs one slow start.  The screen's whole
+ * format is kept there in slides.format.  If it changes
+ * (same size, another line length or color order) the old
+ * fit slides are thrown away.
+ *
+ * When the driver lets us, the frame buffer is made two
+ * screens high.  The slide is copied to the hidden one and
+ * we pan to it (FBIOPAN_DISPLAY) in the vertical blank, so
+ * the whole slide changes at once.  Otherwise it is copied
+ * straight to the screen.
+ *
+ * A slide can come in with a crossfade or a wipe from the
+ * one on the screen (see transition.h).  The frame rate is
+ * logged with the other statistics.
+ *
+ * Usage
+ * 	display_setup(slides);	// NULL terminated list, in show order
+ * 	display_show("idle.fb");
+ * 	display_show("slide1.fb", TRANSITION::FADE, 500);
+ * 	display_stats();	// Log how the slides did
+ ********************************************************/
+#ifndef __DISPLAY_H__
+#define __DISPLAY_H__
+
+// How a slide replaces the one on the screen
+enum class TRANSITION {CUT, FADE, WIPE};
+
+extern void display_setup(const char* const* const slides);
+extern void display_show(const char* const name, const TRANSITION how = TRANSITION::CUT,
+	const unsigned int ms = 0);
+extern void display_stats(void);
+#endif // __DISPLAY_H__
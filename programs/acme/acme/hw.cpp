@@ -28,12 +28,33 @@ struct head_map h2_map = {
     H2_BELL
 };
 
+// Moves the arms.  Defined before the heads so it's still here when
+// they fold their arms on the way out.
+arm_motion motion;
+
+/********************************************************
+ * move_arms -- Start the arm motor
+ *
+ * Parameters
+ * 	go -- Move to go (else to stop)
+ * 	folding -- Fold the arm as it moves
+ * 	run_time -- Time the motor runs (1/10 s)
+ ********************************************************/
+void head::move_arms(const bool go, const bool folding, const unsigned int run_time)
+{
+    const arm_move move = {head_info.motor, head_info.direction, head_info.fold, go, folding, run_time};	// What to do
+    moving = motion.start(move);
+}
+
 /********************************************************
  * fold the arms of the signal
+ *
+ * Parameters
+ * 	wait -- Return when they are folded
  ********************************************************/
-void head::fold_arms(void)
+void head::fold_arms(const bool wait)
 {
-    int sleep_time = acme_config.get_arm_time() * 2;
+    const unsigned int run_time = acme_config.get_arm_time() * 2;
     // ### todo -- make a config item
     {
 	switch (arm_state)
@@ -41,15 +62,11 @@ void head::fold_arms(void)
 	    case ARM_STATE::ARM_NONE: 
 		break;
 	    case ARM_STATE::ARM_STOP:
-		relay("manual", head_info.fold, RELAY_STATE::RELAY_ON);
-		go_arms(sleep_time);
-		relay("manual", head_info.fold, RELAY_STATE::RELAY_OFF);
+		move_arms(true, true, run_time);
 		arm_state = ARM_STATE::ARM_NONE;
 		break;
 	    case ARM_STATE::ARM_GO:
-		relay("manual", head_info.fold, RELAY_STATE::RELAY_ON);
-		stop_arms(sleep_time);
-		relay("manual", head_info.fold, RELAY_STATE::RELAY_OFF);
+		move_arms(false, true, run_time);
 		arm_state = ARM_STATE::ARM_NONE;
 		break;
 	    default:
@@ -57,6 +74,8 @@ void head::fold_arms(void)
 		abort();
 	}
     }
+    if (wait)
+	wait_arms();
 }
 
 /********************************************************
@@ -65,8 +84,9 @@ void head::fold_arms(void)
  * Parameters
  * 	how -- Do we use light, arms, or both
  * 	enabled -- True if the arms are enabled
+ * 	wait -- Return when the arms are done
  *********************************************************/
-void head::stop(SIGNAL_HOW how, const bool enabled)
+void head::stop(SIGNAL_HOW how, const bool enabled, const bool wait)
 {
     if (how == SIGNAL_HOW::AS_CONF)
     {
@@ -93,6 +113,8 @@ void head::stop(SIGNAL_HOW how, const bool enabled)
 	default:
 	    die("Internal error: Bad how");
     }
+    if (wait)
+	wait_arms();
 }
 
 /********************************************************
@@ -101,8 +123,9 @@ void head::stop(SIGNAL_HOW how, const bool enabled)
  * Parameters
  * 	how -- Do we use light, arms, or both
  * 	enabled -- True if the arms are enabled
+ * 	wait -- Return when the arms are done
  *********************************************************/
-void head::go(enum SIGNAL_HOW how, const bool enabled)
+void head::go(enum SIGNAL_HOW how, const bool enabled, const bool wait)
 {
     if (how == SIGNAL_HOW::AS_CONF)
     {
@@ -128,6 +151,8 @@ void head::go(enum SIGNAL_HOW how, const bool enabled)
 	default:
 	    die("Internal error: Bad how");
     }
+    if (wait)
+	wait_arms();
 }
 /********************************************************
  * Turn the lights off
@@ -187,4 +212,12 @@ void flash_both(void)
     relay("manual", h1_map.yellow_light, RELAY_STATE::RELAY_OFF);
     relay("manual", h2_map.yellow_light, RELAY_STATE::RELAY_OFF);
 }
+/********************************************************
+ * Wait for the arms of both heads to stop moving
+ ********************************************************/
+void wait_arms(void)
+{
+    h1.wait_arms();
+    h2.wait_arms();
+}
 
@@ -9,6 +9,7 @@
 #include "relay.h"
 #include "conf.h"
 #include "common.h"
+#include "motion.h"
 
 // Turn relays into something we can use for common code
 struct head_map {
@@ -35,14 +36,15 @@ class head {
     private:
 	enum class ARM_STATE {ARM_NONE, ARM_STOP, ARM_GO};
 
-	ARM_STATE arm_state;		// Where's our arm
+	ARM_STATE arm_state;		// Where's our arm (or where it's going)
 	const head_map& head_info;	// How do we map things
+	arm_motion::move_id moving;	// Last arm move we started
 
     public:
 	// How do we change the stop/go aspect of the signal
 	enum class SIGNAL_HOW {ARMS_ONLY, LIGHTS_ONLY, ARMS_AND_LIGHTS, AS_CONF};
     public:
-	head(const struct head_map& _head_info): arm_state(ARM_STATE::ARM_NONE), head_info(_head_info) {};
+	head(const struct head_map& _head_info): arm_state(ARM_STATE::ARM_NONE), head_info(_head_info), moving(0) {};
 	head(const head&) = default;
 	head& operator = (const head&) = default;
 	~head(void)
@@ -50,37 +52,27 @@ class head {
 	    fold_arms();
 	}
     private:
-	void stop_arms(int sleep_time = -1) {
-	    if (arm_state != ARM_STATE::ARM_STOP)
-	    {
-		if (sleep_time < 0)
-		    sleep_time = acme_config.get_arm_time();
-
-		sleep_10(acme_config.get_arm_time());
-		relay("manual", head_info.direction, RELAY_STATE::RELAY_OFF);
-		relay("manual", head_info.motor, RELAY_STATE::RELAY_ON);
-		sleep_10(sleep_time);
-		relay("manual", head_info.motor, RELAY_STATE::RELAY_OFF);
+	void move_arms(const bool go, const bool folding, const unsigned int run_time);
+	void stop_arms(void) {
+	    if (arm_state != ARM_STATE::ARM_STOP) {
+		move_arms(false, false, acme_config.get_arm_time());
 		arm_state = ARM_STATE::ARM_STOP;
 	    }
 	}
-	void go_arms(int sleep_time = -1) {
+	void go_arms(void) {
 	    if (arm_state != ARM_STATE::ARM_GO) {
-		if (sleep_time < 0)
-		    sleep_time = acme_config.get_arm_time();
-
-		relay("manual", head_info.direction, RELAY_STATE::RELAY_ON);
-		relay("manual", head_info.motor, RELAY_STATE::RELAY_ON);
-		sleep_10(sleep_time);
-		relay("manual", head_info.motor, RELAY_STATE::RELAY_OFF);
-		relay("manual", head_info.direction, RELAY_STATE::RELAY_OFF);
+		move_arms(true, false, acme_config.get_arm_time());
 		arm_state = ARM_STATE::ARM_GO;
 	    }
 	}
     public:
-	void fold_arms(void);
-	void stop(SIGNAL_HOW how, const bool enabled);
-	void go(SIGNAL_HOW how, const bool enabled);
+	// wait -- Return when the arms are done (else as soon as they start moving)
+	void fold_arms(const bool wait = true);
+	void stop(SIGNAL_HOW how, const bool enabled, const bool wait = true);
+	void go(SIGNAL_HOW how, const bool enabled, const bool wait = true);
+	void wait_arms(void) {		// Until the arms stop moving
+	    motion.wait(moving);
+	}
 	void lights_off(void);
 	void bell()
 	{
@@ -88,6 +80,18 @@ class head {
 	    sleep_10(100);
 	    relay("manual", head_info.bell, RELAY_STATE::RELAY_OFF);
 	}
+	void ding(void)		// Tap the bell
+	{
+	    relay("manual", head_info.bell, RELAY_STATE::RELAY_ON);
+	    usleep(750);
+	    relay("manual", head_info.bell, RELAY_STATE::RELAY_OFF);
+	}
+	void flash(const unsigned int sleep_time)	// Yellow on for sleep_time (1/10 s)
+	{
+	    relay("manual", head_info.yellow_light, RELAY_STATE::RELAY_ON);
+	    sleep_10(sleep_time);
+	    relay("manual", head_info.yellow_light, RELAY_STATE::RELAY_OFF);
+	}
 	bool is_go(void) {
 	    return (arm_state == ARM_STATE::ARM_GO);
 	}
@@ -102,4 +106,7 @@ extern class head h2;	// Head two controller
 extern void ding_and_flash_both(void);
 extern void ding_both(void);
 extern void flash_both(void);
+
+// Wait for the arms of both heads to stop moving
+extern void wait_arms(void);
 #endif // __HW_H__
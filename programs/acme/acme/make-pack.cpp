@@ -0,0 +1,291 @@
+/********************************************************
+ * make-pack -- Put the cooked slides in a pack
+ *
+ * Usage: make-pack [-o <pack>] [<slide> ...]
+ *
+ * 	-o <pack> Pack to make (default cooked/slides.pack)
+ * 	<slide> Slides to pack (default the .fb files in cooked)
+ *
+ * Every slide is compressed (see slide-pack.h), then
+ * decoded again to check it.  The format of the slides comes
+ * from slides.format in cooked (or is the old fbi format
+ * if there isn't one).
+ ********************************************************/
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "slide-pack.h"
+
+bool verbose = false;		// Chatter (used by common.cpp)
+bool simulate = false;		// Do not do the work
+
+static const char* const COOKED_DIR = "cooked";	// Where the slides are
+static const unsigned int HASH_BITS = 16;	// Size of the match hash table
+static const unsigned int WINDOW = 65535;	// Furthest back a match can be
+static const unsigned int MIN_MATCH = 4;	// Shortest match
+static const unsigned int MAX_SEARCH = 64;	// Matches to look at for each byte
+static const unsigned int GOOD_MATCH = 1024;	// Stop looking at a match this long
+
+/********************************************************
+ * usage -- Tell the user how to use us
+ ********************************************************/
+static void usage(void)
+{
+    std::cout << "Usage is make-pack [-o <pack>] [<slide> ...]" << std::endl;
+    std::cout << "	-o <pack> Pack to make (default " << COOKED_DIR << "/slides.pack)" << std::endl;
+    std::cout << "	<slide> Slides to pack (default " << COOKED_DIR << "/*.fb)" << std::endl;
+    exit(8);
+}
+/********************************************************
+ * read_file -- Read a whole file
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+static bool read_file(const std::string& name, std::vector<uint8_t>& data)
+{
+    FILE* in_file = fopen(name.c_str(), "rb");
+    if (in_file == NULL)
+	return (false);
+    data.clear();
+    uint8_t buffer[64 * 1024];	// Part of the file
+    size_t size;		// Bytes we got
+    while ((size = fread(buffer, 1, sizeof(buffer), in_file)) > 0)
+	data.insert(data.end(), buffer, buffer + size);
+    const bool good = !ferror(in_file);
+    fclose(in_file);
+    return (good);
+}
+/********************************************************
+ * hash -- Hash of the 4 bytes at data
+ ********************************************************/
+static inline unsigned int hash(const uint8_t* const data)
+{
+    const uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    return ((value * 2654435761U) >> (32 - HASH_BITS));
+}
+/********************************************************
+ * put_length -- Put out the extra bytes of a length
+ ********************************************************/
+static void put_length(std::vector<uint8_t>& out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+	out.push_back(255);
+    out.push_back(length);
+}
+/********************************************************
+ * put_sequence -- Put out a sequence
+ *
+ * Parameters
+ * 	out -- Where it goes
+ * 	literals, literal_size -- The literals
+ * 	offset -- How far back the match is (0 for the last sequence)
+ * 	length -- Bytes in the match
+ ********************************************************/
+static void put_sequence(std::vector<uint8_t>& out, const uint8_t* const literals,
+	const size_t literal_size, const size_t offset, const size_t length)
+{
+    const size_t match_code = (offset == 0) ? 0 : length - MIN_MATCH;	// Match length in the token
+    out.push_back(((literal_size < 15 ? literal_size : 15) << 4) | (match_code < 15 ? match_code : 15));
+    if (literal_size >= 15)
+	put_length(out, literal_size - 15);
+    out.insert(out.end(), literals, literals + literal_size);
+    if (offset == 0)
+	return;
+    out.push_back(offset & 0xFF);
+    out.push_back(offset >> 8);
+    if (match_code >= 15)
+	put_length(out, match_code - 15);
+}
+/********************************************************
+ * encode -- Compress a slide
+ *
+ * Greedy, taking the longest of the last few places the
+ * next 4 bytes were seen (hash chains).
+ *
+ * Parameters
+ * 	in -- The slide
+ * 	out -- The compressed slide
+ ********************************************************/
+static void encode(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+{
+    std::vector<int32_t> head(1 << HASH_BITS, -1);	// Last place each hash was seen
+    std::vector<int32_t> chain(in.size(), -1);		// Place before that with the same hash
+    const size_t size = in.size();			// Bytes to compress
+    size_t anchor = 0;		// Start of the literals
+    size_t pos = 0;		// Where we are
+
+    out.clear();
+    while (pos + MIN_MATCH <= size) {
+	const unsigned int key = hash(&in[pos]);	// Hash of the next bytes
+	size_t best_length = 0;	// Longest match
+	size_t best_offset = 0;	// Where it is
+	unsigned int tries = 0;	// Matches looked at
+	for (int32_t cand = head[key]; (cand >= 0) && (pos - cand <= WINDOW) && (tries < MAX_SEARCH);
+		cand = chain[cand], ++tries) {
+	    size_t length = 0;	// Length of this match
+	    while ((pos + length < size) && (in[cand + length] == in[pos + length]))
+		++length;
+	    if (length > best_length) {
+		best_length = length;
+		best_offset = pos - cand;
+		if (length >= GOOD_MATCH)
+		    break;
+	    }
+	}
+	chain[pos] = head[key];
+	head[key] = pos;
+	if (best_length < MIN_MATCH) {
+	    ++pos;
+	    continue;
+	}
+	put_sequence(out, &in[anchor], pos - anchor, best_offset, best_length);
+
+	// Remember the places inside the match
+	const size_t end = pos + best_length;	// End of the match
+	for (++pos; (pos < end) && (pos + MIN_MATCH <= size); ++pos) {
+	    const unsigned int inside_key = hash(&in[pos]);
+	    chain[pos] = head[inside_key];
+	    head[inside_key] = pos;
+	}
+	pos = end;
+	anchor = pos;
+    }
+    put_sequence(out, &in[anchor], size - anchor, 0, 0);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string pack_name = std::string(COOKED_DIR) + "/slides.pack";	// Pack to make
+    while (true) {
+	int opt = getopt(argc, argv, "o:");
+	if (opt < 0)
+	    break;
+	switch (opt)
+	{
+	    case 'o':
+		pack_name = optarg;
+		break;
+	    default:
+		usage();
+	}
+    }
+    std::vector<std::string> files;	// Slides to pack
+    for (int i = optind; i < argc; ++i)
+	files.push_back(argv[i]);
+    if (files.empty()) {
+	DIR* dir = opendir(COOKED_DIR);
+	if (dir == NULL) {
+	    std::cout << "ERROR: Could not open " << COOKED_DIR << std::endl;
+	    exit(8);
+	}
+	struct dirent* entry;	// Entry in the directory
+	while ((entry = readdir(dir)) != NULL) {
+	    const size_t length = strlen(entry->d_name);
+	    if ((entry->d_name[0] != '.') && (length > 3) && (strcmp(entry->d_name + length - 3, ".fb") == 0))
+		files.push_back(std::string(COOKED_DIR) + "/" + entry->d_name);
+	}
+	closedir(dir);
+	std::sort(files.begin(), files.end());
+    }
+    if (files.empty()) {
+	std::cout << "ERROR: No slides to pack" << std::endl;
+	exit(8);
+    }
+
+    slide_format format;	// Format of the slides
+    const std::string format_name = std::string(COOKED_DIR) + "/" + FORMAT_FILE;
+    if (!format_read(format_name.c_str(), format)) {
+	std::cout << "No " << format_name << ", the slides were cooked by fbi" << std::endl;
+	format_default(format);
+    }
+
+    std::vector<pack_entry> index(files.size());	// Index of the pack
+    std::vector<std::vector<uint8_t> > packed(files.size());	// The compressed slides
+    std::vector<uint8_t> slide;		// A slide
+    std::vector<uint8_t> check;		// A slide decoded again
+    size_t slide_size = 0;		// Size of every slide
+    size_t offset = sizeof(pack_header) + index.size() * sizeof(pack_entry);	// Where the next slide goes
+    long int decode_us = 0;		// Time to decode them all
+
+    for (size_t i = 0; i < files.size(); ++i) {
+	if (!read_file(files[i], slide)) {
+	    std::cout << "ERROR: Could not read " << files[i] << std::endl;
+	    exit(8);
+	}
+	slide_size = format_size(format);
+	if (slide.size() != slide_size) {
+	    std::cout << "ERROR: " << files[i] << " is " << slide.size() << " bytes, not " << slide_size << std::endl;
+	    exit(8);
+	}
+	const std::string name = files[i].substr(files[i].rfind('/') + 1);	// Name of the slide
+	if (name.size() >= PACK_NAME_SIZE) {
+	    std::cout << "ERROR: Name " << name << " is too long" << std::endl;
+	    exit(8);
+	}
+	encode(slide, packed[i]);
+
+	check.assign(slide_size, 0);
+	const int64_t start = now_us();	// Start of the decode
+	const bool good = pack_decode(packed[i].data(), packed[i].size(), check.data(), check.size());
+	decode_us += now_us() - start;
+	if (!good || (check != slide)) {
+	    std::cout << "ERROR: " << files[i] << " did not decode" << std::endl;
+	    exit(8);
+	}
+
+	memset(&index[i], '\0', sizeof(index[i]));
+	strcpy(index[i].name, name.c_str());
+	index[i].offset = offset;
+	index[i].size = packed[i].size();
+	offset += packed[i].size();
+	std::cout << name << " " << slide_size / 1024 << " KB -> " << packed[i].size() / 1024 << " KB" << std::endl;
+    }
+
+    pack_header header;	// Start of the pack
+    memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+    header.count = index.size();
+    header.slide_size = slide_size;
+    header.width = format.width;
+    header.height = format.height;
+    header.bpp = format.bpp;
+    header.line_length = format.line_length;
+    header.red_offset = format.red.offset;
+    header.red_length = format.red.length;
+    header.green_offset = format.green.offset;
+    header.green_length = format.green.length;
+    header.blue_offset = format.blue.offset;
+    header.blue_length = format.blue.length;
+    memset(header.unused, '\0', sizeof(header.unused));
+
+    // Write it next to the old one and swap, so nobody sees half a pack
+    const std::string temp_name = pack_name + ".tmp";
+    FILE* out_file = fopen(temp_name.c_str(), "wb");
+    if (out_file == NULL) {
+	std::cout << "ERROR: Could not create " << temp_name << std::endl;
+	exit(8);
+    }
+    bool good = (fwrite(&header, sizeof(header), 1, out_file) == 1) &&
+	(fwrite(index.data(), sizeof(index[0]), index.size(), out_file) == index.size());
+    for (auto& data: packed)
+	good = good && (fwrite(data.data(), 1, data.size(), out_file) == data.size());
+    if ((fclose(out_file) != 0) || !good || (rename(temp_name.c_str(), pack_name.c_str()) != 0)) {
+	std::cout << "ERROR: Could not write " << pack_name << std::endl;
+	unlink(temp_name.c_str());
+	exit(8);
+    }
+    std::cout << "Packed " << files.size() << " slides: " << files.size() * slide_size / 1024 << " KB -> " <<
+	offset / 1024 << " KB, decode " << decode_us / files.size() << " us a slide" << std::endl;
+    return (0);
+}
@@ -16,22 +16,24 @@
 #include <sys/mman.h>
 #include <sys/fcntl.h>
 
-#include <wiringPi.h>
-
 #include "buttons.h"
+#include "gpio.h"
 #include "hw.h"
 #include "conf.h"
 #include "common.h"
+#include "display.h"
 
 bool verbose = false;
 bool simulate = false;
 
 config acme_config;	// The configuraiton
 
-// ### make common
-static int fb_fd;	// Frame buffer fd
-static void* fb_ptr;	// The FB data
-static const ssize_t FB_SIZE = 530432;	// Size of the frame buffer
+static const unsigned int ACTIVE_DEBOUNCE = 200;	// Active switch must hold this long (ms)
+static const char* gpio_script = NULL;	// Mock GPIO script (NULL for the real pins)
+static gpio* pins;			// Our GPIO pins
+
+// The only slide we show
+static const char* const MASTER_SLIDES[] = {"idle.fb", NULL};
 
 /********************************************************
  * die -- Output a message and die
@@ -57,14 +59,23 @@ static void byebye(int)
  ********************************************************/
 static void setup_gpio(void)
 {
-    if (wiringPiSetup() != 0) {
-	std::cerr << "ERROR: wiringPiSetup failed\r" << std::endl;
-	exit(8);
+    pins = gpio_open(gpio_script);
+    // The active control (with the pull up resistor)
+    pins->add_input(GPIO_ACTIVE_PIN, ACTIVE_DEBOUNCE);
+    pins->start();
+}
+/********************************************************
+ * wait_active -- Wait for the active switch
+ *
+ * Parameters
+ * 	active -- The state to wait for
+ ********************************************************/
+static void wait_active(const bool active)
+{
+    while (pins->read(GPIO_ACTIVE_PIN) != active) {
+	gpio_event event;	// Switch event (the level is all we want)
+	pins->wait(event);
     }
-    pinMode(GPIO_ACTIVE_PIN, INPUT);	// So is the active control
-
-    // Add in the pull up resistor
-    pullUpDnControl(GPIO_ACTIVE_PIN, PUD_UP);
 }
 
 /********************************************************
@@ -113,21 +124,7 @@ void image(const char* const image)
 {
     if (verbose)
 	std::cout << "Image " << image << std::endl;
-    std::ostringstream file;	// Command to execute
-    file << "cooked/" << image;
-
-    int in_fd = open(file.str().c_str(), O_RDONLY);
-    if (in_fd < 0)
-	die("Unable to open image file ");
-
-    if (read(in_fd, fb_ptr, FB_SIZE) != FB_SIZE)
-	die("Read of input file failed");
-
-    int code = msync(fb_ptr, FB_SIZE, 0);
-    if (code != 0)
-	die("msync failure");
-
-    close(in_fd);
+    display_show(image);
 }
 
 /********************************************************
@@ -141,48 +138,22 @@ static void main_loop()
 	 * Active button
 	 * 	= 0 -- Off
 	 * 	= 1 -- On
+	 * The gpio code debounces it (ACTIVE_DEBOUNCE)
 	 */
-	waitForInterrupt(GPIO_ACTIVE_PIN, -1);
-
-	// If we are not active, continue
-	if (digitalRead(GPIO_ACTIVE_PIN) == 0)
-	    continue;
+	wait_active(true);
 
 	if (verbose)
 	    std::cout << "Active turned on " << std::endl;
 
-	sleep(5);
-	// Debounce the switch
-	// If not active, continue
-	if (digitalRead(GPIO_ACTIVE_PIN) == 0)
-	    continue;
-
-	if (verbose)
-	    std::cout << "Active turned on really" << std::endl;
-
 	tv_on();
 	image("idle.fb");
 	
 	// Start the acme program -- get the pid
 	pid_t acme_pid = start_acme_process();
 
-	while (true) {
-	    waitForInterrupt(GPIO_ACTIVE_PIN, -1);
-
-	    // See if this is a glitch
-	    if (digitalRead(GPIO_ACTIVE_PIN) == 1)
-		continue;
-
-	    if (verbose)
-		std::cout << "Active turned off\r" << std::endl;
-
-	    sleep(5);
-	    if (digitalRead(GPIO_ACTIVE_PIN) == 1)
-		continue;
-	    break;
-	}
+	wait_active(false);
 	if (verbose)
-	    std::cout << "Active turned off really\r" << std::endl;
+	    std::cout << "Active turned off\r" << std::endl;
 
 	if (acme_pid >= 0) {
 	    kill(acme_pid, SIGINT);
@@ -200,17 +171,18 @@ static void main_loop()
 static void usage()
 {
     std::cout << "Usage:" << std::endl;
-    std::cout << "    master [-v] [-s]" << std::endl;
+    std::cout << "    master [-v] [-s] [-g <script>]" << std::endl;
     std::cout << "Options: " << std::endl;
     std::cout << "    -v -- verbose " << std::endl;
     std::cout << "    -s -- simulate " << std::endl;
+    std::cout << "    -g <script> -- play a GPIO script (see gpio.h) instead of reading the pins" << std::endl;
     exit(8);
 }
 int main(int argc, char* argv[])
 {
     openlog("master", 0, LOG_USER); 
     while (true) {
-	int opt = getopt(argc, argv, "vs");
+	int opt = getopt(argc, argv, "vsg:");
 	if (opt < 0)
 	    break;
 	
@@ -222,6 +194,9 @@ int main(int argc, char* argv[])
 	    case 's':
 		simulate = true;
 		break;
+	    case 'g':
+		gpio_script = optarg;
+		break;
 	    default:
 		usage();
 	}
@@ -231,17 +206,7 @@ int main(int argc, char* argv[])
 
     setup_gpio();
 
-    fb_fd = open("/dev/fb0", O_RDWR);	// Open the frame buffer
-    if (fb_fd < 0)
-	die("Could not open /dev/fb0");
-
-    ssize_t length = (FB_SIZE + sysconf(_SC_PAGE_SIZE)-1) / sysconf(_SC_PAGE_SIZE);
-    length *= sysconf(_SC_PAGE_SIZE);
-
-    // Length is the size of the fame buffer
-    fb_ptr = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_SHARED, fb_fd, 0);
-    if (fb_ptr == MAP_FAILED)
-	die("Unable to mmap frame buffer");
+    display_setup(MASTER_SLIDES);
     
     tv_off();
     signal(SIGTERM, byebye);
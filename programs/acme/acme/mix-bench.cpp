@@ -0,0 +1,184 @@
+/********************************************************
+ * mix-bench -- How much does mixing sound cost?
+ *
+ * Usage: mix-bench [-s <seconds>]
+ *
+ * 	-s <seconds> Seconds of sound to mix for each test
+ * 		(default 60)
+ *
+ * Mixes 1 to 8 voices of made up sound, 10 ms at a time
+ * like the playback thread, and prints the time it takes
+ * per second of sound (SIMD and scalar).  Needs no sound
+ * card, so it can be run on the build machine.  The SIMD
+ * and scalar mixes are checked against each other, and the
+ * loudest mix the playback thread can make (every voice
+ * full scale at AUDIO_MAX_GAIN) is checked for overflow.
+ ********************************************************/
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "audio.h"
+#include "mixer.h"
+
+bool verbose = false;		// Chatter (used by common.cpp)
+bool simulate = false;		// Do not do the work
+
+static const unsigned int PERIOD_SAMPLES = AUDIO_RATE / 100 * AUDIO_CHANNELS;	// Samples in 10 ms
+static const unsigned int VOICE_COUNTS[] = {1, 2, 4, 8};	// Voices to try
+
+/********************************************************
+ * usage -- Tell the user how to use us
+ ********************************************************/
+static void usage(void)
+{
+    std::cout << "Usage is mix-bench [-s <seconds>]" << std::endl;
+    std::cout << "	-s <seconds> Seconds of sound to mix for each test (default 60)" << std::endl;
+    exit(8);
+}
+/********************************************************
+ * make_voice -- Make up a second of sound (a loud tone)
+ *
+ * Parameters
+ * 	samples -- The sound
+ * 	seed -- Makes the voices different
+ ********************************************************/
+static void make_voice(std::vector<int16_t>& samples, const unsigned int seed)
+{
+    samples.resize(AUDIO_RATE * AUDIO_CHANNELS);
+    for (size_t i = 0; i < samples.size(); ++i) {
+	const double when = static_cast<double>(i / AUDIO_CHANNELS) / AUDIO_RATE;	// Time of the sample
+	samples[i] = static_cast<int16_t>(30000.0 * sin(2.0 * M_PI * (220.0 + 110.0 * seed) * when));
+    }
+}
+/********************************************************
+ * mix -- Mix some voices for a while
+ *
+ * Parameters
+ * 	voices -- The sound
+ * 	count -- Voices to use
+ * 	periods -- Periods to mix
+ * 	simd -- Use the SIMD mixer
+ * 	out -- Where the last period goes
+ *
+ * Returns
+ * 	Time it took (us)
+ ********************************************************/
+static long int mix(const std::vector<std::vector<int16_t>>& voices, const unsigned int count,
+	const unsigned int periods, const bool simd, std::vector<int16_t>& out)
+{
+    std::vector<int32_t> sum(PERIOD_SAMPLES);	// The mix
+    out.resize(PERIOD_SAMPLES);
+    const int64_t start = now_us();	// Start of the test
+    for (unsigned int period = 0; period < periods; ++period) {
+	const size_t where = (period * PERIOD_SAMPLES) % (voices[0].size() - PERIOD_SAMPLES);	// Place in the sound
+	memset(sum.data(), '\0', sum.size() * sizeof(int32_t));
+	for (unsigned int v = 0; v < count; ++v) {
+	    // The gain changes every period, like a fade
+	    const int gain = GAIN_UNITY - ((period + v) % GAIN_UNITY);	// Gain for this period
+	    if (simd)
+		mix_add(sum.data(), voices[v].data() + where, PERIOD_SAMPLES, gain);
+	    else
+		mix_add_scalar(sum.data(), voices[v].data() + where, PERIOD_SAMPLES, gain);
+	}
+	if (simd)
+	    mix_out(out.data(), sum.data(), PERIOD_SAMPLES);
+	else
+	    mix_out_scalar(out.data(), sum.data(), PERIOD_SAMPLES);
+    }
+    return (now_us() - start);
+}
+/********************************************************
+ * loud_check -- Check the loudest mix the playback thread
+ * can make
+ *
+ * AUDIO_MAX_VOICES full scale voices, all in step, at
+ * AUDIO_MAX_GAIN.  The mix must clip, not wrap around.
+ *
+ * Returns
+ * 	true if SIMD and scalar agree and every sample clipped
+ * 	the right way
+ ********************************************************/
+static bool loud_check(void)
+{
+    const int gain = AUDIO_MAX_GAIN * GAIN_UNITY;	// Loudest a voice can be
+    std::vector<int16_t> voice(PERIOD_SAMPLES);	// Full scale square wave
+    for (size_t i = 0; i < voice.size(); ++i)
+	voice[i] = ((i / AUDIO_CHANNELS / 50) % 2 == 0) ? INT16_MAX : INT16_MIN;
+
+    std::vector<int32_t> simd_sum(PERIOD_SAMPLES, 0);	// SIMD mix
+    std::vector<int32_t> scalar_sum(PERIOD_SAMPLES, 0);	// Scalar mix
+    for (unsigned int v = 0; v < AUDIO_MAX_VOICES; ++v) {
+	mix_add(simd_sum.data(), voice.data(), PERIOD_SAMPLES, gain);
+	mix_add_scalar(scalar_sum.data(), voice.data(), PERIOD_SAMPLES, gain);
+    }
+    std::vector<int16_t> simd(PERIOD_SAMPLES);		// SIMD output
+    std::vector<int16_t> scalar(PERIOD_SAMPLES);	// Scalar output
+    mix_out(simd.data(), simd_sum.data(), PERIOD_SAMPLES);
+    mix_out_scalar(scalar.data(), scalar_sum.data(), PERIOD_SAMPLES);
+    // Louder than full scale, so every sample clips to the voice
+    return ((simd == scalar) && (simd == voice));
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int seconds = 60;	// Sound to mix for each test
+    while (true) {
+	int opt = getopt(argc, argv, "s:");
+	if (opt < 0)
+	    break;
+	switch (opt)
+	{
+	    case 's':
+		seconds = atoi(optarg);
+		break;
+	    default:
+		usage();
+	}
+    }
+    if ((seconds == 0) || (optind != argc))
+	usage();
+
+    std::vector<std::vector<int16_t>> voices(VOICE_COUNTS[sizeof(VOICE_COUNTS) / sizeof(VOICE_COUNTS[0]) - 1]);
+    for (unsigned int v = 0; v < voices.size(); ++v)
+	make_voice(voices[v], v);
+
+    if (!loud_check()) {
+	std::cout << "ERROR: " << AUDIO_MAX_VOICES << " voices at gain " << AUDIO_MAX_GAIN <<
+	    " overflow the mix" << std::endl;
+	exit(8);
+    }
+    std::cout << AUDIO_MAX_VOICES << " loud voices at gain " << AUDIO_MAX_GAIN << " clip cleanly" << std::endl;
+
+    const unsigned int periods = seconds * 100;	// 10 ms periods to mix
+    for (auto count: VOICE_COUNTS) {
+	// SIMD must give the same answer as the plain code (8 loud voices clip)
+	std::vector<int16_t> simd;	// SIMD mix
+	std::vector<int16_t> scalar;	// Scalar mix
+	for (unsigned int period = 1; period <= 100; ++period) {
+	    mix(voices, count, period, true, simd);
+	    mix(voices, count, period, false, scalar);
+	    if (simd != scalar) {
+		std::cout << "ERROR: " << count << " voices: SIMD and scalar differ in period " << period << std::endl;
+		exit(8);
+	    }
+	}
+
+	std::cout << count << " voices" << std::endl;
+	for (auto use_simd: {true, false}) {
+	    const long int took = mix(voices, count, periods, use_simd, simd);	// Time for all of it
+	    std::cout << "    " << std::left << std::setw(10) << (use_simd ? "SIMD" : "scalar") << std::right <<
+		std::setw(8) << took / seconds << " us per second of sound" <<
+		std::setw(8) << std::fixed << std::setprecision(3) << took / (seconds * 10000.0) << "% of a CPU" <<
+		std::endl;
+	}
+    }
+    return (0);
+}
@@ -0,0 +1,124 @@
+/********************************************************
+ * Mix sound
+ *
+ * See mixer.h
+ ********************************************************/
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mixer.h"
+
+/********************************************************
+ * mix_add_scalar -- Add a voice to the mix without SIMD
+ *
+ * Parameters
+ * 	mix -- The mix
+ * 	in -- The voice
+ * 	count -- Samples to do
+ * 	gain -- Volume of the voice (GAIN_UNITY is full)
+ ********************************************************/
+void mix_add_scalar(int32_t* const mix, const int16_t* const in, const size_t count, const int gain)
+{
+    for (size_t i = 0; i < count; ++i)
+	mix[i] += in[i] * gain;
+}
+/********************************************************
+ * mix_out_scalar -- Turn the mix into samples without SIMD
+ *
+ * The shift rounds down (toward -infinity), the same as
+ * the SIMD arithmetic shifts.
+ *
+ * Parameters
+ * 	out -- Where the samples go
+ * 	mix -- The mix
+ * 	count -- Samples to do
+ ********************************************************/
+void mix_out_scalar(int16_t* const out, const int32_t* const mix, const size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+	const int32_t sample = mix[i] >> GAIN_SHIFT;	// Back to 16 bit range
+	out[i] = (sample > INT16_MAX) ? INT16_MAX : (sample < INT16_MIN) ? INT16_MIN : sample;
+    }
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+/********************************************************
+ * mix_add -- Add a voice to the mix (NEON, 8 at a time)
+ ********************************************************/
+void mix_add(int32_t* const mix, const int16_t* const in, const size_t count, const int gain)
+{
+    const int16x4_t gain_v = vdup_n_s16(gain);
+    size_t i = 0;	// Sample we are on
+    for (; i + 8 <= count; i += 8) {
+	const int16x8_t voice = vld1q_s16(in + i);
+	vst1q_s32(mix + i, vmlal_s16(vld1q_s32(mix + i), vget_low_s16(voice), gain_v));
+	vst1q_s32(mix + i + 4, vmlal_s16(vld1q_s32(mix + i + 4), vget_high_s16(voice), gain_v));
+    }
+    mix_add_scalar(mix + i, in + i, count - i, gain);
+}
+/********************************************************
+ * mix_out -- Turn the mix into samples (NEON, 8 at a time)
+ ********************************************************/
+void mix_out(int16_t* const out, const int32_t* const mix, const size_t count)
+{
+    size_t i = 0;	// Sample we are on
+    for (; i + 8 <= count; i += 8) {
+	vst1q_s16(out + i, vcombine_s16(vqshrn_n_s32(vld1q_s32(mix + i), GAIN_SHIFT),
+		    vqshrn_n_s32(vld1q_s32(mix + i + 4), GAIN_SHIFT)));
+    }
+    mix_out_scalar(out + i, mix + i, count - i);
+}
+#elif defined(__SSE2__)
+/********************************************************
+ * mix_add -- Add a voice to the mix (SSE2, 8 at a time)
+ *
+ * SSE2 has no 32 bit multiply, so the low and high halves
+ * of the 16 bit products are put back together.
+ ********************************************************/
+void mix_add(int32_t* const mix, const int16_t* const in, const size_t count, const int gain)
+{
+    const __m128i gain_v = _mm_set1_epi16(gain);
+    size_t i = 0;	// Sample we are on
+    for (; i + 8 <= count; i += 8) {
+	const __m128i voice = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+	const __m128i low = _mm_mullo_epi16(voice, gain_v);
+	const __m128i high = _mm_mulhi_epi16(voice, gain_v);
+	__m128i* const where = reinterpret_cast<__m128i*>(mix + i);
+	_mm_storeu_si128(where, _mm_add_epi32(_mm_loadu_si128(where), _mm_unpacklo_epi16(low, high)));
+	_mm_storeu_si128(where + 1, _mm_add_epi32(_mm_loadu_si128(where + 1), _mm_unpackhi_epi16(low, high)));
+    }
+    mix_add_scalar(mix + i, in + i, count - i, gain);
+}
+/********************************************************
+ * mix_out -- Turn the mix into samples (SSE2, 8 at a time)
+ ********************************************************/
+void mix_out(int16_t* const out, const int32_t* const mix, const size_t count)
+{
+    size_t i = 0;	// Sample we are on
+    for (; i + 8 <= count; i += 8) {
+	const __m128i* const where = reinterpret_cast<const __m128i*>(mix + i);
+	const __m128i low = _mm_srai_epi32(_mm_loadu_si128(where), GAIN_SHIFT);
+	const __m128i high = _mm_srai_epi32(_mm_loadu_si128(where + 1), GAIN_SHIFT);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(low, high));
+    }
+    mix_out_scalar(out + i, mix + i, count - i);
+}
+#else
+/********************************************************
+ * mix_add -- Add a voice to the mix
+ ********************************************************/
+void mix_add(int32_t* const mix, const int16_t* const in, const size_t count, const int gain)
+{
+    mix_add_scalar(mix, in, count, gain);
+}
+/********************************************************
+ * mix_out -- Turn the mix into samples
+ ********************************************************/
+void mix_out(int16_t* const out, const int32_t* const mix, const size_t count)
+{
+    mix_out_scalar(out, mix, count);
+}
+#endif
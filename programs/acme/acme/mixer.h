@@ -0,0 +1,35 @@
+/********************************************************
+ * Mix sound (the audio playback thread)
+ *
+ * Voices are added into a 32 bit mix, each with its own
+ * gain, then the mix is brought back to 16 bits (clipping
+ * anything too loud).  Gains are fixed point, GAIN_UNITY
+ * is full volume.  Uses NEON or SSE2 when we have it.
+ *
+ * 	mix_add -- Add a voice to the mix
+ * 	mix_out -- Turn the mix into samples
+ * 	mix_add_scalar, mix_out_scalar -- Same thing without
+ * 		SIMD (gives exactly the same answer)
+ *
+ * With gains no more than GAIN_UNITY, MIX_MAX_VOICES voices
+ * fit in the mix without overflow.
+ *
+ * Usage
+ * 	memset(mix, '\0', sizeof(mix));
+ * 	mix_add(mix, voice, count, GAIN_UNITY / 2);
+ * 	mix_out(out, mix, count);
+ ********************************************************/
+#ifndef __MIXER_H__
+#define __MIXER_H__
+#include <stddef.h>
+#include <stdint.h>
+
+static const unsigned int GAIN_SHIFT = 12;			// Bits of gain
+static const int GAIN_UNITY = 1 << GAIN_SHIFT;			// Full volume
+static const unsigned int MIX_MAX_VOICES = 1 << (31 - 15 - GAIN_SHIFT);	// Voices that fit
+
+extern void mix_add(int32_t* const mix, const int16_t* const in, const size_t count, const int gain);
+extern void mix_add_scalar(int32_t* const mix, const int16_t* const in, const size_t count, const int gain);
+extern void mix_out(int16_t* const out, const int32_t* const mix, const size_t count);
+extern void mix_out_scalar(int16_t* const out, const int32_t* const mix, const size_t count);
+#endif // __MIXER_H__
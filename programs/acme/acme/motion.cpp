@@ -0,0 +1,303 @@
+/********************************************************
+ * Move the signal arms
+ *
+ * See motion.h
+ ********************************************************/
+#include <vector>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "motion.h"
+#include "common.h"
+#include "rt.h"
+
+static const int64_t NEVER = INT64_MAX;	// No deadline
+
+/********************************************************
+ * arm_motion::arm_motion -- Create the arm mover
+ *
+ * The thread starts with the first move.
+ ********************************************************/
+arm_motion::arm_motion(void):
+    next_id(1),
+    thread(0),
+    timer_fd(-1),
+    wake_fd(-1),
+    done_moves(0),
+    late_total(0),
+    late_max(0),
+    run_total(0)
+{
+    pthread_mutexattr_t attr;	// Attributes for the lock
+    pthread_mutexattr_init(&attr);
+    // The motion thread may run at real time priority.  Don't let
+    // a normal thread holding the lock hold it up.
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_cond_init(&finished, NULL);
+}
+/********************************************************
+ * arm_motion::start_thread -- Start the motion thread
+ * (lock must be held)
+ ********************************************************/
+void arm_motion::start_thread(void)
+{
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC|TFD_NONBLOCK);
+    wake_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+    if ((timer_fd < 0) || (wake_fd < 0)) {
+	syslog(LOG_ERR, "ERROR: Could not create arm motion timer -- abort");
+	exit(8);
+    }
+    if (rt_thread_create(&thread, thread_start, this)) {
+	syslog(LOG_ERR, "pthread_create failed for arm motion -- abort");
+	exit(8);
+    }
+}
+/********************************************************
+ * arm_motion::wake -- Wake up the motion thread so it
+ * looks at the deadlines again
+ ********************************************************/
+void arm_motion::wake(void)
+{
+    uint64_t one = 1;	// Value to add to the eventfd
+    if (write(wake_fd, &one, sizeof(one)) != sizeof(one))
+	syslog(LOG_ERR, "ERROR: Could not wake arm motion");
+}
+/********************************************************
+ * arm_motion::is_running -- Is a move still running
+ * (lock must be held)
+ ********************************************************/
+bool arm_motion::is_running(const move_id id) const
+{
+    for (auto& item: moves) {
+	if (item.id == id)
+	    return (true);
+    }
+    return (false);
+}
+/********************************************************
+ * arm_motion::motor_running -- Is a motor in use
+ * (lock must be held)
+ ********************************************************/
+bool arm_motion::motor_running(const enum RELAY_NAME motor) const
+{
+    for (auto& item: moves) {
+	if (item.move.motor == motor)
+	    return (true);
+    }
+    return (false);
+}
+/********************************************************
+ * arm_motion::start -- Start moving an arm
+ *
+ * Returns as soon as the motor is on (after the last move
+ * of the same motor is done).
+ *
+ * Parameters
+ * 	move -- What to move
+ * 	done -- Called by the motion thread when the motor
+ * 		is off (NULL for nobody)
+ * 	arg -- Passed to done
+ *
+ * Returns
+ * 	Id of the move (for wait)
+ ********************************************************/
+arm_motion::move_id arm_motion::start(const arm_move& move, const move_done done, void* const arg)
+{
+    running item;	// The new move
+    item.move = move;
+    item.on = NEVER;
+    item.deadline = NEVER;	// Not until the motor is on
+    item.done = done;
+    item.arg = arg;
+
+    pthread_mutex_lock(&lock);
+    if (thread == 0)
+	start_thread();
+    // One move at a time on a motor
+    while (motor_running(move.motor))
+	pthread_cond_wait(&finished, &lock);
+    item.id = next_id++;
+    moves.push_back(item);
+    pthread_mutex_unlock(&lock);
+
+    // Set the direction and fold, then start the motor.  The relays
+    // are written without the lock so the other head's motor can
+    // be turned off while we do this.
+    const struct relay_change setup[] = {
+	{move.direction, move.go ? RELAY_STATE::RELAY_ON : RELAY_STATE::RELAY_OFF},
+	{move.fold, move.folding ? RELAY_STATE::RELAY_ON : RELAY_STATE::RELAY_OFF}
+    };
+    relay_batch("motion", setup, sizeof(setup) / sizeof(setup[0]));
+    relay("motion", move.motor, RELAY_STATE::RELAY_ON);
+    const int64_t on = now_us();	// When the motor went on
+
+    pthread_mutex_lock(&lock);
+    for (auto& running_item: moves) {
+	if (running_item.id == item.id) {
+	    running_item.on = on;
+	    running_item.deadline = on + move.run_time * 100000LL;
+	}
+    }
+    pthread_mutex_unlock(&lock);
+
+    wake();
+    return (item.id);
+}
+/********************************************************
+ * arm_motion::wait -- Wait for a move to finish
+ *
+ * Returns after its motor is off.
+ *
+ * Parameters
+ * 	id -- The move (0 returns right away)
+ ********************************************************/
+void arm_motion::wait(const move_id id)
+{
+    pthread_mutex_lock(&lock);
+    while (is_running(id))
+	pthread_cond_wait(&finished, &lock);
+    pthread_mutex_unlock(&lock);
+}
+/********************************************************
+ * arm_motion::active -- Is a move still running
+ ********************************************************/
+bool arm_motion::active(const move_id id)
+{
+    pthread_mutex_lock(&lock);
+    const bool result = is_running(id);	// Did we find it
+    pthread_mutex_unlock(&lock);
+    return (result);
+}
+/********************************************************
+ * arm_motion::next_deadline -- Time the next motor goes off
+ * (lock must be held)
+ *
+ * Returns
+ * 	Time in us (NEVER if nothing is running)
+ ********************************************************/
+int64_t arm_motion::next_deadline(void) const
+{
+    int64_t result = NEVER;	// Earliest deadline
+    for (auto& item: moves) {
+	if (item.deadline < result)
+	    result = item.deadline;
+    }
+    return (result);
+}
+/********************************************************
+ * arm_motion::stats -- Log how well the motors were timed
+ ********************************************************/
+void arm_motion::stats(void)
+{
+    pthread_mutex_lock(&lock);
+    if (done_moves != 0) {
+	syslog(LOG_INFO, "Arms: %lu moves, motor ran avg %lld ms, turned off late avg %lld max %lld us",
+		done_moves, static_cast<long long>(run_total / done_moves / 1000),
+		static_cast<long long>(late_total / done_moves), static_cast<long long>(late_max));
+    }
+    pthread_mutex_unlock(&lock);
+}
+/********************************************************
+ * arm_motion::thread_start -- Start of the motion thread
+ ********************************************************/
+void* arm_motion::thread_start(void* me)
+{
+    // We time the motors, so we go above the relay I/O threads
+    rt_thread("motion", 1);
+    static_cast<arm_motion*>(me)->run();
+}
+/********************************************************
+ * arm_motion::run -- The motion thread
+ ********************************************************/
+void arm_motion::run(void)
+{
+    while (true) {
+	pthread_mutex_lock(&lock);
+	const int64_t deadline = next_deadline();	// When the next motor goes off
+	pthread_mutex_unlock(&lock);
+
+	if ((deadline == NEVER) || (deadline - GUARD_US > now_us())) {
+	    // Sleep on the timer until just before the deadline (or a new move)
+	    struct itimerspec when;	// When the timer goes off
+	    memset(&when, '\0', sizeof(when));
+	    if (deadline != NEVER) {
+		when.it_value.tv_sec = (deadline - GUARD_US) / 1000000LL;
+		when.it_value.tv_nsec = (deadline - GUARD_US) % 1000000LL * 1000;
+	    }
+	    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &when, NULL) != 0) {
+		syslog(LOG_ERR, "ERROR: arm motion timerfd_settime failed -- abort");
+		exit(8);
+	    }
+	    struct pollfd poll_list[] = {
+		{timer_fd, POLLIN, 0},
+		{wake_fd, POLLIN, 0}
+	    };
+	    if (poll(poll_list, 2, -1) < 0) {
+		if (errno == EINTR)
+		    continue;
+		syslog(LOG_ERR, "ERROR: arm motion poll failed -- abort");
+		exit(8);
+	    }
+	    uint64_t count;	// Count from the fd (ignored)
+	    if (poll_list[0].revents != 0) {
+		if (read(timer_fd, &count, sizeof(count)) != sizeof(count))
+		    continue;
+	    }
+	    if (poll_list[1].revents != 0) {
+		if (read(wake_fd, &count, sizeof(count)) != sizeof(count))
+		    continue;
+	    }
+	    continue;
+	}
+	// Close enough.  Sleep the rest of the way, then turn off
+	// every motor that is due.
+	sleep_until(deadline);
+	const int64_t now = now_us();	// When we are turning them off
+
+	std::vector<struct relay_change> batch;	// Changes to make
+	std::vector<running> due;		// Moves we are finishing
+	pthread_mutex_lock(&lock);
+	for (auto& item: moves) {
+	    if (item.deadline > now)
+		continue;
+	    // Motor first
+	    batch.push_back({item.move.motor, RELAY_STATE::RELAY_OFF});
+	    batch.push_back({item.move.direction, RELAY_STATE::RELAY_OFF});
+	    batch.push_back({item.move.fold, RELAY_STATE::RELAY_OFF});
+	    due.push_back(item);
+	}
+	pthread_mutex_unlock(&lock);
+
+	relay_batch("motion", batch.data(), batch.size());
+	const int64_t off = now_us();	// When the motors went off
+
+	pthread_mutex_lock(&lock);
+	for (auto& item: due) {
+	    const int64_t late = off - item.deadline;	// Time it ran too long
+	    ++done_moves;
+	    late_total += late;
+	    if (late > late_max)
+		late_max = late;
+	    run_total += off - item.on;
+	    const move_id id = item.id;	// Move we are removing
+	    moves.remove_if([id](const running& running_item) {return (running_item.id == id);});
+	}
+	pthread_cond_broadcast(&finished);
+	pthread_mutex_unlock(&lock);
+
+	for (auto& item: due) {
+	    if (item.done != NULL)
+		item.done(item.id, item.arg);
+	}
+    }
+}
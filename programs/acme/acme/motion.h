@@ -0,0 +1,105 @@
+/********************************************************
+ * Move the signal arms
+ *
+ * An arm move turns on the motor of a head (with the
+ * direction and fold relays it needs), lets it run for the
+ * arm time, and turns it all off.  Starting a move doesn't
+ * wait for it, so both heads can move at once.
+ *
+ * The moves are timed by one real time thread (like the
+ * flasher in signal-prog) that sleeps on a timerfd with
+ * absolute CLOCK_MONOTONIC deadlines.  The run time counts
+ * from when the motor relay was written, so time spent
+ * starting the move is not taken from it.  The timer goes
+ * off a little early (GUARD_US) and the thread sleeps the
+ * rest of the way to the deadline, so a thread that wakes
+ * up late doesn't leave a motor running past its stop.
+ * How late the motors were turned off is logged by stats().
+ *
+ * A new move on a motor that is still running waits for
+ * the old one to finish first.
+ *
+ * Usage
+ * 	arm_move move = {H1_MOTOR_POWER, H1_MOTOR_DIR, H1_FOLD, true, false, 15};
+ * 	arm_motion::move_id id = motion.start(move);	// Returns right away
+ * 	motion.wait(id);	// Until the motor is off
+ *
+ * 	motion.start(move, done, arg);	// done(id, arg) is called when it's off
+ ********************************************************/
+#ifndef __MOTION_H__
+#define __MOTION_H__
+
+#include <list>
+#include <string>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "relay.h"
+
+// How an arm moves
+struct arm_move {
+    enum RELAY_NAME motor;	// Motor power
+    enum RELAY_NAME direction;	// Motor direction (on moves to go)
+    enum RELAY_NAME fold;	// Fold relay
+    bool go;			// Move to go (else to stop)
+    bool folding;		// Fold the arm as it moves
+    unsigned int run_time;	// Time the motor runs (1/10 s, like the arm time)
+};
+
+class arm_motion {
+    public:
+	typedef int move_id;	// Id of a move (0 is no move)
+
+	// Called by the motion thread when a move is done (keep it short)
+	typedef void (*move_done)(const move_id id, void* const arg);
+    private:
+	static const int64_t GUARD_US = 2000;	// Timer goes off this early (us)
+
+	// A move that is running
+	struct running {
+	    move_id id;		// Our id
+	    arm_move move;	// What we are doing
+	    int64_t on;		// When the motor went on (us, CLOCK_MONOTONIC)
+	    int64_t deadline;	// When it goes off
+	    move_done done;	// Who to tell when it's off
+	    void* arg;		// What to tell them
+	};
+	std::list<running> moves;	// Everything running
+	move_id next_id;		// Id for the next move
+
+	pthread_mutex_t lock;		// Protects everything
+	pthread_cond_t finished;	// Signaled when a move is done
+	pthread_t thread;		// The motion thread (0 until the first move)
+	int timer_fd;			// Timer for the next deadline
+	int wake_fd;			// eventfd to wake up the thread
+
+	// Statistics (protected by lock)
+	unsigned long int done_moves;	// Moves finished
+	int64_t late_total;		// Total time the motors ran past the deadline (us)
+	int64_t late_max;		// Worst of them
+	int64_t run_total;		// Total time the motors ran (us)
+    public:
+	arm_motion(void);
+	// Destructor defaults (the thread runs until exit)
+    private:
+	arm_motion(const arm_motion&);			// No copy
+	arm_motion& operator = (const arm_motion&);	// No assignment
+    public:
+	move_id start(const arm_move& move, const move_done done = NULL, void* const arg = NULL);
+	void wait(const move_id id);
+	bool active(const move_id id);
+	void stats(void);
+    private:
+	void start_thread(void);
+	static void* thread_start(void* me);
+	void run(void) __attribute__((noreturn));
+	void wake(void);
+	bool is_running(const move_id id) const;
+	bool motor_running(const enum RELAY_NAME motor) const;
+	int64_t next_deadline(void) const;
+};
+
+// The arm mover used by both heads (defined in hw.cpp)
+extern arm_motion motion;
+#endif // __MOTION_H__
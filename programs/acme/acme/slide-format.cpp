@@ -0,0 +1,406 @@
+/********************************************************
+ * Slide formats and turning pictures into slides
+ *
+ * See slide-format.h
+ ********************************************************/
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#include "slide-format.h"
+
+static const float LANCZOS_SIZE = 3.0;		// Lobes of the Lanczos filter
+
+// The filter for one direction of a scale
+struct filter {
+    unsigned int taps;		// Input pixels for each output pixel
+    std::vector<unsigned int> first;	// First input pixel of each output pixel
+    std::vector<float> weight;	// Weights (taps for each output pixel)
+};
+
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;	// Make the tables once
+static float to_linear[256];		// sRGB -> linear light
+static const unsigned int TO_SRGB_SIZE = 4096;	// Entries in to_srgb
+static float to_srgb[TO_SRGB_SIZE+1];	// Linear light -> sRGB (0-255)
+
+// Ordered dither
+static const float BAYER[4][4] = {
+    { 0,  8,  2, 10},
+    {12,  4, 14,  6},
+    { 3, 11,  1,  9},
+    {15,  7, 13,  5}
+};
+
+/********************************************************
+ * set_field -- Fill in a bitfield
+ ********************************************************/
+static void set_field(struct fb_bitfield& field, const unsigned int offset, const unsigned int length)
+{
+    memset(&field, '\0', sizeof(field));
+    field.offset = offset;
+    field.length = length;
+}
+/********************************************************
+ * format_default -- The format of the slides fbi cooked
+ ********************************************************/
+void format_default(slide_format& format)
+{
+    format.width = 592;
+    format.height = 448;
+    format.bpp = 16;
+    format.line_length = 1184;
+    set_field(format.red, 11, 5);
+    set_field(format.green, 5, 6);
+    set_field(format.blue, 0, 5);
+}
+/********************************************************
+ * format_good -- Check that we can handle a format
+ ********************************************************/
+static bool format_good(const slide_format& format)
+{
+    if ((format.bpp != 16) && (format.bpp != 24) && (format.bpp != 32))
+	return (false);
+    if ((format.width == 0) || (format.height == 0) || (format.line_length < format.width * format.bpp / 8))
+	return (false);
+    const struct fb_bitfield* const fields[] = {&format.red, &format.green, &format.blue};
+    for (auto field: fields) {
+	if ((field->length == 0) || (field->offset + field->length > format.bpp))
+	    return (false);
+    }
+    return (true);
+}
+/********************************************************
+ * format_query -- Get the format of a frame buffer
+ *
+ * Parameters
+ * 	fb_fd -- The frame buffer
+ * 	format -- Its format
+ *
+ * Returns
+ * 	true if it's a screen we can show slides on
+ ********************************************************/
+bool format_query(const int fb_fd, slide_format& format)
+{
+    struct fb_fix_screeninfo fix;	// Fixed screen information
+    struct fb_var_screeninfo var;	// Variable screen information
+    if ((ioctl(fb_fd, FBIOGET_FSCREENINFO, &fix) != 0) ||
+	    (ioctl(fb_fd, FBIOGET_VSCREENINFO, &var) != 0))
+	return (false);
+    if (fix.visual != FB_VISUAL_TRUECOLOR)
+	return (false);
+    format.width = var.xres;
+    format.height = var.yres;
+    format.bpp = var.bits_per_pixel;
+    format.line_length = fix.line_length;
+    set_field(format.red, var.red.offset, var.red.length);
+    set_field(format.green, var.green.offset, var.green.length);
+    set_field(format.blue, var.blue.offset, var.blue.length);
+    return (format_good(format));
+}
+/********************************************************
+ * format_read -- Read a format file
+ *
+ * The file is one line:
+ * 	<width> <height> <bpp> <line bytes> <red offset> <red length>
+ * 		<green offset> <green length> <blue offset> <blue length>
+ *
+ * Returns
+ * 	true if it's there and good
+ ********************************************************/
+bool format_read(const char* const file_name, slide_format& format)
+{
+    FILE* in_file = fopen(file_name, "r");
+    if (in_file == NULL)
+	return (false);
+    unsigned int field[6];	// Offsets and lengths of the colors
+    const int count = fscanf(in_file, "%u %u %u %u %u %u %u %u %u %u",
+	    &format.width, &format.height, &format.bpp, &format.line_length,
+	    &field[0], &field[1], &field[2], &field[3], &field[4], &field[5]);
+    fclose(in_file);
+    if (count != 10)
+	return (false);
+    set_field(format.red, field[0], field[1]);
+    set_field(format.green, field[2], field[3]);
+    set_field(format.blue, field[4], field[5]);
+    return (format_good(format));
+}
+/********************************************************
+ * format_write -- Write a format file
+ *
+ * Returns
+ * 	true if it worked
+ ********************************************************/
+bool format_write(const char* const file_name, const slide_format& format)
+{
+    FILE* out_file = fopen(file_name, "w");
+    if (out_file == NULL)
+	return (false);
+    fprintf(out_file, "%u %u %u %u %u %u %u %u %u %u\n",
+	    format.width, format.height, format.bpp, format.line_length,
+	    format.red.offset, format.red.length, format.green.offset, format.green.length,
+	    format.blue.offset, format.blue.length);
+    return (fclose(out_file) == 0);
+}
+/********************************************************
+ * format_same -- Are two formats the same?
+ ********************************************************/
+bool format_same(const slide_format& a, const slide_format& b)
+{
+    return ((a.width == b.width) && (a.height == b.height) && (a.bpp == b.bpp) &&
+	(a.line_length == b.line_length) &&
+	(a.red.offset == b.red.offset) && (a.red.length == b.red.length) &&
+	(a.green.offset == b.green.offset) && (a.green.length == b.green.length) &&
+	(a.blue.offset == b.blue.offset) && (a.blue.length == b.blue.length));
+}
+/********************************************************
+ * format_size -- Bytes in a slide of a format
+ ********************************************************/
+size_t format_size(const slide_format& format)
+{
+    return (static_cast<size_t>(format.line_length) * format.height);
+}
+/********************************************************
+ * make_tables -- Fill in the sRGB <-> linear tables
+ ********************************************************/
+static void make_tables(void)
+{
+    for (unsigned int i = 0; i < 256; ++i) {
+	const float value = i / 255.0;	// sRGB value (0-1)
+	to_linear[i] = (value <= 0.04045) ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+    }
+    for (unsigned int i = 0; i <= TO_SRGB_SIZE; ++i) {
+	const float value = static_cast<float>(i) / TO_SRGB_SIZE;	// Linear value (0-1)
+	to_srgb[i] = 255.0 * ((value <= 0.0031308) ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055);
+    }
+}
+/********************************************************
+ * lanczos -- The Lanczos filter
+ ********************************************************/
+static float lanczos(const float x)
+{
+    if (x == 0.0)
+	return (1.0);
+    if ((x <= -LANCZOS_SIZE) || (x >= LANCZOS_SIZE))
+	return (0.0);
+    const float pi_x = M_PI * x;
+    return (LANCZOS_SIZE * sin(pi_x) * sin(pi_x / LANCZOS_SIZE) / (pi_x * pi_x));
+}
+/********************************************************
+ * make_filter -- Work out the weights for one direction
+ *
+ * Every output pixel gets the same number of taps, so the
+ * loops that use them are simple enough to vectorize.
+ * Shrinking, the filter is stretched to cover all the input
+ * pixels (no aliasing).
+ *
+ * Parameters
+ * 	in_size -- Input pixels
+ * 	out_size -- Output pixels
+ * 	result -- The filter
+ ********************************************************/
+static void make_filter(const unsigned int in_size, const unsigned int out_size, filter& result)
+{
+    const float scale = static_cast<float>(out_size) / in_size;	// Output pixels per input pixel
+    const float stretch = (scale < 1.0) ? scale : 1.0;		// Filter stretch (when shrinking)
+    const float support = LANCZOS_SIZE / stretch;		// Input pixels each side
+
+    result.taps = static_cast<unsigned int>(ceil(support * 2)) + 1;
+    if (result.taps > in_size)
+	result.taps = in_size;
+    result.first.resize(out_size);
+    result.weight.resize(out_size * result.taps);
+
+    for (unsigned int out = 0; out < out_size; ++out) {
+	const float center = (out + 0.5) / scale - 0.5;	// Where it is in the input
+	int first = static_cast<int>(floor(center - support)) + 1;	// First tap
+	if (first + result.taps > in_size)
+	    first = in_size - result.taps;
+	if (first < 0)
+	    first = 0;
+	result.first[out] = first;
+
+	float* const weight = &result.weight[out * result.taps];	// Weights for this pixel
+	float total = 0.0;		// Sum of the weights
+	for (unsigned int tap = 0; tap < result.taps; ++tap) {
+	    weight[tap] = lanczos((first + tap - center) * stretch);
+	    total += weight[tap];
+	}
+	for (unsigned int tap = 0; tap < result.taps; ++tap)
+	    weight[tap] /= total;
+    }
+}
+/********************************************************
+ * scale -- Resize a picture
+ *
+ * Done in linear light, one color plane at a time, across
+ * then down.
+ *
+ * Parameters
+ * 	image -- The picture
+ * 	width, height -- The size we want
+ * 	planes -- The result (3 planes of width * height,
+ * 		linear light)
+ ********************************************************/
+static void scale(const picture& image, const unsigned int width, const unsigned int height,
+	std::vector<float> planes[3])
+{
+    filter across;	// Filter for the width
+    filter down;	// Filter for the height
+    make_filter(image.width, width, across);
+    make_filter(image.height, height, down);
+
+    // Across (every input line)
+    std::vector<float> wide[3];		// Scaled across (width * image.height)
+    std::vector<float> line[3];		// An input line in linear light
+    for (unsigned int color = 0; color < 3; ++color) {
+	wide[color].resize(static_cast<size_t>(width) * image.height);
+	line[color].resize(image.width);
+    }
+    for (unsigned int y = 0; y < image.height; ++y) {
+	const uint8_t* const in = &image.rgb[static_cast<size_t>(y) * image.width * 3];	// Input line
+	for (unsigned int x = 0; x < image.width; ++x) {
+	    line[0][x] = to_linear[in[x * 3]];
+	    line[1][x] = to_linear[in[x * 3 + 1]];
+	    line[2][x] = to_linear[in[x * 3 + 2]];
+	}
+	for (unsigned int color = 0; color < 3; ++color) {
+	    float* const out = &wide[color][static_cast<size_t>(y) * width];	// Output line
+	    for (unsigned int x = 0; x < width; ++x) {
+		const float* const weight = &across.weight[x * across.taps];	// Weights for this pixel
+		const float* const tap = &line[color][across.first[x]];	// Pixels they go with
+		float sum = 0.0;		// The result
+		for (unsigned int i = 0; i < across.taps; ++i)
+		    sum += weight[i] * tap[i];
+		out[x] = sum;
+	    }
+	}
+    }
+
+    // Down (a weighted sum of whole lines)
+    for (unsigned int color = 0; color < 3; ++color) {
+	planes[color].assign(static_cast<size_t>(width) * height, 0.0);
+	for (unsigned int y = 0; y < height; ++y) {
+	    float* const out = &planes[color][static_cast<size_t>(y) * width];	// Output line
+	    for (unsigned int i = 0; i < down.taps; ++i) {
+		const float weight = down.weight[y * down.taps + i];	// Weight of this line
+		const float* const in = &wide[color][static_cast<size_t>(down.first[y] + i) * width];
+		for (unsigned int x = 0; x < width; ++x)
+		    out[x] += weight * in[x];
+	    }
+	}
+    }
+}
+/********************************************************
+ * pack -- Put one color into a pixel
+ *
+ * Parameters
+ * 	value -- Linear light value
+ * 	field -- Where it goes in the pixel
+ * 	threshold -- Dither threshold (0-1)
+ *
+ * Returns
+ * 	The bits for the pixel
+ ********************************************************/
+static uint32_t pack(float value, const struct fb_bitfield& field, const float threshold)
+{
+    if (value < 0.0)
+	value = 0.0;
+    if (value > 1.0)
+	value = 1.0;
+    const float srgb = to_srgb[static_cast<unsigned int>(value * TO_SRGB_SIZE + 0.5)];	// 0-255
+    const unsigned int length = (field.length > 8) ? 8 : field.length;	// Bits we have
+    const unsigned int max_level = (1 << length) - 1;			// Biggest value
+    unsigned int level = static_cast<unsigned int>(srgb * max_level / 255.0 + threshold);
+    if (level > max_level)
+	level = max_level;
+    // Fill the low bits of a wide field the way the screen would
+    return ((level << (field.length - length)) << field.offset);
+}
+/********************************************************
+ * slide_make -- Make a slide from a picture
+ *
+ * The picture is made as big as it can be and still fit
+ * (like fbi --autozoom), centered on black.
+ *
+ * Parameters
+ * 	image -- The picture
+ * 	format -- Format of the slide
+ * 	slide -- The result
+ ********************************************************/
+void slide_make(const picture& image, const slide_format& format, std::vector<uint8_t>& slide)
+{
+    pthread_once(&tables_once, make_tables);
+
+    // As big as it will go and still fit
+    unsigned int width = format.width;		// Size on the screen
+    unsigned int height = static_cast<unsigned int>(
+	    static_cast<double>(image.height) * format.width / image.width + 0.5);
+    if (height > format.height) {
+	height = format.height;
+	width = static_cast<unsigned int>(
+		static_cast<double>(image.width) * format.height / image.height + 0.5);
+    }
+    if (width == 0)
+	width = 1;
+    if (height == 0)
+	height = 1;
+    std::vector<float> planes[3];	// The scaled picture
+    scale(image, width, height, planes);
+
+    // Black screen with the picture in the middle
+    slide.assign(format_size(format), 0);
+    const unsigned int left = (format.width - width) / 2;	// Where the picture goes
+    const unsigned int top = (format.height - height) / 2;
+    const unsigned int pixel_size = format.bpp / 8;		// Bytes in a pixel
+    const bool dither = (format.red.length < 8) || (format.green.length < 8) || (format.blue.length < 8);
+    for (unsigned int y = 0; y < height; ++y) {
+	uint8_t* out = &slide[static_cast<size_t>(top + y) * format.line_length + left * pixel_size];
+	for (unsigned int x = 0; x < width; ++x) {
+	    const size_t index = static_cast<size_t>(y) * width + x;	// Pixel in the planes
+	    const float threshold = dither ? (BAYER[(top + y) & 3][(left + x) & 3] + 0.5) / 16.0 : 0.5;
+	    const uint32_t pixel = pack(planes[0][index], format.red, threshold) |
+		pack(planes[1][index], format.green, threshold) |
+		pack(planes[2][index], format.blue, threshold);
+	    for (unsigned int byte = 0; byte < pixel_size; ++byte)
+		*out++ = (pixel >> (byte * 8)) & 0xFF;
+	}
+    }
+}
+/********************************************************
+ * unpack -- Get one color out of a pixel (0-255)
+ ********************************************************/
+static inline uint8_t unpack(const uint32_t pixel, const struct fb_bitfield& field)
+{
+    const uint32_t max_level = (1U << field.length) - 1;	// Biggest value
+    return ((((pixel >> field.offset) & max_level) * 255 + max_level / 2) / max_level);
+}
+/********************************************************
+ * slide_unpack -- Turn a slide back into a picture
+ *
+ * Parameters
+ * 	slide -- The slide
+ * 	format -- Its format
+ * 	image -- The picture
+ ********************************************************/
+void slide_unpack(const uint8_t* const slide, const slide_format& format, picture& image)
+{
+    image.width = format.width;
+    image.height = format.height;
+    image.rgb.resize(static_cast<size_t>(format.width) * format.height * 3);
+
+    const unsigned int pixel_size = format.bpp / 8;	// Bytes in a pixel
+    uint8_t* out = image.rgb.data();			// Where the next pixel goes
+    for (unsigned int y = 0; y < format.height; ++y) {
+	const uint8_t* in = slide + static_cast<size_t>(y) * format.line_length;	// Next pixel
+	for (unsigned int x = 0; x < format.width; ++x) {
+	    uint32_t pixel = 0;	// The pixel
+	    for (unsigned int byte = 0; byte < pixel_size; ++byte)
+		pixel |= static_cast<uint32_t>(*in++) << (byte * 8);
+	    *out++ = unpack(pixel, format.red);
+	    *out++ = unpack(pixel, format.green);
+	    *out++ = unpack(pixel, format.blue);
+	}
+    }
+}
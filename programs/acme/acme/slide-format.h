@@ -0,0 +1,59 @@
+/********************************************************
+ * The pixel format of slides and screens, and turning
+ * pictures into slides
+ *
+ * A slide is a dump of the screen it was cooked for (line
+ * bytes * height).  The format it was cooked in is kept in
+ * cooked/slides.format (written by cook) and in the slide
+ * pack.  Slides cooked before that (by fbi) are 592x448
+ * RGB565, which is what format_default gives.
+ *
+ * slide_make scales a picture to fit a format (Lanczos in
+ * linear light, written so the compiler can vectorize it)
+ * and dithers it down to the format's bits.  It is used
+ * by cook, and by the display to fit slides to a screen
+ * they weren't cooked for.
+ *
+ * Usage
+ * 	slide_format format;
+ * 	if (!format_query(fb_fd, format)) ...
+ * 	slide_make(image, format, slide);
+ ********************************************************/
+#ifndef __SLIDE_FORMAT_H__
+#define __SLIDE_FORMAT_H__
+#include <vector>
+
+#include <linux/fb.h>
+#include <stddef.h>
+#include <stdint.h>
+
+static const char* const FORMAT_FILE = "slides.format";	// Format file (in the slide directory)
+
+// The format of a slide (or a screen)
+struct slide_format {
+    unsigned int width;		// Pixels in a line
+    unsigned int height;	// Lines on the screen
+    unsigned int bpp;		// Bits per pixel (16, 24 or 32)
+    unsigned int line_length;	// Bytes in a line
+    struct fb_bitfield red;	// Where the colors go in a pixel
+    struct fb_bitfield green;
+    struct fb_bitfield blue;
+};
+
+// A picture (8 bit RGB)
+struct picture {
+    unsigned int width;		// Size of the picture
+    unsigned int height;
+    std::vector<uint8_t> rgb;	// The pixels (R, G, B, R, G, B ...)
+};
+
+extern void format_default(slide_format& format);
+extern bool format_query(const int fb_fd, slide_format& format);
+extern bool format_read(const char* const file_name, slide_format& format);
+extern bool format_write(const char* const file_name, const slide_format& format);
+extern bool format_same(const slide_format& a, const slide_format& b);
+extern size_t format_size(const slide_format& format);
+
+extern void slide_make(const picture& image, const slide_format& format, std::vector<uint8_t>& slide);
+extern void slide_unpack(const uint8_t* const slide, const slide_format& format, picture& image);
+#endif // __SLIDE_FORMAT_H__
@@ -0,0 +1,255 @@
+/********************************************************
+ * Read a pack of compressed slides
+ *
+ * See slide-pack.h
+ ********************************************************/
+#include <fcntl.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "slide-pack.h"
+
+static const uint8_t* pack_data = NULL;	// The mapped pack
+static size_t pack_size = 0;			// Size of the pack
+
+/********************************************************
+ * copy16 -- Copy 16 bytes
+ *
+ * The source may end where the destination starts (but
+ * not overlap it).
+ ********************************************************/
+static inline void copy16(uint8_t* const out, const uint8_t* const in)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    vst1q_u8(out, vld1q_u8(in));
+#elif defined(__SSE2__)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+	    _mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+#else
+    for (unsigned int i = 0; i < 16; ++i)
+	out[i] = in[i];
+#endif
+}
+/********************************************************
+ * copy_literals -- Copy the literals of a sequence
+ ********************************************************/
+static inline void copy_literals(uint8_t* out, const uint8_t* in, size_t length)
+{
+    for (; length >= 16; length -= 16, out += 16, in += 16)
+	copy16(out, in);
+    for (; length > 0; --length)
+	*out++ = *in++;
+}
+/********************************************************
+ * copy_match -- Copy a match (from what we've decoded)
+ *
+ * A match closer than 16 bytes overlaps itself (it's a
+ * repeating pattern).  We do the first 16 bytes one at a
+ * time, then copy 16 at a time from a whole number of
+ * patterns back.
+ *
+ * Parameters
+ * 	out -- Where it goes
+ * 	offset -- How far back the match is
+ * 	length -- Bytes in the match
+ ********************************************************/
+static inline void copy_match(uint8_t* out, const size_t offset, size_t length)
+{
+    const uint8_t* from = out - offset;	// Where we copy from
+    if (offset < 16) {
+	if (length < 16) {
+	    for (; length > 0; --length)
+		*out++ = *from++;
+	    return;
+	}
+	for (unsigned int i = 0; i < 16; ++i)
+	    out[i] = from[i];
+	out += 16;
+	length -= 16;
+	from = out - offset * ((16 + offset - 1) / offset);
+    }
+    for (; length >= 16; length -= 16, out += 16, from += 16)
+	copy16(out, from);
+    for (; length > 0; --length)
+	*out++ = *from++;
+}
+/********************************************************
+ * read_length -- Read the extra bytes of a length
+ *
+ * Returns
+ * 	false if we ran off the end
+ ********************************************************/
+static inline bool read_length(const uint8_t*& in, const uint8_t* const in_end, size_t& length)
+{
+    unsigned int byte;	// Byte of the length
+    do {
+	if (in >= in_end)
+	    return (false);
+	byte = *in++;
+	length += byte;
+    } while (byte == 255);
+    return (true);
+}
+/********************************************************
+ * pack_decode -- Decompress a slide
+ *
+ * Parameters
+ * 	in, in_size -- The compressed slide
+ * 	out, out_size -- Where it goes
+ *
+ * Returns
+ * 	true if it was good (and exactly filled out)
+ ********************************************************/
+bool pack_decode(const uint8_t* in, const size_t in_size, uint8_t* const out, const size_t out_size)
+{
+    const uint8_t* const in_end = in + in_size;	// End of the input
+    uint8_t* next = out;			// Where the next byte goes
+    uint8_t* const out_end = out + out_size;	// End of the output
+
+    while (in < in_end) {
+	const unsigned int token = *in++;	// Lengths of this sequence
+	size_t literals = token >> 4;		// Literal bytes
+	if ((literals == 15) && !read_length(in, in_end, literals))
+	    return (false);
+	if ((literals > static_cast<size_t>(in_end - in)) || (literals > static_cast<size_t>(out_end - next)))
+	    return (false);
+	copy_literals(next, in, literals);
+	in += literals;
+	next += literals;
+	if (in == in_end)
+	    break;	// Last sequence has no match
+
+	if (in_end - in < 2)
+	    return (false);
+	const size_t offset = in[0] | (in[1] << 8);	// How far back the match is
+	in += 2;
+	if ((offset == 0) || (offset > static_cast<size_t>(next - out)))
+	    return (false);
+	size_t length = token & 0xF;		// Bytes in the match
+	if ((length == 15) && !read_length(in, in_end, length))
+	    return (false);
+	length += 4;
+	if (length > static_cast<size_t>(out_end - next))
+	    return (false);
+	copy_match(next, offset, length);
+	next += length;
+    }
+    return (next == out_end);
+}
+/********************************************************
+ * pack_open -- Map a pack and check it
+ *
+ * Parameters
+ * 	file_name -- The pack
+ *
+ * Returns
+ * 	true if it's there and good
+ ********************************************************/
+bool pack_open(const char* const file_name)
+{
+    const int pack_fd = open(file_name, O_RDONLY);
+    if (pack_fd < 0)
+	return (false);
+    struct stat info;	// Size of the file
+    if ((fstat(pack_fd, &info) != 0) || (static_cast<size_t>(info.st_size) < sizeof(pack_header))) {
+	syslog(LOG_ERR, "ERROR: Slide pack %s is too short", file_name);
+	close(pack_fd);
+	return (false);
+    }
+    void* map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, pack_fd, 0);
+    close(pack_fd);
+    if (map == MAP_FAILED) {
+	syslog(LOG_ERR, "ERROR: Unable to mmap slide pack %s", file_name);
+	return (false);
+    }
+    pack_data = static_cast<const uint8_t*>(map);
+    pack_size = info.st_size;
+
+    // Check the index, so finding a slide can trust it
+    const pack_header* const header = reinterpret_cast<const pack_header*>(pack_data);
+    bool good = (memcmp(header->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0) &&
+	(header->count <= (pack_size - sizeof(pack_header)) / sizeof(pack_entry)) &&
+	(header->slide_size == header->line_length * header->height);
+    const pack_entry* const index = reinterpret_cast<const pack_entry*>(header + 1);
+    for (uint32_t i = 0; good && (i < header->count); ++i) {
+	good = (memchr(index[i].name, '\0', PACK_NAME_SIZE) != NULL) &&
+	    (index[i].offset <= pack_size) && (index[i].size <= pack_size - index[i].offset);
+    }
+    if (!good) {
+	syslog(LOG_ERR, "ERROR: Slide pack %s is bad", file_name);
+	pack_close();
+	return (false);
+    }
+    return (true);
+}
+/********************************************************
+ * pack_find -- Find a slide in the pack
+ *
+ * Parameters
+ * 	name -- Name of the slide
+ * 	size -- Size of the compressed slide (returned)
+ *
+ * Returns
+ * 	The compressed slide (NULL if it's not in the pack)
+ ********************************************************/
+const uint8_t* pack_find(const char* const name, size_t& size)
+{
+    if (pack_data == NULL)
+	return (NULL);
+    const pack_header* const header = reinterpret_cast<const pack_header*>(pack_data);
+    const pack_entry* const index = reinterpret_cast<const pack_entry*>(header + 1);
+    for (uint32_t i = 0; i < header->count; ++i) {
+	if (strcmp(index[i].name, name) == 0) {
+	    size = index[i].size;
+	    return (pack_data + index[i].offset);
+	}
+    }
+    return (NULL);
+}
+/********************************************************
+ * pack_slide_size -- Size of a slide (decompressed)
+ ********************************************************/
+size_t pack_slide_size(void)
+{
+    if (pack_data == NULL)
+	return (0);
+    return (reinterpret_cast<const pack_header*>(pack_data)->slide_size);
+}
+/********************************************************
+ * pack_format -- Format the slides were cooked in
+ ********************************************************/
+void pack_format(slide_format& format)
+{
+    const pack_header* const header = reinterpret_cast<const pack_header*>(pack_data);
+    memset(&format, '\0', sizeof(format));
+    format.width = header->width;
+    format.height = header->height;
+    format.bpp = header->bpp;
+    format.line_length = header->line_length;
+    format.red.offset = header->red_offset;
+    format.red.length = header->red_length;
+    format.green.offset = header->green_offset;
+    format.green.length = header->green_length;
+    format.blue.offset = header->blue_offset;
+    format.blue.length = header->blue_length;
+}
+/********************************************************
+ * pack_close -- Done with the pack
+ ********************************************************/
+void pack_close(void)
+{
+    if (pack_data == NULL)
+	return;
+    munmap(const_cast<uint8_t*>(pack_data), pack_size);
+    pack_data = NULL;
+    pack_size = 0;
+}
@@ -0,0 +1,77 @@
+/********************************************************
+ * A pack of compressed slides (cooked/slides.pack)
+ *
+ * One file holds every slide, so the SD card is read (and
+ * written by the installer) far less.  Made by make-pack,
+ * read by the display.
+ *
+ * Layout (little endian)
+ * 	pack_header	(with the slide format)
+ * 	pack_entry * count	(the index)
+ * 	compressed slides
+ *
+ * Each slide is compressed as a list of sequences (the LZ4
+ * block format):
+ * 	token -- literal length (high 4 bits), match length - 4
+ * 		(low 4 bits).  15 means more length follows in
+ * 		bytes (255 means still more).
+ * 	literals
+ * 	offset -- 2 bytes, how far back the match is (not in the
+ * 		last sequence, which is just literals)
+ * 	match length bytes (if the low 4 bits were 15)
+ *
+ * Flat artwork (and the dither patterns in photographs) come
+ * out as long matches, which are decoded with SIMD copies.
+ *
+ * Usage
+ * 	if (pack_open(SLIDE_PACK)) {
+ * 	    size_t size;
+ * 	    const uint8_t* data = pack_find("idle.fb", size);
+ * 	    if (data != NULL)
+ * 		pack_decode(data, size, slide, pack_slide_size());
+ * 	    pack_format(format);	// What the slides look like
+ ********************************************************/
+#ifndef __SLIDE_PACK_H__
+#define __SLIDE_PACK_H__
+#include <stddef.h>
+#include <stdint.h>
+
+#include "slide-format.h"
+
+static const char PACK_MAGIC[8] = {'S', 'L', 'I', 'D', 'E', 'P', 'K', '2'};
+static const unsigned int PACK_NAME_SIZE = 120;	// Room for a name (with the '\0')
+
+// Start of the pack
+struct pack_header {
+    char magic[8];		// PACK_MAGIC
+    uint32_t count;		// Slides in the pack
+    uint32_t slide_size;	// Size of each slide (decompressed)
+
+    // The format the slides were cooked in
+    uint32_t width;		// Pixels in a line
+    uint32_t height;		// Lines in a slide
+    uint32_t bpp;		// Bits per pixel
+    uint32_t line_length;	// Bytes in a line
+    uint8_t red_offset;		// Where the colors go in a pixel
+    uint8_t red_length;
+    uint8_t green_offset;
+    uint8_t green_length;
+    uint8_t blue_offset;
+    uint8_t blue_length;
+    uint8_t unused[2];
+};
+
+// Index entry for a slide
+struct pack_entry {
+    char name[PACK_NAME_SIZE];	// Name (as in display_show)
+    uint32_t offset;		// Where the compressed slide is (from the start of the file)
+    uint32_t size;		// Compressed size
+};
+
+extern bool pack_open(const char* const file_name);
+extern const uint8_t* pack_find(const char* const name, size_t& size);
+extern size_t pack_slide_size(void);
+extern void pack_format(slide_format& format);
+extern void pack_close(void);
+extern bool pack_decode(const uint8_t* in, const size_t in_size, uint8_t* const out, const size_t out_size);
+#endif // __SLIDE_PACK_H__
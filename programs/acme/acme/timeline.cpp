@@ -0,0 +1,481 @@
+/********************************************************
+ * Run a show from a timeline file
+ *
+ * See timeline.h
+ ********************************************************/
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "common.h"
+#include "hw.h"
+#include "audio.h"
+#include "display.h"
+#include "rt.h"
+#include "timeline.h"
+
+static const char* const TRACK_NAMES[TRACK_COUNT] = {"display", "audio", "h1", "h2"};
+static const long int START_US = 100000;	// Time for the tracks to get going before the show starts
+static const long int LATE_US = 20000;		// An event this late is counted as late
+static const unsigned int DEFAULT_FADE_MS = 500;	// Slide transition when the line doesn't give one
+
+// How a track ran (all its shows)
+struct track_stats {
+    unsigned int events;	// Events run
+    unsigned int late;		// Events more than LATE_US late
+    int64_t drift_us;		// Total of how late they were
+    int64_t drift_max_us;	// Latest one
+};
+static track_stats stats[TRACK_COUNT];	// How each track ran
+static unsigned int shows = 0;		// Shows run
+static int64_t overrun_us = 0;		// Total time the shows ran past their last event
+static int64_t overrun_max_us = 0;	// Most of that
+
+// A track being run
+struct track_run {
+    TRACK track;			// Which one
+    const std::vector<timeline_event>* events;	// What it does
+    int64_t start_us;			// When the show starts
+    int64_t end_us;			// When its last event finished
+};
+
+/********************************************************
+ * read_milli -- Read a number in thousandths
+ *
+ * (Seconds come back as ms, a gain of 1.0 as 1000.)
+ *
+ * Parameters
+ * 	word -- The number
+ * 	milli -- The result
+ *
+ * Returns
+ * 	true if it's a good number
+ ********************************************************/
+static bool read_milli(const std::string& word, long int& milli)
+{
+    char* end;		// End of the number
+    const double number = strtod(word.c_str(), &end);
+    if ((word.empty()) || (*end != '\0') || (number < 0.0))
+	return (false);
+    milli = static_cast<long int>(number * 1000.0 + 0.5);
+    return (true);
+}
+/********************************************************
+ * read_time -- Read the time of an event
+ *
+ * Parameters
+ * 	word -- [<minutes>:]<seconds> or +<seconds>
+ * 	last_ms -- Time of the event before
+ * 	ms -- The result
+ *
+ * Returns
+ * 	true if it's a good time
+ ********************************************************/
+static bool read_time(const std::string& word, const long int last_ms, long int& ms)
+{
+    if (!word.empty() && (word[0] == '+')) {
+	if (!read_milli(word.substr(1), ms))
+	    return (false);
+	ms += last_ms;
+	return (true);
+    }
+    const size_t colon = word.find(':');	// Where the minutes end
+    if (colon == std::string::npos)
+	return (read_milli(word, ms));
+
+    long int minutes_ms;	// The minutes (as if they were seconds)
+    if (!read_milli(word.substr(0, colon), minutes_ms) || !read_milli(word.substr(colon + 1), ms))
+	return (false);
+    ms += minutes_ms * 60;
+    return (true);
+}
+/********************************************************
+ * read_track -- Which track is this?
+ *
+ * Returns
+ * 	true if it's one we know
+ ********************************************************/
+static bool read_track(const std::string& word, TRACK& track)
+{
+    for (unsigned int i = 0; i < TRACK_COUNT; ++i) {
+	if (word == TRACK_NAMES[i]) {
+	    track = static_cast<TRACK>(i);
+	    return (true);
+	}
+    }
+    return (false);
+}
+/********************************************************
+ * check_event -- Is this an action the track can do?
+ *
+ * Parameters
+ * 	track -- The track
+ * 	words -- Action and arguments
+ *
+ * Returns
+ * 	NULL if it's good, what's wrong with it if it isn't
+ ********************************************************/
+static const char* check_event(const TRACK track, const std::vector<std::string>& words)
+{
+    const std::string& action = words[0];	// What to do
+    const size_t args = words.size() - 1;	// Arguments it has
+    long int ms;				// A time argument
+
+    switch (track) {
+	case TRACK::DISPLAY:
+	    if (action != "show")
+		return ("unknown display action");
+	    if ((args < 1) || (args > 3))
+		return ("show needs a slide");
+	    if ((args >= 2) && (words[2] != "cut") && (words[2] != "fade") && (words[2] != "wipe"))
+		return ("transition must be cut, fade or wipe");
+	    if ((args == 3) && !read_milli(words[3], ms))
+		return ("bad transition time");
+	    return (NULL);
+	case TRACK::AUDIO:
+	    if (action == "say")
+		return ((args == 1) ? NULL : "say needs a clip");
+	    if (action == "play") {
+		if ((args < 1) || (args > 5))
+		    return ("play needs a clip");
+		if ((args >= 2) && (words[2] != "effect") && (words[2] != "background"))
+		    return ("voice must be effect or background");
+		if ((args >= 3) && !read_milli(words[3], ms))
+		    return ("bad gain");
+		if ((args >= 4) && !read_milli(words[4], ms))
+		    return ("bad fade time");
+		if ((args == 5) && (words[5] != "loop"))
+		    return ("expected loop");
+		return (NULL);
+	    }
+	    if (action == "fade")
+		return (((args == 3) && read_milli(words[2], ms) && read_milli(words[3], ms)) ?
+			NULL : "fade needs a clip, gain and time");
+	    if (action == "release")
+		return (((args == 2) && read_milli(words[2], ms)) ? NULL : "release needs a clip and time");
+	    if (action == "silence")
+		return (((args == 1) && read_milli(words[1], ms)) ? NULL : "silence needs a time");
+	    return ("unknown audio action");
+	case TRACK::H1:
+	case TRACK::H2:
+	    if ((action == "go") || (action == "stop")) {
+		if (args > 1)
+		    return ("too many arguments");
+		if ((args == 1) && (words[1] != "conf") && (words[1] != "arms") &&
+			(words[1] != "lights") && (words[1] != "both"))
+		    return ("how must be conf, arms, lights or both");
+		return (NULL);
+	    }
+	    if ((action == "fold") || (action == "lights_off") || (action == "ding"))
+		return ((args == 0) ? NULL : "too many arguments");
+	    if (action == "flash")
+		return (((args == 1) && read_milli(words[1], ms)) ? NULL : "flash needs a time");
+	    return ("unknown signal action");
+    }
+    return ("unknown track");
+}
+/********************************************************
+ * timeline_load -- Read a timeline file
+ *
+ * Parameters
+ * 	file_name -- The file
+ * 	show -- Where the show goes
+ *
+ * Returns
+ * 	true if we could read the file
+ ********************************************************/
+bool timeline_load(const char* const file_name, timeline& show)
+{
+    std::ifstream in_file(file_name);
+    if (!in_file.is_open()) {
+	syslog(LOG_ERR, "ERROR: Unable to open timeline %s", file_name);
+	return (false);
+    }
+    show.file_name = file_name;
+    std::vector<std::pair<long int, std::string>> slides;	// Slides and when they are shown
+    std::vector<std::pair<long int, std::string>> clips;	// Clips and when they are played
+    long int last_ms = 0;	// Time of the line before
+    unsigned int line_number = 0;	// Line we are on
+    unsigned int count = 0;		// Events read
+    std::string line;		// Line from the file
+    while (std::getline(in_file, line)) {
+	++line_number;
+	std::istringstream words(line);	// The line broken up
+	std::string time_word;		// When it happens
+	std::string track_word;		// What does it
+	if (!(words >> time_word) || (time_word[0] == '#'))
+	    continue;
+
+	timeline_event event;	// Event we are reading
+	event.line = line_number;
+	TRACK track;		// Track it is on
+	std::string word;	// Action or argument
+	while (words >> word)
+	    event.words.push_back(word);
+	if (!read_time(time_word, last_ms, event.when_ms)) {
+	    syslog(LOG_ERR, "%s:%u: Bad time %s", file_name, line_number, time_word.c_str());
+	    continue;
+	}
+	if (event.words.size() < 2) {
+	    syslog(LOG_ERR, "%s:%u: Needs a track and an action", file_name, line_number);
+	    continue;
+	}
+	if (!read_track(event.words[0], track)) {
+	    syslog(LOG_ERR, "%s:%u: Unknown track %s", file_name, line_number, event.words[0].c_str());
+	    continue;
+	}
+	event.words.erase(event.words.begin());
+	const char* const error = check_event(track, event.words);	// What's wrong with it
+	if (error != NULL) {
+	    syslog(LOG_ERR, "%s:%u: %s", file_name, line_number, error);
+	    continue;
+	}
+	last_ms = event.when_ms;
+	if (track == TRACK::DISPLAY)
+	    slides.push_back(std::make_pair(event.when_ms, event.words[1]));
+	if ((track == TRACK::AUDIO) && ((event.words[0] == "say") || (event.words[0] == "play")))
+	    clips.push_back(std::make_pair(event.when_ms, event.words[1]));
+	show.tracks[static_cast<int>(track)].push_back(event);
+	++count;
+    }
+
+    // Each track runs its events in time order (same time -- file order)
+    for (auto& events: show.tracks) {
+	std::stable_sort(events.begin(), events.end(),
+		[](const timeline_event& a, const timeline_event& b) {return (a.when_ms < b.when_ms);});
+    }
+    // The slide and clip lists are in the order they are needed
+    std::stable_sort(slides.begin(), slides.end(),
+	    [](const std::pair<long int, std::string>& a, const std::pair<long int, std::string>& b) {
+		return (a.first < b.first);});
+    std::stable_sort(clips.begin(), clips.end(),
+	    [](const std::pair<long int, std::string>& a, const std::pair<long int, std::string>& b) {
+		return (a.first < b.first);});
+    for (auto& slide: slides)
+	show.slides.push_back(slide.second);
+    for (auto& clip: clips)
+	show.clips.push_back(clip.second);
+    for (auto& slide: show.slides)
+	show.slide_list.push_back(slide.c_str());
+    show.slide_list.push_back(NULL);
+    for (auto& clip: show.clips)
+	show.clip_list.push_back(clip.c_str());
+    show.clip_list.push_back(NULL);
+
+    syslog(LOG_INFO, "Timeline %s: %u events, %lu slides, %lu clips", file_name, count,
+	    static_cast<unsigned long>(show.slides.size()), static_cast<unsigned long>(show.clips.size()));
+    return (true);
+}
+/********************************************************
+ * read_how -- How a signal head changes
+ ********************************************************/
+static head::SIGNAL_HOW read_how(const std::vector<std::string>& words)
+{
+    if (words.size() < 2)
+	return (head::SIGNAL_HOW::AS_CONF);
+    if (words[1] == "arms")
+	return (head::SIGNAL_HOW::ARMS_ONLY);
+    if (words[1] == "lights")
+	return (head::SIGNAL_HOW::LIGHTS_ONLY);
+    if (words[1] == "both")
+	return (head::SIGNAL_HOW::ARMS_AND_LIGHTS);
+    return (head::SIGNAL_HOW::AS_CONF);
+}
+/********************************************************
+ * do_display -- Run a display event
+ ********************************************************/
+static void do_display(const timeline_event& event)
+{
+    const std::vector<std::string>& words = event.words;	// What to do
+    TRANSITION how = TRANSITION::FADE;	// How the slide comes in
+    long int ms = DEFAULT_FADE_MS;	// How long it takes
+    if (words.size() >= 3)
+	how = (words[2] == "cut") ? TRANSITION::CUT : (words[2] == "wipe") ? TRANSITION::WIPE : TRANSITION::FADE;
+    if (words.size() >= 4)
+	read_milli(words[3], ms);
+    display_show(words[1].c_str(), how, ms);
+}
+/********************************************************
+ * do_audio -- Run an audio event
+ *
+ * Parameters
+ * 	event -- The event
+ * 	voices -- Voices we started (by clip)
+ ********************************************************/
+static void do_audio(const timeline_event& event, std::map<std::string, int>& voices)
+{
+    const std::vector<std::string>& words = event.words;	// What to do
+    long int ms = 0;		// A time
+    long int gain_milli = 1000;	// A gain (1000 is full volume)
+    if (words[0] == "say") {
+	audio_play(words[1].c_str());
+    } else if (words[0] == "play") {
+	const AUDIO_VOICE kind = ((words.size() >= 3) && (words[2] == "background")) ?
+	    AUDIO_VOICE::BACKGROUND : AUDIO_VOICE::EFFECT;	// What it's for
+	if (words.size() >= 4)
+	    read_milli(words[3], gain_milli);
+	if (words.size() >= 5)
+	    read_milli(words[4], ms);
+	voices[words[1]] = audio_start(words[1].c_str(), kind, gain_milli / 1000.0, ms, words.size() == 6);
+    } else if (words[0] == "fade") {
+	read_milli(words[2], gain_milli);
+	read_milli(words[3], ms);
+	if (voices.find(words[1]) != voices.end())
+	    audio_fade(voices[words[1]], gain_milli / 1000.0, ms);
+    } else if (words[0] == "release") {
+	read_milli(words[2], ms);
+	if (voices.find(words[1]) != voices.end()) {
+	    audio_release(voices[words[1]], ms);
+	    voices.erase(words[1]);
+	}
+    } else if (words[0] == "silence") {
+	read_milli(words[1], ms);
+	audio_silence(ms);
+	voices.clear();
+    }
+}
+/********************************************************
+ * do_head -- Run a signal head event
+ *
+ * Parameters
+ * 	signal -- The head
+ * 	arms -- The arms are enabled (for conf)
+ * 	event -- The event
+ ********************************************************/
+static void do_head(head& signal, const bool arms, const timeline_event& event)
+{
+    const std::vector<std::string>& words = event.words;	// What to do
+    if (words[0] == "go") {
+	signal.go(read_how(words), arms);
+    } else if (words[0] == "stop") {
+	signal.stop(read_how(words), arms);
+    } else if (words[0] == "fold") {
+	signal.fold_arms();
+    } else if (words[0] == "lights_off") {
+	signal.lights_off();
+    } else if (words[0] == "ding") {
+	signal.ding();
+    } else if (words[0] == "flash") {
+	long int ms = 0;	// Time the light is on
+	read_milli(words[1], ms);
+	signal.flash((ms + 50) / 100);
+    }
+}
+/********************************************************
+ * track_thread -- Run the events of one track
+ *
+ * Parameters
+ * 	arg -- The track_run
+ ********************************************************/
+static void* track_thread(void* arg)
+{
+    track_run* const run = static_cast<track_run*>(arg);	// What we run
+    const int index = static_cast<int>(run->track);	// Which track we are
+    if ((run->track == TRACK::H1) || (run->track == TRACK::H2))
+	rt_thread(TRACK_NAMES[index]);
+
+    std::map<std::string, int> voices;	// Audio voices we started
+    track_stats& track = stats[index];	// Where our statistics go
+    for (auto& event: *run->events) {
+	const int64_t when = run->start_us + event.when_ms * 1000LL;	// When it should happen
+	sleep_until(when);
+	const int64_t drift = now_us() - when;	// How late we are
+	++track.events;
+	track.drift_us += drift;
+	if (drift > track.drift_max_us)
+	    track.drift_max_us = drift;
+	if (drift > LATE_US) {
+	    ++track.late;
+	    syslog(LOG_INFO, "Timeline: %s line %u ran %lld ms late", TRACK_NAMES[index], event.line,
+		    static_cast<long long>(drift / 1000));
+	}
+
+	switch (run->track) {
+	    case TRACK::DISPLAY:
+		do_display(event);
+		break;
+	    case TRACK::AUDIO:
+		do_audio(event, voices);
+		break;
+	    case TRACK::H1:
+		do_head(h1, acme_config.get_h1_arms(), event);
+		break;
+	    case TRACK::H2:
+		do_head(h2, acme_config.get_h2_arms(), event);
+		break;
+	}
+    }
+    run->end_us = now_us();
+    return (NULL);
+}
+/********************************************************
+ * timeline_run -- Run a show
+ *
+ * Returns when every track has run all its events.
+ *
+ * Parameters
+ * 	show -- The show
+ ********************************************************/
+void timeline_run(const timeline& show)
+{
+    track_run runs[TRACK_COUNT];	// What each track is doing
+    pthread_t threads[TRACK_COUNT];	// The threads doing it
+    const int64_t start = now_us() + START_US;	// When the show starts
+    long int last_ms = 0;		// Time of the last event
+
+    for (unsigned int i = 0; i < TRACK_COUNT; ++i) {
+	runs[i].track = static_cast<TRACK>(i);
+	runs[i].events = &show.tracks[i];
+	runs[i].start_us = start;
+	runs[i].end_us = start;
+	if (show.tracks[i].empty())
+	    continue;
+	last_ms = std::max(last_ms, show.tracks[i].back().when_ms);
+	// The signal heads time relays, so they are real time (when we are)
+	const int result = ((runs[i].track == TRACK::H1) || (runs[i].track == TRACK::H2)) ?
+	    rt_thread_create(&threads[i], track_thread, &runs[i]) :
+	    pthread_create(&threads[i], NULL, track_thread, &runs[i]);	// Result of the create
+	if (result != 0)
+	    die("Unable to start a timeline track");
+    }
+    int64_t end = start;	// When the last track finished
+    for (unsigned int i = 0; i < TRACK_COUNT; ++i) {
+	if (show.tracks[i].empty())
+	    continue;
+	pthread_join(threads[i], NULL);
+	end = std::max(end, runs[i].end_us);
+    }
+    const int64_t overrun = end - (start + last_ms * 1000LL);	// Time past the last event
+    ++shows;
+    overrun_us += overrun;
+    if (overrun > overrun_max_us)
+	overrun_max_us = overrun;
+    syslog(LOG_INFO, "Timeline %s: ran %lld.%lld s (last event at %ld.%ld s)", show.file_name.c_str(),
+	    static_cast<long long>((end - start) / 1000000), static_cast<long long>((end - start) / 100000 % 10),
+	    last_ms / 1000, last_ms / 100 % 10);
+}
+/********************************************************
+ * timeline_stats -- Log how the tracks kept to time
+ ********************************************************/
+void timeline_stats(void)
+{
+    if (shows == 0)
+	return;
+    for (unsigned int i = 0; i < TRACK_COUNT; ++i) {
+	if (stats[i].events == 0)
+	    continue;
+	syslog(LOG_INFO, "Timeline %s: %u events, drift avg %lld max %lld ms, %u late",
+		TRACK_NAMES[i], stats[i].events, static_cast<long long>(stats[i].drift_us / stats[i].events / 1000),
+		static_cast<long long>(stats[i].drift_max_us / 1000), stats[i].late);
+    }
+    syslog(LOG_INFO, "Timeline: %u shows, ran past the last event avg %lld max %lld ms",
+	    shows, static_cast<long long>(overrun_us / shows / 1000), static_cast<long long>(overrun_max_us / 1000));
+}
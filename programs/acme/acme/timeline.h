@@ -0,0 +1,80 @@
+/********************************************************
+ * Run a show from a timeline file (the demos)
+ *
+ * A timeline is a list of events, each at an absolute time
+ * from the start of the show, on one of four tracks:
+ *
+ * 	display -- The slides
+ * 	audio -- Narration and sounds
+ * 	h1, h2 -- The signal heads
+ *
+ * Each track has its own thread and all of them run from
+ * the same CLOCK_MONOTONIC start time, so an arm can move
+ * while the narration plays and the slide changes.  An
+ * event that takes a while (an arm move, a crossfade) only
+ * holds up the later events on its own track.  How late
+ * each event started (the drift) is logged with the other
+ * statistics.
+ *
+ * File format, one event a line:
+ *
+ * 	<time> <track> <action> [<arguments>]
+ *
+ * 	<time> is [<minutes>:]<seconds> from the start, or
+ * 	+<seconds> from the event on the line before.  Blank
+ * 	lines and lines starting with # are ignored.
+ *
+ * 	display show <slide> [cut|fade|wipe] [<seconds>]
+ * 		(fade in half a second if not given)
+ * 	audio say <clip>	Narration (cuts off the last one)
+ * 	audio play <clip> [effect|background] [<gain>] [<fade seconds>] [loop]
+ * 	audio fade <clip> <gain> <seconds>
+ * 	audio release <clip> <seconds>	Fade out and stop
+ * 	audio silence <seconds>	Fade out everything
+ * 	h1|h2 go [conf|arms|lights|both]	(conf if not given)
+ * 	h1|h2 stop [conf|arms|lights|both]
+ * 	h1|h2 fold		Fold the arms
+ * 	h1|h2 lights_off
+ * 	h1|h2 ding		Tap the bell
+ * 	h1|h2 flash <seconds>	Yellow light on for a while
+ *
+ * Bad lines are logged and skipped.
+ *
+ * Usage
+ * 	timeline show;
+ * 	if (!timeline_load("long-demo.timeline", show)) ...
+ * 	display_setup(show.slide_list.data());
+ * 	audio_setup(show.clip_list.data(), "default");
+ * 	timeline_run(show);	// Returns when every track is done
+ * 	timeline_stats();	// Log the drift
+ ********************************************************/
+#ifndef __TIMELINE_H__
+#define __TIMELINE_H__
+#include <string>
+#include <vector>
+
+// The tracks of a show
+enum class TRACK {DISPLAY, AUDIO, H1, H2};
+static const unsigned int TRACK_COUNT = 4;
+
+// Something that happens in the show
+struct timeline_event {
+    long int when_ms;			// Time from the start of the show
+    std::vector<std::string> words;	// Action and its arguments
+    unsigned int line;			// Line of the file it came from
+};
+
+// A show
+struct timeline {
+    std::string file_name;			// Where it came from
+    std::vector<timeline_event> tracks[TRACK_COUNT];	// Events of each track, in time order
+    std::vector<std::string> slides;		// Slides it shows (in show order)
+    std::vector<std::string> clips;		// Clips it plays (in play order)
+    std::vector<const char*> slide_list;	// slides, NULL terminated
+    std::vector<const char*> clip_list;		// clips, NULL terminated
+};
+
+extern bool timeline_load(const char* const file_name, timeline& show);
+extern void timeline_run(const timeline& show);
+extern void timeline_stats(void);
+#endif // __TIMELINE_H__
@@ -0,0 +1,218 @@
+/********************************************************
+ * transition-bench -- How fast can we draw transitions?
+ *
+ * Usage: transition-bench [-f <frames>] [<from> <to>]
+ *
+ * 	-f <frames> Frames to draw for each test (default 300)
+ * 	<from> <to> Cooked slides to use (default made up
+ * 		pictures)
+ *
+ * Draws crossfades (SIMD and scalar) and wipes into memory
+ * for the screen formats we are likely to see and prints
+ * the frames per second and the worst frame.  Needs no
+ * frame buffer, so it can be run on the build machine.  The
+ * SIMD and scalar crossfades are checked against each other.
+ ********************************************************/
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "slide-format.h"
+#include "transition.h"
+
+bool verbose = false;		// Chatter (used by common.cpp)
+bool simulate = false;		// Do not do the work
+
+// A screen to try
+struct bench_screen {
+    const char* name;		// What we call it
+    unsigned int width;		// Size
+    unsigned int height;
+    unsigned int bpp;		// 16 (RGB565) or 32 (XRGB8888)
+};
+static const bench_screen SCREENS[] = {
+    {"RGB565 592x448 (slides)", 592, 448, 16},
+    {"RGB565 800x480", 800, 480, 16},
+    {"XRGB8888 800x480", 800, 480, 32},
+    {"XRGB8888 1920x1080", 1920, 1080, 32}
+};
+
+// What to draw
+enum class BENCH {SIMD, SCALAR, WIPE};
+
+/********************************************************
+ * usage -- Tell the user how to use us
+ ********************************************************/
+static void usage(void)
+{
+    std::cout << "Usage is transition-bench [-f <frames>] [<from> <to>]" << std::endl;
+    std::cout << "	-f <frames> Frames to draw for each test (default 300)" << std::endl;
+    std::cout << "	<from> <to> Cooked slides to use (default made up pictures)" << std::endl;
+    exit(8);
+}
+/********************************************************
+ * make_format -- Format of a screen
+ ********************************************************/
+static void make_format(const bench_screen& screen, slide_format& format)
+{
+    memset(&format, '\0', sizeof(format));
+    format.width = screen.width;
+    format.height = screen.height;
+    format.bpp = screen.bpp;
+    format.line_length = screen.width * screen.bpp / 8;
+    if (screen.bpp == 16) {
+	format.red.offset = 11;		format.red.length = 5;
+	format.green.offset = 5;	format.green.length = 6;
+	format.blue.offset = 0;		format.blue.length = 5;
+    } else {
+	format.red.offset = 16;		format.red.length = 8;
+	format.green.offset = 8;	format.green.length = 8;
+	format.blue.offset = 0;		format.blue.length = 8;
+    }
+}
+/********************************************************
+ * make_picture -- Make up a picture (gradients and bars)
+ *
+ * Parameters
+ * 	image -- The picture
+ * 	seed -- Makes the two pictures different
+ ********************************************************/
+static void make_picture(picture& image, const unsigned int seed)
+{
+    image.width = 640;
+    image.height = 480;
+    image.rgb.resize(image.width * image.height * 3);
+    for (unsigned int y = 0; y < image.height; ++y) {
+	for (unsigned int x = 0; x < image.width; ++x) {
+	    uint8_t* const pixel = &image.rgb[(y * image.width + x) * 3];
+	    pixel[0] = (x + seed * 97) & 0xFF;
+	    pixel[1] = (y * 255) / image.height;
+	    pixel[2] = (((x / 40) + (y / 40) + seed) & 1) ? 0xE0 : 0x20;
+	}
+    }
+}
+/********************************************************
+ * read_picture -- Read a cooked slide as a picture
+ ********************************************************/
+static void read_picture(const char* const name, picture& image)
+{
+    slide_format format;	// Format the slides were cooked in
+    if (!format_read((std::string("cooked/") + FORMAT_FILE).c_str(), format))
+	format_default(format);
+    std::vector<uint8_t> slide(format_size(format));	// The slide
+    FILE* in_file = fopen(name, "rb");
+    if ((in_file == NULL) || (fread(slide.data(), 1, slide.size(), in_file) != slide.size())) {
+	std::cout << "ERROR: Could not read " << name << " (" << slide.size() << " bytes)" << std::endl;
+	exit(8);
+    }
+    fclose(in_file);
+    slide_unpack(slide.data(), format, image);
+}
+/********************************************************
+ * run -- Time one kind of frame
+ *
+ * Parameters
+ * 	what -- What to draw
+ * 	format -- Format of the screen
+ * 	from, to -- The slides
+ * 	frame_count -- Frames to draw
+ ********************************************************/
+static void run(const BENCH what, const slide_format& format, const std::vector<uint8_t>& from,
+	const std::vector<uint8_t>& to, const unsigned int frame_count)
+{
+    std::vector<uint8_t> frame(format_size(format));	// Where we draw
+    long int worst = 0;		// Longest frame (us)
+    const int64_t start = now_us();	// Start of the test
+    for (unsigned int i = 0; i < frame_count; ++i) {
+	const int64_t frame_start = now_us();	// Start of this frame
+	switch (what) {
+	    case BENCH::SIMD:
+		transition_blend(frame.data(), from.data(), to.data(), format, i % (BLEND_MAX + 1));
+		break;
+	    case BENCH::SCALAR:
+		transition_blend_scalar(frame.data(), from.data(), to.data(), format, i % (BLEND_MAX + 1));
+		break;
+	    case BENCH::WIPE:
+		transition_wipe(frame.data(), from.data(), to.data(), format, i % (format.width + 1));
+		break;
+	}
+	const long int frame_time = now_us() - frame_start;	// Time for this frame
+	if (frame_time > worst)
+	    worst = frame_time;
+    }
+    const long int total = now_us() - start;	// Time for all of them
+    static const char* const NAMES[] = {"fade (SIMD)", "fade (scalar)", "wipe"};
+    std::cout << "    " << std::left << std::setw(14) << NAMES[static_cast<int>(what)] << std::right <<
+	std::setw(8) << std::fixed << std::setprecision(1) << frame_count * 1000000.0 / total << " fps" <<
+	std::setw(8) << std::setprecision(2) << total / 1000.0 / frame_count << " ms avg" <<
+	std::setw(8) << worst / 1000.0 << " ms worst" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int frame_count = 300;	// Frames for each test
+    while (true) {
+	int opt = getopt(argc, argv, "f:");
+	if (opt < 0)
+	    break;
+	switch (opt)
+	{
+	    case 'f':
+		frame_count = atoi(optarg);
+		break;
+	    default:
+		usage();
+	}
+    }
+    if ((frame_count == 0) || ((argc - optind != 0) && (argc - optind != 2)))
+	usage();
+
+    picture from_image;		// What we fade from
+    picture to_image;		// What we fade to
+    if (argc - optind == 2) {
+	read_picture(argv[optind], from_image);
+	read_picture(argv[optind + 1], to_image);
+    } else {
+	make_picture(from_image, 0);
+	make_picture(to_image, 1);
+    }
+
+    for (auto& screen: SCREENS) {
+	slide_format format;		// Format of the screen
+	make_format(screen, format);
+	std::vector<uint8_t> from;	// The slides in the screen format
+	std::vector<uint8_t> to;
+	slide_make(from_image, format, from);
+	slide_make(to_image, format, to);
+
+	// SIMD must give the same answer as the plain code
+	std::vector<uint8_t> simd(format_size(format));	// SIMD frame
+	std::vector<uint8_t> scalar(format_size(format));	// Scalar frame
+	for (unsigned int alpha = 0; alpha <= BLEND_MAX; ++alpha) {
+	    transition_blend(simd.data(), from.data(), to.data(), format, alpha);
+	    transition_blend_scalar(scalar.data(), from.data(), to.data(), format, alpha);
+	    if (simd != scalar) {
+		std::cout << "ERROR: " << screen.name << " SIMD and scalar differ at alpha " << alpha << std::endl;
+		exit(8);
+	    }
+	}
+	if (scalar != to) {
+	    std::cout << "ERROR: " << screen.name << " full fade is not the new slide" << std::endl;
+	    exit(8);
+	}
+
+	std::cout << screen.name << std::endl;
+	run(BENCH::SIMD, format, from, to, frame_count);
+	run(BENCH::SCALAR, format, from, to, frame_count);
+	run(BENCH::WIPE, format, from, to, frame_count);
+    }
+    return (0);
+}
@@ -0,0 +1,229 @@
+/********************************************************
+ * Draw the frames of a transition
+ *
+ * See transition.h
+ ********************************************************/
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "transition.h"
+
+/********************************************************
+ * mix -- Blend one value
+ *
+ * The shift rounds down (toward -infinity), the same as
+ * the SIMD arithmetic shifts.
+ ********************************************************/
+static inline int mix(const int from, const int to, const int alpha)
+{
+    return (from + (((to - from) * alpha) >> BLEND_SHIFT));
+}
+/********************************************************
+ * blend16_scalar -- Blend 16 bit pixels one color field at a time
+ *
+ * Parameters
+ * 	out, from, to -- The pixels
+ * 	count -- Pixels to do
+ * 	format -- Where the fields are
+ * 	alpha -- How much of "to" (0 - BLEND_MAX)
+ ********************************************************/
+static void blend16_scalar(uint16_t* const out, const uint16_t* const from, const uint16_t* const to,
+	const size_t count, const slide_format& format, const int alpha)
+{
+    const struct fb_bitfield* const fields[3] = {&format.red, &format.green, &format.blue};
+    for (size_t i = 0; i < count; ++i) {
+	unsigned int pixel = 0;		// The result
+	for (auto field: fields) {
+	    const unsigned int mask = (1 << field->length) - 1;	// Bits in the field
+	    pixel |= mix((from[i] >> field->offset) & mask, (to[i] >> field->offset) & mask, alpha) << field->offset;
+	}
+	out[i] = pixel;
+    }
+}
+/********************************************************
+ * blend8_scalar -- Blend bytes
+ ********************************************************/
+static void blend8_scalar(uint8_t* const out, const uint8_t* const from, const uint8_t* const to,
+	const size_t count, const int alpha)
+{
+    for (size_t i = 0; i < count; ++i)
+	out[i] = mix(from[i], to[i], alpha);
+}
+/********************************************************
+ * transition_blend_scalar -- Crossfade without SIMD
+ *
+ * Parameters
+ * 	out -- Where the frame goes
+ * 	from, to -- The slides
+ * 	format -- Format of all three
+ * 	alpha -- How much of "to" (0 - BLEND_MAX)
+ ********************************************************/
+void transition_blend_scalar(uint8_t* const out, const uint8_t* const from, const uint8_t* const to,
+	const slide_format& format, const unsigned int alpha)
+{
+    const size_t size = format_size(format);	// Bytes in a frame
+    if (format.bpp == 16) {
+	blend16_scalar(reinterpret_cast<uint16_t*>(out), reinterpret_cast<const uint16_t*>(from),
+		reinterpret_cast<const uint16_t*>(to), size / 2, format, alpha);
+    } else {
+	blend8_scalar(out, from, to, size, alpha);
+    }
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+/********************************************************
+ * blend16 -- Blend 16 bit pixels (NEON, 8 at a time)
+ ********************************************************/
+static void blend16(uint16_t* const out, const uint16_t* const from, const uint16_t* const to,
+	const size_t count, const slide_format& format, const int alpha)
+{
+    const struct fb_bitfield* const fields[3] = {&format.red, &format.green, &format.blue};
+    int16x8_t right[3];		// Shift a field down
+    int16x8_t left[3];		// Shift a field back
+    uint16x8_t mask[3];		// Bits in a field
+    for (unsigned int f = 0; f < 3; ++f) {
+	right[f] = vdupq_n_s16(-static_cast<int>(fields[f]->offset));
+	left[f] = vdupq_n_s16(fields[f]->offset);
+	mask[f] = vdupq_n_u16((1 << fields[f]->length) - 1);
+    }
+    const int16x8_t alpha_v = vdupq_n_s16(alpha);
+
+    size_t i = 0;	// Pixel we are on
+    for (; i + 8 <= count; i += 8) {
+	const uint16x8_t a = vld1q_u16(from + i);
+	const uint16x8_t b = vld1q_u16(to + i);
+	uint16x8_t result = vdupq_n_u16(0);
+	for (unsigned int f = 0; f < 3; ++f) {
+	    const int16x8_t fa = vreinterpretq_s16_u16(vandq_u16(vshlq_u16(a, right[f]), mask[f]));
+	    const int16x8_t fb = vreinterpretq_s16_u16(vandq_u16(vshlq_u16(b, right[f]), mask[f]));
+	    const int16x8_t value = vaddq_s16(fa, vshrq_n_s16(vmulq_s16(vsubq_s16(fb, fa), alpha_v), BLEND_SHIFT));
+	    result = vorrq_u16(result, vshlq_u16(vreinterpretq_u16_s16(value), left[f]));
+	}
+	vst1q_u16(out + i, result);
+    }
+    blend16_scalar(out + i, from + i, to + i, count - i, format, alpha);
+}
+/********************************************************
+ * blend8 -- Blend bytes (NEON, 16 at a time)
+ ********************************************************/
+static void blend8(uint8_t* const out, const uint8_t* const from, const uint8_t* const to,
+	const size_t count, const int alpha)
+{
+    const int16x8_t alpha_v = vdupq_n_s16(alpha);
+    size_t i = 0;	// Byte we are on
+    for (; i + 16 <= count; i += 16) {
+	const uint8x16_t a = vld1q_u8(from + i);
+	const uint8x16_t b = vld1q_u8(to + i);
+	const int16x8_t a_low = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(a)));
+	const int16x8_t a_high = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(a)));
+	const int16x8_t b_low = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(b)));
+	const int16x8_t b_high = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(b)));
+	const int16x8_t low = vaddq_s16(a_low, vshrq_n_s16(vmulq_s16(vsubq_s16(b_low, a_low), alpha_v), BLEND_SHIFT));
+	const int16x8_t high = vaddq_s16(a_high, vshrq_n_s16(vmulq_s16(vsubq_s16(b_high, a_high), alpha_v), BLEND_SHIFT));
+	vst1q_u8(out + i, vcombine_u8(vqmovun_s16(low), vqmovun_s16(high)));
+    }
+    blend8_scalar(out + i, from + i, to + i, count - i, alpha);
+}
+#elif defined(__SSE2__)
+/********************************************************
+ * blend16 -- Blend 16 bit pixels (SSE2, 8 at a time)
+ ********************************************************/
+static void blend16(uint16_t* const out, const uint16_t* const from, const uint16_t* const to,
+	const size_t count, const slide_format& format, const int alpha)
+{
+    const struct fb_bitfield* const fields[3] = {&format.red, &format.green, &format.blue};
+    __m128i shift[3];		// Where a field is
+    __m128i mask[3];		// Bits in a field
+    for (unsigned int f = 0; f < 3; ++f) {
+	shift[f] = _mm_cvtsi32_si128(fields[f]->offset);
+	mask[f] = _mm_set1_epi16((1 << fields[f]->length) - 1);
+    }
+    const __m128i alpha_v = _mm_set1_epi16(alpha);
+
+    size_t i = 0;	// Pixel we are on
+    for (; i + 8 <= count; i += 8) {
+	const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+	const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(to + i));
+	__m128i result = _mm_setzero_si128();
+	for (unsigned int f = 0; f < 3; ++f) {
+	    const __m128i fa = _mm_and_si128(_mm_srl_epi16(a, shift[f]), mask[f]);
+	    const __m128i fb = _mm_and_si128(_mm_srl_epi16(b, shift[f]), mask[f]);
+	    const __m128i value = _mm_add_epi16(fa,
+		    _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(fb, fa), alpha_v), BLEND_SHIFT));
+	    result = _mm_or_si128(result, _mm_sll_epi16(value, shift[f]));
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+    }
+    blend16_scalar(out + i, from + i, to + i, count - i, format, alpha);
+}
+/********************************************************
+ * blend8 -- Blend bytes (SSE2, 16 at a time)
+ ********************************************************/
+static void blend8(uint8_t* const out, const uint8_t* const from, const uint8_t* const to,
+	const size_t count, const int alpha)
+{
+    const __m128i alpha_v = _mm_set1_epi16(alpha);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;	// Byte we are on
+    for (; i + 16 <= count; i += 16) {
+	const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+	const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(to + i));
+	const __m128i a_low = _mm_unpacklo_epi8(a, zero);
+	const __m128i a_high = _mm_unpackhi_epi8(a, zero);
+	const __m128i low = _mm_add_epi16(a_low,
+		_mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(b, zero), a_low), alpha_v), BLEND_SHIFT));
+	const __m128i high = _mm_add_epi16(a_high,
+		_mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(b, zero), a_high), alpha_v), BLEND_SHIFT));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(low, high));
+    }
+    blend8_scalar(out + i, from + i, to + i, count - i, alpha);
+}
+#else
+#define blend16 blend16_scalar
+#define blend8 blend8_scalar
+#endif
+
+/********************************************************
+ * transition_blend -- Crossfade
+ *
+ * Parameters
+ * 	out -- Where the frame goes
+ * 	from, to -- The slides
+ * 	format -- Format of all three
+ * 	alpha -- How much of "to" (0 - BLEND_MAX)
+ ********************************************************/
+void transition_blend(uint8_t* const out, const uint8_t* const from, const uint8_t* const to,
+	const slide_format& format, const unsigned int alpha)
+{
+    const size_t size = format_size(format);	// Bytes in a frame
+    if (format.bpp == 16) {
+	blend16(reinterpret_cast<uint16_t*>(out), reinterpret_cast<const uint16_t*>(from),
+		reinterpret_cast<const uint16_t*>(to), size / 2, format, alpha);
+    } else {
+	blend8(out, from, to, size, alpha);
+    }
+}
+/********************************************************
+ * transition_wipe -- Wipe from the left
+ *
+ * Parameters
+ * 	out -- Where the frame goes
+ * 	from, to -- The slides
+ * 	format -- Format of all three
+ * 	edge -- Pixels of "to" on each line
+ ********************************************************/
+void transition_wipe(uint8_t* const out, const uint8_t* const from, const uint8_t* const to,
+	const slide_format& format, const unsigned int edge)
+{
+    const size_t split = static_cast<size_t>((edge < format.width) ? edge : format.width) * format.bpp / 8;
+    for (unsigned int y = 0; y < format.height; ++y) {
+	const size_t line = static_cast<size_t>(y) * format.line_length;	// Start of the line
+	memcpy(out + line, to + line, split);
+	memcpy(out + line + split, from + line + split, format.line_length - split);
+    }
+}
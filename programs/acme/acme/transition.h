@@ -0,0 +1,35 @@
+/********************************************************
+ * Draw the frames of a transition between two slides
+ *
+ * Works on the slides as they are on the screen (the
+ * frame buffer pixel format), so a frame is one pass over
+ * memory.
+ *
+ * 	transition_blend -- Crossfade.  alpha goes from 0 (all
+ * 		from) to BLEND_MAX (all to).  16 bpp screens
+ * 		blend each color field, 24 and 32 bpp blend
+ * 		each byte.  Uses NEON or SSE2 when we have it.
+ * 	transition_blend_scalar -- Same thing without SIMD
+ * 		(gives exactly the same answer)
+ * 	transition_wipe -- The new slide comes in from the left.
+ * 		edge is how many pixels of it show.
+ *
+ * Usage
+ * 	transition_blend(frame, from, to, format, alpha);
+ ********************************************************/
+#ifndef __TRANSITION_H__
+#define __TRANSITION_H__
+#include <stdint.h>
+
+#include "slide-format.h"
+
+static const unsigned int BLEND_SHIFT = 7;			// Bits of alpha
+static const unsigned int BLEND_MAX = 1 << BLEND_SHIFT;	// Alpha for all "to"
+
+extern void transition_blend(uint8_t* const out, const uint8_t* const from, const uint8_t* const to,
+	const slide_format& format, const unsigned int alpha);
+extern void transition_blend_scalar(uint8_t* const out, const uint8_t* const from, const uint8_t* const to,
+	const slide_format& format, const unsigned int alpha);
+extern void transition_wipe(uint8_t* const out, const uint8_t* const from, const uint8_t* const to,
+	const slide_format& format, const unsigned int edge);
+#endif // __TRANSITION_H__
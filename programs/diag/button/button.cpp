@@ -1,14 +1,27 @@
+/*
+ * button -- Show the keys pressed on the keyboards
+ *
+ * Usage: button [<device> ...]
+ *
+ * Watches every device given (default the AVR, the wireless keypad and
+ * the PoKeys) and prints each key with the time the kernel saw it and
+ * how long it took to get to us.
+ */
 #include <iostream>
+#include <iomanip>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <linux/input.h>
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
 
 #include "device.h"
 /*
  * grab_dev -- Get exclusive use of the device
  */
-static void grab_dev(const int fd) 
+static void grab_dev(const int fd)
 {
     if (ioctl(fd, EVIOCGRAB, (void *)1) != 0) {
 	std::cout << "Grab failed for fd=" << fd << " aborting" << std::endl;
@@ -16,69 +29,98 @@ static void grab_dev(const int fd)
     }
 }
 /*
- * get_key -- Read a key from a keyboard
+ * open_dev -- Open a device and add it to the epoll set
  *
- * Parameters
- * 	fd -- FD of the keyboard
+ * Returns
+ * 	true if the device is there
  */
-static int get_key(const int fd)
+static bool open_dev(const int epoll_fd, const char* const device)
 {
-    while (true) {
-	// Event we read from the raw event system
-	struct input_event event;
+    const int fd = open(device, O_RDONLY|O_NONBLOCK);
+    if (fd < 0) {
+	std::cout << "ERROR: Could not open " << device << std::endl;
+	return (false);
+    }
+    grab_dev(fd);
 
-	// Read event, get size
-	int read_size = read(fd, &event, sizeof(event));
-	if (read_size <= 0) {
-	    std::cout <<  "Read error when reading event from " << fd << std::endl;
-	    return (-1);
-	}
-	if ((event.type == EV_KEY) && (event.value == 1)) {
-	    // 69 is some sort of extended code
-	    if (event.code == 69)
-		continue;
-	    return (event.code);
-	}
+    // Time stamp the events with the same clock we read
+    int clock_id = CLOCK_MONOTONIC;
+    if (ioctl(fd, EVIOCSCLOCKID, &clock_id) != 0)
+	std::cout << "Can't set the event clock for " << device << std::endl;
+
+    struct epoll_event event;	// What to watch for
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+	std::cout << "ERROR: epoll_ctl failed for " << device << std::endl;
+	exit(8);
     }
+    std::cout << "fd=" << fd << " is " << device << std::endl;
+    return (true);
 }
 /*
- * generic_input -- Read an input device and handle the key presses
+ * show_keys -- Read a batch of events and print the key presses
  *
  * Parameters
- * 	device -- Device to read
+ * 	fd -- FD of the keyboard
+ *
+ * Returns
+ * 	false if the device is gone
  */
-static void generic_input(const char* const device)
+static bool show_keys(const int fd)
 {
-    while (true) {
-	int fd;	// The fd of the device
+    struct input_event events[64];	// Events we read from the raw event system
 
-	// Loop until we get the device
-	while (true) {
-	    // Get the device
-	    fd = open(device, O_RDONLY);
-	    if (fd >= 0) {
-		break;
-	    }
-	    std::cout << "ERROR: Could not open " << device << " -- sleeping" << std::endl;
-	    sleep(10);
-	    std::cout << "Sleep done " << std::endl;
-	}
-	grab_dev(fd);
+    int read_size = read(fd, events, sizeof(events));
+    if (read_size <= 0) {
+	std::cout <<  "Read error when reading event from " << fd << std::endl;
+	return (false);
+    }
+    struct timespec now;	// When we read them
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-	while (true) {
-	    // Get key code
-	    int key = get_key(fd);
-	    std::cout << "Key " << key << " pressed" << std::endl;
-	    if (key < 0) {
-		close(fd);
-		break;
-	    }
-	}
+    for (size_t i = 0; i < read_size / sizeof(events[0]); ++i) {
+	if ((events[i].type != EV_KEY) || (events[i].value != 1))
+	    continue;
+	// 69 is some sort of extended code
+	if (events[i].code == 69)
+	    continue;
+	const long int latency = (now.tv_sec - events[i].input_event_sec) * 1000000L +
+	    now.tv_nsec / 1000 - events[i].input_event_usec;	// Kernel to us (us)
+	std::cout << "fd=" << fd << " Key " << events[i].code << " pressed at " <<
+	    events[i].input_event_sec << "." << std::setfill('0') << std::setw(6) <<
+	    events[i].input_event_usec << std::setfill(' ') <<
+	    " latency " << latency << " us" << std::endl;
     }
+    return (true);
 }
 
-int main()
+int main(int argc, char* argv[])
 {
-    generic_input(PROKEY55);
+    const int epoll_fd = epoll_create1(0);	// All the devices
+    if (epoll_fd < 0) {
+	std::cout << "ERROR: epoll_create1 failed" << std::endl;
+	exit(8);
+    }
+    int devices = 0;	// Devices we opened
+    if (argc > 1) {
+	for (int i = 1; i < argc; ++i)
+	    devices += open_dev(epoll_fd, argv[i]) ? 1 : 0;
+    } else {
+	devices += open_dev(epoll_fd, AVR_KBD) ? 1 : 0;
+	devices += open_dev(epoll_fd, KEYPAD) ? 1 : 0;
+	devices += open_dev(epoll_fd, PROKEY55) ? 1 : 0;
+    }
+
+    while (devices > 0) {
+	struct epoll_event events[8];	// Devices with something to read
+	int count = epoll_wait(epoll_fd, events, 8, -1);
+	for (int i = 0; i < count; ++i) {
+	    if (!show_keys(events[i].data.fd)) {
+		close(events[i].data.fd);	// Also takes it out of the epoll set
+		--devices;
+	    }
+	}
+    }
     return (0);
 }
@@ -0,0 +1,242 @@
+/*
+ * rt_jitter -- Measure how late timed relay commands go out
+ *
+ * Toggles a relay at fixed times (absolute CLOCK_MONOTONIC deadlines)
+ * and records how late we woke up for each one and how long the relay
+ * command took.  Load can be added to see what the rest of the system
+ * does to us:
+ *
+ * 	-c<n> threads that burn CPU
+ * 	-i<n> threads that write and fsync a file
+ *
+ * Run it with and without -R to see what real time mode buys.
+ *
+ * Usage is rt_jitter [-r] [-v] [-R<cpu>] [-c<n>] [-i<n>] [-n<count>] [-p<ms>] [-l<relay>]
+ */
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "relay.h"
+#include "rt.h"
+
+bool simulate = false;	// Simulate the relays
+bool verbose = false;	// Chatter?
+
+static const int64_t NS_PER_MS = 1000000;	// Nanoseconds in a millisecond
+static const int64_t NS_PER_SEC = 1000000000;	// Nanoseconds in a second
+static const size_t IO_BLOCK = 64 * 1024;	// Size of each I/O load write
+
+/*
+ * now_ns -- Get the time in nanoseconds
+ */
+static int64_t now_ns(void)
+{
+    struct timespec now;	// The time
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * NS_PER_SEC + now.tv_nsec);
+}
+
+/*
+ * cpu_load -- Thread that burns CPU
+ */
+static void* cpu_load(void*)
+{
+    volatile unsigned long int count = 0;	// Something to do
+    while (true)
+	++count;
+}
+
+/*
+ * io_load -- Thread that writes and syncs a temporary file
+ */
+static void* io_load(void*)
+{
+    char name[] = "/tmp/rt_jitterXXXXXX";	// Name of the file
+    const int fd = mkstemp(name);		// The file
+    if (fd < 0) {
+	std::cerr << "Could not create " << name << ": " << strerror(errno) << std::endl;
+	exit(8);
+    }
+    unlink(name);
+
+    std::vector<char> block(IO_BLOCK, 'x');	// What we write
+    while (true) {
+	for (int i = 0; i < 16; ++i) {
+	    if (write(fd, block.data(), block.size()) < 0) {
+		std::cerr << "I/O load write failed: " << strerror(errno) << std::endl;
+		exit(8);
+	    }
+	}
+	fsync(fd);
+	lseek(fd, 0, SEEK_SET);
+    }
+}
+
+/*
+ * start_load -- Start some load threads
+ *
+ * Parameters
+ * 	count -- Number of threads
+ * 	function -- What they run
+ */
+static void start_load(const int count, void* (*function)(void*))
+{
+    for (int i = 0; i < count; ++i) {
+	pthread_t id;	// Thread id (never used)
+	if (pthread_create(&id, NULL, function, NULL)) {
+	    std::cerr << "pthread_create failed for load thread" << std::endl;
+	    exit(8);
+	}
+    }
+}
+
+/*
+ * report -- Print the statistics for a set of samples
+ *
+ * Parameters
+ * 	what -- What we measured
+ * 	samples -- The samples (ns), sorted in place
+ */
+static void report(const char* const what, std::vector<int64_t>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    int64_t total = 0;		// Sum of the samples
+    for (auto sample: samples)
+	total += sample;
+
+    const size_t count = samples.size();	// Number of samples
+    // Relay output goes to stdout in simulate mode so the report goes to stderr
+    std::cerr << std::setw(8) << what <<
+	" min " << std::setw(8) << samples[0] / 1000 <<
+	" avg " << std::setw(8) << total / static_cast<int64_t>(count) / 1000 <<
+	" p99 " << std::setw(8) << samples[(count * 99) / 100] / 1000 <<
+	" max " << std::setw(8) << samples[count - 1] / 1000 << " us" << std::endl;
+}
+
+/*
+ * usage -- Tell the user how to use us
+ */
+static void usage(void)
+{
+    std::cerr << "Usage is rt_jitter [-r] [-v] [-R<cpu>] [-c<n>] [-i<n>] [-n<count>] [-p<ms>] [-l<relay>]" << std::endl;
+    std::cerr << "	-r Simulate relays" << std::endl;
+    std::cerr << "	-v Verbose" << std::endl;
+    std::cerr << "	-R<cpu> Real time, pinned to <cpu> (-1 for any)" << std::endl;
+    std::cerr << "	-c<n> CPU load threads (default 0)" << std::endl;
+    std::cerr << "	-i<n> I/O load threads (default 0)" << std::endl;
+    std::cerr << "	-n<count> Relay commands to time (default 1000)" << std::endl;
+    std::cerr << "	-p<ms> Time between commands (default 10)" << std::endl;
+    std::cerr << "	-l<relay> Relay to toggle (default 0)" << std::endl;
+    exit(8);
+}
+
+int main(int argc, char* argv[])
+{
+    bool real_time = false;	// Run real time
+    int rt_cpu = RT_NO_CPU;	// CPU to run on when real time
+    int cpu_threads = 0;	// CPU load threads
+    int io_threads = 0;		// I/O load threads
+    int count = 1000;		// Commands to time
+    int period_ms = 10;		// Time between commands
+    int relay_number = 0;	// Relay we toggle
+
+    int opt;	// Option we are looking at
+    while ((opt = getopt(argc, argv, "rvR:c:i:n:p:l:")) != -1) {
+	switch (opt) {
+	    case 'r':
+		simulate = true;
+		break;
+	    case 'v':
+		verbose = true;
+		break;
+	    case 'R':
+		real_time = true;
+		rt_cpu = atoi(optarg);
+		break;
+	    case 'c':
+		cpu_threads = atoi(optarg);
+		break;
+	    case 'i':
+		io_threads = atoi(optarg);
+		break;
+	    case 'n':
+		count = atoi(optarg);
+		break;
+	    case 'p':
+		period_ms = atoi(optarg);
+		break;
+	    case 'l':
+		relay_number = atoi(optarg);
+		break;
+	    default:
+		usage();
+	}
+    }
+    if ((optind < argc) || (count <= 0) || (period_ms <= 0))
+	usage();
+
+    openlog("rt_jitter", LOG_PERROR, LOG_USER);
+
+    // Load starts first so it is normal priority whatever we do
+    start_load(cpu_threads, cpu_load);
+    start_load(io_threads, io_load);
+
+    if (real_time) {
+	rt_setup(rt_cpu);
+	rt_thread("rt_jitter");
+    }
+
+    try {
+	relay_setup();
+	relay_reset();
+
+	const enum RELAY_NAME the_relay = static_cast<enum RELAY_NAME>(relay_number);	// Relay to toggle
+	std::vector<int64_t> late;		// How late we woke up (ns)
+	std::vector<int64_t> command;	// How long the relay command took (ns)
+	late.reserve(count);
+	command.reserve(count);
+
+	const int64_t period = period_ms * NS_PER_MS;	// Time between commands (ns)
+	int64_t deadline = now_ns() + period;		// When the next command is due
+	for (int i = 0; i < count; ++i) {
+	    struct timespec when;	// Deadline as a timespec
+	    when.tv_sec = deadline / NS_PER_SEC;
+	    when.tv_nsec = deadline % NS_PER_SEC;
+	    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL) == EINTR)
+		continue;
+
+	    const int64_t woke = now_ns();	// When we got control
+	    relay("rt_jitter", the_relay, ((i % 2) == 0) ? RELAY_STATE::RELAY_ON : RELAY_STATE::RELAY_OFF);
+	    const int64_t done = now_ns();	// When the relay finished
+
+	    late.push_back(woke - deadline);
+	    command.push_back(done - woke);
+	    deadline += period;
+	}
+	relay_reset();
+
+	std::cerr << "rt_jitter: " << count << " commands every " << period_ms << " ms, " <<
+	    cpu_threads << " cpu load, " << io_threads << " io load, " <<
+	    (real_time ? "real time" : "normal") << std::endl;
+	report("late", late);
+	report("command", command);
+    }
+    catch (relay_error& error) {
+	std::cerr << "Relay exception: " << error.error << std::endl;
+	exit(8);
+    }
+    return (0);
+}
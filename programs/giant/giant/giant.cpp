@@ -17,23 +17,16 @@
 #include <string.h>
 #include <sys/wait.h>
 
-#include <wiringPi.h>
-
+#include "gpio.h"
 #include "relay.h"
-static const int GPIO_ON = 5;		// ON/OFF toggle
-static const int GPIO_NOW = 4;		// Execute now
+#include "rt.h"
+static const int GPIO_ON = 24;		// ON/OFF toggle (BCM, wiringPi 5)
+static const int GPIO_NOW = 23;		// Execute now (BCM, wiringPi 4)
+static const unsigned int DEBOUNCE = 100;	// Switches must hold this long (ms)
 
 bool verbose = false;		// Chatter
 bool simulate = false;		// Do not do the work
-
-/********************************************************
- * on_interrupt -- Field an interrupt on which we do	*
- * 	nothing.					*
- ********************************************************/
-static void on_interrupt(void)
-{
-    // Do nothing
-}
+static const char* gpio_script = NULL;	// Mock GPIO script (NULL for the real pins)
 
 /********************************************************
  * die -- Output a message and die
@@ -93,47 +86,35 @@ static void move_arms(void)
 
 
 /********************************************************
- * debounce -- Read a pin with debouncing of 1/10 	*
- * 	seconds.					*
+ * open_pin -- Get a switch input			*
+ *							*
+ * Each thread has its own so they can both wait.	*
  *							*
  * Parameters						*
  * 	gpio_pin Pin to read				*
- * 							*
- * Returns						*
- * 	State of the pin				*
- * 	or -1 for timeout
  ********************************************************/
-static int debounce(const int gpio_pin, time_t wait_time = -1)
+static gpio* open_pin(const int gpio_pin)
 {
-    if (wait_time > 0) {
-	// Get the result of waiting for the interrupt
-	int result = waitForInterrupt(gpio_pin, wait_time*1000);
-	if (result <= 0) 
-	    return (-1);
-    } else
-	waitForInterrupt(gpio_pin, -1);
-
-    while (true)
-    {
-	// Wait for 1/10 second with no change
-	if (waitForInterrupt(gpio_pin, 100) == 0)
-	    break;
-    }
-
-    return (digitalRead(gpio_pin));
+    gpio* pins = gpio_open(gpio_script);	// The pin
+    // With the pull up resistor
+    pins->add_input(gpio_pin, DEBOUNCE);
+    pins->start();
+    return (pins);
 }
 
-
 /********************************************************
  * instant_thread -- Handle the instant button		*
  ********************************************************/
 static void* instant_thread(void*)
 {
+    rt_thread("instant");
+    gpio* now_pin = open_pin(GPIO_NOW);	// The instant button
     while (true)
     {
-	while (debounce(GPIO_NOW) == 0)
-	    continue;
-	move_arms();
+	gpio_event event;	// Button event
+	now_pin->wait(event);
+	if (event.type == GPIO_EVENT::ON)
+	    move_arms();
     }
 }
 
@@ -152,14 +133,18 @@ static std::string the_time(void)
  ********************************************************/
 static void usage(void)
 {
-    std::cout << "Usage giant [-s] [-v] " << std::endl;
+    std::cout << "Usage giant [-s] [-v] [-R<cpu>] [-g <script>]" << std::endl;
+    std::cout << "	-R<cpu> Real time, pinned to <cpu> (-1 for any)" << std::endl;
+    std::cout << "	-g <script> Play a GPIO script (see gpio.h) instead of reading the pins" << std::endl;
     exit(8);
 }
 
 int main(int argc, char* argv[])
 {
+    bool real_time = false;	// Run real time
+    int rt_cpu = RT_NO_CPU;	// CPU to run on when real time
     while (true) {
-	int opt = getopt(argc, argv, "vs");
+	int opt = getopt(argc, argv, "vsR:g:");
 	if (opt < 0)
 	    break;
 	
@@ -171,6 +156,13 @@ int main(int argc, char* argv[])
 	    case 's':
 		simulate = true;
 		break;
+	    case 'R':
+		real_time = true;
+		rt_cpu = atoi(optarg);
+		break;
+	    case 'g':
+		gpio_script = optarg;
+		break;
 	    default:
 		usage();
 	}
@@ -183,6 +175,11 @@ int main(int argc, char* argv[])
     else
 	openlog("giant", 0, LOG_USER); 
 
+    if (real_time) {
+	rt_setup(rt_cpu);
+	rt_thread("giant");
+    }
+
     signal(SIGTERM, byebye);
     signal(SIGINT, byebye);
 
@@ -190,35 +187,19 @@ int main(int argc, char* argv[])
     relay("giant", UPPER_SEMAPHORE, RELAY_STATE::RELAY_OFF);
     relay("giant", LOWER_SEMAPHORE, RELAY_STATE::RELAY_OFF);
 
-    if (wiringPiSetup() != 0) {
-	std::cerr << "ERROR: wiringPiSetup failed" << std::endl;
-	exit(8);
-    }
-    pinMode(GPIO_ON, INPUT);	// Start button is an input
-    pinMode(GPIO_NOW, INPUT);	// So is the active control
-
-    // Add in the pull up resistor
-    pullUpDnControl(GPIO_ON, PUD_UP);
-    pullUpDnControl(GPIO_NOW, PUD_UP);
-
-    if (wiringPiISR (GPIO_ON, INT_EDGE_FALLING, &on_interrupt) != 0) {
-	std::cerr << "ERROR: wiringPiISR failed" << std::endl;
-	exit(8);
-    }
-    if (wiringPiISR (GPIO_NOW, INT_EDGE_BOTH, &on_interrupt)  != 0) {
-	std::cerr << "ERROR: wiringPiISR failed" << std::endl;
-	exit(8);
-    }
+    gpio* on_pin = open_pin(GPIO_ON);	// The on/off toggle
 
     pthread_t id;	// ID of the instant thread
-    pthread_create(&id, NULL, instant_thread, NULL);
+    rt_thread_create(&id, instant_thread, NULL);
 
     // Thread that handles the daily on/off
     while (true)
     {
 	if (verbose) std::cout << the_time() << "Wait for on" << std::endl;
 	// Wait until the system goes on
-	if (debounce(GPIO_ON) == 0)
+	gpio_event event;	// Switch event
+	on_pin->wait(event);
+	if (event.type != GPIO_EVENT::ON)
 	    continue;
 
 	if (verbose) std::cout << "Start periodic" << std::endl;
@@ -230,16 +211,13 @@ int main(int argc, char* argv[])
 	    time_t end_time = time(NULL) + 15 * 60; // Sleep for 14 minutes
 	    move_arms(); 
 
-
-	    while (time(NULL) < end_time)
+	    // Sleep until the next move, or the switch goes off
+	    while (on_pin->read(GPIO_ON) && (time(NULL) < end_time))
 	    {
 		if (verbose) std::cout << "Sleep periodic " << end_time - time(NULL) << std::endl;
-		int status = debounce(GPIO_ON, end_time - time(NULL));
-		if (status < 0)
-		    continue;
-		break;
+		on_pin->wait(event, static_cast<int>(end_time - time(NULL)) * 1000);
 	    }
-	    if (digitalRead(GPIO_ON) == 0) {
+	    if (!on_pin->read(GPIO_ON)) {
 		if (verbose) std::cout << "Periodic off" << std::endl;
 		break;
 	    }
@@ -1,31 +1,337 @@
 /*
  * Firmware for the AVR teensey.   Translates GPIO pins into
- * character. 
+ * character.
  *
  * B pins go to A-H.
- * D pins go to a-h.
+ * D pins go to M-T.
+ *
+ * Keys are held down for as long as the button is, so the host sees
+ * both the press and the release.
+ *
+ * The CPU sleeps until something happens.  A pin change wakes it
+ * (PCINT0-7 for port B, INT0-3 for D0-D3) and starts a 1 ms tick that
+ * runs the debounce state machine (key_debounce.c) until every pin has
+ * settled.  D4-D7 have no pin change interrupt on the atmega32u4, so
+ * while idle the tick keeps running slowly to look at them.
+ *
+ * Built with RAW_HID (make RAW_HID=1) there are no keys.  Each change
+ * sends one raw HID report with every pin in it:
+ *
+ * 	[0] B pins (bit n set if Bn is pressed)
+ * 	[1] D pins
+ * 	[2-3] Sequence number (little endian, +1 every report)
+ * 	[4-7] Time of the change in ms since the USB was configured
+ *
+ * A report also goes out every HEARTBEAT_MS when nothing changes so
+ * the host can match our clock to its own.
+ *
+ * The debounce time and enable of each pin are kept in EEPROM and can
+ * be read and changed through a HID feature report (FEATURE_SIZE bytes,
+ * see signal-prog/avr_config.cpp):
+ *
+ * Read:
+ * 	[0] Page
+ * 	FEATURE_SETTINGS: [1] SETTINGS_VERSION [2] B enable bits
+ * 		[3] D enable bits [4-19] debounce ms for B0-B7, D0-D7
+ * 	FEATURE_BOUNCES: [2-17] bounces seen on B0-B7, D0-D7 (stops at 255)
+ * Write:
+ * 	[0] Command
+ * 	FEATURE_SAVE: [2-19] as the settings page -- use them and save them
+ * 	FEATURE_SELECT: Reads return page [1] from now on
+ * 	FEATURE_CLEAR: Clear the bounce counts
  */
 
 #include <avr/io.h>
 #include <avr/pgmspace.h>
 #include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
 #include <util/delay.h>
 #include "usb_keyboard.h"
+#include "key_debounce.h"
 
 #define CPU_PRESCALE(n)	(CLKPR = 0x80, CLKPR = (n))
 
+// Timer 0 runs in CTC mode.  16 MHz / 64 / 250 = 1 ms
+#define TICK_FAST_PRESCALE ((1<<CS01) | (1<<CS00))
+// 16 MHz / 1024 / 250 = 16 ms (idle scan of D4-D7)
+#define TICK_SLOW_PRESCALE ((1<<CS02) | (1<<CS00))
+#define TICK_COUNT 249
+
+#define HEARTBEAT_MS 1000
+
+// Feature report pages and commands
+#define FEATURE_SETTINGS 0
+#define FEATURE_BOUNCES 1
+#define FEATURE_SAVE 1
+#define FEATURE_SELECT 2
+#define FEATURE_CLEAR 3
+
+#define SETTINGS_MAGIC 0x6B	// EEPROM has been written by us
+#define SETTINGS_VERSION 1
+
+// Settings kept in EEPROM (from enable_b on this is the settings page)
+struct settings {
+    uint8_t magic;		// SETTINGS_MAGIC
+    uint8_t version;		// SETTINGS_VERSION
+    uint8_t enable_b;		// Port B pins in use
+    uint8_t enable_d;		// Port D pins in use
+    uint8_t ticks[16];		// Debounce ms for B0-B7, D0-D7
+};
+#define SETTINGS_PAGE_START 2	// Where the settings go in the report
+
+static struct settings EEMEM ee_settings;	// Saved settings
+static struct settings settings;		// Settings in use
+static volatile struct settings new_settings;	// Settings from the host
+static volatile uint8_t settings_due = 0;	// new_settings need to be used
+static volatile uint8_t clear_due = 0;		// Bounce counts need clearing
+static volatile uint8_t feature_page = FEATURE_SETTINGS;	// Page to read
+
+static struct key_port port_b;	// Debounce for the B pins
+static struct key_port port_d;	// Debounce for the D pins
+
+static volatile uint8_t tick_due = 0;	// Timer went off
+static volatile uint8_t fast = 0;	// Timer is on the fast tick
+
+/*
+ * tick_fast -- Run the timer at the debounce rate
+ *
+ * Called from the pin change interrupts (interrupts are off)
+ */
+static void tick_fast(void)
+{
+    if (fast)
+	return;
+    fast = 1;
+    TCNT0 = 0;
+    TCCR0B = TICK_FAST_PRESCALE;
+    tick_due = 1;	// Take the first sample now
+}
+
+/*
+ * tick_slow -- Run the timer at the idle scan rate
+ */
+static void tick_slow(void)
+{
+    cli();
+    fast = 0;
+    TCNT0 = 0;
+    TCCR0B = TICK_SLOW_PRESCALE;
+    sei();
+}
+
+// Port B pin change
+ISR(PCINT0_vect)
+{
+    tick_fast();
+}
+// Port D0-D3 changes
+ISR(INT0_vect)
+{
+    tick_fast();
+}
+ISR(INT1_vect, ISR_ALIASOF(INT0_vect));
+ISR(INT2_vect, ISR_ALIASOF(INT0_vect));
+ISR(INT3_vect, ISR_ALIASOF(INT0_vect));
+
+// Timer tick
+ISR(TIMER0_COMPA_vect)
+{
+    tick_due = 1;
+}
+
+/*
+ * load_settings -- Get the settings from EEPROM (or the defaults)
+ */
+static void load_settings(void)
+{
+    uint8_t i;	// Pin number
+
+    eeprom_read_block(&settings, &ee_settings, sizeof(settings));
+    if ((settings.magic == SETTINGS_MAGIC) && (settings.version == SETTINGS_VERSION))
+	return;
+    settings.magic = SETTINGS_MAGIC;
+    settings.version = SETTINGS_VERSION;
+    settings.enable_b = 0xFF;
+    settings.enable_d = 0xFF;
+    for (i = 0; i < 16; i++)
+	settings.ticks[i] = KEY_DEBOUNCE_TICKS;
+}
+
+/*
+ * apply_settings -- Put the settings to work
+ */
+static void apply_settings(void)
+{
+    uint8_t i;	// Pin number
+
+    for (i = 0; i < 8; i++) {
+	key_debounce_set(&port_b, i, settings.ticks[i]);
+	key_debounce_set(&port_d, i, settings.ticks[i + 8]);
+    }
+    // Pins not in use don't wake us
+    PCMSK0 = settings.enable_b;
+    EIMSK = settings.enable_d & 0x0F;
+}
+
+/*
+ * usb_feature_get -- The host wants the feature report (USB interrupt)
+ */
+void usb_feature_get(uint8_t *report)
+{
+    uint8_t i;	// Byte in the report
+
+    for (i = 0; i < FEATURE_SIZE; i++)
+	report[i] = 0;
+    report[0] = feature_page;
+    if (feature_page == FEATURE_BOUNCES) {
+	for (i = 0; i < 8; i++) {
+	    report[2 + i] = port_b.pin[i].bounces;
+	    report[10 + i] = port_d.pin[i].bounces;
+	}
+	return;
+    }
+    report[0] = FEATURE_SETTINGS;
+    report[1] = SETTINGS_VERSION;
+    for (i = SETTINGS_PAGE_START; i < sizeof(settings); i++)
+	report[i] = ((const uint8_t *)&settings)[i];
+}
+
+/*
+ * usb_feature_set -- The host sent us a feature report (USB interrupt)
+ *
+ * EEPROM writes are slow, so the main loop does the work.
+ */
+void usb_feature_set(const uint8_t *report)
+{
+    uint8_t i;	// Byte in the report
+
+    switch (report[0]) {
+	case FEATURE_SAVE:
+	    new_settings.magic = SETTINGS_MAGIC;
+	    new_settings.version = SETTINGS_VERSION;
+	    for (i = SETTINGS_PAGE_START; i < sizeof(settings); i++)
+		((volatile uint8_t *)&new_settings)[i] = report[i];
+	    settings_due = 1;
+	    break;
+	case FEATURE_SELECT:
+	    feature_page = report[1];
+	    break;
+	case FEATURE_CLEAR:
+	    clear_due = 1;
+	    break;
+	default:
+	    break;
+    }
+}
+
+#ifdef RAW_HID
+static uint16_t sequence = 0;		// Sequence number of the next report
+static uint32_t last_report = 0;	// When the last report went out (ms)
+
+/*
+ * send_report -- Send the state of every pin
+ *
+ * Parameters
+ * 	b_pins -- Port B pins that are pressed
+ * 	d_pins -- Port D pins that are pressed
+ * 	now -- Time of the change (ms)
+ */
+static void send_report(const uint8_t b_pins, const uint8_t d_pins, const uint32_t now)
+{
+    uint8_t report[RAWHID_SIZE];	// The report
+
+    report[0] = b_pins;
+    report[1] = d_pins;
+    report[2] = sequence & 0xFF;
+    report[3] = sequence >> 8;
+    report[4] = now & 0xFF;
+    report[5] = (now >> 8) & 0xFF;
+    report[6] = (now >> 16) & 0xFF;
+    report[7] = (now >> 24) & 0xFF;
+
+    // A report that can't be sent still uses its number, so the host sees the gap
+    ++sequence;
+    last_report = now;
+    usb_rawhid_send(report);
+}
+#else
+/*
+ * key_change -- Put a key in the report or take it out
+ *
+ * Parameters
+ * 	key -- Key code
+ * 	down -- 1 if the key went down, 0 if it came up
+ */
+static void key_change(const uint8_t key, const uint8_t down)
+{
+    uint8_t i;	// Slot in the report
+
+    for (i = 0; i < 6; i++) {
+	if (down && (keyboard_keys[i] == 0)) {
+	    keyboard_keys[i] = key;
+	    return;
+	}
+	if (!down && (keyboard_keys[i] == key)) {
+	    keyboard_keys[i] = 0;
+	    return;
+	}
+    }
+    // More than 6 keys down -- the extra ones are not sent
+}
+
+/*
+ * send_changes -- Report the keys that changed on a port
+ *
+ * Parameters
+ * 	first_key -- Key for pin 0 of the port
+ * 	down -- Pins that went down
+ * 	up -- Pins that came up
+ *
+ * Returns
+ * 	Non-zero if something changed
+ */
+static uint8_t send_changes(const uint8_t first_key, const uint8_t down, const uint8_t up)
+{
+    uint8_t i;		// Pin number
+    uint8_t mask = 1;	// Bit for the pin
+
+    for (i = 0; i < 8; i++, mask <<= 1) {
+	if (up & mask)
+	    key_change(first_key + i, 0);
+	if (down & mask)
+	    key_change(first_key + i, 1);
+    }
+    return (down | up);
+}
+#endif
+
 int main(void)
 {
-    uint8_t b;		  // Data from GPIO B register
-    uint8_t d;		  // Data from GPIO B register
-    uint8_t b_prev=0xFF;  // Last data from the B register
-    uint8_t d_prev=0xFF;  // Last data from the D register
-    uint8_t mask;	  // Current idle bitmask
-    uint8_t i;		  // Loop counter
+    uint8_t i;			// Byte of the settings
+    uint8_t down;		// Pins that just went down
+    uint8_t up;			// Pins that just came up
+    uint8_t busy;		// Pins still being debounced
+    uint8_t changed;		// The report needs to go out
+#ifdef RAW_HID
+    uint8_t b_pins = 0;		// Debounced state of the B pins
+    uint8_t d_pins = 0;		// Debounced state of the D pins
+    uint32_t now;		// Time of this tick (ms)
+#endif
 
     // set for 16 MHz clock
     CPU_PRESCALE(0);
 
+    // Turn off what we don't use
+    ACSR = (1<<ACD);	// Analog comparator
+    power_adc_disable();
+    power_spi_disable();
+    power_twi_disable();
+    power_usart1_disable();
+    power_timer1_disable();
+    power_timer3_disable();
+
     // Configure all port B and port D pins as inputs with pullup resistors.
     // See the "Using I/O Pins" page for details.
     // http://www.pjrc.com/teensy/pins.html
@@ -34,40 +340,96 @@ int main(void)
     PORTB = 0xFF;
     PORTD = 0xFF;
 
+    key_debounce_init(&port_b);
+    key_debounce_init(&port_d);
+    load_settings();
+
     // Initialize the USB, and then wait for the host to set configuration.
     // If the Teensy is powered without a PC connected to the USB port,
     // this will wait forever.
     usb_init();
-    while (!usb_configured()) 
+    while (!usb_configured())
 	continue/* wait */ ;
 
     // Wait an extra second for the PC's operating system to load drivers
     // and do whatever it does to actually be ready for input
     _delay_ms(1000);
 
+    // Pin change interrupts: port B, D0-D3 on any edge (the pins in use)
+    PCICR = (1<<PCIE0);
+    EICRA = (1<<ISC30) | (1<<ISC20) | (1<<ISC10) | (1<<ISC00);
+    EIFR = 0x0F;
+    apply_settings();
+
+    // Timer 0 ticks, starting slow
+    TCCR0A = (1<<WGM01);
+    OCR0A = TICK_COUNT;
+    TIMSK0 = (1<<OCIE0A);
+    tick_slow();
+
+    // USB needs its clocks, so idle is as deep as we can go
+    set_sleep_mode(SLEEP_MODE_IDLE);
+
     while (1) {
-	// read all port B and port D pins
-	b = PINB;
-	d = PIND;
-	// check if any pins are low, but were high previously
-	
-	mask = 1;
-	for (i=0; i<8; i++) {
-	    if (((b & mask) == 0) && (b_prev & mask) != 0) {
-		usb_keyboard_press(KEY_A+i, 0);
-	    }
-	    if (((d & mask) == 0) && (d_prev & mask) != 0) {
-		usb_keyboard_press(KEY_M+i, 0);
+	cli();
+	if (!tick_due && !settings_due && !clear_due) {
+	    sleep_enable();
+	    sei();
+	    sleep_cpu();	// Any interrupt wakes us
+	    sleep_disable();
+	}
+	sei();
+
+	if (settings_due) {
+	    cli();
+	    for (i = 0; i < sizeof(settings); i++)
+		((uint8_t *)&settings)[i] = ((volatile uint8_t *)&new_settings)[i];
+	    settings_due = 0;
+	    apply_settings();
+	    sei();
+	    eeprom_update_block(&settings, &ee_settings, sizeof(settings));
+	}
+	if (clear_due) {
+	    clear_due = 0;
+	    key_debounce_clear_bounces(&port_b);
+	    key_debounce_clear_bounces(&port_d);
+	}
+	if (!tick_due)
+	    continue;	// Woken by USB, nothing for us
+	tick_due = 0;
+
+	// Buttons pull the pins low
+#ifdef RAW_HID
+	now = usb_millis();
+	busy = key_debounce_tick(&port_b, ~PINB & settings.enable_b, &down, &up);
+	changed = down | up;
+	b_pins = (b_pins | down) & ~up;
+	busy |= key_debounce_tick(&port_d, ~PIND & settings.enable_d, &down, &up);
+	changed |= down | up;
+	d_pins = (d_pins | down) & ~up;
+
+	if (changed || ((now - last_report) >= HEARTBEAT_MS))
+	    send_report(b_pins, d_pins, now);
+#else
+	busy = key_debounce_tick(&port_b, ~PINB & settings.enable_b, &down, &up);
+	changed = send_changes(KEY_A, down, up);
+	busy |= key_debounce_tick(&port_d, ~PIND & settings.enable_d, &down, &up);
+	changed |= send_changes(KEY_M, down, up);
+
+	if (changed)
+	    usb_keyboard_send();
+#endif
+
+	if (busy) {
+	    // A slow tick that found a D4-D7 change speeds up
+	    if (!fast) {
+		cli();
+		tick_fast();
+		tick_due = 0;
+		sei();
 	    }
-	    mask = mask << 1;
+	} else if (fast) {
+	    tick_slow();
 	}
-	// now the current pins will be the previous, and
-	// wait a short delay so we're not highly sensitive
-	// to mechanical "bounce".
-	b_prev = b;
-	d_prev = d;
-	_delay_ms(2);
     }
 }
-
-
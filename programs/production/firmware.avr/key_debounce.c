@@ -0,0 +1,126 @@
+/*
+ * key_debounce -- Debounce state machine for 8 key pins
+ *
+ * See key_debounce.h
+ */
+#include "key_debounce.h"
+
+/*
+ * key_debounce_init -- Start with every key released
+ *
+ * Parameters
+ * 	port -- The port to set up
+ */
+void key_debounce_init(struct key_port* port)
+{
+    uint8_t i;	// Pin number
+
+    for (i = 0; i < KEY_DEBOUNCE_PINS; i++) {
+	port->pin[i].state = KEY_UP;
+	port->pin[i].count = 0;
+	port->pin[i].ticks = KEY_DEBOUNCE_TICKS;
+	port->pin[i].bounces = 0;
+    }
+}
+
+/*
+ * key_debounce_set -- Set the number of ticks a pin needs to change
+ *
+ * Parameters
+ * 	port -- The port
+ * 	pin -- The pin (0-7)
+ * 	ticks -- Ticks to change (0 is taken as 1)
+ */
+void key_debounce_set(struct key_port* port, uint8_t pin, uint8_t ticks)
+{
+    if (pin >= KEY_DEBOUNCE_PINS)
+	return;
+    port->pin[pin].ticks = (ticks == 0) ? 1 : ticks;
+}
+
+/*
+ * key_debounce_clear_bounces -- Start counting bounces again
+ */
+void key_debounce_clear_bounces(struct key_port* port)
+{
+    uint8_t i;	// Pin number
+
+    for (i = 0; i < KEY_DEBOUNCE_PINS; i++)
+	port->pin[i].bounces = 0;
+}
+
+/*
+ * key_debounce_tick -- Run one sample of the pins through the state machine
+ *
+ * Parameters
+ * 	port -- The port
+ * 	pressed -- Sample of the pins (bit n set if pin n reads pressed)
+ * 	down -- Returns the pins that just went down
+ * 	up -- Returns the pins that just came up
+ *
+ * Returns
+ * 	Non-zero if a pin is still being counted (keep the ticks coming)
+ */
+uint8_t key_debounce_tick(struct key_port* port, uint8_t pressed,
+	uint8_t* down, uint8_t* up)
+{
+    uint8_t i;		// Pin number
+    uint8_t mask = 1;	// Bit for the pin
+    uint8_t busy = 0;	// Pins being counted
+
+    *down = 0;
+    *up = 0;
+    for (i = 0; i < KEY_DEBOUNCE_PINS; i++, mask <<= 1) {
+	struct key_pin* pin = &port->pin[i];
+	const uint8_t is_pressed = ((pressed & mask) != 0);
+
+	switch (pin->state) {
+	    case KEY_UP:
+		if (is_pressed) {
+		    pin->state = KEY_GOING_DOWN;
+		    pin->count = 0;
+		}
+		break;
+	    case KEY_DOWN:
+		if (!is_pressed) {
+		    pin->state = KEY_GOING_UP;
+		    pin->count = 0;
+		}
+		break;
+	    default:
+		break;
+	}
+	// A change can finish on the tick it starts (ticks = 1)
+	switch (pin->state) {
+	    case KEY_GOING_DOWN:
+		if (!is_pressed) {
+		    pin->state = KEY_UP;	// Bounce
+		    if (pin->bounces != 255)
+			pin->bounces++;
+		} else if (++pin->count >= pin->ticks) {
+		    pin->state = KEY_DOWN;
+		    *down |= mask;
+		}
+		break;
+	    case KEY_GOING_UP:
+		if (is_pressed) {
+		    pin->state = KEY_DOWN;	// Bounce
+		    if (pin->bounces != 255)
+			pin->bounces++;
+		} else if (++pin->count >= pin->ticks) {
+		    pin->state = KEY_UP;
+		    *up |= mask;
+		}
+		break;
+	    case KEY_UP:
+	    case KEY_DOWN:
+		break;
+	    default:
+		pin->state = KEY_UP;
+		break;
+	}
+	if ((pin->state == KEY_GOING_DOWN) || (pin->state == KEY_GOING_UP))
+	    busy |= mask;
+    }
+    return (busy);
+}
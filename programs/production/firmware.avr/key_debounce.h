@@ -0,0 +1,54 @@
+/*
+ * key_debounce -- Debounce state machine for 8 key pins
+ *
+ * Plain C with no AVR headers so it can be built and tried out on
+ * the host as well as in the firmware.
+ *
+ * Each pin goes through four states:
+ *
+ * 	UP -- Released
+ * 	GOING_DOWN -- Looks pressed, counting ticks
+ * 	DOWN -- Pressed
+ * 	GOING_UP -- Looks released, counting ticks
+ *
+ * A pin has to read the same for its number of ticks (default
+ * KEY_DEBOUNCE_TICKS, set with key_debounce_set) in a row to change
+ * state.  A sample that goes back the other way drops it back to where
+ * it was, so contact bounce never makes a key event.  Each time that
+ * happens the pin's bounce count goes up (so noisy buttons can be found.)
+ *
+ * Usage
+ * 	key_debounce_init(&port);
+ * 	every tick:
+ * 	    busy = key_debounce_tick(&port, pressed_bits, &down, &up);
+ * 	    (down / up are the pins that just changed, busy is true while
+ * 	    a pin is still being counted)
+ */
+#ifndef __KEY_DEBOUNCE_H__
+#define __KEY_DEBOUNCE_H__
+
+#include <stdint.h>
+
+#define KEY_DEBOUNCE_PINS 8	// Pins in a port
+#define KEY_DEBOUNCE_TICKS 5	// Default ticks a pin must hold steady to change
+
+enum key_state {KEY_UP, KEY_GOING_DOWN, KEY_DOWN, KEY_GOING_UP};
+
+struct key_pin {
+    uint8_t state;	// enum key_state
+    uint8_t count;	// Ticks the pin has held its new value
+    uint8_t ticks;	// Ticks needed to change
+    uint8_t bounces;	// Changes that bounced back (stops at 255)
+};
+
+struct key_port {
+    struct key_pin pin[KEY_DEBOUNCE_PINS];	// The pins
+};
+
+void key_debounce_init(struct key_port* port);
+void key_debounce_set(struct key_port* port, uint8_t pin, uint8_t ticks);
+void key_debounce_clear_bounces(struct key_port* port);
+uint8_t key_debounce_tick(struct key_port* port, uint8_t pressed,
+	uint8_t* down, uint8_t* up);
+
+#endif /* __KEY_DEBOUNCE_H__ */
@@ -0,0 +1,204 @@
+/*
+ * key_debounce_test -- Try out the debounce state machine on the host
+ *
+ * Usage: make test	(builds with the host cc, not avr-gcc)
+ *
+ * Prints each check that fails and exits non-zero if any did.
+ */
+#include <stdio.h>
+
+#include "key_debounce.h"
+
+static int failures = 0;	// Checks that failed
+
+/*
+ * check -- Note a check that failed
+ *
+ * Parameters
+ * 	ok -- Did it pass
+ * 	what -- What we were checking
+ */
+static void check(int ok, const char* what)
+{
+    if (!ok) {
+	printf("FAIL: %s\n", what);
+	failures++;
+    }
+}
+
+/*
+ * run -- Feed the same sample to the port for a number of ticks
+ *
+ * Parameters
+ * 	port -- The port
+ * 	pressed -- The sample
+ * 	ticks -- How many ticks
+ * 	down, up -- All the pins that went down / came up
+ *
+ * Returns
+ * 	busy from the last tick
+ */
+static uint8_t run(struct key_port* port, uint8_t pressed, int ticks,
+	uint8_t* down, uint8_t* up)
+{
+    uint8_t busy = 0;	// Result of the last tick
+    uint8_t d;		// Pins down this tick
+    uint8_t u;		// Pins up this tick
+    int i;		// Tick number
+
+    *down = 0;
+    *up = 0;
+    for (i = 0; i < ticks; i++) {
+	busy = key_debounce_tick(port, pressed, &d, &u);
+	*down |= d;
+	*up |= u;
+    }
+    return (busy);
+}
+
+/*
+ * test_clean -- A clean press and release each take N ticks
+ */
+static void test_clean(void)
+{
+    struct key_port port;	// Port under test
+    uint8_t down, up;		// Events
+    uint8_t busy;		// Still counting
+
+    key_debounce_init(&port);
+    busy = run(&port, 0x01, KEY_DEBOUNCE_TICKS - 1, &down, &up);
+    check(down == 0, "clean: no down before N ticks");
+    check(busy == 0x01, "clean: busy while counting the press");
+
+    busy = run(&port, 0x01, 1, &down, &up);
+    check(down == 0x01, "clean: down on tick N");
+    check(busy == 0, "clean: not busy once pressed");
+    check(port.pin[0].state == KEY_DOWN, "clean: pin is DOWN");
+
+    busy = run(&port, 0x01, 10, &down, &up);
+    check((down == 0) && (up == 0) && (busy == 0), "clean: no events or busy while held");
+
+    busy = run(&port, 0x00, KEY_DEBOUNCE_TICKS - 1, &down, &up);
+    check(up == 0, "clean: no up before N ticks");
+    check(busy == 0x01, "clean: busy while counting the release");
+
+    busy = run(&port, 0x00, 1, &down, &up);
+    check(up == 0x01, "clean: up on tick N");
+    check(busy == 0, "clean: not busy once released");
+    check(port.pin[0].bounces == 0, "clean: no bounces");
+}
+
+/*
+ * test_bounce -- A sample that goes back drops the pin back, counts a
+ * bounce and makes no event
+ */
+static void test_bounce(void)
+{
+    struct key_port port;	// Port under test
+    uint8_t down, up;		// Events
+    uint8_t busy;		// Still counting
+
+    key_debounce_init(&port);
+    run(&port, 0x80, 2, &down, &up);
+    busy = run(&port, 0x00, 1, &down, &up);
+    check((down == 0) && (up == 0), "bounce: no event going down");
+    check(port.pin[7].state == KEY_UP, "bounce: back to UP");
+    check(port.pin[7].bounces == 1, "bounce: counted going down");
+    check(busy == 0, "bounce: not busy back at UP");
+
+    run(&port, 0x80, KEY_DEBOUNCE_TICKS, &down, &up);
+    check(down == 0x80, "bounce: pressed after holding N ticks");
+
+    run(&port, 0x00, 2, &down, &up);
+    busy = run(&port, 0x80, 1, &down, &up);
+    check((down == 0) && (up == 0), "bounce: no event going up");
+    check(port.pin[7].state == KEY_DOWN, "bounce: back to DOWN");
+    check(port.pin[7].bounces == 2, "bounce: counted going up");
+    check(busy == 0, "bounce: not busy back at DOWN");
+
+    key_debounce_clear_bounces(&port);
+    check(port.pin[7].bounces == 0, "bounce: cleared");
+}
+
+/*
+ * test_one_tick -- With ticks = 1 a change finishes on the tick it starts
+ */
+static void test_one_tick(void)
+{
+    struct key_port port;	// Port under test
+    uint8_t down, up;		// Events
+    uint8_t busy;		// Still counting
+
+    key_debounce_init(&port);
+    key_debounce_set(&port, 3, 1);
+    busy = run(&port, 0x08, 1, &down, &up);
+    check(down == 0x08, "one tick: down on the first tick");
+    check(busy == 0, "one tick: not busy");
+
+    busy = run(&port, 0x00, 1, &down, &up);
+    check(up == 0x08, "one tick: up on the first tick");
+    check(busy == 0, "one tick: not busy after release");
+
+    key_debounce_set(&port, 3, 0);
+    check(port.pin[3].ticks == 1, "one tick: 0 ticks is taken as 1");
+}
+
+/*
+ * test_saturate -- The bounce count stops at 255
+ */
+static void test_saturate(void)
+{
+    struct key_port port;	// Port under test
+    uint8_t down, up;		// Events
+    uint8_t all_down = 0;	// Every down we saw
+    int i;			// Bounce number
+
+    key_debounce_init(&port);
+    for (i = 0; i < 300; i++) {
+	run(&port, 0x02, 1, &down, &up);
+	all_down |= down;
+	run(&port, 0x00, 1, &down, &up);
+	all_down |= down;
+    }
+    check(port.pin[1].bounces == 255, "saturate: bounces stop at 255");
+    check(all_down == 0, "saturate: no events from bouncing");
+}
+
+/*
+ * test_settled -- busy is 0 only when every pin has settled
+ */
+static void test_settled(void)
+{
+    struct key_port port;	// Port under test
+    uint8_t down, up;		// Events
+    uint8_t busy;		// Still counting
+
+    key_debounce_init(&port);
+    busy = run(&port, 0x00, 1, &down, &up);
+    check(busy == 0, "settled: not busy at rest");
+
+    key_debounce_set(&port, 0, 2);
+    busy = run(&port, 0x03, 2, &down, &up);
+    check(down == 0x01, "settled: fast pin down");
+    check(busy == 0x02, "settled: slow pin still busy");
+
+    busy = run(&port, 0x03, KEY_DEBOUNCE_TICKS - 2, &down, &up);
+    check(down == 0x02, "settled: slow pin down");
+    check(busy == 0, "settled: not busy when both are down");
+}
+
+int main(void)
+{
+    test_clean();
+    test_bounce();
+    test_one_tick();
+    test_saturate();
+    test_settled();
+
+    if (failures != 0) {
+	printf("%d checks failed\n", failures);
+	return (1);
+    }
+    printf("key_debounce: all tests passed\n");
+    return (0);
+}
@@ -23,6 +23,8 @@
 
 // Version 1.0: Initial Release
 // Version 1.1: Add support for Teensy 2.0
+// Garden: RAW_HID replaces the keyboard with a vendor defined raw HID
+// report (see gpio_to_key.c for the layout)
 
 #define USB_SERIAL_PRIVATE_INCLUDE
 #include "usb_keyboard.h"
@@ -35,7 +37,11 @@
 
 // You can change these to give your code its own name.
 #define STR_MANUFACTURER	L"MfgName"
+#ifdef RAW_HID
+#define STR_PRODUCT		L"Garden Buttons"
+#else
 #define STR_PRODUCT		L"Keyboard"
+#endif
 
 
 // Mac OS-X and Linux automatically load the correct drivers.  On
@@ -43,7 +49,11 @@
 // INF file is needed to load the driver.  These numbers need to
 // match the INF file.
 #define VENDOR_ID		0x16C0
+#ifdef RAW_HID
+#define PRODUCT_ID		0x0480
+#else
 #define PRODUCT_ID		0x047C
+#endif
 
 
 // USB devices are supposed to implment a halt feature, which is
@@ -106,6 +116,24 @@ static uint8_t PROGMEM const device_descriptor[] = {
 	1					// bNumConfigurations
 };
 
+#ifdef RAW_HID
+// Vendor defined page, one RAWHID_SIZE byte input report, no report id
+static uint8_t PROGMEM const keyboard_hid_report_desc[] = {
+	0x06, 0xAB, 0xFF,	// Usage Page (Vendor 0xFFAB)
+	0x0A, 0x00, 0x02,	// Usage (0x0200)
+	0xA1, 0x01,		// Collection (Application)
+	0x75, 0x08,		//   Report Size (8)
+	0x15, 0x00,		//   Logical Minimum (0)
+	0x26, 0xFF, 0x00,	//   Logical Maximum (255)
+	0x95, RAWHID_SIZE,	//   Report Count
+	0x09, 0x01,		//   Usage (1)
+	0x81, 0x02,		//   Input (Data, Variable, Absolute)
+	0x95, FEATURE_SIZE,	//   Report Count
+	0x09, 0x02,		//   Usage (2)
+	0xB1, 0x02,		//   Feature (Data, Variable, Absolute)
+	0xC0			// End Collection
+};
+#else
 // Keyboard Protocol 1, HID 1.11 spec, Appendix B, page 59-60
 static uint8_t PROGMEM const keyboard_hid_report_desc[] = {
         0x05, 0x01,          // Usage Page (Generic Desktop),
@@ -139,8 +167,16 @@ static uint8_t PROGMEM const keyboard_hid_report_desc[] = {
         0x19, 0x00,          //   Usage Minimum (0),
         0x29, 0x68,          //   Usage Maximum (104),
         0x81, 0x00,          //   Input (Data, Array),
+        0x06, 0xAB, 0xFF,    //   Usage Page (Vendor 0xFFAB),
+        0x09, 0x02,          //   Usage (2),
+        0x15, 0x00,          //   Logical Minimum (0),
+        0x26, 0xFF, 0x00,    //   Logical Maximum (255),
+        0x75, 0x08,          //   Report Size (8),
+        0x95, FEATURE_SIZE,  //   Report Count (FEATURE_SIZE),
+        0xB1, 0x02,          //   Feature (Data, Variable, Absolute), ;Settings
         0xc0                 // End Collection
 };
+#endif
 
 #define CONFIG1_DESC_SIZE        (9+9+9+7)
 #define KEYBOARD_HID_DESC_OFFSET (9+9)
@@ -162,8 +198,13 @@ static uint8_t PROGMEM const config1_descriptor[CONFIG1_DESC_SIZE] = {
 	0,					// bAlternateSetting
 	1,					// bNumEndpoints
 	0x03,					// bInterfaceClass (0x03 = HID)
+#ifdef RAW_HID
+	0x00,					// bInterfaceSubClass (none)
+	0x00,					// bInterfaceProtocol (none)
+#else
 	0x01,					// bInterfaceSubClass (0x01 = Boot)
 	0x01,					// bInterfaceProtocol (0x01 = Keyboard)
+#endif
 	0,					// iInterface
 	// HID interface descriptor, HID 1.11 spec, section 6.2.1
 	9,					// bLength
@@ -258,6 +299,14 @@ static uint8_t keyboard_idle_count=0;
 // 1=num lock, 2=caps lock, 4=scroll lock, 8=compose, 16=kana
 volatile uint8_t keyboard_leds=0;
 
+// milliseconds since we were configured (counted by start of frame)
+static volatile uint32_t usb_ms=0;
+
+#ifdef RAW_HID
+// last raw report sent (for GET_REPORT)
+static uint8_t rawhid_report[RAWHID_SIZE];
+#endif
+
 
 /**************************************************************************
  *
@@ -336,6 +385,53 @@ int8_t usb_keyboard_send(void)
 	return 0;
 }
 
+#ifdef RAW_HID
+// send a raw report (RAWHID_SIZE bytes)
+int8_t usb_rawhid_send(const uint8_t *report)
+{
+	uint8_t i, intr_state, timeout;
+
+	if (!usb_configuration) return -1;
+	intr_state = SREG;
+	cli();
+	UENUM = KEYBOARD_ENDPOINT;
+	timeout = UDFNUML + 50;
+	while (1) {
+		// are we ready to transmit?
+		if (UEINTX & (1<<RWAL)) break;
+		SREG = intr_state;
+		// has the USB gone offline?
+		if (!usb_configuration) return -1;
+		// have we waited too long?
+		if (UDFNUML == timeout) return -1;
+		// get ready to try checking again
+		intr_state = SREG;
+		cli();
+		UENUM = KEYBOARD_ENDPOINT;
+	}
+	for (i=0; i<RAWHID_SIZE; i++) {
+		rawhid_report[i] = report[i];
+		UEDATX = report[i];
+	}
+	UEINTX = 0x3A;
+	SREG = intr_state;
+	return 0;
+}
+#endif
+
+// milliseconds since configured (wraps after 49 days)
+uint32_t usb_millis(void)
+{
+	uint32_t ms;
+	uint8_t intr_state;
+
+	intr_state = SREG;
+	cli();
+	ms = usb_ms;
+	SREG = intr_state;
+	return ms;
+}
+
 /**************************************************************************
  *
  *  Private Functions - not intended for general user consumption....
@@ -349,8 +445,11 @@ int8_t usb_keyboard_send(void)
 //
 ISR(USB_GEN_vect)
 {
-	uint8_t intbits, i;
+	uint8_t intbits;
+#ifndef RAW_HID
+	uint8_t i;
 	static uint8_t div4=0;
+#endif
 
         intbits = UDINT;
         UDINT = 0;
@@ -363,6 +462,9 @@ ISR(USB_GEN_vect)
 		usb_configuration = 0;
         }
 	if ((intbits & (1<<SOFI)) && usb_configuration) {
+		usb_ms++;
+#ifndef RAW_HID
+		// (the raw report goes out only when gpio_to_key sends it)
 		if (keyboard_idle_config && (++div4 & 3) == 0) {
 			UENUM = KEYBOARD_ENDPOINT;
 			if (UEINTX & (1<<RWAL)) {
@@ -378,6 +480,7 @@ ISR(USB_GEN_vect)
 				}
 			}
 		}
+#endif
 	}
 }
 
@@ -541,13 +644,30 @@ ISR(USB_COM_vect)
 		#endif
 		if (wIndex == KEYBOARD_INTERFACE) {
 			if (bmRequestType == 0xA1) {
+				if (bRequest == HID_GET_REPORT && (wValue >> 8) == 3) {
+					// feature report
+					uint8_t feature[FEATURE_SIZE];
+					usb_feature_get(feature);
+					usb_wait_in_ready();
+					for (i=0; i<FEATURE_SIZE; i++) {
+						UEDATX = feature[i];
+					}
+					usb_send_in();
+					return;
+				}
 				if (bRequest == HID_GET_REPORT) {
 					usb_wait_in_ready();
+#ifdef RAW_HID
+					for (i=0; i<RAWHID_SIZE; i++) {
+						UEDATX = rawhid_report[i];
+					}
+#else
 					UEDATX = keyboard_modifier_keys;
 					UEDATX = 0;
 					for (i=0; i<6; i++) {
 						UEDATX = keyboard_keys[i];
 					}
+#endif
 					usb_send_in();
 					return;
 				}
@@ -565,6 +685,22 @@ ISR(USB_COM_vect)
 				}
 			}
 			if (bmRequestType == 0x21) {
+				if (bRequest == HID_SET_REPORT && (wValue >> 8) == 3) {
+					// feature report
+					uint8_t feature[FEATURE_SIZE];
+					n = (wLength < FEATURE_SIZE) ? wLength : FEATURE_SIZE;
+					for (i=n; i<FEATURE_SIZE; i++) {
+						feature[i] = 0;
+					}
+					usb_wait_receive_out();
+					for (i=0; i<n; i++) {
+						feature[i] = UEDATX;
+					}
+					usb_ack_out();
+					usb_send_in();
+					usb_feature_set(feature);
+					return;
+				}
 				if (bRequest == HID_SET_REPORT) {
 					usb_wait_receive_out();
 					keyboard_leds = UEDATX;
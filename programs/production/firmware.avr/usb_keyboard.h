@@ -12,6 +12,17 @@ extern uint8_t keyboard_modifier_keys;
 extern uint8_t keyboard_keys[6];
 extern volatile uint8_t keyboard_leds;
 
+// Raw HID report mode (RAW_HID)
+#define RAWHID_SIZE		8
+int8_t usb_rawhid_send(const uint8_t *report);
+uint32_t usb_millis(void);		// milliseconds (USB frames) since configured
+
+// Feature report (settings, see gpio_to_key.c).  The application
+// supplies these two.  Both are called from the USB interrupt.
+#define FEATURE_SIZE		20
+void usb_feature_get(uint8_t *report);
+void usb_feature_set(const uint8_t *report);
+
 // This file does not include the HID debug functions, so these empty
 // macros replace them with nothing, so users can compile code that
 // has calls to these functions.
@@ -13,9 +13,10 @@ static const char* const BUTTON_PROG = "/home/garden/bin/button_avr";
 #include <signal.h>
 #include <unistd.h>
 
-#include <wiringPi.h>
+#include "gpio.h"
 
 bool stdout_log = false;	// Send log messages to stdout
+static const char* gpio_script = NULL;	// Mock GPIO script (NULL for the real pins)
 
 // Garden pid file
 #define GARDEN_PID  "/var/run/garden.pid"
@@ -24,10 +25,12 @@ bool stdout_log = false;	// Send log messages to stdout
 static const int START_HOUR = 8;	// Turn on at 8am
 static const int STOP_HOUR = 19;	// Stop at 7pm
 
-static const int OVER_POWER_ON = 24;	// Pin to read the power on override
-static const int OVER_POWER_OFF = 22;	// Pin to read the power off override
+// BCM GPIO numbers
+static const int OVER_POWER_ON = 8;	// Pin to read the power on override (physical pin 24)
+static const int OVER_POWER_OFF = 25;	// Pin to read the power off override (physical pin 22)
+static const unsigned int OVER_DEBOUNCE = 50;	// Override switches must hold this long (ms)
 
-static const int POWER_CONTROL = 23;	// Power control bit
+static const int POWER_CONTROL = 11;	// Power control bit (physical pin 23)
 
 
 // Current state of the power switch
@@ -86,6 +89,22 @@ static void start_garden(void) {
 #endif
     return;
 }
+/*
+ * local_now -- Get the local time
+ */
+static struct tm local_now(void)
+{
+    time_t now;	// The current time
+    time(&now);	// Get the time
+
+    struct tm now_tm; // Now as a TM time
+
+    if (localtime_r(&now, &now_tm) == NULL) {
+	std::cout << "ERROR: Can't tell time " << std::endl;
+	exit(8);
+    }
+    return (now_tm);
+}
 /*
  * start_button -- Start the button program
  */
@@ -110,12 +129,16 @@ int main(int argc, char* argv[])
 	exit(8);
     }
     //	-- s log to stdout
+    //	-- g <script> play a GPIO script (see gpio.h) instead of reading the pins
     int opt;	// Option we are looking
-    while ((opt = getopt(argc, argv, "s")) != -1) {
+    while ((opt = getopt(argc, argv, "sg:")) != -1) {
 	switch (opt) {
 	    case 's':
 		stdout_log = true;
 		break;
+	    case 'g':
+		gpio_script = optarg;
+		break;
 	    default: /* '?' */
 		std::cerr << "Unknown option " << std::endl;
 		exit(8);
@@ -125,38 +148,28 @@ int main(int argc, char* argv[])
     openlog("power", stdout_log ? LOG_PERROR : 0, LOG_USER); 
     syslog(LOG_INFO, "Starting power program");
 
-    wiringPiSetupPhys();	// Setup the GPI
-    pinMode(OVER_POWER_ON, INPUT);
-    pullUpDnControl(OVER_POWER_ON, PUD_OFF);
-
-    pinMode(OVER_POWER_OFF, INPUT);
-    pullUpDnControl(OVER_POWER_OFF, PUD_OFF);
-
-    pinMode(POWER_CONTROL, OUTPUT);
+    // The overrides are on when they read 0
+    gpio* pins = gpio_open(gpio_script);
+    pins->add_input(OVER_POWER_ON, OVER_DEBOUNCE, 0, GPIO_BIAS::NONE, true);
+    pins->add_input(OVER_POWER_OFF, OVER_DEBOUNCE, 0, GPIO_BIAS::NONE, true);
+    pins->add_output(POWER_CONTROL);
+    pins->start();
 
     while (1) {
 	enum POWER_STATE new_state = POWER_UNKNOWN;	// State we want to be in
 	std::string modifier = "none";
 
-	if (digitalRead(OVER_POWER_ON) == 0) {
+	if (pins->read(OVER_POWER_ON)) {
 	    new_state = POWER_ON;
 	    modifier = "[forced]";
 	}
-	if (digitalRead(OVER_POWER_OFF) == 0) {
+	if (pins->read(OVER_POWER_OFF)) {
 	    new_state = POWER_OFF;
 	    modifier = "[forced]";
 	}
 	
 	if (new_state == POWER_UNKNOWN) {
-	    time_t now;	// The current time
-	    time(&now);	// Get the time
-
-	    struct tm now_tm; // Now as a TM time
-
-	    if (localtime_r(&now, &now_tm) == NULL) {
-		std::cout << "ERROR: Can't tell time " << std::endl;
-		exit(8);
-	    }
+	    struct tm now_tm = local_now(); // Now as a TM time
 
 	    if ((now_tm.tm_hour < START_HOUR) || (now_tm.tm_hour >= STOP_HOUR)) {
 		new_state = POWER_OFF;
@@ -171,12 +184,12 @@ int main(int argc, char* argv[])
 
 	    switch (new_state) {
 		case POWER_ON:
-		    digitalWrite(POWER_CONTROL, 1);
+		    pins->write(POWER_CONTROL, true);
 		    log_msg += "on";
 		    break;
 		case POWER_OFF:
 		    kill_garden();
-		    digitalWrite(POWER_CONTROL, 0);
+		    pins->write(POWER_CONTROL, false);
 		    log_msg += "off";
 		    break;
 		default:
@@ -194,7 +207,13 @@ int main(int argc, char* argv[])
 		sleep(10);
 	    }
 	    syslog(LOG_INFO, "Power sleep done");
+	    pins->discard();	// The levels are all we need
 	}
-	sleep(1);
+	// The schedule only changes on the hour, so sleep until then
+	// (or until an override switch changes)
+	struct tm now_tm = local_now(); // Now as a TM time
+	const int to_hour = (60 - now_tm.tm_min) * 60 - now_tm.tm_sec;	// Seconds to the next hour
+	gpio_event event;	// Switch event (the level is all we want)
+	pins->wait(event, to_hour * 1000);
     }
 }
@@ -0,0 +1,289 @@
+/*
+ * avr_config -- Look at and change the AVR button settings
+ *
+ * The AVR firmware (firmware.avr/gpio_to_key.c) keeps the debounce
+ * time and enable of each pin in EEPROM.  They are read and written
+ * through a HID feature report, so a noisy button can be tuned in the
+ * field without reflashing.
+ *
+ * Usage:
+ * 	avr_config [-d <device>] show
+ * 	avr_config [-d <device>] debounce <pin>|* <ms>
+ * 	avr_config [-d <device>] enable <pin>|*
+ * 	avr_config [-d <device>] disable <pin>|*
+ * 	avr_config [-d <device>] [-c] [-w] bounces
+ *
+ * <pin> is B0-B7, D0-D7 (or 0-15).  bounces shows how many times each
+ * pin bounced (a change that went back before the debounce time was up);
+ * -c clears the counts after showing them, -w shows them every second.
+ *
+ * <device> is the hidraw device.  Without it we look for the AVR (keyboard
+ * or raw HID firmware) by USB id.
+ */
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <cctype>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "device.h"
+
+// Must match firmware.avr/gpio_to_key.c
+static const int FEATURE_SIZE = 20;		// Size of the feature report
+static const uint8_t FEATURE_SETTINGS = 0;	// Page: settings
+static const uint8_t FEATURE_BOUNCES = 1;	// Page: bounce counts
+static const uint8_t FEATURE_SAVE = 1;		// Command: use and save settings
+static const uint8_t FEATURE_SELECT = 2;	// Command: select the page to read
+static const uint8_t FEATURE_CLEAR = 3;		// Command: clear the bounce counts
+static const uint8_t SETTINGS_VERSION = 1;	// Settings layout we understand
+static const int PINS = 16;			// Pins on the AVR
+
+// Where things are in the settings page
+static const int ENABLE_B = 2;	// Port B enable bits
+static const int ENABLE_D = 3;	// Port D enable bits
+static const int TICKS = 4;	// Debounce ms (one per pin)
+static const int BOUNCES = 2;	// Bounce counts (one per pin, bounces page)
+
+// The report (byte 0 is the report number, always 0 for us)
+typedef uint8_t feature_report[FEATURE_SIZE + 1];
+
+/*
+ * usage -- Tell the user how to use us
+ */
+static void usage(void)
+{
+    std::cerr << "Usage is:" << std::endl;
+    std::cerr << "	avr_config [-d <device>] show" << std::endl;
+    std::cerr << "	avr_config [-d <device>] debounce <pin>|* <ms>" << std::endl;
+    std::cerr << "	avr_config [-d <device>] enable <pin>|*" << std::endl;
+    std::cerr << "	avr_config [-d <device>] disable <pin>|*" << std::endl;
+    std::cerr << "	avr_config [-d <device>] [-c] [-w] bounces" << std::endl;
+    std::cerr << "<pin> is B0-B7, D0-D7 or 0-15" << std::endl;
+    exit(8);
+}
+/*
+ * find_device -- Find the hidraw device for the AVR
+ *
+ * Returns
+ * 	The device name (exits if not found)
+ */
+static std::string find_device(void)
+{
+    for (int i = 0; i < 16; ++i) {
+	std::ostringstream uevent_name;	// Where the USB id is
+	uevent_name << "/sys/class/hidraw/hidraw" << i << "/device/uevent";
+	std::ifstream uevent(uevent_name.str().c_str());
+	std::string line;	// Line from the file
+	while (std::getline(uevent, line)) {
+	    if ((line == AVR_HID_ID) || (line == AVR_KBD_HID_ID)) {
+		std::ostringstream device_name;	// The device that goes with it
+		device_name << "/dev/hidraw" << i;
+		return (device_name.str());
+	    }
+	}
+    }
+    std::cerr << "ERROR: No AVR found" << std::endl;
+    exit(8);
+}
+/*
+ * pin_name -- Turn a pin number into a name
+ */
+static std::string pin_name(const int pin)
+{
+    std::ostringstream name;	// The name
+    name << ((pin < 8) ? 'B' : 'D') << (pin % 8);
+    return (name.str());
+}
+/*
+ * parse_pin -- Turn a pin name into a number
+ *
+ * Returns
+ * 	Pin number, -1 for all of them (exits on a bad pin)
+ */
+static int parse_pin(const std::string& name)
+{
+    if (name == "*")
+	return (-1);
+    int pin = -1;	// The pin
+    const bool port_pin = (name.size() == 2) && (name[1] >= '0') && (name[1] <= '7');	// B<n> or D<n>
+    if (port_pin && (toupper(name[0]) == 'B'))
+	pin = name[1] - '0';
+    else if (port_pin && (toupper(name[0]) == 'D'))
+	pin = name[1] - '0' + 8;
+    else if (!name.empty() && isdigit(name[0]))
+	pin = atoi(name.c_str());
+
+    if ((pin < 0) || (pin >= PINS)) {
+	std::cerr << "ERROR: Bad pin " << name << std::endl;
+	exit(8);
+    }
+    return (pin);
+}
+/*
+ * send_feature -- Send a feature report to the AVR
+ */
+static void send_feature(const int fd, feature_report& report)
+{
+    report[0] = 0;	// Report number
+    if (ioctl(fd, HIDIOCSFEATURE(sizeof(report)), report) < 0) {
+	std::cerr << "ERROR: Could not send feature report: " << strerror(errno) << std::endl;
+	exit(8);
+    }
+}
+/*
+ * get_page -- Read a page of the feature report
+ *
+ * Parameters
+ * 	fd -- The device
+ * 	page -- Page to read
+ * 	report -- Where to put it
+ */
+static void get_page(const int fd, const uint8_t page, feature_report& report)
+{
+    feature_report select;	// Command to select the page
+    memset(select, '\0', sizeof(select));
+    select[1] = FEATURE_SELECT;
+    select[2] = page;
+    send_feature(fd, select);
+
+    memset(report, '\0', sizeof(report));
+    if (ioctl(fd, HIDIOCGFEATURE(sizeof(report)), report) < 0) {
+	std::cerr << "ERROR: Could not get feature report: " << strerror(errno) << std::endl;
+	exit(8);
+    }
+    if (report[1] != page) {
+	std::cerr << "ERROR: AVR sent page " << static_cast<int>(report[1]) <<
+	    " for page " << static_cast<int>(page) << std::endl;
+	exit(8);
+    }
+    if ((page == FEATURE_SETTINGS) && (report[2] != SETTINGS_VERSION)) {
+	std::cerr << "ERROR: AVR settings version " << static_cast<int>(report[2]) <<
+	    " (we know " << static_cast<int>(SETTINGS_VERSION) << ")" << std::endl;
+	exit(8);
+    }
+}
+/*
+ * show_settings -- Print the settings
+ *
+ * Parameters
+ * 	report -- The settings page (report number in byte 0)
+ */
+static void show_settings(const feature_report& report)
+{
+    std::cout << "Pin  Enabled  Debounce (ms)" << std::endl;
+    for (int pin = 0; pin < PINS; ++pin) {
+	const uint8_t enable = report[1 + ((pin < 8) ? ENABLE_B : ENABLE_D)];	// Enable bits for the port
+	std::cout << std::setw(3) << pin_name(pin) << "  " <<
+	    std::setw(7) << (((enable & (1 << (pin % 8))) != 0) ? "yes" : "no") << "  " <<
+	    std::setw(13) << static_cast<int>(report[1 + TICKS + pin]) << std::endl;
+    }
+}
+/*
+ * show_bounces -- Print the bounce counts
+ *
+ * Parameters
+ * 	report -- The bounces page (report number in byte 0)
+ */
+static void show_bounces(const feature_report& report)
+{
+    for (int pin = 0; pin < PINS; ++pin)
+	std::cout << pin_name(pin) << ":" << std::setw(3) << static_cast<int>(report[1 + BOUNCES + pin]) <<
+	    (((pin % 8) == 7) ? "\n" : " ");
+}
+
+int main(int argc, char* argv[])
+{
+    std::string device;		// The hidraw device
+    bool clear = false;		// Clear the bounce counts
+    bool watch = false;		// Keep showing the bounce counts
+
+    int opt;	// Option we are looking at
+    while ((opt = getopt(argc, argv, "d:cw")) != -1) {
+	switch (opt) {
+	    case 'd':
+		device = optarg;
+		break;
+	    case 'c':
+		clear = true;
+		break;
+	    case 'w':
+		watch = true;
+		break;
+	    default:
+		usage();
+	}
+    }
+    if (optind >= argc)
+	usage();
+    const std::string command = argv[optind];	// What to do
+    const int args = argc - optind - 1;		// Arguments to the command
+
+    if (device.empty())
+	device = find_device();
+    const int fd = open(device.c_str(), O_RDWR);	// The AVR
+    if (fd < 0) {
+	std::cerr << "ERROR: Could not open " << device << ": " << strerror(errno) << std::endl;
+	exit(8);
+    }
+
+    feature_report report;	// Report from the AVR
+    if ((command == "show") && (args == 0)) {
+	get_page(fd, FEATURE_SETTINGS, report);
+	show_settings(report);
+    } else if (((command == "debounce") && (args == 2)) ||
+	    (((command == "enable") || (command == "disable")) && (args == 1))) {
+	const int pin = parse_pin(argv[optind + 1]);	// Pin to change (-1 for all)
+	const int ms = (args == 2) ? atoi(argv[optind + 2]) : 0;	// New debounce time
+	if ((command == "debounce") && ((ms < 1) || (ms > 255))) {
+	    std::cerr << "ERROR: Debounce must be 1-255 ms" << std::endl;
+	    exit(8);
+	}
+	get_page(fd, FEATURE_SETTINGS, report);
+	for (int i = 0; i < PINS; ++i) {
+	    if ((pin >= 0) && (pin != i))
+		continue;
+	    uint8_t& enable = report[1 + ((i < 8) ? ENABLE_B : ENABLE_D)];	// Enable bits for the port
+	    if (command == "debounce")
+		report[1 + TICKS + i] = ms;
+	    else if (command == "enable")
+		enable |= (1 << (i % 8));
+	    else
+		enable &= ~(1 << (i % 8));
+	}
+	report[1] = FEATURE_SAVE;
+	send_feature(fd, report);
+
+	// Read it back so the user sees what the AVR has
+	get_page(fd, FEATURE_SETTINGS, report);
+	show_settings(report);
+    } else if ((command == "bounces") && (args == 0)) {
+	while (true) {
+	    get_page(fd, FEATURE_BOUNCES, report);
+	    show_bounces(report);
+	    if (clear) {
+		feature_report clear_cmd;	// Command to clear the counts
+		memset(clear_cmd, '\0', sizeof(clear_cmd));
+		clear_cmd[1] = FEATURE_CLEAR;
+		send_feature(fd, clear_cmd);
+	    }
+	    if (!watch)
+		break;
+	    sleep(1);
+	    std::cout << std::endl;
+	}
+    } else {
+	usage();
+    }
+    close(fd);
+    return (0);
+}
@@ -16,156 +16,145 @@
  * Pin 8  D1	  N    6
  * Pin 9  D2	  O    7
  * Pin 10 D3	  P    8
+ *
+ * button_avr [-s] [-r [<device>]]
+ *
+ * The keyboards to watch come from the avr_key lines in garden.conf:
+ *
+ * 	avr_key <device> [<key code>=<button> ...]
+ *
+ * Without any we watch the AVR, the wireless keypad and the PoKeys
+ * (AVR_KBD, KEYPAD and PROKEY55 in device.h) with the map above plus the
+ * digit keys.  All of them are read in one loop, a batch of events at a
+ * time, and the time the kernel saw each key is kept (see evdev_source
+ * in input.cpp).  Presses and releases are sent.
+ *
+ * With -r the AVR runs the raw HID firmware (firmware.avr, make RAW_HID=1).
+ * Each report has all the pins, so presses and releases are sent with
+ * the same button numbers and lost reports are logged.  <device> is the
+ * hidraw device (found by USB id if not given).
  */
 #include <iostream>
 #include <stdlib.h>
 #include <unistd.h>
-#include <linux/input.h>
 #include <fcntl.h>
 #include <syslog.h>
 
 #include "device.h"
+#include "garden_conf.h"
+#include "input.h"
+
+static int out_fd = -1;	// The input pipe
 
 /*
- * grab_dev -- Get exclusive use of the device
+ * send_button -- Send a button event down the pipe
+ *
+ * See device.h for the characters.
  */
-static void grab_dev(const int fd) 
+static void send_button(const struct button_event& event)
 {
-    if (ioctl(fd, EVIOCGRAB, (void *)1) != 0) {
-	std::cout << "Grab failed for fd=" << fd << " aborting" << std::endl;
-	exit(8);
-    }
+    if ((event.button < 0) || (event.button >= INPUT_PIPE_BUTTONS))
+	return;
+    if (event.type == BUTTON_EVENT::PRESS)
+	syslog(LOG_INFO, "Button %d pressed", event.button);
+    else if (event.type != BUTTON_EVENT::RELEASE)
+	return;	// Auto repeat
+    const char input = ((event.type == BUTTON_EVENT::PRESS) ? INPUT_PIPE_PRESS : INPUT_PIPE_RELEASE) +
+	event.button;	// Character to send
+    if (write(out_fd, &input, 1) != 1)
+	syslog(LOG_ERR, "ERROR: Write to input pipe failed");
 }
 /*
- * get_key -- Read a key from a keyboard
- *
- * Parameters
- * 	fd -- FD of the keyboard
+ * open_pipe -- Wait for the garden's input pipe
  */
-static int get_key(const int fd)
+static void open_pipe(void)
 {
     while (true) {
-	// Event we read from the raw event system
-	struct input_event event;
+	out_fd = open(INPUT_PIPE, O_WRONLY);
+	if (out_fd >= 0)
+	    break;
+	syslog(LOG_ERR, "ERROR: Could not open input pipe");
+	sleep(30);
+    }
+}
+/*
+ * keyboard_input -- Read all the keyboards and send the buttons
+ */
+static void keyboard_input(void)
+{
+    open_pipe();
+    input_loop loop(send_button);
 
-	// Read event, get size
-	int read_size = read(fd, &event, sizeof(event));
-	if (read_size <= 0) {
-	    std::cout <<  "Read error when reading event from " << fd << std::endl;
-	    return (-1);
-	}
-	if ((event.type == EV_KEY) && (event.value == 1)) {
-	    // 69 is some sort of extended code
-	    if (event.code == 69)
-		continue;
-	    return (event.code);
+    for (auto& key_line: garden_conf.get_all("avr_key")) {
+	garden_config::line_t line(key_line);	// Turned into a source line
+	line[0] = "evdev";
+	line.insert(line.begin(), "source");
+	input_source* const source = make_source(line);	// Source for the keyboard
+	if (source == NULL)
+	    exit(8);
+	loop.add_source(source);
+    }
+    if (loop.empty()) {
+	static const char* const devices[] = {AVR_KBD, KEYPAD, PROKEY55};	// Default keyboards
+	for (auto device: devices) {
+	    garden_config::line_t line;	// Source line for the device
+	    line.push_back("source");
+	    line.push_back("evdev");
+	    line.push_back(device);
+	    loop.add_source(make_source(line));
 	}
     }
+    loop.run();
 }
 /*
- * generic_input -- Read an input device and handle the key presses
+ * raw_input -- Read the raw HID reports and send the buttons
  *
  * Parameters
- * 	device -- Device to read
+ * 	device -- hidraw device (NULL to find it)
  */
-static void generic_input(const char* const device)
+static void raw_input(const char* const device)
 {
-    int out_fd;	// FD for the output fifo
-
-    while (true) {
-	// Open the socket for this process
-	out_fd = open(INPUT_PIPE, O_WRONLY);
-	if (out_fd < 0) {
-	    syslog(LOG_ERR, "ERROR: Could not open input pipe");
-	    sleep(30);
-	} else {
-	    break;
-	}
-    }
-
-    while (true) {
-	int fd;	// The fd of the device
+    open_pipe();
+    garden_config::line_t line;	// Source line for the device
+    line.push_back("source");
+    line.push_back("hidraw");
+    if (device != NULL)
+	line.push_back(device);
 
-	// Loop until we get the device
-	while (true) {
-	    // Get the device
-	    fd = open(device, O_RDONLY);
-	    if (fd >= 0) {
-		break;
-	    }
-	    syslog(LOG_ERR, "ERROR: Could not open %s -- sleeping", device);
-	    sleep(10);
-	    syslog(LOG_ERR, "Sleep done ");
-	}
-	grab_dev(fd);
-
-	while (true) {
-	    // Get key code
-	    int key = get_key(fd);
-	    syslog(LOG_INFO, "Key %d pressed", key);
-
-	    if (key < 0) {
-		close(fd);
-		break;
-	    }
-
-	    switch (key) {
-		case KEY_A:
-		    write(out_fd, "0", 1);
-		    break;
-		case KEY_B:
-		    write(out_fd, "1", 1);
-		    break;
-		case KEY_C:
-		    write(out_fd, "2", 1);
-		    break;
-		case KEY_D:
-		    write(out_fd, "3", 1);
-		    break;
-		case KEY_H:
-		    write(out_fd, "4", 1);
-		    break;
-		case KEY_M:
-		    write(out_fd, "5", 1);
-		    break;
-		case KEY_N:
-		    write(out_fd, "6", 1);
-		    break;
-		case KEY_O:
-		    write(out_fd, "7", 1);
-		    break;
-		case KEY_P:
-		    write(out_fd, "8", 1);
-		    break;
-		default:
-		    break;
-	    }
-	}
-    }
+    input_loop loop(send_button);
+    loop.add_source(make_source(line));
+    loop.run();
 }
 
 int main(int argc, char* argv[])
 {
     bool stdout_log = false;	// Send log messages to stdout
+    bool raw = false;		// Raw HID firmware
 
     int opt;	// Option we are looking
-    while ((opt = getopt(argc, argv, "s")) != -1) {
+    while ((opt = getopt(argc, argv, "sr")) != -1) {
 	switch (opt) {
 	    case 's':
 		stdout_log = true;
 		break;
+	    case 'r':
+		raw = true;
+		break;
 	    default:
-		std::cerr << "Usage " << argv[0] << " [-s]" << std::endl;
+		std::cerr << "Usage " << argv[0] << " [-s] [-r [<device>]]" << std::endl;
 		exit(EXIT_FAILURE);
 	}
     }
-    if (optind < argc) {
+    if ((optind < argc - 1) || ((optind < argc) && !raw)) {
 	std::cerr << "Extra arguements on the command line" << std::endl;
 	exit(EXIT_FAILURE);
     }
     // Open up the syslog system
     openlog("button_avr", stdout_log ? LOG_PERROR : 0, LOG_USER); 
+    garden_conf.load();		// For the avr_key lines
 
-    generic_input(AVR_KBD);
+    if (raw)
+	raw_input((optind < argc) ? argv[optind] : NULL);
+    keyboard_input();
     return (0);
 }
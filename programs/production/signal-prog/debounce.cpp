@@ -0,0 +1,137 @@
+/*
+ * debounce -- Turn raw pin samples into clean button events
+ */
+#include <string.h>
+
+#include "debounce.h"
+#include "limit.h"
+
+pin_debounce::pin_debounce(void):
+    limit0(0), limit1(0), limit2(0)
+{
+    pin_setting setting;	// Default settings
+    setting.samples = DEFAULT_SAMPLES;
+    setting.long_ms = DEFAULT_LONG;
+    setting.repeat_ms = DEFAULT_REPEAT;
+    for (int pin = 0; pin < PINS; ++pin)
+	set(pin, setting);
+    reset();
+}
+/*
+ * pin_debounce::set -- Set the tuning for a pin
+ *
+ * Parameters
+ * 	pin -- Pin to set (0-7)
+ * 	setting -- The new settings
+ */
+void pin_debounce::set(const int pin, const pin_setting& setting)
+{
+    if ((pin < 0) || (pin >= PINS))
+	return;
+    settings[pin] = setting;
+    if (settings[pin].samples < 1)
+	settings[pin].samples = 1;
+    if (settings[pin].samples > MAX_SAMPLES)
+	settings[pin].samples = MAX_SAMPLES;
+
+    // Spread the limit across the bit planes
+    const uint8_t bit = (1 << pin);	// Bit for this pin
+    const unsigned int samples = settings[pin].samples;
+    limit0 = (samples & 1) ? (limit0 | bit) : (limit0 & ~bit);
+    limit1 = (samples & 2) ? (limit1 | bit) : (limit1 & ~bit);
+    limit2 = (samples & 4) ? (limit2 | bit) : (limit2 & ~bit);
+}
+/*
+ * pin_debounce::reset -- Forget everything (all pins released)
+ */
+void pin_debounce::reset(void)
+{
+    state = 0;
+    count0 = count1 = count2 = 0;
+    long_sent = 0;
+    memset(first_seen, '\0', sizeof(first_seen));
+    memset(pressed_at, '\0', sizeof(pressed_at));
+    memset(repeat_due, '\0', sizeof(repeat_due));
+}
+/*
+ * pin_debounce::update -- Run one sample through the debouncer
+ *
+ * Parameters
+ * 	pressed -- The raw sample (bit n set if pin n reads pressed)
+ * 	now -- When the sample was taken
+ * 	edges -- Place to put the events
+ *
+ * Returns
+ * 	Number of events put in edges
+ */
+int pin_debounce::update(const uint8_t pressed, const struct timespec& now, edge edges[MAX_EDGES])
+{
+    int n_edges = 0;	// Events so far
+
+    // Pins that disagree with their debounced state count up,
+    // everything else goes back to 0.
+    const uint8_t differ = pressed ^ state;		// Pins that want to change
+    const uint8_t idle = ~(count0 | count1 | count2);	// Pins with nothing counted yet
+
+    const uint8_t new0 = (count0 ^ 0xFF) & differ;
+    const uint8_t new1 = (count1 ^ count0) & differ;
+    const uint8_t new2 = (count2 ^ (count0 & count1)) & differ;
+
+    // Pins whose count reached their limit change state
+    const uint8_t done = differ & ~((new0 ^ limit0) | (new1 ^ limit1) | (new2 ^ limit2));
+    count0 = new0 & ~done;
+    count1 = new1 & ~done;
+    count2 = new2 & ~done;
+
+    // Remember when a change started so the event has the real time
+    uint8_t started = differ & idle;	// Pins on their first disagreeing sample
+    for (int pin = 0; started != 0; ++pin, started >>= 1) {
+	if ((started & 1) != 0)
+	    first_seen[pin] = now;
+    }
+
+    state ^= done;
+    const uint8_t went_down = done & state;
+    const uint8_t went_up = done & ~state;
+
+    for (int pin = 0; pin < PINS; ++pin) {
+	const uint8_t bit = (1 << pin);	// Bit for this pin
+
+	if ((went_down & bit) != 0) {
+	    pressed_at[pin] = first_seen[pin];
+	    long_sent &= ~bit;
+	    repeat_due[pin] = settings[pin].long_ms + settings[pin].repeat_ms;
+	    edges[n_edges].pin = pin;
+	    edges[n_edges].type = EDGE::PRESS;
+	    edges[n_edges].when = first_seen[pin];
+	    ++n_edges;
+	} else if ((went_up & bit) != 0) {
+	    edges[n_edges].pin = pin;
+	    edges[n_edges].type = EDGE::RELEASE;
+	    edges[n_edges].when = first_seen[pin];
+	    ++n_edges;
+	} else if ((state & bit) != 0) {
+	    // Held down -- long press, then repeats
+	    const long int held = ms_between(pressed_at[pin], now);	// Time held (ms)
+	    const pin_setting& setting = settings[pin];
+
+	    if ((setting.long_ms != 0) && ((long_sent & bit) == 0) &&
+		    (held >= static_cast<long int>(setting.long_ms))) {
+		long_sent |= bit;
+		edges[n_edges].pin = pin;
+		edges[n_edges].type = EDGE::LONG_PRESS;
+		edges[n_edges].when = now;
+		++n_edges;
+	    } else if ((setting.repeat_ms != 0) && (held >= repeat_due[pin])) {
+		// One repeat even if we were slow to look; no catching up
+		while (repeat_due[pin] <= held)
+		    repeat_due[pin] += setting.repeat_ms;
+		edges[n_edges].pin = pin;
+		edges[n_edges].type = EDGE::REPEAT;
+		edges[n_edges].when = now;
+		++n_edges;
+	    }
+	}
+    }
+    return (n_edges);
+}
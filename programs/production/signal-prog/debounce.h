@@ -0,0 +1,77 @@
+/*
+ * debounce -- Turn raw pin samples into clean button events
+ *
+ * Each sample of a port (8 pins) goes through a vertical counter:
+ * three bytes hold a 3 bit counter for every pin, so all 8 pins are
+ * counted with a handful of bitwise operations.  A pin changes state
+ * only after it has disagreed with its old state for "samples" reads
+ * in a row.  Any sample that agrees resets the count, so a bouncing
+ * contact never gets through.
+ *
+ * Events
+ * 	PRESS -- Pin went to pressed (time of the first sample that saw it)
+ * 	RELEASE -- Pin went to released
+ * 	LONG_PRESS -- Pin has been held for long_ms
+ * 	REPEAT -- Pin still held, every repeat_ms after the long press
+ *
+ * Settings are per pin.  Use one pin_debounce for each device.
+ */
+#ifndef __DEBOUNCE_H__
+#define __DEBOUNCE_H__
+
+#include <stdint.h>
+#include <time.h>
+
+class pin_debounce {
+    public:
+	static const int PINS = 8;			// Pins in a port
+	static const unsigned int MAX_SAMPLES = 7;	// Largest count a 3 bit counter holds
+	static const int MAX_EDGES = PINS * 2;		// Most events from one sample
+
+	enum class EDGE {PRESS, RELEASE, LONG_PRESS, REPEAT};
+
+	// One event
+	struct edge {
+	    int pin;			// Pin number (0-7)
+	    EDGE type;			// What happened
+	    struct timespec when;	// When it happened (CLOCK_MONOTONIC)
+	};
+	// Tuning for one pin
+	struct pin_setting {
+	    unsigned int samples;	// Samples in a row to change state (1-7)
+	    unsigned int long_ms;	// Hold time for a long press (0 = none)
+	    unsigned int repeat_ms;	// Repeat rate after the long press (0 = none)
+	};
+	static const unsigned int DEFAULT_SAMPLES = 4;
+	static const unsigned int DEFAULT_LONG = 1000;
+	static const unsigned int DEFAULT_REPEAT = 0;
+    private:
+	uint8_t state;			// Debounced state (1 = pressed)
+	uint8_t count0, count1, count2;	// Vertical counter (bit n is pin n)
+	uint8_t limit0, limit1, limit2;	// Per pin sample limit, same layout
+	uint8_t long_sent;		// Pins that have had their long press
+
+	pin_setting settings[PINS];		// Tuning
+	struct timespec first_seen[PINS];	// First sample of a change in progress
+	struct timespec pressed_at[PINS];	// When each held pin went down
+	long int repeat_due[PINS];		// Next repeat (ms after the press)
+    public:
+	pin_debounce(void);
+	// Copy constructor defaults
+	// Assignment operator defaults
+	// Destructor defaults
+    public:
+	void set(const int pin, const pin_setting& setting);
+	void reset(void);
+	int update(const uint8_t pressed, const struct timespec& now, edge edges[MAX_EDGES]);
+
+	// Is a change being counted (keep sampling fast)
+	bool settling(void) const {
+	    return ((count0 | count1 | count2) != 0);
+	}
+	// Pins that are held down
+	uint8_t get_state(void) const {
+	    return (state);
+	}
+};
+#endif // __DEBOUNCE_H__
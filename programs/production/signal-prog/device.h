@@ -10,8 +10,37 @@ static const char* const PROKEY55 =
     "/dev/input/by-id/usb-PoLabs_PoKeys56U_2.34126-if02-event-kbd";
 
 // Socket from input handler to garden
+//
+// Each event is one character: a base for the event type plus the
+// button number (n < INPUT_PIPE_BUTTONS).
+// 	'0' + n -- Press (buttons 10-15 are ':' ';' '<' '=' '>' '?')
+// 	'@' + n -- Long press ('@' 'A' ... 'O')
+// 	'P' + n -- Repeat ('P' 'Q' ... '_')
+// 	'`' + n -- Release ('`' 'a' ... 'o')
+// Programs that only send presses ('0'-'9') work as they always have.
 static const char* const INPUT_PIPE = "/tmp/garden.input";
+static const int INPUT_PIPE_BUTTONS = 16;
+static const char INPUT_PIPE_PRESS = '0';
+static const char INPUT_PIPE_LONG = '@';
+static const char INPUT_PIPE_REPEAT = 'P';
+static const char INPUT_PIPE_RELEASE = '`';
+
+// Pipe from garden to the input handler telling it how to light the buttons
+//
+// Each update is one line with a character for every button
+// (button 0 first):
+// 	'0' -- Off
+// 	'1' -- Ready (steady on)
+// 	'2' -- Running (blink)
+// 	'3' -- Locked out (off)
+static const char* const LIGHT_PIPE = "/tmp/garden.lights";
+static const char LIGHT_PIPE_OFF = '0';
 
 static const char* const AVR_KBD = "/dev/input/by-id/usb-MfgName_Keyboard-event-kbd";
 
+// USB ids of the AVR (firmware.avr) as a keyboard and built for raw
+// HID reports (make RAW_HID=1)
+static const char* const AVR_KBD_HID_ID = "HID_ID=0003:000016C0:0000047C";
+static const char* const AVR_HID_ID = "HID_ID=0003:000016C0:00000480";
+
 #endif // __DEVICE_H__
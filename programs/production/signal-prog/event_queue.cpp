@@ -0,0 +1,274 @@
+/*
+ * event_queue -- Queue of events going to a single garden handler
+ *
+ * The queue is a bounded ring (Dmitry Vyukov's design).  Each cell
+ * has a sequence number that tells if it is free for a producer or
+ * full for the consumer, so the producers only need a compare and
+ * swap on the head and nobody ever takes a lock.
+ *
+ * The consumer sleeps on futex_word.  Every post bumps the word and
+ * wakes the consumer if it is sleeping.
+ */
+#include <errno.h>
+#include <linux/futex.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "event_queue.h"
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32 bit word");
+
+/*
+ * futex -- The futex system call (glibc has no wrapper)
+ */
+static long int futex(std::atomic<uint32_t>* const word, const int op, const uint32_t value,
+	const struct timespec* const timeout, const uint32_t value3)
+{
+    return (syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), op, value, timeout, NULL, value3));
+}
+
+/*
+ * deadline_after -- Compute a deadline
+ *
+ * Parameters
+ * 	ms -- Number of milliseconds from now
+ *
+ * Returns
+ * 	The absolute CLOCK_MONOTONIC time of the deadline
+ */
+struct timespec deadline_after(const long int ms)
+{
+    struct timespec deadline;	// The result
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+	deadline.tv_nsec -= 1000000000L;
+	++deadline.tv_sec;
+    }
+    return (deadline);
+}
+
+/*
+ * event_queue::event_queue -- Create an empty queue
+ *
+ * Parameters
+ * 	_policy -- What to do with extra presses
+ */
+event_queue::event_queue(const COALESCE _policy):
+    head(0),
+    tail(0),
+    futex_word(0),
+    waiting(false),
+    policy(_policy),
+    press_pending(false),
+    busy(false),
+    shutdown(false),
+    posted(0),
+    coalesced(0),
+    overflow(0)
+{
+    for (unsigned int i = 0; i < QUEUE_SIZE; ++i)
+	cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+/*
+ * event_queue::post -- Post an event stamped with the current time
+ *
+ * Parameters
+ * 	type -- Type of the event
+ * 	button -- Button that caused it (-1 for none)
+ *
+ * Returns
+ * 	true if the event was queued
+ */
+bool event_queue::post(const EVENT_TYPE type, const int button)
+{
+    handler_event event;	// The event to post
+    event.type = type;
+    event.button = button;
+    clock_gettime(CLOCK_MONOTONIC, &event.when);
+    return (post(event));
+}
+
+/*
+ * event_queue::post -- Post an event to the queue
+ *
+ * Safe to call from any thread.  Never blocks.
+ *
+ * Parameters
+ * 	event -- The event to post
+ *
+ * Returns
+ * 	true if the event was queued
+ * 	false if it was merged, dropped by the policy, or the queue was full
+ */
+bool event_queue::post(const handler_event& event)
+{
+    // Is this a button event (the only thing the policy touches)
+    const bool button_event = (event.type == EVENT_TYPE::PRESS) ||
+			      (event.type == EVENT_TYPE::LONG_PRESS) ||
+			      (event.type == EVENT_TYPE::RELEASE);
+    // Is this a press (the only thing we merge)
+    const bool press = (event.type == EVENT_TYPE::PRESS) || (event.type == EVENT_TYPE::LONG_PRESS);
+
+    if (event.type == EVENT_TYPE::SHUTDOWN) {
+	// Shutdown is a flag, not a queue entry, so it can't be lost
+	shutdown = true;
+    } else {
+	if (button_event && (policy == COALESCE::DROP_WHEN_BUSY) && busy) {
+	    ++coalesced;
+	    return (false);
+	}
+	if (press && (policy == COALESCE::KEEP_ONE) && press_pending.exchange(true)) {
+	    ++coalesced;
+	    return (false);
+	}
+
+	uint32_t pos = head.load(std::memory_order_relaxed);	// Where we put it
+	cell* current;		// The cell we are filling in
+	while (true) {
+	    current = &cells[pos & (QUEUE_SIZE - 1)];
+	    const uint32_t sequence = current->sequence.load(std::memory_order_acquire);
+	    const int32_t diff = static_cast<int32_t>(sequence - pos);
+
+	    if (diff == 0) {
+		if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+		    break;
+	    } else if (diff < 0) {
+		// Queue is full
+		if (press && (policy == COALESCE::KEEP_ONE))
+		    press_pending = false;
+		++overflow;
+		return (false);
+	    } else {
+		pos = head.load(std::memory_order_relaxed);
+	    }
+	}
+	current->event = event;
+	current->sequence.store(pos + 1, std::memory_order_release);
+	++posted;
+    }
+
+    // Tell the consumer something happened
+    ++futex_word;
+    if (waiting)
+	futex(&futex_word, FUTEX_WAKE_PRIVATE, 1, NULL, 0);
+    return (true);
+}
+
+/*
+ * event_queue::pop -- Take the next event off the queue
+ *
+ * Consumer only.
+ *
+ * Parameters
+ * 	event -- Where to put the event
+ *
+ * Returns
+ * 	true if we got one
+ */
+bool event_queue::pop(handler_event& event)
+{
+    cell* current = &cells[tail & (QUEUE_SIZE - 1)];	// Cell we are looking at
+    const uint32_t sequence = current->sequence.load(std::memory_order_acquire);
+
+    if (static_cast<int32_t>(sequence - (tail + 1)) != 0)
+	return (false);		// Empty
+
+    event = current->event;
+    current->sequence.store(tail + QUEUE_SIZE, std::memory_order_release);
+    ++tail;
+
+    if ((event.type == EVENT_TYPE::PRESS) || (event.type == EVENT_TYPE::LONG_PRESS))
+	press_pending = false;
+    return (true);
+}
+
+/*
+ * event_queue::wait -- Wait forever for the next event
+ *
+ * Returns
+ * 	The event
+ */
+handler_event event_queue::wait(void)
+{
+    return (wait_for_event(NULL));
+}
+
+/*
+ * event_queue::wait_until -- Wait for the next event or a deadline
+ *
+ * Parameters
+ * 	deadline -- Absolute CLOCK_MONOTONIC time to give up
+ *
+ * Returns
+ * 	The event (type TIMEOUT if the deadline passed)
+ */
+handler_event event_queue::wait_until(const struct timespec& deadline)
+{
+    return (wait_for_event(&deadline));
+}
+
+/*
+ * event_queue::wait_for_event -- Wait for the next event
+ *
+ * Parameters
+ * 	deadline -- Absolute CLOCK_MONOTONIC time to give up (NULL for never)
+ *
+ * Returns
+ * 	The event (type TIMEOUT if the deadline passed)
+ */
+handler_event event_queue::wait_for_event(const struct timespec* const deadline)
+{
+    handler_event event;	// The result
+
+    while (true) {
+	if (shutdown) {
+	    event.type = EVENT_TYPE::SHUTDOWN;
+	    event.button = -1;
+	    clock_gettime(CLOCK_MONOTONIC, &event.when);
+	    return (event);
+	}
+	waiting = true;
+	const uint32_t value = futex_word;	// Value before we look at the queue
+
+	if (pop(event)) {
+	    waiting = false;
+	    return (event);
+	}
+	// Sleep unless something was posted since we read the value
+	const long int result = futex(&futex_word, FUTEX_WAIT_BITSET_PRIVATE, value,
+		deadline, FUTEX_BITSET_MATCH_ANY);
+	waiting = false;
+
+	if ((result == -1) && (errno == ETIMEDOUT)) {
+	    // Something may have slipped in at the last moment
+	    if (!shutdown && pop(event))
+		return (event);
+	    event.type = (shutdown) ? EVENT_TYPE::SHUTDOWN : EVENT_TYPE::TIMEOUT;
+	    event.button = -1;
+	    clock_gettime(CLOCK_MONOTONIC, &event.when);
+	    return (event);
+	}
+	if ((result == -1) && (errno != EAGAIN) && (errno != EINTR)) {
+	    syslog(LOG_ERR, "ERROR: futex wait failed -- abort");
+	    exit(8);
+	}
+    }
+}
+
+/*
+ * event_queue::clear -- Throw away everything waiting
+ *
+ * Consumer only.  The shutdown flag is not cleared.
+ */
+void event_queue::clear(void)
+{
+    handler_event event;	// Event we throw away
+    while (pop(event))
+	continue;
+}
@@ -0,0 +1,111 @@
+/*
+ * event_queue -- Queue of events going to a single garden handler
+ *
+ * Any number of threads can post events (input thread, command
+ * socket, other handlers).  Only the handler itself takes them out.
+ * Posting never blocks and never takes a lock so it is safe to use
+ * from anywhere.
+ *
+ * The handler waits on a futex with an absolute CLOCK_MONOTONIC
+ * deadline, so a wait is precise to the nanosecond and does not
+ * jump when NTP sets the clock.
+ *
+ * Coalescing policies (applies to presses only -- control events
+ * like MODE_CHANGE and SHUTDOWN are always delivered)
+ * 	QUEUE_ALL -- Every press is queued (until the queue is full)
+ * 	KEEP_ONE -- At most one press is waiting; extra presses are merged into it
+ * 	DROP_WHEN_BUSY -- Presses are thrown away while the handler says it is busy
+ */
+#ifndef __EVENT_QUEUE_H__
+#define __EVENT_QUEUE_H__
+
+#include <atomic>
+
+#include <stdint.h>
+#include <time.h>
+
+// The type of an event
+enum class EVENT_TYPE {
+    PRESS,		// Button pressed
+    RELEASE,		// Button released
+    LONG_PRESS,		// Button held down
+    MODE_CHANGE,	// The signal mode changed (low noise on/off)
+    SHUTDOWN,		// Turn everything off and exit
+    ATTRACT,		// Run the sequence for attract mode (nobody pressed anything)
+    TIMEOUT		// Not a real event: the wait timed out
+};
+
+// What to do with presses that come in while another is waiting
+enum class COALESCE {QUEUE_ALL, KEEP_ONE, DROP_WHEN_BUSY};
+
+// A single event
+struct handler_event {
+    EVENT_TYPE type;		// What happened
+    int button;			// Button that caused it (-1 for none)
+    struct timespec when;	// CLOCK_MONOTONIC time of the event
+};
+
+class event_queue {
+    private:
+	static const unsigned int QUEUE_SIZE = 16;	// Must be a power of 2
+
+	// One slot in the ring.  Sequence tells who owns it (Vyukov bounded queue)
+	struct cell {
+	    std::atomic<uint32_t> sequence;	// Slot sequence number
+	    handler_event event;		// The data
+	};
+	cell cells[QUEUE_SIZE];			// The ring
+	std::atomic<uint32_t> head;		// Next slot to write (producers)
+	uint32_t tail;				// Next slot to read (consumer only)
+
+	std::atomic<uint32_t> futex_word;	// Bumped on every post, futex waits on it
+	std::atomic<bool> waiting;		// Consumer is (about to be) asleep
+
+	COALESCE policy;			// How we treat extra presses
+	std::atomic<bool> press_pending;	// A press is in the queue (KEEP_ONE)
+	std::atomic<bool> busy;			// Handler is busy (DROP_WHEN_BUSY)
+	std::atomic<bool> shutdown;		// Sticky shutdown flag
+
+	// Statistics
+	std::atomic<unsigned long> posted;	// Events queued
+	std::atomic<unsigned long> coalesced;	// Presses merged or dropped by policy
+	std::atomic<unsigned long> overflow;	// Events lost because the queue was full
+    public:
+	event_queue(const COALESCE _policy = COALESCE::QUEUE_ALL);
+	// Destructor defaults
+    private:
+	event_queue(const event_queue&);		// No copy
+	event_queue& operator = (const event_queue&);	// No assignment
+    public:
+	// Producer side (any thread)
+	bool post(const EVENT_TYPE type, const int button = -1);
+	bool post(const handler_event& event);
+
+	// Consumer side (the handler thread only)
+	handler_event wait(void);
+	handler_event wait_until(const struct timespec& deadline);
+	void clear(void);
+	void set_busy(const bool _busy) {
+	    busy = _busy;
+	}
+	bool is_shutdown(void) const {
+	    return (shutdown);
+	}
+
+	unsigned long get_posted(void) const {
+	    return (posted);
+	}
+	unsigned long get_coalesced(void) const {
+	    return (coalesced);
+	}
+	unsigned long get_overflow(void) const {
+	    return (overflow);
+	}
+    private:
+	bool pop(handler_event& event);
+	handler_event wait_for_event(const struct timespec* const deadline);
+};
+
+// Compute an absolute CLOCK_MONOTONIC deadline ms milliseconds from now
+extern struct timespec deadline_after(const long int ms);
+#endif // __EVENT_QUEUE_H__
@@ -0,0 +1,368 @@
+/*
+ * flasher -- Drive relays in a steady on/off rhythm
+ */
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "flasher.h"
+#include "rt.h"
+
+static const int64_t NEVER = INT64_MAX;		// No deadline
+
+flasher flash;	// The flasher used by everyone
+
+/*
+ * now_ns -- Get the CLOCK_MONOTONIC time in nanoseconds
+ */
+static int64_t now_ns(void)
+{
+    struct timespec now;	// The time now
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec);
+}
+
+/*
+ * flasher::flasher -- Create the flasher (the thread starts with start())
+ */
+flasher::flasher(void):
+    next_id(1),
+    thread(0),
+    timer_fd(-1),
+    wake_fd(-1),
+    wakeups(0),
+    late_total(0),
+    late_max(0),
+    writes(0),
+    write_total(0),
+    write_max(0),
+    slips(0)
+{
+    pthread_mutexattr_t attr;	// Attributes for the lock
+    pthread_mutexattr_init(&attr);
+    // The flasher thread may run at real time priority.  Don't let
+    // a normal thread holding the lock hold it up.
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_cond_init(&stopped, NULL);
+}
+
+/*
+ * flasher::start -- Start the flasher thread
+ */
+void flasher::start(void)
+{
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC|TFD_NONBLOCK);
+    wake_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+    if ((timer_fd < 0) || (wake_fd < 0)) {
+	syslog(LOG_ERR, "ERROR: Could not create flasher timer -- abort");
+	exit(8);
+    }
+    if (rt_thread_create(&thread, thread_start, this)) {
+	syslog(LOG_ERR, "pthread_create failed for flasher -- abort");
+	exit(8);
+    }
+}
+
+/*
+ * flasher::wake -- Wake up the flasher thread so it looks at the patterns again
+ */
+void flasher::wake(void)
+{
+    if (wake_fd < 0)
+	return;		// Not started, it will look when it starts
+    uint64_t one = 1;	// Value to add to the eventfd
+    if (write(wake_fd, &one, sizeof(one)) != sizeof(one))
+	syslog(LOG_ERR, "ERROR: Could not wake flasher");
+}
+
+/*
+ * flasher::add -- Start flashing a pattern
+ *
+ * The first flash starts now.
+ *
+ * Parameters
+ * 	pattern -- What to flash
+ *
+ * Returns
+ * 	Id of the pattern (for stop)
+ */
+flasher::flash_id flasher::add(const flash_pattern& pattern)
+{
+    running item;	// The new pattern
+    item.pattern = pattern;
+
+    if ((item.pattern.per_minute < FLASH_MIN) || (item.pattern.per_minute > FLASH_MAX)) {
+	syslog(LOG_WARNING, "Flash rate %u out of range (%u-%u)",
+		item.pattern.per_minute, FLASH_MIN, FLASH_MAX);
+	item.pattern.per_minute = (item.pattern.per_minute < FLASH_MIN) ? FLASH_MIN : FLASH_MAX;
+    }
+    const bool pair = (pattern.partner != pattern.relay);	// Two relays?
+    if (item.pattern.duty < 1)
+	item.pattern.duty = 1;
+    if (item.pattern.duty > (pair ? 50U : 100U))
+	item.pattern.duty = pair ? 50U : 100U;
+
+    item.period = 60000000000LL / item.pattern.per_minute;
+    const int64_t on_time = item.period * item.pattern.duty / 100;	// Time a relay is on
+
+    // Build the edges of one flash
+    item.n_edges = 0;
+    item.edges[item.n_edges++] = {0, {pattern.relay, RELAY_STATE::RELAY_ON}};
+    if (on_time < item.period)
+	item.edges[item.n_edges++] = {on_time, {pattern.relay, RELAY_STATE::RELAY_OFF}};
+    if (pair) {
+	item.edges[item.n_edges++] = {item.period / 2, {pattern.partner, RELAY_STATE::RELAY_ON}};
+	item.edges[item.n_edges++] =
+	    {(item.period / 2 + on_time) % item.period, {pattern.partner, RELAY_STATE::RELAY_OFF}};
+    }
+    // Sort them by time (insertion sort, there are at most 4).  Offs go before ons.
+    for (int i = 1; i < item.n_edges; ++i) {
+	for (int j = i; j > 0; --j) {
+	    const edge& a = item.edges[j - 1];
+	    const edge& b = item.edges[j];
+	    if ((a.offset < b.offset) ||
+		((a.offset == b.offset) && (a.change.state == RELAY_STATE::RELAY_OFF)))
+		break;
+	    std::swap(item.edges[j - 1], item.edges[j]);
+	}
+    }
+    item.cycle = 0;
+    item.next_edge = 0;
+    item.stopping = false;
+    item.finished = false;
+
+    pthread_mutex_lock(&lock);
+    item.id = next_id++;
+    item.start = now_ns();
+    patterns.push_back(item);
+    pthread_mutex_unlock(&lock);
+
+    wake();
+    return (item.id);
+}
+
+/*
+ * flasher::stop -- Stop a pattern
+ *
+ * Returns after the relays of the pattern are off.
+ *
+ * Parameters
+ * 	id -- The pattern to stop
+ */
+void flasher::stop(const flash_id id)
+{
+    pthread_mutex_lock(&lock);
+    bool found = false;		// Is it running
+    for (auto& item: patterns) {
+	if (item.id == id) {
+	    item.stopping = true;
+	    found = true;
+	}
+    }
+    if (found) {
+	wake();
+	while (true) {
+	    found = false;
+	    for (auto& item: patterns) {
+		if (item.id == id)
+		    found = true;
+	    }
+	    if (!found)
+		break;
+	    pthread_cond_wait(&stopped, &lock);
+	}
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * flasher::active -- Is a pattern still running
+ */
+bool flasher::active(const flash_id id)
+{
+    bool result = false;	// Did we find it
+    pthread_mutex_lock(&lock);
+    for (auto& item: patterns) {
+	if ((item.id == id) && !item.finished)
+	    result = true;
+    }
+    pthread_mutex_unlock(&lock);
+    return (result);
+}
+
+/*
+ * flasher::next_deadline -- Time of the next edge (lock must be held)
+ *
+ * Returns
+ * 	Time in ns (NEVER if nothing is running)
+ */
+int64_t flasher::next_deadline(void) const
+{
+    int64_t result = NEVER;	// Earliest edge
+    for (auto& item: patterns) {
+	if (item.stopping)
+	    return (0);		// Right now
+	if (item.finished)
+	    continue;
+	const int64_t when = item.start + item.cycle * item.period + item.edges[item.next_edge].offset;
+	if (when < result)
+	    result = when;
+    }
+    return (result);
+}
+
+/*
+ * flasher::stats -- Report the timing of the flasher
+ */
+std::string flasher::stats(void)
+{
+    std::ostringstream result;	// The report
+    pthread_mutex_lock(&lock);
+    result << "Flasher running " << patterns.size() <<
+	" wakeups " << wakeups <<
+	" late avg " << ((wakeups == 0) ? 0 : late_total / wakeups / 1000) << "us" <<
+	" max " << late_max / 1000 << "us" <<
+	" writes " << writes <<
+	" avg " << ((writes == 0) ? 0 : write_total / writes / 1000) << "us" <<
+	" max " << write_max / 1000 << "us" <<
+	" slips " << slips << std::endl;
+    pthread_mutex_unlock(&lock);
+    return (result.str());
+}
+
+/*
+ * flasher::thread_start -- Start of the flasher thread
+ */
+void* flasher::thread_start(void* me)
+{
+    // The flasher times the relays, so it goes above the relay I/O threads
+    rt_thread("flasher", 1);
+    static_cast<flasher*>(me)->run();
+}
+
+/*
+ * flasher::run -- The flasher thread
+ */
+void flasher::run(void)
+{
+    // Changes to make.  Kept between passes so it isn't allocated
+    // each time, and never full, so no edge or final off is lost.
+    std::vector<struct relay_change> batch;
+
+    while (true) {
+	pthread_mutex_lock(&lock);
+	const int64_t deadline = next_deadline();	// When the next edge is due
+	pthread_mutex_unlock(&lock);
+
+	struct itimerspec when;	// When the timer goes off
+	memset(&when, '\0', sizeof(when));
+	if (deadline != NEVER) {
+	    when.it_value.tv_sec = deadline / 1000000000LL;
+	    when.it_value.tv_nsec = deadline % 1000000000LL;
+	    if ((when.it_value.tv_sec == 0) && (when.it_value.tv_nsec == 0))
+		when.it_value.tv_nsec = 1;	// Zero would disarm the timer
+	}
+	if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &when, NULL) != 0) {
+	    syslog(LOG_ERR, "ERROR: flasher timerfd_settime failed -- abort");
+	    exit(8);
+	}
+
+	struct pollfd poll_list[] = {
+	    {timer_fd, POLLIN, 0},
+	    {wake_fd, POLLIN, 0}
+	};
+	if (poll(poll_list, 2, -1) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    syslog(LOG_ERR, "ERROR: flasher poll failed -- abort");
+	    exit(8);
+	}
+	const int64_t now = now_ns();	// When we woke up
+	uint64_t count;			// Count from the fd (ignored)
+	const bool timer_fired = (poll_list[0].revents != 0) &&
+		(read(timer_fd, &count, sizeof(count)) == sizeof(count));
+	if (poll_list[1].revents != 0) {
+	    if (read(wake_fd, &count, sizeof(count)) != sizeof(count))
+		continue;
+	}
+
+	batch.clear();
+	bool any_finished = false;		// Did a pattern end
+
+	pthread_mutex_lock(&lock);
+	if (timer_fired && (deadline != 0)) {
+	    const int64_t late = now - deadline;	// How late we woke up
+	    ++wakeups;
+	    late_total += late;
+	    if (late > late_max)
+		late_max = late;
+	}
+	for (auto& item: patterns) {
+	    if (item.finished)
+		continue;
+	    if (item.stopping) {
+		item.finished = true;
+	    } else {
+		while (true) {
+		    const int64_t edge_time =
+			item.start + item.cycle * item.period + item.edges[item.next_edge].offset;
+		    if (edge_time > now)
+			break;
+		    if (now - edge_time >= item.period) {
+			// A whole flash behind.  Jump to the current flash to stay in phase.
+			const unsigned int current = (now - item.start) / item.period;
+			slips += (current - item.cycle) * item.n_edges - item.next_edge;
+			item.cycle = current;
+			item.next_edge = 0;
+			continue;
+		    }
+		    batch.push_back(item.edges[item.next_edge].change);
+		    if (++item.next_edge >= item.n_edges) {
+			item.next_edge = 0;
+			++item.cycle;
+		    }
+		    if ((item.pattern.cycles != 0) && (item.cycle >= item.pattern.cycles)) {
+			item.finished = true;
+			break;
+		    }
+		}
+	    }
+	    if (item.finished) {
+		any_finished = true;
+		batch.push_back({item.pattern.relay, RELAY_STATE::RELAY_OFF});
+		batch.push_back({item.pattern.partner, RELAY_STATE::RELAY_OFF});
+	    }
+	}
+	pthread_mutex_unlock(&lock);
+
+	if (!batch.empty()) {
+	    const int64_t write_start = now_ns();	// Time the write started
+	    relay_batch("flasher", batch.data(), batch.size());
+	    const int64_t write_time = now_ns() - write_start;	// How long it took
+
+	    pthread_mutex_lock(&lock);
+	    ++writes;
+	    write_total += write_time;
+	    if (write_time > write_max)
+		write_max = write_time;
+	    pthread_mutex_unlock(&lock);
+	}
+	if (any_finished) {
+	    pthread_mutex_lock(&lock);
+	    patterns.remove_if([](const running& item) {return (item.finished);});
+	    pthread_cond_broadcast(&stopped);
+	    pthread_mutex_unlock(&lock);
+	}
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * flasher -- Drive relays in a steady on/off rhythm
+ *
+ * Crossing flashers and wig wags flash 40 to 60 times a minute.
+ * The flasher runs its own thread that sleeps on a timerfd with
+ * absolute CLOCK_MONOTONIC deadlines.  Every edge is computed from
+ * the start time of the pattern so errors never add up, and all the
+ * relays that change at the same moment go out in one batch.
+ *
+ * Patterns
+ * 	Single relay -- on for duty percent of each flash
+ * 	Alternating pair -- relay on in the first half, partner in the second
+ *
+ * The thread keeps track of how late it wakes up (jitter), how long
+ * the relay writes take, and how many edges it had to skip because
+ * it fell a whole flash behind (drift).
+ */
+#ifndef __FLASHER_H__
+#define __FLASHER_H__
+
+#include <list>
+#include <string>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "relay.h"
+
+// Flash rates allowed (flashes a minute)
+static const unsigned int FLASH_MIN = 40;
+static const unsigned int FLASH_MAX = 60;
+
+// What to flash
+struct flash_pattern {
+    enum RELAY_NAME relay;	// Relay to flash
+    enum RELAY_NAME partner;	// Relay that alternates with it (same as relay for none)
+    unsigned int per_minute;	// Flashes a minute
+    unsigned int duty;		// Percent of each flash the relay is on
+    unsigned int cycles;	// Number of flashes (0 = until stopped)
+};
+
+class flasher {
+    public:
+	typedef int flash_id;	// Id of a running pattern
+    private:
+	static const int MAX_EDGES = 4;	// On and off for two relays
+
+	// An edge is a point in the flash where relays change
+	struct edge {
+	    int64_t offset;		// Time from the start of the flash (ns)
+	    struct relay_change change;	// What to do
+	};
+	// A pattern that is running
+	struct running {
+	    flash_id id;		// Our id
+	    flash_pattern pattern;	// What we are doing
+	    int64_t start;		// Start time (ns, CLOCK_MONOTONIC)
+	    int64_t period;		// Length of a flash (ns)
+	    edge edges[MAX_EDGES];	// Changes in a flash (in time order)
+	    int n_edges;		// Number of edges
+	    unsigned int cycle;		// Flash we are on
+	    int next_edge;		// Next edge to do
+	    bool stopping;		// Stop has been asked for
+	    bool finished;		// Done, relays off (the thread removes it)
+	};
+	std::list<running> patterns;	// Everything running
+	flash_id next_id;		// Id for the next pattern
+
+	pthread_mutex_t lock;		// Protects everything
+	pthread_cond_t stopped;		// Signaled when a pattern is gone
+	pthread_t thread;		// The flasher thread
+	int timer_fd;			// Timer for the next edge
+	int wake_fd;			// eventfd to wake up the thread
+
+	// Statistics (protected by lock)
+	unsigned long int wakeups;	// Times the timer went off
+	int64_t late_total;		// Total wakeup lateness (ns)
+	int64_t late_max;		// Worst wakeup lateness (ns)
+	unsigned long int writes;	// Batches written
+	int64_t write_total;		// Total time writing relays (ns)
+	int64_t write_max;		// Worst relay write (ns)
+	unsigned long int slips;	// Edges skipped because we fell behind
+    public:
+	flasher(void);
+	// Destructor defaults (the thread runs until exit)
+    private:
+	flasher(const flasher&);		// No copy
+	flasher& operator = (const flasher&);	// No assignment
+    public:
+	void start(void);
+	flash_id add(const flash_pattern& pattern);
+	void stop(const flash_id id);
+	bool active(const flash_id id);
+	std::string stats(void);
+    private:
+	static void* thread_start(void* me);
+	void run(void) __attribute__((noreturn));
+	void wake(void);
+	int64_t next_deadline(void) const;
+};
+
+// The flasher used by everyone
+extern flasher flash;
+#endif // __FLASHER_H__
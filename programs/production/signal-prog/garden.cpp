@@ -2,13 +2,16 @@
  * Run the signal garden.
  *
  * Input comes in through:
- *    1) A socket connected to the input handler
+ *    1) The input sources (see input.h) -- the input pipe fed by the
+ *       button programs, or the keyboards and MCP2200 read directly
  *    2) From an external socket (debug, maintenance)
  *    3) Console thread (debugging only)
  *
  * The system responds to the incoming events and runs the signals.
  *
  */
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <map>
 #include <sstream>
@@ -21,7 +24,6 @@
 #include <linux/input.h>
 #include <net/if.h>
 #include <netinet/in.h>
-#include <semaphore.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -36,9 +38,16 @@
 #include <time.h>
 #include <unistd.h>
 #include <sys/poll.h>
+#include <sys/eventfd.h>
 
 #include "relay.h"
 #include "device.h"
+#include "event_queue.h"
+#include "flasher.h"
+#include "garden_conf.h"
+#include "input.h"
+#include "limit.h"
+#include "rt.h"
 
 bool verbose = false;		// Chatter
 bool simulate = false;		// Do not do the work
@@ -49,22 +58,36 @@ static bool debug = false;	// Do not go into background
 // Configuration
 /*------------------------------------------------------*/
 /*------------------------------------------------------*/
+// All times are in milliseconds
+
 // H2 Signal
-static const int H2_WAIT = 5;	// Turn read for 5 seconds
+static const long int H2_WAIT = 5000;	// Turn read for 5 seconds
 
 // Track cars
-static const int CAR_WAIT = 6;	
+static const long int CAR_WAIT = 6000;	
 
 // 4 White lights
-static const int W4_WAIT = 5;	// Wait five seconds between changes
+static const long int W4_WAIT = 5000;	// Wait five seconds between changes
 // 3 Color lights
-static const int C3_WAIT = 5;	// Wait five seconds between changes
+static const long int C3_WAIT = 5000;	// Wait five seconds between changes
 
 // Wig Wag / Bell wait
-static const int WW_WAIT = 15;	// Longer time for bells
+static const long int WW_WAIT = 15000;	// Longer time for bells
 
 // Noise reduction wait
-static const int NOISE_WAIT = 7;	// 10 seconds each noise reduction step
+static const long int NOISE_WAIT = 7000;	// 7 seconds each noise reduction step
+
+// Attract mode (defaults -- see garden.conf)
+static const long int ATTRACT_IDLE = 300;	// Seconds without a press before attract mode starts
+static const long int ATTRACT_PERIOD = 45;	// Seconds between attract sequences
+static const long int ATTRACT_CAP = 600;	// Most relay actuations an hour for attract mode
+
+// Press storm limits (defaults -- see garden.conf)
+static const long int DEBOUNCE = 150;		// Presses of one button closer than this (ms) are bounces
+static const double BUTTON_RATE = 20.0;		// Presses a minute for each button
+static const double BUTTON_BURST = 3.0;		// Presses a button gets before the rate kicks in
+static const double HANDLER_RATE = 12.0;	// Presses a minute for each handler
+static const double HANDLER_BURST = 4.0;	// Presses a handler gets before the rate kicks in
 
 
 typedef void *(*thread_function) (void *);
@@ -84,7 +107,9 @@ enum HANDLER_ID {
 
 static const enum HANDLER_ID HANDLE_FIRST = HANDLE_H2;	// First handler
 
-static enum HANDLER_ID button_handler_map[10] = {
+// Buttons 8-15 are a second panel (a second MCP2200 at offset 8)
+// laid out the same as the first.
+static enum HANDLER_ID button_handler_map[16] = {
     HANDLE_H2,		// [0] H2 dwarf spotlight at entrance
     HANDLE_W4,		// [1] 4 White light indicator (dwarf)
     HANDLE_C3,		// [2] 3 color lights (set)
@@ -93,16 +118,36 @@ static enum HANDLER_ID button_handler_map[10] = {
     HANDLE_BELL,	// [5] Crossing bell (NC)
     HANDLE_LWW,		// [6] Lower quadrant wig wag
     HANDLE_UWW,		// [7] Upper quadrant wig wag
-    HANDLE_H2,		// [8] H2 (NC)
-    HANDLE_H2,		// [9] H2 (NC)
+    HANDLE_H2,		// [8] Panel 2: H2
+    HANDLE_W4,		// [9] Panel 2: 4 White light indicator
+    HANDLE_C3,		// [10] Panel 2: 3 color lights
+    HANDLE_C3,		// [11] Panel 2: 3 color lights
+    HANDLE_CAR,		// [12] Panel 2: Track car indicator
+    HANDLE_BELL,	// [13] Panel 2: Crossing bell
+    HANDLE_LWW,		// [14] Panel 2: Lower quadrant wig wag
+    HANDLE_UWW,		// [15] Panel 2: Upper quadrant wig wag
 };
+// Number of buttons we know about
+static const int MAX_BUTTONS = sizeof(button_handler_map) / sizeof(button_handler_map[0]);
 
 struct handler_info {
     thread_function funct;	// Function to handle the item
-    sem_t sem;			// Semaphore that controls us
+    event_queue queue;		// Events going to this handler
     const char* const name;	// Name of the handler
     enum HANDLER_ID id;		// ID Number of the handler
+    int attract_cost;		// Relay actuations in one run of the sequence
+    pthread_t thread;		// Thread running the handler
+    bool attract;		// Running for attract mode (handler thread only)
+    bool restart;		// A real press cut into attract mode (handler thread only)
+};
+
+// Flash settings for the wig wag handlers (see garden.conf)
+struct flash_setting {
+    unsigned int per_minute;	// Flashes a minute (0 = steady on)
+    unsigned int duty;		// Percent of the flash the relay is on
+    int partner;		// Relay that alternates with ours (-1 for none)
 };
+static struct flash_setting flash_settings[HANDLE_LAST];
 
 static const int SWITCH_NO_SOUND = 0;	// The number of the "No Sound" switch
 static const int SWITCH_LOW_NOISE = 1;	// The number of the "Low sound" switch
@@ -110,34 +155,144 @@ static const int SWITCH_LOW_NOISE = 1;	// The number of the "Low sound" switch
 static volatile bool low_noise_active = false;	// Are we in the low noise routine
 
 // Are the signals under control of the low noise function
-static enum {SIGNAL_NORMAL, SIGNAL_LOW_NOISE} signal_mode = SIGNAL_NORMAL;
+enum SIGNAL_MODE {SIGNAL_NORMAL, SIGNAL_LOW_NOISE};
+static volatile enum SIGNAL_MODE signal_mode = SIGNAL_NORMAL;
+
+static std::atomic<bool> handler_busy[HANDLE_LAST];	// Is the handler running a show
+static int lights_event = -1;	// eventfd that tells the input thread to redo the lights
 
 /*
- * sem_clear -- Clear all pending semaphores
+ * lights_wake -- Tell the input thread the button lights need a look
+ *
+ * Safe to call from any thread.
+ */
+static void lights_wake(void)
+{
+    const uint64_t one = 1;	// Value added to the eventfd
+    if (lights_event >= 0) {
+	if (write(lights_event, &one, sizeof(one)) != sizeof(one))
+	    syslog(LOG_ERR, "ERROR: lights eventfd write failed");
+    }
+}
+/*
+ * set_busy -- Note whether a handler is running a show (for the lights)
  *
  * Parameters
- * 	sem -- Semaphore to deal with
+ * 	me -- The handler
+ * 	busy -- True if it's running
  */
-static void sem_clear(sem_t* const sem)
+static void set_busy(const struct handler_info* const me, const bool busy)
 {
-    while (sem_trywait(sem) == 0) 
-	continue;
+    if (handler_busy[me->id].exchange(busy) != busy)
+	lights_wake();
 }
 
+static void attract_charge(const struct handler_info* const me);
 /*
- * sem-wait-time -- Wait the specified amount of time or until a semaphore is triggered
+ * wait_button -- Wait for a button press
+ *
+ * Mode changes and releases are ignored.
  *
  * Parameters
- * 	sem -- Semaphore
- * 	wait -- How long to wait
+ * 	me -- Information about me
+ *
+ * Returns
+ * 	What ended the wait (PRESS, LONG_PRESS, ATTRACT or SHUTDOWN)
  */
-static void sem_wait_time(sem_t* const sem, const time_t wait)
+static EVENT_TYPE wait_button(struct handler_info* const me)
 {
-    struct timespec wait_time;	// Time we are going wait until
+    me->attract = false;
+    if (me->restart) {
+	// The press that stopped attract mode
+	me->restart = false;
+	return (EVENT_TYPE::PRESS);
+    }
+    set_busy(me, false);
+    while (true) {
+	const handler_event event = me->queue.wait();
+	switch (event.type) {
+	    case EVENT_TYPE::ATTRACT:
+		me->attract = true;
+		set_busy(me, true);
+		attract_charge(me);
+		return (event.type);
+	    case EVENT_TYPE::PRESS:
+	    case EVENT_TYPE::LONG_PRESS:
+		set_busy(me, true);
+		return (event.type);
+	    case EVENT_TYPE::SHUTDOWN:
+		return (event.type);
+	    default:
+		break;
+	}
+    }
+}
+/*
+ * wait_time -- Wait the specified amount of time or until a button is pressed
+ *
+ * A press ends the wait early (the sequence moves on to the next step).
+ * When running for attract mode any press or mode change stops the
+ * sequence.  A press to us is then run as a real press.
+ *
+ * Parameters
+ * 	me -- Information about me
+ * 	wait -- How long to wait (ms)
+ *
+ * Returns
+ * 	true -- Go on to the next step
+ * 	false -- Stop the sequence (shutdown or attract mode over)
+ */
+static bool wait_time(struct handler_info* const me, const long int wait)
+{
+    const struct timespec deadline = deadline_after(wait);	// When we stop waiting
 
-    wait_time.tv_sec = time(NULL) + wait;
-    wait_time.tv_nsec = 0;
-    sem_timedwait(sem, &wait_time);
+    while (true) {
+	const handler_event event = me->queue.wait_until(deadline);
+	switch (event.type) {
+	    case EVENT_TYPE::TIMEOUT:
+		return (true);
+	    case EVENT_TYPE::SHUTDOWN:
+		return (false);
+	    case EVENT_TYPE::PRESS:
+	    case EVENT_TYPE::LONG_PRESS:
+		if (me->attract) {
+		    me->restart = true;
+		    return (false);
+		}
+		return (true);
+	    case EVENT_TYPE::MODE_CHANGE:
+		if (me->attract)
+		    return (false);
+		break;
+	    default:
+		break;
+	}
+    }
+}
+/*
+ * pause_time -- Wait the specified amount of time no matter what is pressed
+ *
+ * Parameters
+ * 	me -- Information about me
+ * 	wait -- How long to wait (ms)
+ *
+ * Returns
+ * 	true if we are shutting down
+ */
+static bool pause_time(struct handler_info* const me, const long int wait)
+{
+    const struct timespec deadline = deadline_after(wait);	// When we stop waiting
+
+    while (true) {
+	switch (me->queue.wait_until(deadline).type) {
+	    case EVENT_TYPE::SHUTDOWN:
+		return (true);
+	    case EVENT_TYPE::TIMEOUT:
+		return (false);
+	    default:
+		break;
+	}
+    }
 }
 static void* handle_h2(void* me_v);
 static void* handle_w4(void* me_v);
@@ -147,55 +302,94 @@ static void* handle_lww(void* me_v);
 static void* handle_uww(void* me_v);
 static void* handle_bell(void* me_v);
 static void* handle_noise(void* me_v);
+static std::string metrics(void);
+static void attract_activity(const enum HANDLER_ID handler);
+static void update_lights(void);
 /*
  * Array containing all the signal handlers 
  */
 static struct handler_info handler_array[] = {
     {
 	handle_h2,		// 0
-	{{0}},
+	{COALESCE::KEEP_ONE},
 	"h2",
-	HANDLE_H2
+	HANDLE_H2,
+	2,
+	0,
+	false,
+	false
     }, {
 	handle_w4,		// 1
-	{{0}},
+	{COALESCE::KEEP_ONE},
 	"w4",
-	HANDLE_W4
+	HANDLE_W4,
+	8,
+	0,
+	false,
+	false
     }, {
 	handle_c3,		// 2
-	{{0}},
+	{COALESCE::KEEP_ONE},
 	"c3",
-	HANDLE_C3
+	HANDLE_C3,
+	6,
+	0,
+	false,
+	false
     }, {
 	handle_car,		// 3
-	{{0}},
+	{COALESCE::KEEP_ONE},
 	"car",
-	HANDLE_CAR
+	HANDLE_CAR,
+	11,
+	0,
+	false,
+	false
     }, {
 	handle_lww,		// 4
-	{{0}},
+	{COALESCE::DROP_WHEN_BUSY},
 	"lww",
-	HANDLE_LWW
+	HANDLE_LWW,
+	2,
+	0,
+	false,
+	false
     }, {
 	handle_bell,		// 5
-	{{0}},
+	{COALESCE::DROP_WHEN_BUSY},
 	"bell",
-	HANDLE_BELL
+	HANDLE_BELL,
+	2,
+	0,
+	false,
+	false
     }, {
 	handle_uww,		// 6
-	{{0}},
+	{COALESCE::DROP_WHEN_BUSY},
 	"uww",
-	HANDLE_UWW
+	HANDLE_UWW,
+	2,
+	0,
+	false,
+	false
     }, {
 	handle_noise,		// 7
-	{{0}},
+	{COALESCE::KEEP_ONE},
 	"noise",
-	HANDLE_NOISE
+	HANDLE_NOISE,
+	20,
+	0,
+	false,
+	false
     }, {
 	NULL,			// 8
-	{{0}},
+	{COALESCE::QUEUE_ALL},
 	"End Of List",
-	HANDLE_LAST
+	HANDLE_LAST,
+	0,
+	0,
+	false,
+	false
     }
 };
 
@@ -207,12 +401,25 @@ static struct handler_info handler_array[] = {
  */
 static std::string push(enum HANDLER_ID id)
 {
-    if (sem_post(&handler_array[id].sem) == -1) {
-	syslog(LOG_ERR, "ERROR: sem_post failed -- abort");
-	exit(8);
-    }
+    if (!handler_array[id].queue.post(EVENT_TYPE::PRESS))
+	return ("Ignored");
     return ("OK");
 }
+/*
+ * set_signal_mode -- Change the signal mode and tell everyone about it
+ *
+ * Parameters
+ * 	mode -- The new mode
+ */
+static void set_signal_mode(const enum SIGNAL_MODE mode)
+{
+    signal_mode = mode;
+    lights_wake();
+    for (int id = HANDLE_FIRST; id < HANDLE_LAST; ++id) {
+	if (id != HANDLE_NOISE)
+	    handler_array[id].queue.post(EVENT_TYPE::MODE_CHANGE);
+    }
+}
 /*
  * handle_h2 -- Handle the h2 signal
  *
@@ -227,15 +434,12 @@ static void* handle_h2(void* me_v) {
     
     while (true) {
 	relay(me->name, H2_RELAY, RELAY_STATE::RELAY_OFF);
-	sem_clear(&me->sem);
-	if (sem_wait(&me->sem) != 0) {
-	    if (errno == EAGAIN)
-		continue;
-	    syslog(LOG_ERR, "h2: ERROR: Semaphore failed -- abort ");
-	    exit(8);
-	}
+	me->queue.clear();
+	if (wait_button(me) == EVENT_TYPE::SHUTDOWN)
+	    break;
 	relay(me->name, H2_RELAY, RELAY_STATE::RELAY_ON);
-	sem_wait_time(&me->sem, H2_WAIT);
+	if (!wait_time(me, H2_WAIT))
+	    continue;
     }
     return (NULL);
 }
@@ -251,15 +455,12 @@ static void* handle_h2(void* me_v) {
 static void generic_ww(struct handler_info* const me, const enum RELAY_NAME relay_id)
 {
     while (true) {
-	sem_clear(&me->sem);
+	me->queue.clear();
+	me->queue.set_busy(false);
 	relay(me->name, relay_id, RELAY_STATE::RELAY_OFF);
 
-	if (sem_wait(&me->sem) != 0) {
-	    if (errno == EAGAIN)
-		continue;
-	    syslog(LOG_ERR, "%s: ERROR: Semaphore failed -- abort ", me->name);
-	    exit(8);
-	}
+	if (wait_button(me) == EVENT_TYPE::SHUTDOWN)
+	    return;
 	if (gpio_status(SWITCH_NO_SOUND) == "0") {
 	    continue;
 	}
@@ -271,9 +472,32 @@ static void generic_ww(struct handler_info* const me, const enum RELAY_NAME rela
 	    push(HANDLE_NOISE);
 	}
 
-	// Display track open
-	relay(me->name, relay_id, RELAY_STATE::RELAY_ON);
-	sleep(WW_WAIT);
+	// Display track open (presses are dropped while we run,
+	// except in attract mode where a press must stop us)
+	me->queue.set_busy(!me->attract);
+
+	flasher::flash_id flash_id = 0;	// Flash pattern we are running (0 for none)
+	const struct flash_setting& setting = flash_settings[me->id];
+	if (setting.per_minute != 0) {
+	    flash_pattern pattern;	// Our pattern
+	    pattern.relay = relay_id;
+	    pattern.partner = (setting.partner < 0) ? relay_id : static_cast<enum RELAY_NAME>(setting.partner);
+	    pattern.per_minute = setting.per_minute;
+	    pattern.duty = setting.duty;
+	    pattern.cycles = 0;
+	    flash_id = flash.add(pattern);
+	} else {
+	    relay(me->name, relay_id, RELAY_STATE::RELAY_ON);
+	}
+	if (me->attract) 
+	    wait_time(me, WW_WAIT);
+	else
+	    pause_time(me, WW_WAIT);
+
+	if (flash_id != 0)
+	    flash.stop(flash_id);
+	if (me->queue.is_shutdown())
+	    return;
     }
 }
 /*
@@ -341,7 +565,7 @@ static void* handle_car(void* me_v)
     struct handler_info* me = reinterpret_cast<struct handler_info*>(me_v);
     
     while (true) {
-	sem_clear(&me->sem);
+	me->queue.clear();
 
 	if (signal_mode == SIGNAL_NORMAL) {
 	    relay(me->name, TRACK_SEM_L, RELAY_STATE::RELAY_OFF);
@@ -349,12 +573,8 @@ static void* handle_car(void* me_v)
 	    relay(me->name, TRACK_CAR, RELAY_STATE::RELAY_OFF);
 	}
 
-	if (sem_wait(&me->sem) != 0) {
-	    if (errno == EAGAIN)
-		continue;
-	    syslog(LOG_ERR, "car: ERROR: Semaphore failed -- abort ");
-	    exit(8);
-	}
+	if (wait_button(me) == EVENT_TYPE::SHUTDOWN)
+	    break;
 	if (signal_mode == SIGNAL_LOW_NOISE) continue;
 
 	// Train runs from right to left
@@ -362,24 +582,28 @@ static void* handle_car(void* me_v)
 	relay(me->name, TRACK_SEM_L, RELAY_STATE::RELAY_ON);
 	relay(me->name, TRACK_SEM_R, RELAY_STATE::RELAY_ON);
 	relay(me->name, TRACK_CAR, RELAY_STATE::RELAY_ON);
-	sem_wait_time(&me->sem, CAR_WAIT);
+	if (!wait_time(me, CAR_WAIT))
+	    continue;
 	if (signal_mode == SIGNAL_LOW_NOISE) continue;
 
 	// Train has reached the track car indicator
 	relay(me->name, TRACK_CAR, RELAY_STATE::RELAY_OFF);
-	sem_wait_time(&me->sem, CAR_WAIT);
+	if (!wait_time(me, CAR_WAIT))
+	    continue;
 	if (signal_mode == SIGNAL_LOW_NOISE) continue;
 
 	// Train has reached the first semaphore
 	relay(me->name, TRACK_CAR, RELAY_STATE::RELAY_ON);
 	relay(me->name, TRACK_SEM_L, RELAY_STATE::RELAY_OFF);
-	sem_wait_time(&me->sem, CAR_WAIT);
+	if (!wait_time(me, CAR_WAIT))
+	    continue;
 	if (signal_mode == SIGNAL_LOW_NOISE) continue;
 
 	// Train has reached the second semaphore
 	relay(me->name, TRACK_SEM_L, RELAY_STATE::RELAY_ON);
 	relay(me->name, TRACK_SEM_R, RELAY_STATE::RELAY_OFF);
-	sem_wait_time(&me->sem, CAR_WAIT);
+	if (!wait_time(me, CAR_WAIT))
+	    continue;
 	if (signal_mode == SIGNAL_LOW_NOISE) continue;
 
 	// Now we turn things off because the demo is done
@@ -401,19 +625,15 @@ static void* handle_noise(void* me_v)
     struct handler_info* me = reinterpret_cast<struct handler_info*>(me_v);
     
     while (true) {
-	sem_clear(&me->sem);
+	me->queue.clear();
 	
 	// Do not reset the signals while waiting 
 	// They can in use by other functions.
 
-	if (sem_wait(&me->sem) != 0) {
-	    if (errno == EAGAIN)
-		continue;
-	    syslog(LOG_ERR, "car: ERROR: Semaphore failed -- abort ");
-	    exit(8);
-	}
+	if (wait_button(me) == EVENT_TYPE::SHUTDOWN)
+	    break;
 
-	signal_mode = SIGNAL_LOW_NOISE;
+	set_signal_mode(SIGNAL_LOW_NOISE);
 	relay(me->name, TRACK_SEM_L, RELAY_STATE::RELAY_ON);
 	relay(me->name, TRACK_SEM_R, RELAY_STATE::RELAY_ON);
 	relay(me->name, TRACK_CAR, RELAY_STATE::RELAY_ON);
@@ -421,27 +641,32 @@ static void* handle_noise(void* me_v)
 	relay(me->name, C3_RED, RELAY_STATE::RELAY_ON);
 	relay(me->name, C3_YELLOW, RELAY_STATE::RELAY_OFF);
 	relay(me->name, C3_GREEN, RELAY_STATE::RELAY_OFF);
-	sleep(WW_WAIT);
+	if (pause_time(me, WW_WAIT))
+	    break;
 
 	// Train runs from right to left (it just made the track car lights)
 	relay(me->name, TRACK_CAR, RELAY_STATE::RELAY_OFF);
-	sleep(NOISE_WAIT);
+	if (pause_time(me, NOISE_WAIT))
+	    break;
 
 	// Train is now as the left semaphore
 	relay(me->name, TRACK_CAR, RELAY_STATE::RELAY_ON);
 	relay(me->name, TRACK_SEM_L, RELAY_STATE::RELAY_OFF);
-	sleep(NOISE_WAIT);
+	if (pause_time(me, NOISE_WAIT))
+	    break;
 
 	// Car is at the right semaphore
 	relay(me->name, TRACK_SEM_L, RELAY_STATE::RELAY_ON);
 	relay(me->name, TRACK_SEM_R, RELAY_STATE::RELAY_OFF);
-	sleep(NOISE_WAIT);
+	if (pause_time(me, NOISE_WAIT))
+	    break;
 
 	// Car is clear of the car indicators, now just past the yellow light
 	relay(me->name, TRACK_SEM_R, RELAY_STATE::RELAY_ON);
 	relay(me->name, C3_RED, RELAY_STATE::RELAY_OFF);
 	relay(me->name, C3_YELLOW, RELAY_STATE::RELAY_ON);
-	sleep(NOISE_WAIT);
+	if (pause_time(me, NOISE_WAIT))
+	    break;
 
 	// We just cleared the last section of trake.  Green light
 	relay(me->name, C3_YELLOW, RELAY_STATE::RELAY_OFF);
@@ -453,9 +678,10 @@ static void* handle_noise(void* me_v)
 	relay(me->name, TRACK_SEM_R, RELAY_STATE::RELAY_OFF);
 	
 	low_noise_active = false;
-	sleep(NOISE_WAIT);
+	if (pause_time(me, NOISE_WAIT))
+	    break;
 	relay(me->name, C3_GREEN, RELAY_STATE::RELAY_OFF);
-	signal_mode = SIGNAL_NORMAL;
+	set_signal_mode(SIGNAL_NORMAL);
     }
     return (NULL);
 }
@@ -475,7 +701,7 @@ static void* handle_c3(void* me_v)
     struct handler_info* me = reinterpret_cast<struct handler_info*>(me_v);
     
     while (true) {
-	sem_clear(&me->sem);
+	me->queue.clear();
 
 	if (signal_mode == SIGNAL_NORMAL) {
 	    relay(me->name, C3_RED, RELAY_STATE::RELAY_OFF);
@@ -483,29 +709,28 @@ static void* handle_c3(void* me_v)
 	    relay(me->name, C3_GREEN, RELAY_STATE::RELAY_OFF);
 	}
 
-	if (sem_wait(&me->sem) != 0) {
-	    if (errno == EAGAIN)
-		continue;
-	    syslog(LOG_ERR, "c3: ERROR: Semaphore failed -- abort ");
-	    exit(8);
-	}
+	if (wait_button(me) == EVENT_TYPE::SHUTDOWN)
+	    break;
 	if (signal_mode == SIGNAL_LOW_NOISE) continue;
 
 	// Display red
 	relay(me->name, C3_RED, RELAY_STATE::RELAY_ON);
-	sem_wait_time(&me->sem, C3_WAIT);
+	if (!wait_time(me, C3_WAIT))
+	    continue;
 	if (signal_mode == SIGNAL_LOW_NOISE) continue;
 
 	// Display yellow
 	relay(me->name, C3_RED, RELAY_STATE::RELAY_OFF);
 	relay(me->name, C3_YELLOW, RELAY_STATE::RELAY_ON);
-	sem_wait_time(&me->sem, C3_WAIT);
+	if (!wait_time(me, C3_WAIT))
+	    continue;
 	if (signal_mode == SIGNAL_LOW_NOISE) continue;
 
 	// Display green
 	relay(me->name, C3_YELLOW, RELAY_STATE::RELAY_OFF);
 	relay(me->name, C3_GREEN, RELAY_STATE::RELAY_ON);
-	sem_wait_time(&me->sem, C3_WAIT);
+	if (!wait_time(me, C3_WAIT))
+	    continue;
 	if (signal_mode == SIGNAL_LOW_NOISE) continue;
     }
     return (NULL);
@@ -526,33 +751,32 @@ static void* handle_w4(void* me_v)
     struct handler_info* me = reinterpret_cast<struct handler_info*>(me_v);
     
     while (true) {
-	sem_clear(&me->sem);
+	me->queue.clear();
 
 	relay(me->name, W4_RED, RELAY_STATE::RELAY_OFF);
 	relay(me->name, W4_YELLOW, RELAY_STATE::RELAY_ON);
 	relay(me->name, W4_GREEN, RELAY_STATE::RELAY_OFF);
 
-	if (sem_wait(&me->sem) != 0) {
-	    if (errno == EAGAIN)
-		continue;
-	    syslog(LOG_ERR, "w4: ERROR: Semaphore failed -- abort ");
-	    exit(8);
-	}
+	if (wait_button(me) == EVENT_TYPE::SHUTDOWN)
+	    break;
 
 	// Display red
 	relay(me->name, W4_RED, RELAY_STATE::RELAY_ON);
 	relay(me->name, W4_YELLOW, RELAY_STATE::RELAY_OFF);
-	sem_wait_time(&me->sem, W4_WAIT);
+	if (!wait_time(me, W4_WAIT))
+	    continue;
 
 	// Display yellow
 	relay(me->name, W4_RED, RELAY_STATE::RELAY_OFF);
 	relay(me->name, W4_YELLOW, RELAY_STATE::RELAY_ON);
-	sem_wait_time(&me->sem, W4_WAIT);
+	if (!wait_time(me, W4_WAIT))
+	    continue;
 
 	// Display green
 	relay(me->name, W4_YELLOW, RELAY_STATE::RELAY_OFF);
 	relay(me->name, W4_GREEN, RELAY_STATE::RELAY_ON);
-	sem_wait_time(&me->sem, W4_WAIT);
+	if (!wait_time(me, W4_WAIT))
+	    continue;
     }
     return (NULL);
 }
@@ -672,9 +896,12 @@ static std::string do_cmd(const char* const cmd)
 	    return (do_button(cmd[1]));
 	case 's':
 	    return (status());
+	case 'm':
+	    return (metrics());
 	default:
 	    return (
 		    "s -- Status\n"
+		    "m -- Press and relay metrics\n"
 		    "r -- reset\n"
 		    "i -- IP addr -- to console\n"
 		    "t -- lamp test\n"
@@ -700,16 +927,35 @@ static void cmd_line(void)
 	std::cout << result << std::endl;
     }
 }
+/*
+ * handler_start -- Start a handler thread
+ *
+ * The handlers that time relays run real time (if turned on).
+ * The noise handler only plays sounds so it stays normal.
+ *
+ * Parameters
+ * 	me_v -- The handler_info for the handler
+ */
+static void* handler_start(void* me_v)
+{
+    struct handler_info* me = reinterpret_cast<struct handler_info*>(me_v);
+    if (me->id != HANDLE_NOISE)
+	rt_thread(me->name);
+    return (me->funct(me_v));
+}
 /*
  * usage -- Tell someone how to use the thing
  */
 static void usage(void)
 {
-    std::cout << "Usage is garden [-v] [-s] [-d] [-r] " << std::endl;
+    std::cout << "Usage is garden [-v] [-s] [-d] [-r] [-R<cpu>] [-c<conf>] [-t<script>]" << std::endl;
     std::cout << "       -v Verbose " << std::endl;
     std::cout << "       -s Log to stderr and syslog " << std::endl;
     std::cout << "       -d debug " << std::endl;
     std::cout << "       -r Simulate relays " << std::endl;
+    std::cout << "       -R<cpu> Real time relay threads pinned to <cpu> (-1 for any) " << std::endl;
+    std::cout << "       -c<conf> Configuration file " << std::endl;
+    std::cout << "       -t<script> Play a test script of button presses " << std::endl;
     exit(8);
 }
 
@@ -808,93 +1054,598 @@ static void* start_socket(void*)
     return (0);
 }
 
+/*------------------------------------------------------*/
+// Press storm limits
+/*------------------------------------------------------*/
+// Limits and metrics for one button
+struct button_limit {
+    long int debounce;				// Bounce window (ms)
+    struct timespec last_press;			// Last press we let through
+    token_bucket bucket;			// Rate limit for the button
+    std::atomic<unsigned long int> pressed;	// Presses seen
+    std::atomic<unsigned long int> accepted;	// Presses sent to the handler
+    std::atomic<unsigned long int> debounced;	// Presses thrown away as bounces
+    std::atomic<unsigned long int> limited;	// Presses thrown away by a rate limit
+    std::atomic<unsigned long int> long_presses;	// Long presses seen
+    std::atomic<unsigned long int> repeats;	// Repeats seen
+};
+static struct button_limit button_limits[MAX_BUTTONS];
+
+// Limits and metrics for one handler
+struct handler_limit {
+    token_bucket bucket;			// Rate limit for the handler
+    std::atomic<unsigned long int> limited;	// Presses thrown away by the limit
+};
+static struct handler_limit handler_limits[HANDLE_LAST];
+
 /*
- *  drain -- Dump all input from a fd
- * 
+ * find_handler -- Find a handler by name
+ *
+ * Returns
+ * 	The handler id (HANDLE_LAST if not found)
+ */
+static enum HANDLER_ID find_handler(const std::string& name)
+{
+    for (int id = HANDLE_FIRST; id < HANDLE_LAST; ++id) {
+	if (name == handler_array[id].name)
+	    return (static_cast<enum HANDLER_ID>(id));
+    }
+    return (HANDLE_LAST);
+}
+/*
+ * bad_line -- Complain about a bad configuration line and die
+ */
+static void bad_line(const garden_config::line_t& line)
+{
+    std::string text;	// The line put back together
+    for (auto& word: line)
+	text += word + " ";
+    syslog(LOG_ERR, "ERROR: Bad line in %s: %s", garden_conf.get_file_name().c_str(), text.c_str());
+    exit(8);
+}
+/*
+ * setup_limits -- Set the press limits from the configuration file
+ *
+ *	debounce <ms> [<button>]
+ *	button_limit <presses a minute> <burst> [<button>]
+ *	handler_limit <presses a minute> <burst> [<handler name>]
+ *
+ * Lines without a button (handler) set every button (handler).  Lines
+ * are done in order so the general ones should come first.
+ */
+static void setup_limits(void)
+{
+    for (int button = 0; button < MAX_BUTTONS; ++button) {
+	button_limits[button].debounce = DEBOUNCE;
+	button_limits[button].bucket.set(BUTTON_RATE, BUTTON_BURST);
+    }
+    for (int id = HANDLE_FIRST; id < HANDLE_LAST; ++id)
+	handler_limits[id].bucket.set(HANDLER_RATE, HANDLER_BURST);
+
+    for (auto& line: garden_conf.get_all("debounce")) {
+	if ((line.size() < 2) || (line.size() > 3))
+	    bad_line(line);
+	const long int debounce = strtol(line[1].c_str(), NULL, 0);
+	for (int button = 0; button < MAX_BUTTONS; ++button) {
+	    if ((line.size() == 2) || (strtol(line[2].c_str(), NULL, 0) == button))
+		button_limits[button].debounce = debounce;
+	}
+    }
+    for (auto& line: garden_conf.get_all("button_limit")) {
+	if ((line.size() < 3) || (line.size() > 4))
+	    bad_line(line);
+	const double rate = strtod(line[1].c_str(), NULL);
+	const double burst = strtod(line[2].c_str(), NULL);
+	for (int button = 0; button < MAX_BUTTONS; ++button) {
+	    if ((line.size() == 3) || (strtol(line[3].c_str(), NULL, 0) == button))
+		button_limits[button].bucket.set(rate, burst);
+	}
+    }
+    for (auto& line: garden_conf.get_all("handler_limit")) {
+	if ((line.size() < 3) || (line.size() > 4))
+	    bad_line(line);
+	const double rate = strtod(line[1].c_str(), NULL);
+	const double burst = strtod(line[2].c_str(), NULL);
+	if ((line.size() == 4) && (find_handler(line[3]) == HANDLE_LAST))
+	    bad_line(line);
+	for (int id = HANDLE_FIRST; id < HANDLE_LAST; ++id) {
+	    if ((line.size() == 3) || (find_handler(line[3]) == id))
+		handler_limits[id].bucket.set(rate, burst);
+	}
+    }
+}
+/*
+ * setup_flash -- Set up the flashers from the configuration file
+ *
+ *	flash <handler> <flashes a minute> [<duty %>] [<partner relay>]
+ */
+static void setup_flash(void)
+{
+    for (auto& line: garden_conf.get_all("flash")) {
+	if ((line.size() < 3) || (line.size() > 5))
+	    bad_line(line);
+	const enum HANDLER_ID id = find_handler(line[1]);
+	// Only the wig wag handlers flash
+	if ((id != HANDLE_LWW) && (id != HANDLE_UWW) && (id != HANDLE_BELL))
+	    bad_line(line);
+
+	struct flash_setting& setting = flash_settings[id];
+	setting.per_minute = strtoul(line[2].c_str(), NULL, 0);
+	setting.duty = (line.size() > 3) ? strtoul(line[3].c_str(), NULL, 0) : 50;
+	setting.partner = (line.size() > 4) ? strtol(line[4].c_str(), NULL, 0) : -1;
+	if ((setting.per_minute < FLASH_MIN) || (setting.per_minute > FLASH_MAX) ||
+	    (setting.duty < 1) || (setting.duty > 100) || (setting.partner > LAST_RELAY))
+	    bad_line(line);
+    }
+}
+/*
+ * allow_press -- Check a press against the debounce and rate limits
+ *
+ * Called only from the input thread.
+ *
  * Parameters
- *	fd -- FD to drain
+ * 	event -- The press
+ * 	handler -- Handler the press goes to
+ *
+ * Returns
+ * 	true if the press should go to the handler
  */
-static void drain(const int fd) 
+static bool allow_press(const struct button_event& event, const enum HANDLER_ID handler)
 {
-    // Poll structure so we can get the input
-    struct pollfd fds[] = {
-	{fd, POLLIN, 0}
-    };
+    struct button_limit& limit = button_limits[event.button];	// Limits for this button
+
+    ++limit.pressed;
+    if (ms_between(limit.last_press, event.when) < limit.debounce) {
+	++limit.debounced;
+	if (verbose)
+	    syslog(LOG_INFO, "Button %d bounce ignored", event.button);
+	return (false);
+    }
+    if (!limit.bucket.take(event.when)) {
+	++limit.limited;
+	if (verbose)
+	    syslog(LOG_INFO, "Button %d over its limit", event.button);
+	return (false);
+    }
+    if (!handler_limits[handler].bucket.take(event.when)) {
+	++handler_limits[handler].limited;
+	if (verbose)
+	    syslog(LOG_INFO, "Button %d: %s over its limit", event.button, handler_array[handler].name);
+	return (false);
+    }
+    limit.last_press = event.when;
+    ++limit.accepted;
+    return (true);
+}
 
-    // Loop till no more input
-    while (1) {
-	if (poll(fds, 1, 0) != 1) {
-	    return;
+/*
+ * do_button_event -- Called by the input sources when a button changes
+ *
+ * Parameters
+ * 	event -- What happened
+ */
+static void do_button_event(const struct button_event& event)
+{
+    if (event.type == BUTTON_EVENT::PRESS)
+	syslog(LOG_NOTICE, "Button %d pressed (%s)", event.button, event.source);
+
+    if ((event.button < 0) || (event.button >= MAX_BUTTONS)) {
+	syslog(LOG_INFO, "Bad button number %d", event.button);
+	return;
+    }
+    // Long presses and repeats are counted but the handlers don't
+    // use them yet (a long press would look like a second press)
+    if (event.type == BUTTON_EVENT::LONG_PRESS) {
+	++button_limits[event.button].long_presses;
+	if (verbose)
+	    syslog(LOG_INFO, "Button %d long press (%s)", event.button, event.source);
+	return;
+    }
+    if (event.type == BUTTON_EVENT::REPEAT) {
+	++button_limits[event.button].repeats;
+	return;
+    }
+    // Map the button to what need to be used
+    enum HANDLER_ID handler_index = button_handler_map[event.button];
+    if (handler_index < HANDLE_LAST) {
+	if (event.type == BUTTON_EVENT::PRESS) {
+	    const bool allowed = allow_press(event, handler_index);	// Press gets through
+	    // Someone is here.  The handler we post to stops its own attract run.
+	    attract_activity(allowed ? handler_index : HANDLE_LAST);
+	    if (!allowed) {
+		update_lights();	// Show the lock out
+		return;
+	    }
 	}
-	char input[2];	// Input from the socket
 
-	ssize_t read_size = read(fd, input, 1);
-	if (read_size == 0) {
-	    syslog(LOG_ERR, "EOF while attempting to drain input");
+	handler_event post_event;	// The event we give the handler
+	post_event.type = (event.type == BUTTON_EVENT::PRESS) ? EVENT_TYPE::PRESS : EVENT_TYPE::RELEASE;
+	post_event.button = event.button;
+	post_event.when = event.when;
+	if (!handler_array[handler_index].queue.post(post_event) && verbose) 
+	    syslog(LOG_INFO, "Button %d ignored by %s", event.button, handler_array[handler_index].name);
+    }
+}
+
+static input_loop input(do_button_event);	// All the input sources
+
+/*------------------------------------------------------*/
+// Attract mode
+//
+// Everything here runs on timers in the input thread.
+/*------------------------------------------------------*/
+static long int attract_idle = ATTRACT_IDLE * 1000;	// Idle time before attract (ms, 0 = off)
+static long int attract_period = ATTRACT_PERIOD * 1000;	// Time between sequences (ms)
+static long int attract_cap = ATTRACT_CAP;		// Most actuations an hour
+static std::vector<enum HANDLER_ID> attract_list;	// Handlers we rotate through
+static unsigned int attract_next = 0;			// Next one in the list
+
+static std::atomic<bool> attract_active(false);	// Are we in attract mode
+static int idle_timer = -1;		// Timer that starts attract mode
+static int rotate_timer = -1;		// Timer that starts the next sequence
+
+static struct timespec attract_hour;	// Start of the current hour
+static std::atomic<long int> attract_used(0);	// Actuations used this hour (charged by the handlers)
+
+static std::atomic<unsigned long int> attract_runs(0);		// Sequences started
+static std::atomic<unsigned long int> attract_skipped(0);	// Sequences skipped
+
+/*
+ * noisy_handler -- Does this handler make noise
+ */
+static bool noisy_handler(const enum HANDLER_ID id)
+{
+    return ((id == HANDLE_LWW) || (id == HANDLE_UWW) || (id == HANDLE_BELL));
+}
+/*
+ * attract_charge -- A handler is starting its attract sequence,
+ * count what it costs against the hourly cap
+ *
+ * Called by the handler thread, so a post that was merged or
+ * never taken costs nothing.
+ *
+ * Parameters
+ * 	me -- The handler
+ */
+static void attract_charge(const struct handler_info* const me)
+{
+    attract_used += me->attract_cost;
+    ++attract_runs;
+}
+/*
+ * attract_rotate -- Start the next attract sequence
+ */
+static void attract_rotate(void)
+{
+    // Leave the signals alone while low noise has them
+    if ((signal_mode != SIGNAL_NORMAL) || low_noise_active) {
+	++attract_skipped;
+	return;
+    }
+    // Quiet please?
+    const bool quiet = (gpio_status(SWITCH_NO_SOUND) == "0") || (gpio_status(SWITCH_LOW_NOISE) == "0");
+
+    struct timespec now;	// The time now
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (ms_between(attract_hour, now) >= 60L * 60L * 1000L) {
+	attract_hour = now;
+	attract_used = 0;
+    }
+
+    for (unsigned int tries = 0; tries < attract_list.size(); ++tries) {
+	const enum HANDLER_ID id = attract_list[attract_next];	// Who's next
+	attract_next = (attract_next + 1) % attract_list.size();
+
+	if (quiet && noisy_handler(id))
+	    continue;
+	// Still running (a show or the last attract run).  A post now would
+	// just wait in its queue, so give the slot to someone else.
+	if (handler_busy[id])
+	    continue;
+
+	if (attract_used + handler_array[id].attract_cost > attract_cap) {
+	    if (verbose)
+		syslog(LOG_INFO, "Attract: hourly cap reached, %s skipped", handler_array[id].name);
+	    ++attract_skipped;
 	    return;
 	}
-	if (read_size != 1) {
-	    syslog(LOG_ERR, "Read erro while draining");
-	    exit(EXIT_FAILURE);
+	if (verbose)
+	    syslog(LOG_INFO, "Attract: %s", handler_array[id].name);
+	handler_array[id].queue.post(EVENT_TYPE::ATTRACT);
+	return;
+    }
+    ++attract_skipped;
+}
+/*
+ * attract_start -- Nobody has pressed anything for a while, start attract mode
+ */
+static void attract_start(void)
+{
+    idle_timer = -1;	// One shot timers go away by themselves
+    if (attract_list.empty())
+	return;
+
+    syslog(LOG_NOTICE, "Attract mode on");
+    attract_active = true;
+    attract_rotate();
+    rotate_timer = input.add_timer(attract_period, true, attract_rotate);
+}
+/*
+ * attract_activity -- Someone pressed a button
+ *
+ * Stop attract mode (right now) and restart the idle timer.
+ *
+ * Parameters
+ * 	handler -- Handler getting the press.  It stops itself when it sees the press.
+ * 		(HANDLE_LAST if the press is not going anywhere)
+ */
+static void attract_activity(const enum HANDLER_ID handler)
+{
+    if (attract_idle <= 0)
+	return;
+
+    if (attract_active) {
+	syslog(LOG_NOTICE, "Attract mode off");
+	attract_active = false;
+	input.cancel_timer(rotate_timer);
+	rotate_timer = -1;
+
+	// Tell everyone else attract mode is over
+	for (int id = HANDLE_FIRST; id < HANDLE_LAST; ++id) {
+	    if ((id != handler) && (id != HANDLE_NOISE))
+		handler_array[id].queue.post(EVENT_TYPE::MODE_CHANGE);
 	}
     }
+    input.cancel_timer(idle_timer);
+    idle_timer = input.add_timer(attract_idle, false, attract_start);
 }
 /*
- * input_thread -- Read the input device and control the relays
+ * setup_attract -- Set up attract mode from the configuration file
+ *
+ *	attract_idle <seconds>		(0 turns attract mode off)
+ *	attract_period <seconds>
+ *	attract_cap <relay actuations an hour>
+ *	attract_handlers <handler> [<handler> ...]
+ *
+ * Must be called before the input thread starts.
  */
-static void* input_thread(void*)
+static void setup_attract(void)
 {
-    mkfifo(INPUT_PIPE, 0666);
-    chmod(INPUT_PIPE, 0666);
-
-    // Open the socket for this process
-    int fd = open(INPUT_PIPE, O_RDWR);
-    if (fd < 0) {
-	syslog(LOG_ERR, "ERROR: Could not open input pipe");
-	exit(EXIT_FAILURE);
+    attract_idle = garden_conf.get_int("attract_idle", ATTRACT_IDLE) * 1000;
+    attract_period = garden_conf.get_int("attract_period", ATTRACT_PERIOD) * 1000;
+    attract_cap = garden_conf.get_int("attract_cap", ATTRACT_CAP);
+
+    std::vector<garden_config::line_t> lines = garden_conf.get_all("attract_handlers");
+    if (lines.empty()) {
+	// The quiet ones
+	attract_list.push_back(HANDLE_H2);
+	attract_list.push_back(HANDLE_W4);
+	attract_list.push_back(HANDLE_C3);
+	attract_list.push_back(HANDLE_CAR);
+    } else {
+	for (unsigned int i = 1; i < lines.back().size(); ++i) {
+	    const enum HANDLER_ID id = find_handler(lines.back()[i]);
+	    if ((id == HANDLE_LAST) || (id == HANDLE_NOISE))
+		bad_line(lines.back());
+	    attract_list.push_back(id);
+	}
     }
-    drain(fd);
-    while (1) {
-	char input[2];	// Input from the socket
+    if ((attract_idle <= 0) || (attract_period <= 0))
+	return;
 
-	// Read one character from input, get size
-	ssize_t read_size = read(fd, input, 1);
-        if (read_size == 0) {
-	    syslog(LOG_ERR, "ERROR: EOF seen on input pipe");
-	    exit(EXIT_FAILURE);
-        }
-	if (read_size != 1) {
-	    syslog(LOG_ERR, "ERROR: Read error on input pipe");
-	    exit(EXIT_FAILURE);
+    clock_gettime(CLOCK_MONOTONIC, &attract_hour);
+    idle_timer = input.add_timer(attract_idle, false, attract_start);
+}
+
+/*------------------------------------------------------*/
+// Button lights
+//
+// Each button shows what pressing it will do:
+// 	READY -- The handler is waiting for a press
+// 	RUNNING -- The handler is running a show
+// 	LOCKED -- A rate limit would throw the press away, or the
+// 		low noise routine has the signals and this one is noisy
+//
+// Everything here runs in the input thread.  The handlers poke the
+// lights_event eventfd when they start or stop.  The lights go to the
+// input sources (a MCP2200 we read ourselves) and down LIGHT_PIPE
+// (for button_mcp).
+/*------------------------------------------------------*/
+static const unsigned int LIGHTS_REFRESH = 5 * 1000;	// Look at the lights this often (ms)
+static int lights_pipe = -1;		// Write end of LIGHT_PIPE (-1 if no reader)
+static int unlock_timer = -1;		// Timer for when a lock out ends
+
+/*
+ * send_lights -- Send the lights down the light pipe
+ *
+ * The pipe is opened (non blocking) when someone is reading it.
+ * If no one is, the lights are dropped.  Every update has all the
+ * buttons, so nothing is lost.
+ *
+ * Parameters
+ * 	lights -- State of every button
+ */
+static void send_lights(const LIGHT* const lights)
+{
+    if (lights_pipe < 0) {
+	lights_pipe = open(LIGHT_PIPE, O_WRONLY|O_NONBLOCK|O_CLOEXEC);
+	if (lights_pipe < 0)
+	    return;	// ENXIO (no reader) or ENOENT (no pipe)
+    }
+    char line[MAX_BUTTONS + 1];	// One update
+    for (int button = 0; button < MAX_BUTTONS; ++button)
+	line[button] = LIGHT_PIPE_OFF + static_cast<int>(lights[button]);
+    line[MAX_BUTTONS] = '\n';
+
+    if (write(lights_pipe, line, sizeof(line)) < 0) {
+	if (errno == EAGAIN)
+	    return;	// Reader is behind, it gets the next one
+	close(lights_pipe);	// EPIPE -- reader went away
+	lights_pipe = -1;
+    }
+}
+/*
+ * update_lights -- Work out what every button should show and show it
+ */
+static void update_lights(void)
+{
+    struct timespec now;	// The time now
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Low noise has the signals?
+    const bool quiet = (signal_mode == SIGNAL_LOW_NOISE) || low_noise_active;
+
+    LIGHT lights[MAX_BUTTONS];	// What each button shows
+    long int unlock = 0;	// Time until the first lock out ends (ms, 0 = none)
+    for (int button = 0; button < MAX_BUTTONS; ++button) {
+	const enum HANDLER_ID id = button_handler_map[button];	// Handler for the button
+	if (id >= HANDLE_LAST) {
+	    lights[button] = LIGHT::OFF;
+	    continue;
 	}
-	char& ch = input[0];	// Get the character in a nice variable
-	syslog(LOG_NOTICE, "Input character %c", ch);
-
-	if ((ch >= '0') && (ch <= '9')) {
-	    // Map the button to what need to be used
-	    int handler_index = button_handler_map[ch - '0'];
-	    if (handler_index < HANDLE_LAST) {
-		if (sem_post(&handler_array[handler_index].sem) == -1) {
-		    syslog(LOG_ERR, "ERROR: sem_post failed -- abort");
-		    exit(EXIT_FAILURE);
-		}
-	    }
+	const long int wait = std::max(button_limits[button].bucket.wait_ms(now),
+		handler_limits[id].bucket.wait_ms(now));	// Time until a press gets through
+	if (wait > 0) {
+	    lights[button] = LIGHT::LOCKED;
+	    if ((unlock == 0) || (wait < unlock))
+		unlock = wait;
+	} else if (quiet && noisy_handler(id)) {
+	    lights[button] = LIGHT::LOCKED;
+	} else if (handler_busy[id]) {
+	    lights[button] = LIGHT::RUNNING;
 	} else {
-	    syslog(LOG_INFO, "Bad input character %c", input[0]);
+	    lights[button] = LIGHT::READY;
+	}
+    }
+    input.set_lights(lights, MAX_BUTTONS);
+    send_lights(lights);
+
+    // Come back when the lock out is over
+    input.cancel_timer(unlock_timer);
+    unlock_timer = -1;
+    if (unlock > 0) {
+	unlock_timer = input.add_timer(unlock, false, []() {
+	    unlock_timer = -1;
+	    update_lights();
+	});
+    }
+}
+/*
+ * setup_lights -- Start the button lights
+ *
+ * Must be called before the input thread starts.
+ */
+static void setup_lights(void)
+{
+    lights_event = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    if (lights_event < 0) {
+	syslog(LOG_ERR, "ERROR: eventfd failed -- abort");
+	exit(8);
+    }
+    input.add_fd(lights_event, POLLIN, [](const short) {
+	uint64_t count;	// Number of wake ups (ignored)
+	if (read(lights_event, &count, sizeof(count)) != sizeof(count))
+	    return;
+	update_lights();
+    });
+    // Catches things nobody tells us about (and a reader that shows up late)
+    input.add_timer(LIGHTS_REFRESH, true, update_lights);
+    update_lights();
+}
+
+/*
+ * metrics -- Report the press and relay counts
+ */
+static std::string metrics(void)
+{
+    std::ostringstream result;	// Result of the metrics
+    for (int button = 0; button < MAX_BUTTONS; ++button) {
+	const struct button_limit& limit = button_limits[button];
+	result << "Button " << button << 
+		" pressed " << limit.pressed <<
+		" accepted " << limit.accepted <<
+		" debounced " << limit.debounced <<
+		" limited " << limit.limited <<
+		" long " << limit.long_presses <<
+		" repeat " << limit.repeats << std::endl;
+    }
+    for (int id = HANDLE_FIRST; id < HANDLE_LAST; ++id) {
+	result << "Handler " << handler_array[id].name << 
+		" limited " << handler_limits[id].limited <<
+		" posted " << handler_array[id].queue.get_posted() <<
+		" coalesced " << handler_array[id].queue.get_coalesced() <<
+		" overflow " << handler_array[id].queue.get_overflow() << std::endl;
+    }
+    result << "Attract " << (attract_active ? "on" : "off") <<
+	    " runs " << attract_runs <<
+	    " skipped " << attract_skipped << std::endl;
+
+    result << flash.stats();
+
+    unsigned long int sent;	// Relay commands sent
+    unsigned long int skipped;	// Relay commands not needed
+    relay_counts(sent, skipped);
+    result << "Relay commands sent " << sent << " skipped " << skipped << std::endl;
+    return (result.str());
+}
+/*
+ * start_input -- Create the input sources
+ *
+ * The sources come from the "source" lines in the configuration
+ * file.  If there are none we use the input pipe like we always have.
+ *
+ * Parameters
+ * 	test_script -- Script for the test source (NULL for none)
+ */
+static void start_input(const char* const test_script)
+{
+    for (auto& line: garden_conf.get_all("source")) {
+	input_source* source = make_source(line);
+	if (source == NULL) {
+	    std::cerr << "Bad source line in " << garden_conf.get_file_name() << std::endl;
+	    exit(EXIT_FAILURE);
 	}
+	input.add_source(source);
+    }
+    if (test_script != NULL) {
+	garden_config::line_t test_line;	// Fake config line for the test source
+	test_line.push_back("source");
+	test_line.push_back("test");
+	test_line.push_back(test_script);
+	input.add_source(make_source(test_line));
+    }
+    if (input.empty()) {
+	garden_config::line_t fifo_line;	// Fake config line for the default source
+	fifo_line.push_back("source");
+	fifo_line.push_back("fifo");
+	input.add_source(make_source(fifo_line));
     }
 }
+/*
+ * input_thread -- Read the input devices and control the relays
+ */
+static void* input_thread(void*)
+{
+    input.run();
+}
 
 int main(int argc, char *argv[])
 {
     try {
 	bool stdout_log = false;	// Send log messages to stdout
+	const char* conf_file = NULL;	// Configuration file (NULL for the default)
+	const char* test_script = NULL;	// Script for the test input source
+	bool real_time = false;		// Run the relay threads real time
+	int rt_cpu = RT_NO_CPU;		// CPU for the real time threads
 	//	-- v verbose
 	//	-- s log to stdout
 	//	-- d Debug -- stay in foreground
 	//	-- r Simulate relays
+	//	-- R<cpu> Real time mode, relay threads pinned to cpu
+	//	-- c<file> Configuration file
+	//	-- t<file> Test script of button presses
 	int opt;	// Option we are looking
-	while ((opt = getopt(argc, argv, "vsdr")) != -1) {
+	while ((opt = getopt(argc, argv, "vsdrR:c:t:")) != -1) {
 	    switch (opt) {
 		case 'v':
 		    verbose = true;
@@ -908,6 +1659,16 @@ int main(int argc, char *argv[])
 		case 'r':
 		    simulate = true;
 		    break;
+		case 'R':
+		    real_time = true;
+		    rt_cpu = atoi(optarg);
+		    break;
+		case 'c':
+		    conf_file = optarg;
+		    break;
+		case 't':
+		    test_script = optarg;
+		    break;
 		default: /* '?' */
 		    usage();
 	    }
@@ -920,8 +1681,14 @@ int main(int argc, char *argv[])
 
 	// Open up the syslog system
 	openlog("garden", stdout_log ? LOG_PERROR : 0, LOG_USER); 
+	if (real_time)
+	    rt_setup(rt_cpu);
+	garden_conf.load(conf_file);
+	setup_limits();
+	setup_flash();
 
 	relay_setup();
+	relay_cache(true);	// We are the only program using the board
 	relay_reset();
 
 	pthread_t socket_id;	// ID number of the handler
@@ -929,25 +1696,36 @@ int main(int argc, char *argv[])
 	    syslog(LOG_ERR, "pthread_create failed -- abort");
 	    exit(8);
 	}
-	pthread_t input_id;	// ID number of the handler
-	if (pthread_create(&input_id, NULL, input_thread, NULL)) {
-	    syslog(LOG_ERR, "pthread_create failed for input thread-- abort");
-	    exit(8);
-	}
+
+	// Signals we shut down on.  Every thread inherits the blocked mask
+	// so only the main thread (in sigwait) sees them.
+	sigset_t stop_signals;
+	sigemptyset(&stop_signals);
+	sigaddset(&stop_signals, SIGTERM);
+	sigaddset(&stop_signals, SIGINT);
+	if (!debug)
+	    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+	// A light pipe reader that goes away is an EPIPE, not a signal
+	signal(SIGPIPE, SIG_IGN);
+
+	flash.start();
 
 	// Loop through each handler and start it
 	for(int id = HANDLE_FIRST; id < HANDLE_LAST; ++id) {
-	    if (sem_init(&handler_array[id].sem, 0, 0) == -1) {
-		syslog(LOG_ERR, "sem_init failed -- abort");
-		exit(8);
-	    }
-
-	    pthread_t handler_id;	// ID number of the handler
-	    if (pthread_create(&handler_id, NULL, handler_array[id].funct, &handler_array[id])) {
+	    if (rt_thread_create(&handler_array[id].thread, handler_start, &handler_array[id])) {
 		syslog(LOG_ERR, "pthread_create failed -- abort");
 		exit(8);
 	    }
 	}
+	// Input starts after the handlers are ready for it
+	start_input(test_script);
+	setup_attract();
+	setup_lights();
+	pthread_t input_id;	// ID number of the handler
+	if (pthread_create(&input_id, NULL, input_thread, NULL)) {
+	    syslog(LOG_ERR, "pthread_create failed for input thread-- abort");
+	    exit(8);
+	}
 #if 0
 	if (!debug) {
 	    daemon(true, false);	// Turn into a daemon
@@ -958,9 +1736,16 @@ int main(int argc, char *argv[])
 	if (debug) {
 	    cmd_line();
 	} else {
-	    while (1) {
-		wait(NULL);
-	    }
+	    int sig;	// The signal we got
+	    sigwait(&stop_signals, &sig);
+	    syslog(LOG_NOTICE, "Signal %d -- shutting down", sig);
+
+	    // Tell every handler to stop and wait for them
+	    for(int id = HANDLE_FIRST; id < HANDLE_LAST; ++id)
+		handler_array[id].queue.post(EVENT_TYPE::SHUTDOWN);
+	    for(int id = HANDLE_FIRST; id < HANDLE_LAST; ++id)
+		pthread_join(handler_array[id].thread, NULL);
+	    relay_reset();
 	}
 	exit(0);
     }
@@ -0,0 +1,94 @@
+/*
+ * garden_conf -- Read the garden configuration file
+ */
+#include <fstream>
+#include <sstream>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <syslog.h>
+
+#include "garden_conf.h"
+
+garden_config garden_conf;	// The configuration
+
+/*
+ * garden_config::load -- Load the configuration file
+ *
+ * Parameters
+ * 	name -- Name of the file to use (NULL means look in the standard places)
+ */
+void garden_config::load(const char* const name)
+{
+    lines.clear();
+    file_name.clear();
+
+    if (name != NULL) {
+	file_name = name;
+    } else if (access(GARDEN_GLOBAL_CONF, R_OK) == 0) {
+	file_name = GARDEN_GLOBAL_CONF;
+    } else if (access(GARDEN_LOCAL_CONF, R_OK) == 0) {
+	file_name = GARDEN_LOCAL_CONF;
+    } else {
+	return;		// No file, all defaults
+    }
+
+    std::ifstream in_file(file_name.c_str());
+    if (!in_file.is_open()) {
+	syslog(LOG_ERR, "ERROR: Unable to open configuration file %s", file_name.c_str());
+	exit(8);
+    }
+    std::string text;	// A line from the file
+    while (std::getline(in_file, text)) {
+	// Remove comments
+	std::string::size_type hash = text.find('#');
+	if (hash != std::string::npos)
+	    text.erase(hash);
+
+	std::istringstream words(text);	// The line as words
+	line_t line;			// The split up line
+	std::string word;		// A single word
+
+	while (words >> word)
+	    line.push_back(word);
+
+	if (!line.empty())
+	    lines.push_back(line);
+    }
+}
+/*
+ * garden_config::get_all -- Get all lines with a keyword
+ *
+ * Parameters
+ * 	keyword -- Keyword to look for
+ *
+ * Returns
+ * 	The matching lines (keyword included as word 0)
+ */
+std::vector<garden_config::line_t> garden_config::get_all(const char* const keyword) const
+{
+    std::vector<line_t> result;		// The lines we found
+    for (auto& line: lines) {
+	if (line[0] == keyword)
+	    result.push_back(line);
+    }
+    return (result);
+}
+/*
+ * garden_config::get_int -- Get a numeric configuration item
+ *
+ * If the keyword appears more than once the last one wins.
+ *
+ * Parameters
+ * 	keyword -- Keyword to look for
+ * 	default_value -- Value if the item is not in the file
+ */
+long int garden_config::get_int(const char* const keyword, const long int default_value) const
+{
+    long int result = default_value;	// Value we return
+    for (auto& line: lines) {
+	if ((line[0] == keyword) && (line.size() > 1))
+	    result = strtol(line[1].c_str(), NULL, 0);
+    }
+    return (result);
+}
@@ -0,0 +1,51 @@
+/*
+ * garden_conf -- Read the garden configuration file
+ *
+ * The file is a list of lines.  The first word on each line is the
+ * keyword, the rest of the words are the values.  Everything after
+ * a '#' is a comment.  Keywords may be repeated (for example there
+ * is one "source" line for each input source.)
+ *
+ *	# Input sources
+ *	source fifo
+ *	source evdev /dev/input/by-id/usb-MfgName_Keyboard-event-kbd
+ *
+ * The file is optional.  If it can not be found every value
+ * takes its default.
+ */
+#ifndef __GARDEN_CONF_H__
+#define __GARDEN_CONF_H__
+
+#include <string>
+#include <vector>
+
+// Location of the configuration file
+static const char* const GARDEN_GLOBAL_CONF = "/home/garden/garden.conf";
+static const char* const GARDEN_LOCAL_CONF = "./garden.conf";
+
+class garden_config {
+    public:
+	typedef std::vector<std::string> line_t;	// One line split into words
+    private:
+	std::vector<line_t> lines;	// All the lines in the file
+	std::string file_name;		// File we read (empty if none)
+    public:
+	garden_config(void) {}
+	// Copy constructor defaults
+	// Assignment operator defaults
+	// Destructor defaults
+    public:
+	void load(const char* const name = NULL);
+
+	// Name of the file we loaded (empty if using defaults)
+	const std::string& get_file_name(void) const {
+	    return (file_name);
+	}
+	// Get every line that starts with the given keyword
+	std::vector<line_t> get_all(const char* const keyword) const;
+
+	// Get a single numeric value
+	long int get_int(const char* const keyword, const long int default_value) const;
+};
+extern garden_config garden_conf;	// The configuration
+#endif // __GARDEN_CONF_H__
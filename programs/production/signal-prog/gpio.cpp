@@ -0,0 +1,598 @@
+/*
+ * gpio -- Event driven GPIO (see gpio.h)
+ */
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "gpio.h"
+
+static const char* const GPIO_CHIP = "/dev/gpiochip0";	// The Pi's GPIO pins
+
+/*
+ * ms_since -- Milliseconds from start to end (CLOCK_MONOTONIC times)
+ */
+static long int ms_since(const struct timespec& start, const struct timespec& end)
+{
+    return ((end.tv_sec - start.tv_sec) * 1000L + (end.tv_nsec - start.tv_nsec) / 1000000L);
+}
+/*
+ * add_ms -- Add milliseconds to a time
+ */
+static struct timespec add_ms(const struct timespec& start, const long int ms)
+{
+    struct timespec result;	// The new time
+    result.tv_sec = start.tv_sec + ms / 1000;
+    result.tv_nsec = start.tv_nsec + (ms % 1000) * 1000000L;
+    if (result.tv_nsec >= 1000000000L) {
+	result.tv_nsec -= 1000000000L;
+	++result.tv_sec;
+    }
+    return (result);
+}
+
+/*
+ * due -- Has the time come
+ *
+ * Returns
+ * 	true if now is at or after when
+ */
+static bool due(const struct timespec& when, const struct timespec& now)
+{
+    return ((now.tv_sec > when.tv_sec) || ((now.tv_sec == when.tv_sec) && (now.tv_nsec >= when.tv_nsec)));
+}
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// gpio -- Debouncing and events (all backends)
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+/*
+ * gpio::add_input -- Add an input pin
+ *
+ * Parameters
+ * 	pin -- The pin
+ * 	debounce_ms -- Time the pin must hold a new level
+ * 	long_ms -- Time on for a LONG event (0 for none)
+ * 	bias -- Pull up / down
+ * 	active_low -- On is 0
+ */
+void gpio::add_input(const int pin, const unsigned int debounce_ms, const unsigned int long_ms,
+	const GPIO_BIAS bias, const bool active_low)
+{
+    if (started) {
+	syslog(LOG_ERR, "ERROR: GPIO pin %d added after start", pin);
+	exit(8);
+    }
+    input info;		// The new input
+    memset(&info, '\0', sizeof(info));
+    info.debounce_ms = debounce_ms;
+    info.long_ms = long_ms;
+    info.bias = bias;
+    info.active_low = active_low;
+    info.long_sent = true;
+    inputs[pin] = info;
+}
+/*
+ * gpio::add_output -- Add an output pin
+ *
+ * Parameters
+ * 	pin -- The pin
+ * 	level -- Level to start with
+ */
+void gpio::add_output(const int pin, const bool level)
+{
+    if (started) {
+	syslog(LOG_ERR, "ERROR: GPIO pin %d added after start", pin);
+	exit(8);
+    }
+    outputs[pin] = level;
+}
+/*
+ * gpio::start -- Get the pins from the backend
+ *
+ * The inputs start out at the level they have now (no events
+ * for that.)
+ */
+void gpio::start(void)
+{
+    fd = request();
+    started = true;
+
+    struct timespec now;	// Time we start
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (auto& info: inputs) {
+	info.second.level = info.second.raw = get_level(info.first);
+	info.second.raw_when = info.second.on_when = now;
+    }
+}
+/*
+ * gpio::settle -- See if an input has held its level long enough
+ *
+ * Parameters
+ * 	pin -- The pin
+ * 	info -- Its state
+ * 	now -- The time to check against (the time of the next edge when
+ * 		catching up on edges)
+ */
+void gpio::settle(const int pin, input& info, const struct timespec& now)
+{
+    gpio_event event;	// Event we may send
+    event.pin = pin;
+
+    if ((info.raw != info.level) && (ms_since(info.raw_when, now) >= static_cast<long int>(info.debounce_ms))) {
+	info.level = info.raw;
+	event.type = info.level ? GPIO_EVENT::ON : GPIO_EVENT::OFF;
+	event.when = info.raw_when;
+	ready.push_back(event);
+	if (info.level) {
+	    info.on_when = info.raw_when;
+	    info.long_sent = (info.long_ms == 0);
+	}
+    }
+    if (info.level && !info.long_sent && (ms_since(info.on_when, now) >= static_cast<long int>(info.long_ms))) {
+	info.long_sent = true;
+	event.type = GPIO_EVENT::LONG;
+	event.when = add_ms(info.on_when, info.long_ms);
+	ready.push_back(event);
+    }
+}
+/*
+ * gpio::process -- Take in the edges and turn them into events
+ *
+ * Parameters
+ * 	now -- The current time
+ */
+void gpio::process(const struct timespec& now)
+{
+    std::vector<edge> edges;	// Edges that came in
+    read_edges(edges);
+
+    for (auto& item: edges) {
+	std::map<int, input>::iterator info = inputs.find(item.pin);
+	if (info == inputs.end())
+	    continue;
+	// Did the last level hold long enough before this edge?
+	settle(item.pin, info->second, item.when);
+	info->second.raw = item.level;
+	info->second.raw_when = item.when;
+    }
+    for (auto& info: inputs)
+	settle(info.first, info.second, now);
+}
+/*
+ * gpio::next_deadline -- Time until the next debounce or long press is up
+ *
+ * Returns
+ * 	Milliseconds (-1 if nothing is waiting)
+ */
+long int gpio::next_deadline(const struct timespec& now) const
+{
+    long int deadline = -1;	// The soonest so far
+    for (auto& info: inputs) {
+	long int wait = -1;	// Time for this pin
+	if (info.second.raw != info.second.level)
+	    wait = info.second.debounce_ms - ms_since(info.second.raw_when, now);
+	else if (info.second.level && !info.second.long_sent)
+	    wait = info.second.long_ms - ms_since(info.second.on_when, now);
+	else
+	    continue;
+	if (wait < 0)
+	    wait = 0;
+	if ((deadline < 0) || (wait < deadline))
+	    deadline = wait;
+    }
+    return (deadline);
+}
+/*
+ * gpio::wait -- Wait for the next input event
+ *
+ * Sleeps until an edge comes in or a debounce / long press
+ * time is up.  There is no polling.
+ *
+ * Parameters
+ * 	event -- Where to put the event
+ * 	timeout_ms -- Longest to wait (-1 for forever)
+ *
+ * Returns
+ * 	true if we got an event, false on timeout
+ */
+bool gpio::wait(gpio_event& event, const int timeout_ms)
+{
+    struct timespec start;	// When we started waiting
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (ready.empty()) {
+	struct timespec now;	// The time now
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	process(now);
+	if (!ready.empty())
+	    break;
+
+	long int wait = next_deadline(now);	// How long to sleep
+	if (timeout_ms >= 0) {
+	    const long int left = timeout_ms - ms_since(start, now);	// Time the caller has left
+	    if (left <= 0)
+		return (false);
+	    if ((wait < 0) || (left < wait))
+		wait = left;
+	}
+	struct pollfd item = {fd, POLLIN, 0};	// Wait for edges
+	if ((poll(&item, 1, static_cast<int>(wait)) < 0) && (errno != EINTR)) {
+	    syslog(LOG_ERR, "ERROR: GPIO poll failed -- abort");
+	    exit(8);
+	}
+    }
+    event = ready.front();
+    ready.pop_front();
+    return (true);
+}
+/*
+ * gpio::discard -- Throw away every event so far
+ *
+ * For when a program has been busy and doesn't want presses
+ * that came in while it was.  The levels are kept.
+ */
+void gpio::discard(void)
+{
+    struct timespec now;	// The time now
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    process(now);
+    ready.clear();
+}
+/*
+ * gpio::read -- Get the debounced level of an input
+ *
+ * Only as new as the last wait (or discard).
+ *
+ * Returns
+ * 	true if the pin is on
+ */
+bool gpio::read(const int pin) const
+{
+    std::map<int, input>::const_iterator info = inputs.find(pin);
+    if (info == inputs.end())
+	return (false);
+    return (info->second.level);
+}
+/*
+ * gpio::write -- Set an output
+ */
+void gpio::write(const int pin, const bool level)
+{
+    if (outputs.find(pin) == outputs.end()) {
+	syslog(LOG_ERR, "ERROR: GPIO pin %d is not an output", pin);
+	return;
+    }
+    set_level(pin, level);
+}
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// gpio_cdev -- The GPIO character device (GPIO v2 uAPI)
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+class gpio_cdev: public gpio {
+    private:
+	int chip_fd;			// The GPIO chip
+	int epoll_fd;			// All the input lines
+	std::map<int, int> line_fds;	// Pin -> line request
+    public:
+	gpio_cdev(void): chip_fd(-1), epoll_fd(-1) {}
+	~gpio_cdev() {
+	    for (auto& line: line_fds)
+		close(line.second);
+	    if (epoll_fd >= 0)
+		close(epoll_fd);
+	    if (chip_fd >= 0)
+		close(chip_fd);
+	}
+    protected:
+	int request(void);
+	void read_edges(std::vector<edge>& edges);
+	bool get_level(const int pin);
+	void set_level(const int pin, const bool level);
+    private:
+	int request_line(const int pin, const uint64_t flags, const bool level);
+};
+/*
+ * gpio_cdev::request_line -- Get one line from the chip
+ *
+ * Parameters
+ * 	pin -- The line
+ * 	flags -- GPIO_V2_LINE_FLAG_...
+ * 	level -- Starting level (outputs)
+ *
+ * Returns
+ * 	The fd of the line request
+ */
+int gpio_cdev::request_line(const int pin, const uint64_t flags, const bool level)
+{
+    struct gpio_v2_line_request request;	// What we want
+    memset(&request, '\0', sizeof(request));
+    request.offsets[0] = pin;
+    request.num_lines = 1;
+    strncpy(request.consumer, program_invocation_short_name, sizeof(request.consumer) - 1);
+    request.config.flags = flags;
+    if ((flags & GPIO_V2_LINE_FLAG_OUTPUT) != 0) {
+	request.config.num_attrs = 1;
+	request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+	request.config.attrs[0].attr.values = level ? 1 : 0;
+	request.config.attrs[0].mask = 1;
+    }
+    if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+	syslog(LOG_ERR, "ERROR: Could not get GPIO %d: %s", pin, strerror(errno));
+	exit(8);
+    }
+    line_fds[pin] = request.fd;
+    return (request.fd);
+}
+/*
+ * gpio_cdev::request -- Get all the pins
+ *
+ * Each input gets its own line request (so each can have its own
+ * bias) and they all go in one epoll set.
+ *
+ * Returns
+ * 	The epoll fd (readable when any input has an edge)
+ */
+int gpio_cdev::request(void)
+{
+    chip_fd = open(GPIO_CHIP, O_RDWR|O_CLOEXEC);
+    if (chip_fd < 0) {
+	syslog(LOG_ERR, "ERROR: Could not open %s: %s", GPIO_CHIP, strerror(errno));
+	exit(8);
+    }
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+	syslog(LOG_ERR, "ERROR: epoll_create1 failed -- abort");
+	exit(8);
+    }
+    for (auto& info: inputs) {
+	uint64_t flags = GPIO_V2_LINE_FLAG_INPUT|GPIO_V2_LINE_FLAG_EDGE_RISING|GPIO_V2_LINE_FLAG_EDGE_FALLING;
+	switch (info.second.bias) {
+	    case GPIO_BIAS::PULL_UP:
+		flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+		break;
+	    case GPIO_BIAS::PULL_DOWN:
+		flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
+		break;
+	    case GPIO_BIAS::NONE:
+		flags |= GPIO_V2_LINE_FLAG_BIAS_DISABLED;
+		break;
+	}
+	if (info.second.active_low)
+	    flags |= GPIO_V2_LINE_FLAG_ACTIVE_LOW;
+
+	const int line_fd = request_line(info.first, flags, false);	// The line
+	fcntl(line_fd, F_SETFL, fcntl(line_fd, F_GETFL) | O_NONBLOCK);
+
+	struct epoll_event event;	// Watch it for edges
+	memset(&event, '\0', sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = line_fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, line_fd, &event) != 0) {
+	    syslog(LOG_ERR, "ERROR: Could not watch GPIO %d: %s", info.first, strerror(errno));
+	    exit(8);
+	}
+    }
+    for (auto& output: outputs)
+	request_line(output.first, GPIO_V2_LINE_FLAG_OUTPUT, output.second);
+    return (epoll_fd);
+}
+/*
+ * gpio_cdev::read_edges -- Read the edges from the lines that have them
+ *
+ * The kernel stamps each edge with CLOCK_MONOTONIC and with rising
+ * meaning "went on" (it handles active_low.)
+ */
+void gpio_cdev::read_edges(std::vector<edge>& edges)
+{
+    struct epoll_event ready_lines[16];	// Lines with edges waiting
+    const int count = epoll_wait(epoll_fd, ready_lines, 16, 0);
+    for (int i = 0; i < count; ++i) {
+	while (true) {
+	    struct gpio_v2_line_event events[16];	// Edges read at once
+	    ssize_t read_size = ::read(ready_lines[i].data.fd, events, sizeof(events));
+	    if (read_size <= 0)
+		break;
+	    const size_t got = read_size / sizeof(events[0]);	// Edges we got
+	    for (size_t e = 0; e < got; ++e) {
+		edge item;	// The edge
+		item.pin = events[e].offset;
+		item.level = (events[e].id == GPIO_V2_LINE_EVENT_RISING_EDGE);
+		item.when.tv_sec = events[e].timestamp_ns / 1000000000ULL;
+		item.when.tv_nsec = events[e].timestamp_ns % 1000000000ULL;
+		edges.push_back(item);
+	    }
+	    if (got < sizeof(events) / sizeof(events[0]))
+		break;
+	}
+    }
+}
+/*
+ * gpio_cdev::get_level -- Read a line
+ */
+bool gpio_cdev::get_level(const int pin)
+{
+    struct gpio_v2_line_values values;	// Value of the line
+    memset(&values, '\0', sizeof(values));
+    values.mask = 1;
+    if (ioctl(line_fds[pin], GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+	syslog(LOG_ERR, "ERROR: Could not read GPIO %d: %s", pin, strerror(errno));
+	return (false);
+    }
+    return ((values.bits & 1) != 0);
+}
+/*
+ * gpio_cdev::set_level -- Set an output line
+ */
+void gpio_cdev::set_level(const int pin, const bool level)
+{
+    struct gpio_v2_line_values values;	// Value of the line
+    memset(&values, '\0', sizeof(values));
+    values.mask = 1;
+    values.bits = level ? 1 : 0;
+    if (ioctl(line_fds[pin], GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0)
+	syslog(LOG_ERR, "ERROR: Could not set GPIO %d: %s", pin, strerror(errno));
+}
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// gpio_mock -- Plays a script of edges
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+class gpio_mock: public gpio {
+    private:
+	// A line of the script
+	struct step {
+	    unsigned int delay;		// Time since the step before (ms)
+	    int pin;			// Pin that changes
+	    bool level;			// New level
+	};
+	const std::string script_file;	// Where the script came from
+	std::vector<step> script;	// The script
+	size_t next;			// Next step to play
+	struct timespec next_when;	// When it plays
+	int timer_fd;			// Goes off when it's time
+	std::map<int, bool> levels;	// Level of each pin
+    public:
+	explicit gpio_mock(const std::string& _script_file):
+	    script_file(_script_file), next(0), timer_fd(-1)
+	{}
+	~gpio_mock() {
+	    if (timer_fd >= 0)
+		close(timer_fd);
+	}
+    protected:
+	int request(void);
+	void read_edges(std::vector<edge>& edges);
+	bool get_level(const int pin) {
+	    return (levels[pin]);
+	}
+	void set_level(const int pin, const bool level) {
+	    syslog(LOG_INFO, "GPIO %d -> %s", pin, level ? "on" : "off");
+	}
+    private:
+	void arm(void);
+};
+/*
+ * gpio_mock::request -- Read the script and start playing it
+ *
+ * Steps for pins we don't have are skipped (their time still counts.)
+ *
+ * Returns
+ * 	The timer fd (readable when the next step is due)
+ */
+int gpio_mock::request(void)
+{
+    std::ifstream in_file(script_file.c_str());
+    if (!in_file.is_open()) {
+	syslog(LOG_ERR, "ERROR: Unable to open GPIO script %s", script_file.c_str());
+	exit(8);
+    }
+    unsigned int skipped = 0;	// Time of the steps we skipped
+    std::string line;		// Line from the script
+    while (std::getline(in_file, line)) {
+	if (line.empty() || (line[0] == '#'))
+	    continue;
+	std::istringstream words(line);	// The line broken up
+	step item;			// Step we are reading
+	int level;			// Level as a number
+
+	if (!(words >> item.delay >> item.pin >> level)) {
+	    syslog(LOG_ERR, "Bad GPIO script line %s", line.c_str());
+	    continue;
+	}
+	if (inputs.find(item.pin) == inputs.end()) {
+	    skipped += item.delay;
+	    continue;
+	}
+	item.delay += skipped;
+	skipped = 0;
+	item.level = (level != 0);
+	script.push_back(item);
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+    if (timer_fd < 0) {
+	syslog(LOG_ERR, "ERROR: timerfd_create failed -- abort");
+	exit(8);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &next_when);
+    if (!script.empty())
+	next_when = add_ms(next_when, script[0].delay);
+    arm();
+    return (timer_fd);
+}
+/*
+ * gpio_mock::arm -- Set the timer for the next step
+ */
+void gpio_mock::arm(void)
+{
+    if (next >= script.size()) {
+	syslog(LOG_INFO, "GPIO script done");
+	return;
+    }
+    struct itimerspec when;	// When the timer goes off
+    memset(&when, '\0', sizeof(when));
+    when.it_value = next_when;
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &when, NULL) != 0) {
+	syslog(LOG_ERR, "ERROR: timerfd_settime failed -- abort");
+	exit(8);
+    }
+}
+/*
+ * gpio_mock::read_edges -- Play every step that is due
+ *
+ * The edges get the time in the script, so the results don't
+ * depend on how fast we are.
+ */
+void gpio_mock::read_edges(std::vector<edge>& edges)
+{
+    uint64_t expired;	// Number of expirations (ignored)
+    if (::read(timer_fd, &expired, sizeof(expired)) != sizeof(expired))
+	return;
+
+    struct timespec now;	// The time now
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    while ((next < script.size()) && due(next_when, now)) {
+	edge item;	// The edge
+	item.pin = script[next].pin;
+	item.level = script[next].level;
+	item.when = next_when;
+	edges.push_back(item);
+	levels[item.pin] = item.level;
+
+	++next;
+	if (next < script.size())
+	    next_when = add_ms(next_when, script[next].delay);
+    }
+    arm();
+}
+
+/*
+ * gpio_open -- Open the GPIO pins
+ *
+ * Parameters
+ * 	mock_script -- Script for the mock (NULL for the real pins)
+ */
+gpio* gpio_open(const char* const mock_script)
+{
+    if (mock_script != NULL)
+	return (new gpio_mock(mock_script));
+    return (new gpio_cdev);
+}
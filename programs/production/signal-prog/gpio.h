@@ -0,0 +1,124 @@
+/*
+ * gpio -- Event driven GPIO for the Pi switches and buttons
+ *
+ * Used by master, the acme demos, giant and power in place of
+ * wiringPi.  Nothing is polled:  the kernel tells us about every edge
+ * (with the CLOCK_MONOTONIC time it happened) and we sleep until
+ * the next edge or the next debounce / long press deadline.
+ *
+ * Each input has:
+ * 	debounce_ms -- The pin must hold a new level this long before it
+ * 		counts.  Bounces shorter than that are never seen.
+ * 	long_ms -- A pin held on this long gives a LONG event (0 for none)
+ * 	bias -- Pull up, pull down or none
+ * 	active_low -- The pin is "on" when it reads 0
+ *
+ * Backends
+ * 	gpio_open(NULL) -- The GPIO character device (/dev/gpiochip0),
+ * 		pins are BCM GPIO numbers
+ * 	gpio_open(<script>) -- Mock that plays a script of edges, so the
+ * 		programs can be tried out without a Pi.  Each line is:
+ *
+ * 			<ms> <pin> <0|1>
+ *
+ * 		<ms> is the time since the line before (like the garden
+ * 		test scripts), 1 means "on" (after active_low).  Every
+ * 		pin starts off.  Outputs are logged.
+ *
+ * Usage
+ * 	gpio* pins = gpio_open(mock_script);
+ * 	pins->add_input(PIN, 100);
+ * 	pins->start();
+ * 	while (true) {
+ * 	    gpio_event event;
+ * 	    if (pins->wait(event, timeout_ms)) ...
+ *
+ * Not thread safe.  Threads that each want their own pins should
+ * each open their own gpio.
+ */
+#ifndef __GPIO_H__
+#define __GPIO_H__
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <time.h>
+
+// What happened to an input (after debouncing)
+enum class GPIO_EVENT {ON, OFF, LONG};
+
+// Pull up / down resistor of an input
+enum class GPIO_BIAS {NONE, PULL_UP, PULL_DOWN};
+
+// An input event
+struct gpio_event {
+    int pin;			// Pin it happened on
+    GPIO_EVENT type;		// What happened
+    struct timespec when;	// CLOCK_MONOTONIC time of the edge that caused it
+};
+
+/*
+ * gpio -- A set of pins (base class of the backends)
+ */
+class gpio {
+    protected:
+	// A raw (not debounced) edge from the backend
+	struct edge {
+	    int pin;			// Pin that changed
+	    bool level;			// New level (true = on)
+	    struct timespec when;	// When it changed
+	};
+	// Settings and state of an input
+	struct input {
+	    unsigned int debounce_ms;	// Time a level must hold
+	    unsigned int long_ms;	// Long press time (0 for none)
+	    GPIO_BIAS bias;		// Pull up / down
+	    bool active_low;		// On is 0
+
+	    bool level;			// Debounced level
+	    bool raw;			// Level of the last edge
+	    struct timespec raw_when;	// Time of the last edge
+	    struct timespec on_when;	// When it went on
+	    bool long_sent;		// LONG sent (or not wanted) for this press
+	};
+	std::map<int, input> inputs;		// Input pins
+	std::map<int, bool> outputs;		// Output pins (and their initial level)
+    private:
+	std::deque<gpio_event> ready;		// Events waiting for wait()
+	bool started;				// start() has been called
+	int fd;					// Readable when there are edges
+    public:
+	gpio(void): started(false), fd(-1) {}
+	virtual ~gpio() {}
+    private:
+	gpio(const gpio&);			// No copy
+	gpio& operator = (const gpio&);		// No assignment
+    public:
+	void add_input(const int pin, const unsigned int debounce_ms, const unsigned int long_ms = 0,
+		const GPIO_BIAS bias = GPIO_BIAS::PULL_UP, const bool active_low = false);
+	void add_output(const int pin, const bool level = false);
+	void start(void);
+
+	bool wait(gpio_event& event, const int timeout_ms = -1);
+	void discard(void);
+	bool read(const int pin) const;
+	void write(const int pin, const bool level);
+    protected:
+	// Backend -- get the pins, return the fd that is readable when edges come in
+	virtual int request(void) = 0;
+	// Backend -- read the edges that have come in (without blocking)
+	virtual void read_edges(std::vector<edge>& edges) = 0;
+	// Backend -- current level of an input (true = on)
+	virtual bool get_level(const int pin) = 0;
+	// Backend -- set an output
+	virtual void set_level(const int pin, const bool level) = 0;
+    private:
+	void settle(const int pin, input& info, const struct timespec& now);
+	void process(const struct timespec& now);
+	long int next_deadline(const struct timespec& now) const;
+};
+
+// Open the GPIO chip (mock_script NULL) or the mock
+extern gpio* gpio_open(const char* const mock_script);
+#endif // __GPIO_H__
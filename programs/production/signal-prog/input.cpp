@@ -0,0 +1,1365 @@
+/*
+ * input -- Button input sources for the garden
+ */
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <list>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "debounce.h"
+#include "device.h"
+#include "input.h"
+#include "mcp2200.h"
+
+static const unsigned int DEVICE_RETRY = 10 * 1000;	// Retry missing devices every 10 seconds
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// input_source
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+/*
+ * input_source::send -- Map a code and send it to the loop
+ *
+ * Parameters
+ * 	code -- Source specific code
+ * 	type -- What happened
+ * 	offset -- Added to the button number (for sources with several devices)
+ */
+void input_source::send(const int code, const BUTTON_EVENT type, const int offset)
+{
+    struct timespec now;	// Time of the event
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    send(code, type, now, offset);
+}
+/*
+ * input_source::send -- Map a code and send it to the loop
+ *
+ * Parameters
+ * 	code -- Source specific code
+ * 	type -- What happened
+ * 	when -- When it happened (CLOCK_MONOTONIC)
+ * 	offset -- Added to the button number (for sources with several devices)
+ */
+void input_source::send(const int code, const BUTTON_EVENT type, const struct timespec& when,
+	const int offset)
+{
+    key_map::const_iterator key = keys.find(code);
+    if (key == keys.end()) {
+	if (type == BUTTON_EVENT::PRESS)
+	    syslog(LOG_INFO, "%s: Unmapped code %d", name.c_str(), code);
+	return;
+    }
+    struct button_event event;	// The event we are sending
+    event.button = key->second + offset;
+    event.type = type;
+    event.source = name.c_str();
+    event.when = when;
+    loop->send(event);
+}
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// input_loop
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+input_loop::input_loop(event_handler _handler):
+    epoll_fd(epoll_create1(EPOLL_CLOEXEC)), handler(_handler)
+{
+    if (epoll_fd < 0) {
+	syslog(LOG_ERR, "ERROR: epoll_create1 failed -- abort");
+	exit(8);
+    }
+}
+input_loop::~input_loop()
+{
+    for (auto source: sources)
+	delete source;
+    close(epoll_fd);
+}
+/*
+ * input_loop::add_source -- Add a source and start it
+ *
+ * Parameters
+ * 	source -- The source (the loop takes ownership)
+ */
+void input_loop::add_source(input_source* const source)
+{
+    sources.push_back(source);
+    source->start(*this);
+    syslog(LOG_INFO, "Input source %s started", source->get_name().c_str());
+}
+/*
+ * input_loop::add_fd -- Watch a file descriptor
+ *
+ * Parameters
+ * 	fd -- FD to watch
+ * 	events -- Events to watch for (POLLIN, ...)
+ * 	fd_handler -- Function to call when something happens
+ */
+void input_loop::add_fd(const int fd, const short events, fd_handler fd_handler)
+{
+    fd_info info;	// Information about this fd
+    info.events = events;
+    info.handler = fd_handler;
+    fds[fd] = info;
+
+    struct epoll_event event;	// What epoll is to watch for
+    memset(&event, '\0', sizeof(event));
+    event.events = static_cast<unsigned short>(events);
+    event.data.fd = fd;
+    // A closed fd leaves the set by itself, so the number may be new to epoll
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+	if ((errno != EEXIST) || (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) != 0)) {
+	    syslog(LOG_ERR, "ERROR: Could not watch fd %d: %s", fd, strerror(errno));
+	    fds.erase(fd);
+	}
+    }
+}
+/*
+ * input_loop::remove_fd -- Stop watching a file descriptor
+ *
+ * Safe to call from inside a handler.
+ */
+void input_loop::remove_fd(const int fd)
+{
+    if (fds.erase(fd) != 0)
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);	// Fails if already closed (that's fine)
+}
+/*
+ * input_loop::add_timer -- Create a timer
+ *
+ * Parameters
+ * 	ms -- Time in milliseconds
+ * 	periodic -- If true, repeat every ms milliseconds
+ * 	timer -- Function to call when the timer goes off
+ *
+ * Returns
+ * 	Timer id (to be used by cancel_timer)
+ */
+int input_loop::add_timer(const unsigned int ms, const bool periodic, timer_handler timer)
+{
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+    if (timer_fd < 0) {
+	syslog(LOG_ERR, "ERROR: timerfd_create failed -- abort");
+	exit(8);
+    }
+    struct itimerspec when;	// When the timer goes off
+    memset(&when, '\0', sizeof(when));
+    when.it_value.tv_sec = ms / 1000;
+    when.it_value.tv_nsec = (ms % 1000) * 1000000L;
+    if ((when.it_value.tv_sec == 0) && (when.it_value.tv_nsec == 0))
+	when.it_value.tv_nsec = 1;	// Zero would disarm the timer
+    if (periodic)
+	when.it_interval = when.it_value;
+
+    if (timerfd_settime(timer_fd, 0, &when, NULL) != 0) {
+	syslog(LOG_ERR, "ERROR: timerfd_settime failed -- abort");
+	exit(8);
+    }
+    add_fd(timer_fd, POLLIN, [this, timer_fd, periodic, timer](const short) {
+	uint64_t expired;	// Number of expirations (ignored)
+	if (read(timer_fd, &expired, sizeof(expired)) != sizeof(expired))
+	    return;
+	if (!periodic)
+	    cancel_timer(timer_fd);
+	timer();
+    });
+    return (timer_fd);
+}
+/*
+ * input_loop::cancel_timer -- Get rid of a timer
+ */
+void input_loop::cancel_timer(const int timer_fd)
+{
+    if (timer_fd < 0)
+	return;
+    remove_fd(timer_fd);
+    close(timer_fd);
+}
+/*
+ * input_loop::run -- Run the loop forever
+ */
+void input_loop::run(void)
+{
+    while (true) {
+	struct epoll_event events[32];	// What happened
+	int result = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(events[0]), -1);
+	if (result < 0) {
+	    if (errno == EINTR)
+		continue;
+	    syslog(LOG_ERR, "ERROR: Input epoll failed -- abort");
+	    exit(EXIT_FAILURE);
+	}
+	for (int i = 0; i < result; ++i) {
+	    // A previous handler may have removed this fd
+	    std::map<int, fd_info>::iterator info = fds.find(events[i].data.fd);
+	    if (info == fds.end())
+		continue;
+
+	    fd_handler fd_handler = info->second.handler; // Copy, the handler may remove itself
+	    fd_handler(static_cast<short>(events[i].events));
+	}
+    }
+}
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// fifo_source -- Legacy input pipe
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+class fifo_source: public input_source {
+    private:
+	const std::string path;	// Path of the fifo
+	int fd;			// FD of the fifo
+    public:
+	fifo_source(const std::string& _path, const key_map& _keys):
+	    input_source("fifo", _keys), path(_path), fd(-1)
+	{}
+	~fifo_source() {
+	    if (fd >= 0)
+		close(fd);
+	}
+    public:
+	void start(input_loop& _loop);
+    private:
+	void drain(void);
+	void do_input(void);
+};
+/*
+ * fifo_source::start -- Create and open the fifo
+ */
+void fifo_source::start(input_loop& _loop)
+{
+    loop = &_loop;
+    mkfifo(path.c_str(), 0666);
+    chmod(path.c_str(), 0666);
+
+    // Opened read/write so we never see EOF when the writers go away
+    fd = open(path.c_str(), O_RDWR|O_NONBLOCK);
+    if (fd < 0) {
+	syslog(LOG_ERR, "ERROR: Could not open input pipe");
+	exit(EXIT_FAILURE);
+    }
+    drain();
+    loop->add_fd(fd, POLLIN, [this](const short) {do_input();});
+}
+/*
+ *  fifo_source::drain -- Throw away anything left over from before we started
+ */
+void fifo_source::drain(void)
+{
+    char input[64];	// Input from the fifo
+    while (read(fd, input, sizeof(input)) > 0)
+	continue;
+}
+/*
+ * fifo_source::do_input -- Read the characters in the pipe
+ */
+void fifo_source::do_input(void)
+{
+    char input[64];	// Input from the fifo
+
+    ssize_t read_size = read(fd, input, sizeof(input));
+    if (read_size < 0) {
+	if ((errno == EAGAIN) || (errno == EINTR))
+	    return;
+	syslog(LOG_ERR, "ERROR: Read error on input pipe");
+	exit(EXIT_FAILURE);
+    }
+    for (ssize_t i = 0; i < read_size; ++i) {
+	syslog(LOG_NOTICE, "Input character %c", input[i]);
+
+	// Long press, repeat and release are sent as the press
+	// character moved up (see device.h).  A character in the
+	// key map is always a press.
+	const int button = input[i] & 0x0F;	// Button part of the character
+	switch ((keys.find(input[i]) != keys.end()) ? 0 : (input[i] & 0xF0)) {
+	    case INPUT_PIPE_LONG:
+		send(INPUT_PIPE_PRESS + button, BUTTON_EVENT::LONG_PRESS);
+		break;
+	    case INPUT_PIPE_REPEAT:
+		send(INPUT_PIPE_PRESS + button, BUTTON_EVENT::REPEAT);
+		break;
+	    case INPUT_PIPE_RELEASE:
+		send(INPUT_PIPE_PRESS + button, BUTTON_EVENT::RELEASE);
+		break;
+	    default:
+		send(input[i], BUTTON_EVENT::PRESS);
+		break;
+	}
+    }
+}
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// evdev_source -- Keyboard devices
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+class evdev_source: public input_source {
+    private:
+	static const int BATCH = 64;	// Events read at a time
+	static const unsigned int STATS_PERIOD = 10 * 60 * 1000;	// Log the statistics this often
+
+	const std::string device;	// Device to read
+	int fd;				// FD of the device (-1 if not open)
+	int notify_fd;			// Inotify FD for the device directory
+	int retry_timer;		// Timer to try to open again
+	bool kernel_time;		// Event times are CLOCK_MONOTONIC (else we stamp them)
+
+	// Statistics
+	unsigned long int key_events;	// Key events seen (with kernel times)
+	unsigned long int reads;	// Reads that had events
+	unsigned long int dropped;	// Times the kernel dropped events (SYN_DROPPED)
+	int64_t latency_total;		// Sum of the latencies (us)
+	int64_t latency_max;		// Worst latency (us)
+    public:
+	evdev_source(const std::string& _device, const key_map& _keys):
+	    input_source("evdev:" + _device.substr(_device.rfind('/') + 1), _keys),
+	    device(_device), fd(-1), notify_fd(-1), retry_timer(-1), kernel_time(false),
+	    key_events(0), reads(0), dropped(0), latency_total(0), latency_max(0)
+	{}
+	~evdev_source() {
+	    if (fd >= 0)
+		close(fd);
+	    if (notify_fd >= 0)
+		close(notify_fd);
+	}
+    public:
+	void start(input_loop& _loop);
+    private:
+	void try_open(void);
+	void lost_device(void);
+	void do_input(void);
+	void log_stats(void);
+};
+/*
+ * evdev_source::start -- Start watching the device
+ *
+ * The directory containing the device is watched so we know
+ * as soon as a hot plugged device shows up.
+ */
+void evdev_source::start(input_loop& _loop)
+{
+    loop = &_loop;
+
+    notify_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    if (notify_fd >= 0) {
+	std::vector<char> dir(device.begin(), device.end());	// dirname changes its argument
+	dir.push_back('\0');
+	if (inotify_add_watch(notify_fd, dirname(dir.data()), IN_CREATE|IN_ATTRIB|IN_MOVED_TO) < 0) {
+	    // Directory does not exist yet (no input devices) -- the retry timer will cover us
+	    close(notify_fd);
+	    notify_fd = -1;
+	} else {
+	    loop->add_fd(notify_fd, POLLIN, [this](const short) {
+		char buffer[4096];	// Inotify events (we don't care which ones)
+		while (read(notify_fd, buffer, sizeof(buffer)) > 0)
+		    continue;
+		if (fd < 0)
+		    try_open();
+	    });
+	}
+    }
+    try_open();
+    if (fd < 0)
+	syslog(LOG_ERR, "ERROR: Could not open %s -- waiting for it", device.c_str());
+    loop->add_timer(STATS_PERIOD, true, [this]() {log_stats();});
+}
+/*
+ * evdev_source::try_open -- Try to open the device
+ *
+ * The kernel is asked to stamp the events with CLOCK_MONOTONIC
+ * (the same clock as the rest of the garden) instead of the wall clock.
+ */
+void evdev_source::try_open(void)
+{
+    fd = open(device.c_str(), O_RDONLY|O_NONBLOCK|O_CLOEXEC);
+    if (fd < 0) {
+	if (retry_timer < 0)
+	    retry_timer = loop->add_timer(DEVICE_RETRY, true, [this]() {try_open();});
+	return;
+    }
+    loop->cancel_timer(retry_timer);
+    retry_timer = -1;
+
+    // Get exclusive use of the device
+    if (ioctl(fd, EVIOCGRAB, (void *)1) != 0)
+	syslog(LOG_ERR, "Grab failed for %s", device.c_str());
+
+    int clock_id = CLOCK_MONOTONIC;	// Clock for the event times
+    kernel_time = (ioctl(fd, EVIOCSCLOCKID, &clock_id) == 0);
+    if (!kernel_time)
+	syslog(LOG_ERR, "%s: Can't get monotonic event times -- using read times", device.c_str());
+
+    loop->add_fd(fd, POLLIN, [this](const short revents) {
+	if ((revents & (POLLERR|POLLHUP|POLLNVAL)) != 0)
+	    lost_device();
+	else
+	    do_input();
+    });
+    syslog(LOG_INFO, "Opened %s", device.c_str());
+}
+/*
+ * evdev_source::lost_device -- The device went away (unplugged)
+ */
+void evdev_source::lost_device(void)
+{
+    syslog(LOG_ERR, "ERROR: Lost %s -- waiting for it", device.c_str());
+    loop->remove_fd(fd);
+    close(fd);
+    fd = -1;
+    retry_timer = loop->add_timer(DEVICE_RETRY, true, [this]() {try_open();});
+}
+/*
+ * evdev_source::do_input -- Read the events from the device
+ *
+ * Reads BATCH events at a time until the device is empty.
+ * Each key event keeps the time the kernel saw it.
+ */
+void evdev_source::do_input(void)
+{
+    while (true) {
+	struct input_event events[BATCH];	// Events we read from the raw event system
+
+	ssize_t read_size = read(fd, events, sizeof(events));
+	if (read_size < 0) {
+	    if ((errno == EAGAIN) || (errno == EINTR))
+		return;
+	    lost_device();
+	    return;
+	}
+	if (read_size == 0) {
+	    lost_device();
+	    return;
+	}
+	++reads;
+
+	struct timespec now;	// When we read them
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	const size_t count = read_size / sizeof(events[0]);	// Events we got
+	for (size_t i = 0; i < count; ++i) {
+	    if ((events[i].type == EV_SYN) && (events[i].code == SYN_DROPPED)) {
+		++dropped;
+		syslog(LOG_WARNING, "%s: Kernel dropped events", device.c_str());
+		continue;
+	    }
+	    if (events[i].type != EV_KEY)
+		continue;
+	    // 69 is some sort of extended code
+	    if (events[i].code == 69)
+		continue;
+
+	    struct timespec when = now;	// When the key changed
+	    if (kernel_time) {
+		when.tv_sec = events[i].input_event_sec;
+		when.tv_nsec = events[i].input_event_usec * 1000L;
+
+		const int64_t latency = (static_cast<int64_t>(now.tv_sec) - when.tv_sec) * 1000000 +
+		    (now.tv_nsec - when.tv_nsec) / 1000;	// Kernel to us (us)
+		++key_events;
+		latency_total += latency;
+		latency_max = std::max(latency_max, latency);
+	    }
+
+	    // value 1 = press, 0 = release, 2 = auto repeat
+	    if (events[i].value == 1)
+		send(events[i].code, BUTTON_EVENT::PRESS, when);
+	    else if (events[i].value == 0)
+		send(events[i].code, BUTTON_EVENT::RELEASE, when);
+	    else if (events[i].value == 2)
+		send(events[i].code, BUTTON_EVENT::REPEAT, when);
+	}
+	if (count < static_cast<size_t>(BATCH))
+	    return;	// Short read, nothing left
+    }
+}
+/*
+ * evdev_source::log_stats -- Log the event statistics
+ */
+void evdev_source::log_stats(void)
+{
+    if (reads == 0)
+	return;
+    if (key_events == 0) {
+	syslog(LOG_INFO, "%s: %lu reads, %lu drops", device.c_str(), reads, dropped);
+	return;
+    }
+    syslog(LOG_INFO, "%s: %lu key events in %lu reads, %lu drops, latency avg %ld max %ld us",
+	    device.c_str(), key_events, reads, dropped,
+	    static_cast<long int>(latency_total / static_cast<int64_t>(key_events)),
+	    static_cast<long int>(latency_max));
+}
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// hidraw_source -- The AVR with the raw HID report firmware
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+class hidraw_source: public input_source {
+    private:
+	static const int REPORT_SIZE = 8;	// Size of a report (see firmware.avr/gpio_to_key.c)
+	static const unsigned int STATS_PERIOD = 10 * 60 * 1000;	// Log the statistics this often
+	static const int64_t OFFSET_WINDOW = 60 * 1000;	// Clock match window (ms)
+
+	const std::string device;	// Device to read (empty to look for it)
+	std::string path;		// Device we opened
+	int fd;				// FD of the device (-1 if not open)
+	int retry_timer;		// Timer to try to open again
+
+	bool have_report;		// Have we seen a report since opening
+	uint16_t last_sequence;		// Sequence number of the last report
+	uint16_t last_pins;		// Pins in the last report
+	uint32_t last_stamp;		// Device time of the last report (ms)
+	int64_t device_ms;		// Device time, without the wrap (ms)
+	int64_t offset;			// Host time - device time for the fastest report (ms)
+	int64_t window_offset;		// Fastest report in this window
+	int64_t window_start;		// When this window started (host ms)
+
+	// Statistics
+	unsigned long int reports;	// Reports seen
+	unsigned long int lost;		// Reports missing (sequence gaps)
+	int64_t latency_total;		// Sum of the latencies (ms)
+	int64_t latency_max;		// Worst latency (ms)
+    public:
+	hidraw_source(const std::string& _device, const key_map& _keys):
+	    input_source("hidraw", _keys), device(_device), fd(-1), retry_timer(-1),
+	    have_report(false), last_sequence(0), last_pins(0), last_stamp(0),
+	    device_ms(0), offset(0), window_offset(0), window_start(0),
+	    reports(0), lost(0), latency_total(0), latency_max(0)
+	{}
+	~hidraw_source() {
+	    if (fd >= 0)
+		close(fd);
+	}
+    public:
+	void start(input_loop& _loop);
+    private:
+	static std::string find_device(void);
+	void try_open(void);
+	void lost_device(void);
+	void do_input(void);
+	void do_report(const unsigned char* const report);
+	void log_stats(void);
+};
+/*
+ * hidraw_source::start -- Start looking for the device
+ */
+void hidraw_source::start(input_loop& _loop)
+{
+    loop = &_loop;
+    try_open();
+    if (fd < 0)
+	syslog(LOG_ERR, "ERROR: Could not open AVR raw HID device -- waiting for it");
+    loop->add_timer(STATS_PERIOD, true, [this]() {log_stats();});
+}
+/*
+ * hidraw_source::find_device -- Find the hidraw device with our USB id
+ *
+ * Returns
+ * 	The device (empty if not plugged in)
+ */
+std::string hidraw_source::find_device(void)
+{
+    for (int i = 0; i < 16; ++i) {
+	std::ostringstream uevent_name;	// Where the USB id is
+	uevent_name << "/sys/class/hidraw/hidraw" << i << "/device/uevent";
+	std::ifstream uevent(uevent_name.str().c_str());
+	std::string line;	// Line from the file
+	while (std::getline(uevent, line)) {
+	    if (line == AVR_HID_ID) {
+		std::ostringstream device_name;	// The device that goes with it
+		device_name << "/dev/hidraw" << i;
+		return (device_name.str());
+	    }
+	}
+    }
+    return ("");
+}
+/*
+ * hidraw_source::try_open -- Try to open the device
+ */
+void hidraw_source::try_open(void)
+{
+    path = device.empty() ? find_device() : device;
+    if (!path.empty())
+	fd = open(path.c_str(), O_RDONLY|O_NONBLOCK|O_CLOEXEC);
+    if (fd < 0) {
+	if (retry_timer < 0)
+	    retry_timer = loop->add_timer(DEVICE_RETRY, true, [this]() {try_open();});
+	return;
+    }
+    loop->cancel_timer(retry_timer);
+    retry_timer = -1;
+    have_report = false;
+
+    loop->add_fd(fd, POLLIN, [this](const short revents) {
+	if ((revents & (POLLERR|POLLHUP|POLLNVAL)) != 0)
+	    lost_device();
+	else
+	    do_input();
+    });
+    syslog(LOG_INFO, "Opened %s", path.c_str());
+}
+/*
+ * hidraw_source::lost_device -- The device went away (unplugged)
+ *
+ * Anything held down is let go.
+ */
+void hidraw_source::lost_device(void)
+{
+    syslog(LOG_ERR, "ERROR: Lost %s -- waiting for it", path.c_str());
+    loop->remove_fd(fd);
+    close(fd);
+    fd = -1;
+    for (int pin = 0; pin < 16; ++pin) {
+	if ((last_pins & (1 << pin)) != 0)
+	    send(pin, BUTTON_EVENT::RELEASE);
+    }
+    last_pins = 0;
+    retry_timer = loop->add_timer(DEVICE_RETRY, true, [this]() {try_open();});
+}
+/*
+ * hidraw_source::do_input -- Read the reports from the device
+ */
+void hidraw_source::do_input(void)
+{
+    while (true) {
+	unsigned char report[REPORT_SIZE];	// One report (hidraw gives one per read)
+	ssize_t read_size = read(fd, report, sizeof(report));
+	if (read_size < 0) {
+	    if ((errno == EAGAIN) || (errno == EINTR))
+		return;
+	    lost_device();
+	    return;
+	}
+	if (read_size == 0) {
+	    lost_device();
+	    return;
+	}
+	if (read_size != REPORT_SIZE) {
+	    syslog(LOG_ERR, "ERROR: %s: short report (%d bytes)", path.c_str(), static_cast<int>(read_size));
+	    continue;
+	}
+	do_report(report);
+    }
+}
+/*
+ * hidraw_source::do_report -- Turn a report into events
+ *
+ * The device time is matched to ours through the report that got
+ * here fastest (in each OFFSET_WINDOW, so clock drift is followed).
+ * The events get the time the device saw the change, and the
+ * latency is how much later than the fastest this report was.
+ *
+ * Parameters
+ * 	report -- The report (see firmware.avr/gpio_to_key.c)
+ */
+void hidraw_source::do_report(const unsigned char* const report)
+{
+    struct timespec now;	// When the report came in
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t now_ms = static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+
+    const uint16_t pins = report[0] | (report[1] << 8);		// Pins held down
+    const uint16_t sequence = report[2] | (report[3] << 8);	// Report number
+    const uint32_t stamp = report[4] | (report[5] << 8) | (report[6] << 16) |
+	(static_cast<uint32_t>(report[7]) << 24);		// Device time (ms)
+
+    ++reports;
+    if (!have_report) {
+	have_report = true;
+	device_ms = stamp;
+	offset = window_offset = now_ms - device_ms;
+	window_start = now_ms;
+    } else {
+	const uint16_t missing = sequence - last_sequence - 1;	// Reports we didn't get
+	if (missing != 0) {
+	    lost += missing;
+	    syslog(LOG_WARNING, "%s: %d reports lost", path.c_str(), missing);
+	}
+	device_ms += static_cast<int32_t>(stamp - last_stamp);
+    }
+    last_sequence = sequence;
+    last_stamp = stamp;
+
+    // Match the clocks
+    window_offset = std::min(window_offset, now_ms - device_ms);
+    offset = std::min(offset, window_offset);
+    if (now_ms - window_start >= OFFSET_WINDOW) {
+	offset = window_offset;
+	window_offset = now_ms - device_ms;
+	window_start = now_ms;
+    }
+    const int64_t when_ms = device_ms + offset;	// Our time for the change
+    const int64_t latency = now_ms - when_ms;	// How much slower than the best
+    latency_total += latency;
+    latency_max = std::max(latency_max, latency);
+
+    struct timespec when;	// Event time
+    when.tv_sec = when_ms / 1000;
+    when.tv_nsec = (when_ms % 1000) * 1000000;
+
+    // Everything that changed (several pins at once is fine)
+    const uint16_t changed = pins ^ last_pins;
+    last_pins = pins;
+    for (int pin = 0; pin < 16; ++pin) {
+	if ((changed & (1 << pin)) != 0)
+	    send(pin, ((pins & (1 << pin)) != 0) ? BUTTON_EVENT::PRESS : BUTTON_EVENT::RELEASE, when);
+    }
+}
+/*
+ * hidraw_source::log_stats -- Log the report statistics
+ */
+void hidraw_source::log_stats(void)
+{
+    if (reports == 0)
+	return;
+    syslog(LOG_INFO, "%s: %lu reports, %lu lost, latency avg %ld max %ld ms",
+	    path.c_str(), reports, lost,
+	    static_cast<long int>(latency_total / static_cast<int64_t>(reports)),
+	    static_cast<long int>(latency_max));
+}
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// mcp2200_source -- The MCP2200 USB GPIO device
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+class mcp2200_source: public input_source {
+    private:
+	// One attached MCP2200
+	struct unit {
+	    mcp2200_source* source;	// Who owns us
+	    std::string serial;		// Serial number of the device
+	    int offset;			// Added to the button number
+	    mcp2200_t* device;		// The device
+	    uint8_t old_bits;		// Last value of the pins
+	    mcp2200_sampler_t sampler;	// How often to read the pins
+	    pin_debounce debounce;	// Turns samples into events
+	    int sample_timer;		// Timer for the next read (-1 if none)
+	    int led_bits;		// Output pins last sent (-1 if never)
+	};
+	static const unsigned int BLINK_MS = 250;	// Half period of a RUNNING light
+
+	pin_debounce::pin_setting settings[pin_debounce::PINS];	// Debounce tuning for each pin
+	std::map<int, int> leds;	// LED pin -> pin of the button it lights
+	uint8_t output_mask;		// Pins used for LEDs
+	std::vector<LIGHT> lights;	// State of every button (by button number)
+	bool blink_on;			// Blinking lights are on right now
+	int blink_timer;		// Timer for blinking lights (-1 if none)
+	std::map<std::string, int> wanted;	// Serial -> offset (empty for every device)
+	std::map<std::string, unit*> units;	// Devices that are open (by serial)
+	int retry_timer;		// Timer to look for missing devices
+	int open_timer;			// Timer to open a device that just arrived
+    public:
+	mcp2200_source(const std::map<std::string, int>& _wanted, const key_map& _keys):
+	    input_source("mcp2200", _keys), output_mask(0), blink_on(true), blink_timer(-1),
+	    wanted(_wanted), retry_timer(-1), open_timer(-1)
+	{}
+	~mcp2200_source() {
+	    for (auto& item: units) {
+		delete item.second->device;
+		delete item.second;
+	    }
+	}
+    public:
+	void start(input_loop& _loop);
+	void show_lights(const LIGHT* const new_lights, const int count);
+    private:
+	static int LIBUSB_CALL hotplug(libusb_context* ctx, libusb_device* dev,
+		libusb_hotplug_event event, void* data);
+	static void LIBUSB_CALL pollfd_added(int fd, short events, void* data);
+	static void LIBUSB_CALL pollfd_removed(int fd, void* data);
+	void load_settings(void);
+	static void sample_done(mcp2200_t& device,
+		const mcp2200_t::read_all_response_t* const response, void* const data);
+	void watch_usb_fd(const int fd, const short events);
+	void scan(void);
+	bool missing(void) const;
+	void open_unit(const std::string& serial);
+	void close_unit(const std::string& serial);
+	void close_later(const std::string& serial);
+	void sample(unit* const the_unit);
+	void schedule(unit* const the_unit, const unsigned int wait);
+	void update_leds(unit* const the_unit);
+};
+/*
+ * mcp2200_source::start -- Start libusb and look for the devices
+ */
+void mcp2200_source::start(input_loop& _loop)
+{
+    loop = &_loop;
+    load_settings();
+
+    int usb_init = libusb_init(NULL);
+    if (usb_init != 0) {
+	syslog(LOG_ERR, "ERROR: libusb_init failed with code %d", usb_init);
+	exit(8);
+    }
+    // libusb does its work through file descriptors -- put them in our loop
+    const struct libusb_pollfd** usb_fds = libusb_get_pollfds(NULL);
+    if (usb_fds != NULL) {
+	for (int i = 0; usb_fds[i] != NULL; ++i)
+	    watch_usb_fd(usb_fds[i]->fd, usb_fds[i]->events);
+	libusb_free_pollfds(usb_fds);
+    }
+    libusb_set_pollfd_notifiers(NULL, pollfd_added, pollfd_removed, this);
+
+    if (libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+	libusb_hotplug_callback_handle handle;	// Handle for the callback (we never remove it)
+	int result = libusb_hotplug_register_callback(NULL,
+		static_cast<libusb_hotplug_event>(
+		    LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+		LIBUSB_HOTPLUG_NO_FLAGS,
+		mcp2200_t::MCP2200_VENDOR_ID, mcp2200_t::MCP2200_PRODUCT_ID,
+		LIBUSB_HOTPLUG_MATCH_ANY, hotplug, this, &handle);
+	if (result != LIBUSB_SUCCESS)
+	    syslog(LOG_ERR, "ERROR: MCP2200 hotplug registration failed %d", result);
+    }
+    scan();
+}
+/*
+ * mcp2200_source::load_settings -- Get the debounce tuning from the configuration
+ *
+ *	mcp_pin <pin>|* <samples> [<long press ms> [<repeat ms>]]
+ *
+ *	mcp_led <led pin> <button pin>
+ *
+ * Same for every device (the panels are laid out the same.)
+ */
+void mcp2200_source::load_settings(void)
+{
+    for (int pin = 0; pin < pin_debounce::PINS; ++pin) {
+	settings[pin].samples = pin_debounce::DEFAULT_SAMPLES;
+	settings[pin].long_ms = pin_debounce::DEFAULT_LONG;
+	settings[pin].repeat_ms = pin_debounce::DEFAULT_REPEAT;
+    }
+    for (auto& line: garden_conf.get_all("mcp_pin")) {
+	if (line.size() < 3) {
+	    syslog(LOG_ERR, "ERROR: mcp_pin needs a pin and a sample count");
+	    continue;
+	}
+	pin_debounce::pin_setting setting;	// Setting from this line
+	setting.samples = atoi(line[2].c_str());
+	setting.long_ms = (line.size() > 3) ? atoi(line[3].c_str()) : pin_debounce::DEFAULT_LONG;
+	setting.repeat_ms = (line.size() > 4) ? atoi(line[4].c_str()) : pin_debounce::DEFAULT_REPEAT;
+
+	for (int pin = 0; pin < pin_debounce::PINS; ++pin) {
+	    if ((line[1] == "*") || (atoi(line[1].c_str()) == pin))
+		settings[pin] = setting;
+	}
+    }
+    leds.clear();
+    output_mask = 0;
+    for (auto& line: garden_conf.get_all("mcp_led")) {
+	if (line.size() < 3) {
+	    syslog(LOG_ERR, "ERROR: mcp_led needs a LED pin and a button pin");
+	    continue;
+	}
+	const int led = atoi(line[1].c_str());		// Pin driving the LED
+	const int button = atoi(line[2].c_str());	// Pin the button is on
+	if ((led < 0) || (led >= pin_debounce::PINS) || (button < 0) || (button >= pin_debounce::PINS)) {
+	    syslog(LOG_ERR, "ERROR: mcp_led pin out of range");
+	    continue;
+	}
+	leds[led] = button;
+	output_mask |= (1 << led);
+    }
+}
+/*
+ * mcp2200_source::watch_usb_fd -- Add a libusb fd to the loop
+ */
+void mcp2200_source::watch_usb_fd(const int fd, const short events)
+{
+    loop->add_fd(fd, events, [](const short) {
+	struct timeval zero = {0, 0};	// Don't wait, just process
+	libusb_handle_events_timeout_completed(NULL, &zero, NULL);
+    });
+}
+void LIBUSB_CALL mcp2200_source::pollfd_added(int fd, short events, void* data)
+{
+    static_cast<mcp2200_source*>(data)->watch_usb_fd(fd, events);
+}
+void LIBUSB_CALL mcp2200_source::pollfd_removed(int fd, void* data)
+{
+    static_cast<mcp2200_source*>(data)->loop->remove_fd(fd);
+}
+/*
+ * mcp2200_source::hotplug -- A MCP2200 came or went
+ *
+ * We can't do synchronous USB work in here, so the scan is done
+ * from a timer a little later.
+ */
+int LIBUSB_CALL mcp2200_source::hotplug(libusb_context*, libusb_device*,
+	libusb_hotplug_event event, void* data)
+{
+    mcp2200_source* me = static_cast<mcp2200_source*>(data);
+    if ((event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) && (me->open_timer < 0)) {
+	me->open_timer = me->loop->add_timer(100, false, [me]() {
+	    me->open_timer = -1;
+	    me->scan();
+	});
+    }
+    // Device left is seen as a failed transfer
+    return (0);
+}
+/*
+ * mcp2200_source::missing -- Are we waiting for a device
+ *
+ * Returns
+ * 	true if a device we want is not open (or, when we take every
+ * 	device, none are open)
+ */
+bool mcp2200_source::missing(void) const
+{
+    if (wanted.empty())
+	return (units.empty());
+    for (auto& item: wanted) {
+	if (units.find(item.first) == units.end())
+	    return (true);
+    }
+    return (false);
+}
+/*
+ * mcp2200_source::scan -- Open every device we want that isn't open yet
+ *
+ * If something is still missing, look again every DEVICE_RETRY.
+ */
+void mcp2200_source::scan(void)
+{
+    try {
+	std::list<std::string> serial_list = mcp2200_t::get_serial_list();
+
+	for (auto& serial: serial_list) {
+	    if (units.find(serial) != units.end())
+		continue;
+	    if (wanted.empty() || (wanted.find(serial) != wanted.end()))
+		open_unit(serial);
+	}
+    }
+    catch (mcp2200_error_t &error) {
+	syslog(LOG_ERR, "ERROR: %s:%d usb error: %d:%s",
+		error.file, error.line, error.usb_error, error.msg.c_str());
+    }
+    if (!missing()) {
+	loop->cancel_timer(retry_timer);
+	retry_timer = -1;
+    } else if (retry_timer < 0) {
+	syslog(LOG_ERR, "ERROR: MCP2200 missing -- waiting for it");
+	retry_timer = loop->add_timer(DEVICE_RETRY, true, [this]() {scan();});
+    }
+}
+/*
+ * mcp2200_source::open_unit -- Open a device and start reading it
+ *
+ * Parameters
+ * 	serial -- Serial number of the device
+ */
+void mcp2200_source::open_unit(const std::string& serial)
+{
+    std::map<std::string, int>::const_iterator want = wanted.find(serial);
+    unit* the_unit = new unit;		// The new device
+    the_unit->source = this;
+    the_unit->serial = serial;
+    the_unit->offset = (want == wanted.end()) ? 0 : want->second;
+    the_unit->device = NULL;
+    the_unit->old_bits = 0xFF;
+    the_unit->sample_timer = -1;
+    the_unit->led_bits = -1;
+    for (int pin = 0; pin < pin_debounce::PINS; ++pin)
+	the_unit->debounce.set(pin, settings[pin]);
+    try {
+	the_unit->device = new mcp2200_t(serial);
+
+	mcp2200_t::config_cmd_t config;	// Get the configuration
+	config.set_io_bmp(~output_mask);	// Buttons are inputs, LEDs outputs
+	the_unit->device->configure(config);
+    }
+    catch (mcp2200_error_t &error) {
+	syslog(LOG_ERR, "ERROR: MCP2200 %s: %s:%d usb error: %d:%s", serial.c_str(),
+		error.file, error.line, error.usb_error, error.msg.c_str());
+	delete the_unit->device;
+	delete the_unit;
+	return;
+    }
+    units[serial] = the_unit;
+    syslog(LOG_INFO, "Opened MCP2200 %s (buttons +%d)", serial.c_str(), the_unit->offset);
+    update_leds(the_unit);
+    sample(the_unit);
+}
+/*
+ * mcp2200_source::close_unit -- Give up on a device and wait for it to come back
+ *
+ * Parameters
+ * 	serial -- Serial number of the device (may already be closed)
+ */
+void mcp2200_source::close_unit(const std::string& serial)
+{
+    std::map<std::string, unit*>::iterator item = units.find(serial);
+    if (item == units.end())
+	return;
+    unit* the_unit = item->second;	// The device we are closing
+    units.erase(item);
+
+    loop->cancel_timer(the_unit->sample_timer);
+    delete the_unit->device;
+    delete the_unit;
+    syslog(LOG_INFO, "Closed MCP2200 %s", serial.c_str());
+
+    if (retry_timer < 0)
+	retry_timer = loop->add_timer(DEVICE_RETRY, true, [this]() {scan();});
+}
+/*
+ * mcp2200_source::close_later -- Close a device once we are out of its callbacks
+ */
+void mcp2200_source::close_later(const std::string& serial)
+{
+    loop->add_timer(0, false, [this, serial]() {close_unit(serial);});
+}
+/*
+ * mcp2200_source::sample -- Start a read of the pins
+ *
+ * May be called from inside sample_done, so on an error the device
+ * is closed later rather than right now.
+ */
+void mcp2200_source::sample(unit* const the_unit)
+{
+    if (the_unit->device->async_pending())
+	return;
+    try {
+	the_unit->device->async_read_all(sample_done, the_unit);
+    }
+    catch (mcp2200_error_t &error) {
+	syslog(LOG_ERR, "ERROR: MCP2200 %s: %s:%d usb error: %d:%s", the_unit->serial.c_str(),
+		error.file, error.line, error.usb_error, error.msg.c_str());
+	close_later(the_unit->serial);
+    }
+}
+/*
+ * mcp2200_source::schedule -- Arrange for the next read of the pins
+ *
+ * Parameters
+ * 	the_unit -- Device to read
+ * 	wait -- Time to wait (ms).  0 means read again right now.
+ */
+void mcp2200_source::schedule(unit* const the_unit, const unsigned int wait)
+{
+    if (wait == 0) {
+	sample(the_unit);
+	return;
+    }
+    the_unit->sample_timer = loop->add_timer(wait, false, [this, the_unit]() {
+	the_unit->sample_timer = -1;
+	sample(the_unit);
+    });
+}
+/*
+ * mcp2200_source::sample_done -- Turn the pin values into button events
+ *
+ * Buttons pull the pin low.  The debouncer decides when a pin has
+ * really changed.
+ */
+void mcp2200_source::sample_done(mcp2200_t&,
+	const mcp2200_t::read_all_response_t* const response, void* const data)
+{
+    unit* the_unit = static_cast<unit*>(data);
+    mcp2200_source* me = the_unit->source;
+    if (response == NULL) {
+	syslog(LOG_ERR, "ERROR: MCP2200 %s read failed -- device closed", the_unit->serial.c_str());
+	// Can't delete the device from inside its own callback
+	me->close_later(the_unit->serial);
+	return;
+    }
+    struct timespec now;	// When the sample came in
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Current value of the I/O pins
+    uint8_t current = response->get_IO_Port_Val_bmap();
+    pin_debounce::edge edges[pin_debounce::MAX_EDGES];	// What happened
+    // LED pins read back what we drive them to -- they are not buttons
+    const uint8_t pressed = ~current & ~me->output_mask;
+    const int n_edges = the_unit->debounce.update(pressed, now, edges);
+
+    for (int i = 0; i < n_edges; ++i) {
+	static const BUTTON_EVENT types[] = {	// Debounce edge -> button event
+	    BUTTON_EVENT::PRESS, BUTTON_EVENT::RELEASE, BUTTON_EVENT::LONG_PRESS, BUTTON_EVENT::REPEAT
+	};
+	me->send(edges[i].pin, types[static_cast<int>(edges[i].type)], edges[i].when, the_unit->offset);
+    }
+    // Stay fast while anything is moving or being counted
+    const bool changed = ((current ^ the_unit->old_bits) & ~me->output_mask) || the_unit->debounce.settling();
+    me->schedule(the_unit, the_unit->sampler.next(changed));
+    the_unit->old_bits = current;
+}
+/*
+ * mcp2200_source::show_lights -- Light the buttons
+ *
+ * RUNNING lights blink, so a timer runs while any are showing.
+ *
+ * Parameters
+ * 	new_lights -- State of each button
+ * 	count -- Number of buttons
+ */
+void mcp2200_source::show_lights(const LIGHT* const new_lights, const int count)
+{
+    lights.assign(new_lights, new_lights + count);
+
+    const bool blinking = std::find(lights.begin(), lights.end(), LIGHT::RUNNING) != lights.end();
+    if (blinking && (blink_timer < 0)) {
+	blink_timer = loop->add_timer(BLINK_MS, true, [this]() {
+	    blink_on = !blink_on;
+	    for (auto& item: units)
+		update_leds(item.second);
+	});
+    } else if (!blinking && (blink_timer >= 0)) {
+	loop->cancel_timer(blink_timer);
+	blink_timer = -1;
+	blink_on = true;
+    }
+    for (auto& item: units)
+	update_leds(item.second);
+}
+/*
+ * mcp2200_source::update_leds -- Drive a device's LEDs to match the lights
+ *
+ * All the LEDs on a device go out in one set / clear, and only
+ * when something has changed.
+ */
+void mcp2200_source::update_leds(unit* const the_unit)
+{
+    if (output_mask == 0)
+	return;
+
+    uint8_t bits = 0;	// LED pins that should be on
+    for (auto& led: leds) {
+	key_map::const_iterator key = keys.find(led.second);
+	if (key == keys.end())
+	    continue;
+	const unsigned int button = key->second + the_unit->offset;	// Button this LED shows
+	if (button >= lights.size())
+	    continue;
+	if ((lights[button] == LIGHT::READY) || ((lights[button] == LIGHT::RUNNING) && blink_on))
+	    bits |= (1 << led.first);
+    }
+    if (bits == the_unit->led_bits)
+	return;
+
+    mcp2200_t::set_clear_all_t cmd;	// Command to set the LEDs
+    cmd.clear(output_mask);
+    cmd.set(bits);
+    try {
+	the_unit->device->async_set_clear_all(cmd);
+	the_unit->led_bits = bits;
+    }
+    catch (mcp2200_error_t &error) {
+	syslog(LOG_ERR, "ERROR: MCP2200 %s: %s:%d usb error: %d:%s", the_unit->serial.c_str(),
+		error.file, error.line, error.usb_error, error.msg.c_str());
+	close_later(the_unit->serial);
+    }
+}
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// test_source -- Play a script of button presses
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+class test_source: public input_source {
+    private:
+	struct step {
+	    unsigned int delay;	// Time to wait before this step (ms)
+	    int button;		// Button to push
+	    BUTTON_EVENT type;	// What to do with it
+	};
+	std::vector<step> script;	// The script we are playing
+	size_t next;			// Next step to play
+    public:
+	test_source(const std::string& script_file, const key_map& _keys);
+    public:
+	void start(input_loop& _loop);
+    private:
+	void play(void);
+};
+/*
+ * test_source::test_source -- Read the script
+ *
+ * Each line of the script is
+ * 	<delay in ms> <button> [press|release|long|repeat]
+ */
+test_source::test_source(const std::string& script_file, const key_map& _keys):
+    input_source("test", _keys), next(0)
+{
+    std::ifstream in_file(script_file.c_str());
+    if (!in_file.is_open()) {
+	syslog(LOG_ERR, "ERROR: Unable to open test script %s", script_file.c_str());
+	exit(8);
+    }
+    std::string line;	// Line from the script
+    while (std::getline(in_file, line)) {
+	if (line.empty() || (line[0] == '#'))
+	    continue;
+	std::istringstream words(line);	// The line broken up
+	step item;			// Step we are reading
+	std::string type;		// Press, release, long or repeat
+
+	if (!(words >> item.delay >> item.button)) {
+	    syslog(LOG_ERR, "Bad test script line %s", line.c_str());
+	    continue;
+	}
+	words >> type;
+	if (type == "release")
+	    item.type = BUTTON_EVENT::RELEASE;
+	else if (type == "long")
+	    item.type = BUTTON_EVENT::LONG_PRESS;
+	else if (type == "repeat")
+	    item.type = BUTTON_EVENT::REPEAT;
+	else
+	    item.type = BUTTON_EVENT::PRESS;
+	script.push_back(item);
+    }
+}
+void test_source::start(input_loop& _loop)
+{
+    loop = &_loop;
+    if (!script.empty())
+	loop->add_timer(script[0].delay, false, [this]() {play();});
+}
+/*
+ * test_source::play -- Play one step, then set a timer for the next one
+ */
+void test_source::play(void)
+{
+    send(script[next].button, script[next].type);
+    ++next;
+    if (next < script.size())
+	loop->add_timer(script[next].delay, false, [this]() {play();});
+    else
+	syslog(LOG_INFO, "Test script done");
+}
+
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+// Source creation
+/*------------------------------------------------------*/
+/*------------------------------------------------------*/
+/*
+ * default_keys -- Key map each source type starts out with
+ */
+static key_map default_keys(const std::string& type)
+{
+    key_map keys;	// The map we are building
+    if (type == "fifo") {
+	// '0' + n for button n (see device.h)
+	for (int i = 0; i < INPUT_PIPE_BUTTONS; ++i)
+	    keys[INPUT_PIPE_PRESS + i] = i;
+    } else if (type == "evdev") {
+	// AVR Teensy (see button_avr.cpp for the pin layout)
+	keys[KEY_A] = 0; keys[KEY_B] = 1; keys[KEY_C] = 2; keys[KEY_D] = 3;
+	keys[KEY_H] = 4; keys[KEY_M] = 5; keys[KEY_N] = 6; keys[KEY_O] = 7;
+	keys[KEY_P] = 8;
+
+	// Keypads
+	static const int digit_keys[10] = {
+	    KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9
+	};
+	static const int keypad_keys[10] = {
+	    KEY_KP0, KEY_KP1, KEY_KP2, KEY_KP3, KEY_KP4, KEY_KP5, KEY_KP6, KEY_KP7, KEY_KP8, KEY_KP9
+	};
+	for (int i = 0; i < 10; ++i) {
+	    keys[digit_keys[i]] = i;
+	    keys[keypad_keys[i]] = i;
+	}
+    } else if (type == "hidraw") {
+	// Same buttons as the AVR keyboard: pins 0-7 are B0-B7, 8-15 are D0-D7
+	keys[0] = 0; keys[1] = 1; keys[2] = 2; keys[3] = 3;
+	keys[7] = 4; keys[8] = 5; keys[9] = 6; keys[10] = 7;
+	keys[11] = 8;
+    } else {
+	// mcp2200 pins and test scripts map straight through
+	for (int i = 0; i < 16; ++i)
+	    keys[i] = i;
+    }
+    return (keys);
+}
+/*
+ * make_source -- Create a source from a configuration line
+ *
+ *	source fifo [<path>] [<code>=<button> ...]
+ *	source evdev <device> [<code>=<button> ...]
+ *	source mcp2200 [<serial>[@<offset>] ...] [<code>=<button> ...]
+ *	source hidraw [<device>] [<pin>=<button> ...]
+ *	source test <script> [<code>=<button> ...]
+ *
+ * <code> is the character (fifo), key code (evdev) or pin number (mcp2200,
+ * hidraw).  hidraw with no device finds the AVR by its USB id.
+ *
+ * mcp2200 with no serial numbers uses every device plugged in.  With
+ * serial numbers it uses only those, adding <offset> (default 0) to
+ * the button number of each.
+ *
+ * Returns
+ * 	The source or NULL if the line is bad
+ */
+input_source* make_source(const garden_config::line_t& line)
+{
+    if (line.size() < 2) {
+	syslog(LOG_ERR, "ERROR: source needs a type");
+	return (NULL);
+    }
+    const std::string& type = line[1];	// Type of the source
+    std::string arg;			// Argument (path, serial, script)
+    std::map<std::string, int> serials;	// mcp2200 serial numbers -> button offset
+    key_map keys = default_keys(type);	// The key map for this source
+
+    for (size_t i = 2; i < line.size(); ++i) {
+	std::string::size_type equal = line[i].find('=');
+	if (equal == std::string::npos) {
+	    arg = line[i];
+	    std::string::size_type at = arg.find('@');	// Offset part of serial@offset
+	    if (at == std::string::npos)
+		serials[arg] = 0;
+	    else
+		serials[arg.substr(0, at)] = atoi(arg.substr(at+1).c_str());
+	    continue;
+	}
+	std::string code = line[i].substr(0, equal);	// Code part of code=button
+	int button = atoi(line[i].substr(equal+1).c_str());
+
+	if ((type == "fifo") && (code.size() == 1))
+	    keys[code[0]] = button;
+	else
+	    keys[strtol(code.c_str(), NULL, 0)] = button;
+    }
+    if (type == "fifo")
+	return (new fifo_source(arg.empty() ? INPUT_PIPE : arg, keys));
+    if (type == "mcp2200")
+	return (new mcp2200_source(serials, keys));
+    if (type == "hidraw")
+	return (new hidraw_source(arg, keys));
+    if (arg.empty()) {
+	syslog(LOG_ERR, "ERROR: source %s needs a device or file", type.c_str());
+	return (NULL);
+    }
+    if (type == "evdev")
+	return (new evdev_source(arg, keys));
+    if (type == "test")
+	return (new test_source(arg, keys));
+    syslog(LOG_ERR, "ERROR: Unknown source type %s", type.c_str());
+    return (NULL);
+}
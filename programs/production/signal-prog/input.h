@@ -0,0 +1,148 @@
+/*
+ * input -- Button input for the garden
+ *
+ * The garden reads its buttons directly through a set of input
+ * sources that all run inside a single epoll loop (the input thread).
+ *
+ * Sources
+ * 	fifo_source -- The legacy input pipe (fed by button_mcp, button_avr,
+ * 		button_type or anything else that can write a digit)
+ * 	evdev_source -- A keyboard (AVR Teensy, wireless keypad, PoKeys)
+ * 	hidraw_source -- The AVR Teensy with the raw HID firmware (all the
+ * 		pins in one report, with sequence numbers and time stamps)
+ * 	mcp2200_source -- MCP2200 USB GPIO devices (as many as are plugged in,
+ * 		each with its own button offset)
+ * 	test_source -- Plays a script of button presses (for testing)
+ *
+ * Each source has its own key map which turns the source specific code
+ * (character, key code, pin number) into a button number.
+ * Devices that go away are re-opened when they come back.
+ *
+ * Sources that can light their buttons (mcp2200_source) are told
+ * the state of every button through set_lights.
+ */
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#include "garden_conf.h"
+
+// What happened to a button
+enum class BUTTON_EVENT {PRESS, RELEASE, LONG_PRESS, REPEAT};
+
+// What a button's light shows
+// 	OFF -- Nothing
+// 	READY -- Push me (steady on)
+// 	RUNNING -- Show is running (blinking)
+// 	LOCKED -- Rate limited or quiet hours (off)
+enum class LIGHT {OFF, READY, RUNNING, LOCKED};
+
+// A button event coming from one of the sources
+struct button_event {
+    int button;			// Button number (after key mapping)
+    BUTTON_EVENT type;		// What happened
+    struct timespec when;	// CLOCK_MONOTONIC time the event was seen
+    const char* source;		// Name of the source that saw it
+};
+
+// Map from a source specific code to a button number
+typedef std::map<int, int> key_map;
+
+class input_loop;
+
+/*
+ * input_source -- Base class for all sources
+ */
+class input_source {
+    protected:
+	const std::string name;	// Name of the source (for logging)
+	key_map keys;		// Code -> button map
+	input_loop* loop;	// The loop we are running in
+    public:
+	input_source(const std::string& _name, const key_map& _keys):
+	    name(_name), keys(_keys), loop(NULL)
+	{}
+	virtual ~input_source() {}
+    private:
+	input_source(const input_source&);		// No copy
+	input_source& operator = (const input_source&);	// No assignment
+    public:
+	// Change a single entry in the key map
+	void set_key(const int code, const int button) {
+	    keys[code] = button;
+	}
+	const std::string& get_name(void) const {
+	    return (name);
+	}
+	// Register our file descriptors with the loop
+	virtual void start(input_loop& _loop) = 0;
+	// Show the state of the buttons (lights[n] is button n)
+	virtual void show_lights(const LIGHT* const, const int) {}
+    protected:
+	void send(const int code, const BUTTON_EVENT type, const int offset = 0);
+	void send(const int code, const BUTTON_EVENT type, const struct timespec& when,
+		const int offset = 0);
+};
+
+/*
+ * input_loop -- epoll loop that runs all the sources
+ *
+ * Every fd (devices, timers, libusb) is in one epoll set, so a wakeup
+ * costs one system call no matter how many devices are plugged in.
+ * Events are given as POLLIN, POLLOUT, ... (the same bits as EPOLLIN,
+ * EPOLLOUT, ...)
+ *
+ * Not thread safe.  Everything must be done from the input thread
+ * (or before it starts.)
+ */
+class input_loop {
+    public:
+	typedef std::function<void (const short revents)> fd_handler;
+	typedef std::function<void (void)> timer_handler;
+	typedef void (*event_handler)(const struct button_event& event);
+    private:
+	struct fd_info {
+	    short events;	// Events to poll for
+	    fd_handler handler;	// Who to call
+	};
+	int epoll_fd;				// The epoll set
+	std::map<int, fd_info> fds;		// Everything we watch
+	std::vector<input_source*> sources;	// Sources (we own them)
+	event_handler handler;			// Where the events go
+    public:
+	explicit input_loop(event_handler _handler);
+	~input_loop();
+    private:
+	input_loop(const input_loop&);			// No copy
+	input_loop& operator = (const input_loop&);	// No assignment
+    public:
+	void add_source(input_source* const source);
+	bool empty(void) const {
+	    return (sources.empty());
+	}
+	void add_fd(const int fd, const short events, fd_handler fd_handler);
+	void remove_fd(const int fd);
+
+	// Timers are timerfds -- the fd is the timer id
+	int add_timer(const unsigned int ms, const bool periodic, timer_handler timer);
+	void cancel_timer(const int timer_fd);
+
+	void send(const struct button_event& event) {
+	    handler(event);
+	}
+	void set_lights(const LIGHT* const lights, const int count) {
+	    for (auto source: sources)
+		source->show_lights(lights, count);
+	}
+	void run(void) __attribute__((noreturn));
+};
+
+// Create a source from a "source" line in the configuration file
+extern input_source* make_source(const garden_config::line_t& line);
+#endif // __INPUT_H__
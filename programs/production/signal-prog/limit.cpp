@@ -0,0 +1,86 @@
+/*
+ * limit -- Token bucket rate limiter
+ */
+#include "limit.h"
+
+/*
+ * token_bucket::set -- Set the rate and size of the bucket
+ *
+ * The bucket starts out full.
+ *
+ * Parameters
+ * 	per_minute -- Tokens added each minute (0 for no limit)
+ * 	_burst -- The most tokens the bucket can hold
+ */
+void token_bucket::set(const double per_minute, const double _burst)
+{
+    per_second = per_minute / 60.0;
+    burst = (_burst < 1.0) ? 1.0 : _burst;
+    tokens = burst;
+    last.tv_sec = 0;
+    last.tv_nsec = 0;
+}
+
+/*
+ * token_bucket::take -- Take tokens from the bucket
+ *
+ * Parameters
+ * 	now -- The current CLOCK_MONOTONIC time
+ * 	count -- Number of tokens to take
+ *
+ * Returns
+ * 	true if there were enough tokens (they are gone now)
+ * 	false if the action should be suppressed
+ */
+bool token_bucket::take(const struct timespec& now, const double count)
+{
+    if (per_second <= 0.0)
+	return (true);
+
+    if ((last.tv_sec != 0) || (last.tv_nsec != 0)) {
+	tokens += per_second * (ms_between(last, now) / 1000.0);
+	if (tokens > burst)
+	    tokens = burst;
+    }
+    last = now;
+
+    if (tokens < count)
+	return (false);
+    tokens -= count;
+    return (true);
+}
+
+/*
+ * token_bucket::wait_ms -- How long until the next take will work
+ *
+ * Parameters
+ * 	now -- The current CLOCK_MONOTONIC time
+ *
+ * Returns
+ * 	Milliseconds until there is a token (0 if there is one now)
+ */
+long int token_bucket::wait_ms(const struct timespec& now) const
+{
+    if (per_second <= 0.0)
+	return (0);
+
+    double have = tokens;	// Tokens we would have now
+    if ((last.tv_sec != 0) || (last.tv_nsec != 0))
+	have += per_second * (ms_between(last, now) / 1000.0);
+    if (have >= 1.0)
+	return (0);
+    return (static_cast<long int>((1.0 - have) / per_second * 1000.0) + 1);
+}
+/*
+ * ms_between -- Compute the time between two times
+ *
+ * Parameters
+ * 	start, end -- The times
+ *
+ * Returns
+ * 	end - start in milliseconds
+ */
+long int ms_between(const struct timespec& start, const struct timespec& end)
+{
+    return ((end.tv_sec - start.tv_sec) * 1000L + (end.tv_nsec - start.tv_nsec) / 1000000L);
+}
@@ -0,0 +1,40 @@
+/*
+ * limit -- Token bucket rate limiter
+ *
+ * The bucket holds up to "burst" tokens and gains "per_minute"
+ * tokens a minute.  Each action takes a token.  When the bucket is
+ * empty the action is suppressed.
+ *
+ * A full bucket lets a normal burst through with no delay at all,
+ * so a single press never feels slower.  Only a sustained storm of
+ * presses gets cut down to the refill rate.
+ *
+ * Not thread safe.  Each bucket must be used by one thread.
+ */
+#ifndef __LIMIT_H__
+#define __LIMIT_H__
+
+#include <time.h>
+
+class token_bucket {
+    private:
+	double per_second;	// Tokens added each second (0 means no limit)
+	double burst;		// The most tokens we can hold
+	double tokens;		// Tokens we have now
+	struct timespec last;	// CLOCK_MONOTONIC time we last added tokens
+    public:
+	token_bucket(const double per_minute = 0.0, const double _burst = 1.0) {
+	    set(per_minute, _burst);
+	}
+	// Copy constructor defaults
+	// Assignment operator defaults
+	// Destructor defaults
+    public:
+	void set(const double per_minute, const double _burst);
+	bool take(const struct timespec& now, const double count = 1.0);
+	long int wait_ms(const struct timespec& now) const;
+};
+
+// Milliseconds between two CLOCK_MONOTONIC times
+extern long int ms_between(const struct timespec& start, const struct timespec& end);
+#endif // __LIMIT_H__
@@ -0,0 +1,600 @@
+/*
+ * mcp2200 -- Routines to talk to the MCP2200 USB GPIO device
+ *
+ * Written 2014 by Steve Oualline
+ * Placed in the public domain by Steve Oualline
+ * oualline@www.oualline.com
+ */
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+#include <cstdlib>
+#include <list>
+#include <cstring>
+#include <syslog.h>
+
+#include "mcp2200.h"
+
+/*
+ * get_serial_list -- Get list of serial numbers for the devices on the system
+ */
+std::list<std::string> mcp2200_t::get_serial_list(void)
+{
+    std::list<std::string> result;		// List of serial numbers returned
+    libusb_device **devs;			// The devices return by lsusb 
+
+    // Get the devices from the item
+    int cnt = libusb_get_device_list(NULL, &devs);
+    if (cnt < 0) {
+	throw (mcp2200_error_t(__FILE__, __LINE__, cnt, "Unable to get a list of devices"));
+    }
+
+    // Loop through each device to see if it is a mcp2200
+    for(int i = 0; i < cnt; i++) {
+	// Usb device descriptor
+	struct libusb_device_descriptor desc;
+
+	// Get the device description
+	int usb_result = libusb_get_device_descriptor(devs[i], &desc);
+	if (usb_result < 0) {
+	    throw (mcp2200_error_t(__FILE__, __LINE__, usb_result, "Unable to get device information"));
+	} else {
+	    if ((MCP2200_VENDOR_ID == desc.idVendor) &&
+		(MCP2200_PRODUCT_ID == desc.idProduct)) {
+		if (desc.iSerialNumber > 0) {
+		    libusb_device_handle *handle;
+		    int res = libusb_open(devs[i], &handle);
+		    if (res < 0) {
+			throw (mcp2200_error_t(__FILE__, __LINE__, res, "Unable to open device"));
+		    }
+		    unsigned char serial[100] = {0};
+		    ssize_t serial_len = libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, serial, sizeof(serial)-1);
+		    serial[serial_len] = '\0';
+		    result.push_back(reinterpret_cast<char*>(serial));
+		    libusb_close(handle);
+		}
+	    }
+	}
+    }
+    libusb_free_device_list(devs, 1);
+    return result;
+}
+/*
+ * mcp2200_t::mcp2200_t -- Open a given mcp2200 device
+ *
+ * Parameters
+ * 	serial -- Serial number to use for opening the device
+ */
+mcp2200_t::mcp2200_t(const std::string& dev_serial):
+    handle(NULL), out_transfer(NULL), in_transfer(NULL), 
+    async_busy(false), async_done(NULL), async_data(NULL),
+    led_transfer(NULL), led_busy(false), led_dirty(false)
+{
+    //TODO: Need to make sure libusb is initialized
+    libusb_device **devs;	// The devices return by lsusb
+
+    // Get the devices from the item
+    int cnt = libusb_get_device_list(NULL, &devs);
+    if (cnt < 0) {
+	throw (mcp2200_error_t(__FILE__, __LINE__, cnt, "Unable to get a list of devices"));
+    }
+
+    for(int i = 0; i < cnt; i++){
+	// Usb device descriptor
+	struct libusb_device_descriptor desc;
+
+	// Get the device description
+	int result = libusb_get_device_descriptor(devs[i], &desc);
+	if (result < 0) {
+	    throw (mcp2200_error_t(__FILE__, __LINE__, result, "Unable to get device information"));
+	} else {
+	    if ((MCP2200_VENDOR_ID == desc.idVendor) &&
+		(MCP2200_PRODUCT_ID == desc.idProduct)) {
+		if (desc.iSerialNumber > 0) {
+		    int res = libusb_open(devs[i], &handle);
+		    if (res < 0) {
+			throw (mcp2200_error_t(__FILE__, __LINE__, result, "Unable to open device"));
+		    }
+		    unsigned char serial[100] = {0};	// Serial number as a bunch of characters
+		    // Get the serial number of the device (and it's length)
+		    ssize_t serial_len = libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, serial, sizeof(serial)-1);
+		    serial[serial_len] = '\0';
+
+		    // See if this is our serial number
+		    if (strcmp(reinterpret_cast<char*>(serial), dev_serial.c_str()) == 0) {
+			break;
+		    }
+		    // Not the one we wanted
+		    libusb_close(handle);
+		    handle = NULL;
+		}
+	    }
+	}
+    }
+    libusb_free_device_list(devs, 1);
+
+    // With more than one device attached the last one we looked at
+    // may not be ours
+    if (handle == NULL)
+	throw (mcp2200_error_t(__FILE__, __LINE__, 0, "No such serial number"));
+
+    libusb_detach_kernel_driver(handle, MCP2200_HID_INTERFACE);
+    // Claim HID interface
+    int result = libusb_claim_interface(handle, MCP2200_HID_INTERFACE);
+    if (result != 0){
+	throw (mcp2200_error_t(__FILE__, __LINE__, 0, "No such serial number"));
+    }
+    // We don't claim the CDC interface as this is just about the HID interface
+}
+/*
+ * mcp2200_t::configure -- Configure the device
+ *
+ * Parameters
+ * 	config_cmd_t -- The configuration to use
+ */
+void mcp2200_t::configure(const mcp2200_t::config_cmd_t& config_data)
+{
+    int write_size = 0;	// Number of bytes transfered
+
+    int result = libusb_claim_interface(handle, MCP2200_HID_INTERFACE);
+    if (result != 0) {
+	syslog(LOG_ERR, "CONFIGURE claim interface result %d", result);
+	throw(mcp2200_error_t(__FILE__, __LINE__, result, "Claim of interface failure"));
+    }
+    // Send the configuration command.   Get the result of the transfer
+    result = libusb_interrupt_transfer(
+	    handle, 
+	    MCP2200_HID_ENDPOINT_OUT, 
+	    const_cast<unsigned char*>(config_data.get_data()), 
+	    config_data.get_data_size(), 
+	    &write_size, 
+	    MCP2200_HID_TRANSFER_TIMEOUT);
+
+    libusb_release_interface(handle, MCP2200_HID_INTERFACE);
+
+    if (result != 0) {
+	throw(mcp2200_error_t(__FILE__, __LINE__, result, "USB write error with configuration"));
+    }
+	
+    if (write_size != config_data.get_data_size()) {
+	throw(mcp2200_error_t(__FILE__, __LINE__, 0, "Write of configuration data failed"));
+    }
+}
+/*
+ * mcp2200_t::read_all -- Do a read_all on the device
+ *
+ */
+mcp2200_t::read_all_response_t mcp2200_t::read_all()
+{
+    int result = libusb_claim_interface(handle, MCP2200_HID_INTERFACE);
+    if (result != 0) {
+	syslog(LOG_ERR, "READ_ALL claim interface result %d", result);
+	throw(mcp2200_error_t(__FILE__, __LINE__, result, "Claim of interface failure"));
+    }
+
+    // Command to read all values
+    static const unsigned char read_all_cmd[16] = {
+	MCP2200_HID_COMMAND_READ_ALL,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+
+    int write_size = 0;	// Number of bytes transfered
+
+    // Send the read all command -- get the result of the transfer
+    result = libusb_interrupt_transfer(
+	    handle, 
+	    MCP2200_HID_ENDPOINT_OUT, 
+	    const_cast<unsigned char*>(read_all_cmd), 
+	    sizeof(read_all_cmd), 
+	    &write_size, 
+	    MCP2200_HID_TRANSFER_TIMEOUT);
+
+    if (result != 0) {
+	throw(mcp2200_error_t(__FILE__, __LINE__, result, "USB write error with readall command"));
+    }
+	
+    if (write_size != sizeof(read_all_cmd)) {
+	throw(mcp2200_error_t(__FILE__, __LINE__, 0, "Write of readall command failed"));
+    }
+    mcp2200_t::read_all_response_t response;	// The response 
+
+    // Read the response and check result
+    result = libusb_interrupt_transfer(
+	    handle, 
+	    MCP2200_HID_ENDPOINT_IN, 
+	    const_cast<unsigned char*>(response.get_data()), 
+	    response.get_data_size(), 
+	    &write_size, 
+	    MCP2200_HID_TRANSFER_TIMEOUT
+	);
+
+    if (result != 0) {
+	throw(mcp2200_error_t(__FILE__, __LINE__, result, "USB read error with readall command"));
+    }
+    libusb_release_interface(handle, MCP2200_HID_INTERFACE);
+	
+    if (write_size != response.get_data_size()) {
+	throw(mcp2200_error_t(__FILE__, __LINE__, 0, "Read of readall command failed"));
+    }
+    return (response);
+}
+/*
+ * set_clear_all -- Do a set clear all command
+ *
+ * Parameters
+ * 	set_clear_param -- Bits to set or clear
+ */
+void mcp2200_t::set_clear_all(set_clear_all_t& set_clear_param)
+{
+    int write_size = 0;	// Number of bytes transfered
+
+    int result = libusb_claim_interface(handle, MCP2200_HID_INTERFACE);
+    if (result != 0) {
+	syslog(LOG_ERR, "SET_CLEAR_ALL claim interface result %d", result);
+	throw(mcp2200_error_t(__FILE__, __LINE__, result, "Claim of interface failure"));
+    }
+
+    result = libusb_interrupt_transfer(
+	    handle, 
+	    MCP2200_HID_ENDPOINT_OUT, 
+	    const_cast<unsigned char*>(set_clear_param.get_data()), 
+	    set_clear_param.get_data_size(), 
+	    &write_size, 
+	    MCP2200_HID_TRANSFER_TIMEOUT);
+
+    libusb_release_interface(handle, MCP2200_HID_INTERFACE);
+
+    if (result != 0) {
+	throw(mcp2200_error_t(__FILE__, __LINE__, result, "USB write error with set_clear_all command"));
+    }
+	
+    if (write_size != set_clear_param.get_data_size()) {
+	throw(mcp2200_error_t(__FILE__, __LINE__, 0, "Write of set_clear_all command failed"));
+    }
+}
+/*
+ * mcp2200_t::~mcp2200_t -- Close the device
+ *
+ * Any asynchronous request still in flight is cancelled and we
+ * wait for libusb to hand the transfers back before freeing them.
+ */
+mcp2200_t::~mcp2200_t()
+{
+    led_dirty = false;
+    if (led_busy)
+	libusb_cancel_transfer(led_transfer);
+    if (async_busy) {
+	async_done = NULL;
+	libusb_cancel_transfer(out_transfer);
+	libusb_cancel_transfer(in_transfer);
+    }
+    while (async_busy || led_busy) {
+	struct timeval timeout = {0, 100000};	// Wait 1/10 second for the cancel
+	int completed = 0;			// Ignored
+	if (libusb_handle_events_timeout_completed(NULL, &timeout, &completed) != 0)
+	    break;
+    }
+    if (out_transfer != NULL)
+	libusb_free_transfer(out_transfer);
+    if (in_transfer != NULL)
+	libusb_free_transfer(in_transfer);
+    if (led_transfer != NULL)
+	libusb_free_transfer(led_transfer);
+    if (handle != NULL)
+	libusb_close(handle);
+}
+/*
+ * mcp2200_t::async_setup -- Get ready for asynchronous transfers
+ *
+ * The interface is claimed once and kept -- it must stay ours
+ * while transfers are queued.  (So don't mix the synchronous
+ * calls, which release it, with the asynchronous ones.)
+ */
+void mcp2200_t::async_setup(void)
+{
+    if (out_transfer != NULL)
+	return;
+
+    int result = libusb_claim_interface(handle, MCP2200_HID_INTERFACE);
+    if (result != 0) {
+	syslog(LOG_ERR, "ASYNC claim interface result %d", result);
+	throw(mcp2200_error_t(__FILE__, __LINE__, result, "Claim of interface failure"));
+    }
+    out_transfer = libusb_alloc_transfer(0);
+    in_transfer = libusb_alloc_transfer(0);
+    led_transfer = libusb_alloc_transfer(0);
+    if ((out_transfer == NULL) || (in_transfer == NULL) || (led_transfer == NULL))
+	throw(mcp2200_error_t(__FILE__, __LINE__, 0, "Unable to allocate transfer"));
+}
+/*
+ * mcp2200_t::async_read_all -- Start a read all without waiting for it
+ *
+ * The READ_ALL command is sent out the OUT endpoint.  When that
+ * finishes the response is collected from the IN endpoint and
+ * the done function is called.   Both steps happen inside 
+ * libusb_handle_events*, so the caller must be running an event loop.
+ *
+ * Parameters
+ * 	done -- Function to call when the response arrives
+ * 	data -- Data passed to the done function
+ */
+void mcp2200_t::async_read_all(read_all_done_t done, void* const data)
+{
+    // Command to read all values
+    static unsigned char read_all_cmd[16] = {
+	MCP2200_HID_COMMAND_READ_ALL,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+
+    if (async_busy)
+	throw(mcp2200_error_t(__FILE__, __LINE__, 0, "Asynchronous read all already in progress"));
+
+    async_setup();
+    async_done = done;
+    async_data = data;
+
+    libusb_fill_interrupt_transfer(out_transfer, handle, MCP2200_HID_ENDPOINT_OUT,
+	    read_all_cmd, sizeof(read_all_cmd), async_out_done, this, 
+	    MCP2200_HID_TRANSFER_TIMEOUT);
+
+    int result = libusb_submit_transfer(out_transfer);
+    if (result != 0)
+	throw(mcp2200_error_t(__FILE__, __LINE__, result, "USB submit error with readall command"));
+    async_busy = true;
+}
+/*
+ * mcp2200_t::async_out_done -- The read all command went out, go get the answer
+ */
+void LIBUSB_CALL mcp2200_t::async_out_done(struct libusb_transfer* transfer)
+{
+    mcp2200_t* device = static_cast<mcp2200_t*>(transfer->user_data);
+
+    if ((transfer->status != LIBUSB_TRANSFER_COMPLETED) ||
+	(transfer->actual_length != transfer->length)) {
+	device->async_finish(false);
+	return;
+    }
+    libusb_fill_interrupt_transfer(device->in_transfer, device->handle, 
+	    MCP2200_HID_ENDPOINT_IN,
+	    const_cast<unsigned char*>(device->async_response.get_data()), 
+	    device->async_response.get_data_size(), 
+	    async_in_done, device, MCP2200_HID_TRANSFER_TIMEOUT);
+
+    if (libusb_submit_transfer(device->in_transfer) != 0)
+	device->async_finish(false);
+}
+/*
+ * mcp2200_t::async_in_done -- The response to the read all came in
+ */
+void LIBUSB_CALL mcp2200_t::async_in_done(struct libusb_transfer* transfer)
+{
+    mcp2200_t* device = static_cast<mcp2200_t*>(transfer->user_data);
+
+    device->async_finish((transfer->status == LIBUSB_TRANSFER_COMPLETED) &&
+	    (transfer->actual_length == transfer->length));
+}
+/*
+ * mcp2200_t::async_finish -- Tell the user the asynchronous read is done
+ *
+ * Parameters
+ * 	ok -- True if we have a good response
+ */
+void mcp2200_t::async_finish(const bool ok)
+{
+    async_busy = false;
+    if (async_done != NULL)
+	async_done(*this, ok ? &async_response : NULL, async_data);
+}
+/*
+ * mcp2200_t::async_set_clear_all -- Send a set / clear without waiting
+ *
+ * Only one set / clear is on the wire at a time.  If one is in
+ * flight this one is held and sent when it finishes.  Anything
+ * newer that shows up before then replaces it, so a burst of
+ * changes goes out as at most two transfers.  The device does not
+ * answer a set / clear, so there is nothing to read back.
+ *
+ * Parameters
+ * 	set_clear_param -- The command to send
+ */
+void mcp2200_t::async_set_clear_all(const set_clear_all_t& set_clear_param)
+{
+    async_setup();
+    led_next = set_clear_param;
+    led_dirty = true;
+    if (!led_busy)
+	led_submit();
+}
+/*
+ * mcp2200_t::led_submit -- Put the pending set / clear on the wire
+ */
+void mcp2200_t::led_submit(void)
+{
+    led_sending = led_next;
+    led_dirty = false;
+
+    libusb_fill_interrupt_transfer(led_transfer, handle, MCP2200_HID_ENDPOINT_OUT,
+	    const_cast<unsigned char*>(led_sending.get_data()), led_sending.get_data_size(),
+	    led_done, this, MCP2200_HID_TRANSFER_TIMEOUT);
+
+    int result = libusb_submit_transfer(led_transfer);
+    if (result != 0) {
+	syslog(LOG_ERR, "ASYNC_SET_CLEAR_ALL submit result %d", result);
+	return;
+    }
+    led_busy = true;
+}
+/*
+ * mcp2200_t::led_done -- A set / clear went out, send the next one if any
+ */
+void LIBUSB_CALL mcp2200_t::led_done(struct libusb_transfer* transfer)
+{
+    mcp2200_t* device = static_cast<mcp2200_t*>(transfer->user_data);
+
+    device->led_busy = false;
+    if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED)
+	    return;
+	syslog(LOG_WARNING, "ASYNC_SET_CLEAR_ALL status %d", transfer->status);
+    }
+    if (device->led_dirty)
+	device->led_submit();
+}
+/*
+ * mcp2200_config::toString -- Turn configuration into a string
+ */
+std::string mcp2200_t::read_all_response_t::toString(void)
+{
+    std::ostringstream output;	// Output string
+    for (unsigned i = 0; i < sizeof(read_all_response_data.data); ++i) {
+	output << std::setw(2) << i << ": " << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(read_all_response_data.data[i]) << " ";
+	output << std::setw(0) << std::setfill(' ') << std::dec;
+
+	switch (i) {
+	    case 0: 
+		output << "Read all";
+		break;
+	    case 1:
+		output << "EEPROM Location";
+		break;
+	    case 3:
+		output << "EEPROM Value";
+		break;
+	    case 4:
+		output << "IO Bitmap";
+		break;
+	    case 5:
+		output << "Config_Alt_Pins (";
+		if ((read_all_response_data.response.config_alt_pins & ALT_SSPND) != 0)
+		    output << "SSPND ";
+		if ((read_all_response_data.response.config_alt_pins & ALT_USBCFG) != 0)
+		    output << "USBCFG ";
+		if ((read_all_response_data.response.config_alt_pins & ALT_RxLED) != 0)
+		    output << "RxLED ";
+		if ((read_all_response_data.response.config_alt_pins & ALT_TxLED) != 0)
+		    output << "TxLED ";
+		output << ")";
+		break;
+	    case 6:
+		output << "Default IO Bitmap";
+		break;
+	    case 7:
+		output << "Config Alt Options (";
+		if ((read_all_response_data.response.config_alt_options & ALT_OPT_RxTGL) != 0) 
+		    output << "RxTGL ";
+		if ((read_all_response_data.response.config_alt_options & ALT_OPT_TxTGL) != 0) 
+		    output << "TxTGL ";
+		if ((read_all_response_data.response.config_alt_options & ALT_OPT_LEDX) != 0) 
+		    output << "LEDX ";
+		if ((read_all_response_data.response.config_alt_options & ALT_OPT_INVERT) != 0) 
+		    output << "INVERT ";
+		if ((read_all_response_data.response.config_alt_options & ALT_OPT_HW_FLOW) != 0) 
+		    output << "HW_FLOW ";
+		output << ")";
+		break;
+	    case 8:
+		output << "Baud H";
+		break;
+	    case 9:
+		output << "Baud L";
+		break;
+	    case 10:
+		output << "GPIO Bitmap";
+		break;
+	    case 2:
+	    case 11:
+	    case 12:
+	    case 13:
+	    case 14:
+	    case 15:
+		output << "Don't care";
+		break;
+	    default:
+		output << "Internal error";
+		break;
+	}
+	output << std::endl;
+    }
+    int baud_rate_divisor = read_all_response_data.response.baud_h << 8 | read_all_response_data.response.baud_l;
+    int baud = 12000000 / (baud_rate_divisor + 1);
+    output << "Baud Rate Divisor " << baud_rate_divisor << " Rate: " << baud << std::endl;
+    return (output.str());
+}
+
+/*
+ * mcp2200_config::toString -- Turn configuration into a string
+ */
+std::string mcp2200_t::config_cmd_t::toString(void)
+{
+    std::ostringstream output;	// Output string
+    for (unsigned i = 0; i < sizeof(config_cmd.data); ++i) {
+	output << std::setw(2) << i << ": " << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(config_cmd.data[i]) << " ";
+	output << std::setw(0) << std::setfill(' ') << std::dec;
+
+	switch (i) {
+	    case 0: 
+		output << "CONFIGURE command";
+		break;
+	    case 1:
+	    case 2:
+	    case 3:
+	    case 10:
+	    case 11:
+	    case 12:
+	    case 13:
+	    case 14:
+	    case 15:
+		output << "Don't care";
+		break;
+	    case 4:
+		output << "IO Bitmap";
+		break;
+	    case 5:
+		output << "Config_Alt_Pins (";
+		if ((config_cmd.cmd.config_alt_pins & ALT_SSPND) != 0)
+		    output << "SSPND ";
+		if ((config_cmd.cmd.config_alt_pins & ALT_USBCFG) != 0)
+		    output << "USBCFG ";
+		if ((config_cmd.cmd.config_alt_pins & ALT_RxLED) != 0)
+		    output << "RxLED ";
+		if ((config_cmd.cmd.config_alt_pins & ALT_TxLED) != 0)
+		    output << "TxLED ";
+		output << ")";
+		break;
+	    case 6:
+		output << "Default IO Bitmap";
+		break;
+	    case 7:
+		output << "Config Alt Options (";
+		if ((config_cmd.cmd.config_alt_options & ALT_OPT_RxTGL) != 0) 
+		    output << "RxTGL ";
+		if ((config_cmd.cmd.config_alt_options & ALT_OPT_TxTGL) != 0) 
+		    output << "TxTGL ";
+		if ((config_cmd.cmd.config_alt_options & ALT_OPT_LEDX) != 0) 
+		    output << "LEDX ";
+		if ((config_cmd.cmd.config_alt_options & ALT_OPT_INVERT) != 0) 
+		    output << "INVERT ";
+		if ((config_cmd.cmd.config_alt_options & ALT_OPT_HW_FLOW) != 0) 
+		    output << "HW_FLOW ";
+		output << ")";
+		break;
+	    case 8:
+		output << "Baud H";
+		break;
+	    case 9:
+		output << "Baud L";
+		break;
+	    default:
+		output << "Internal error";
+		break;
+	}
+	output << std::endl;
+    }
+    // Compute the baud rate divisor
+    int baud_rate_divisor = config_cmd.cmd.baud_h << 8 | config_cmd.cmd.baud_l;
+
+    // Now get the baud rate
+    int baud = 12000000 / (baud_rate_divisor + 1);
+    output << "Baud Rate Divisor " << baud_rate_divisor << " Rate: " << baud << std::endl;
+    return (output.str());
+}
+
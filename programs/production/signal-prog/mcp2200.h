@@ -0,0 +1,440 @@
+/*
+ * mcp2200.h -- Interface to the MCP2200 USB GPIO device
+ *
+ * Written 2014 by Steve Oualline
+ * Placed in the public domain by Steve Oualline
+ * oualline@www.oualline.com
+ *
+ * mcp2200_t -- Class for handling the mcp device
+ *
+ * Member function
+ * 	get_serial_list -- Get a list of the serial numbers of the attached devices.
+ * 		(static function so can be called without a class instance)
+ *
+ * 	mcp2200_t(serial) -- Create a class for this specific device
+ * 	configure(config_data) -- Configure the device
+ * 	read_all_response_t = read_all() -- Do a read all and get the response
+ * 	set_class_all(set_clear_all_t) -- Do a set/clear
+ * 	async_read_all(done, data) -- Start a read all, call done when it arrives
+ * 	async_set_clear_all(set_clear_all_t) -- Send a set/clear without waiting
+ * 		(changes made while one is in flight are merged into the next)
+ *
+ * mcp2200_sampler_t -- Adaptive read rate (fast when pins change, slow when idle)
+ * 	next(changed) -- Time to wait before the next read
+ *
+ * Embedded classes
+ * ================
+ *
+ * config_cmd_t -- Configuration commmand block
+ * 	set_io_bmp -- Set the io_bmp config field
+ * 	set_config_alt_pins -- Set the config_alt_pins config field
+ * 	set_io_default_val_bmap -- Set the io_default_val_bmap config field
+ * 	set_config_alt_options -- Set the config_alt_options config field
+ * 	set_baud -- Set the baud rate
+ * 	toString -- Produce string from configuration data
+ *
+ * read_all_response_t -- Response to the read-all command
+ * 	get_EEP_Addr -- Return the EEP_Addr value
+ * 	get_EEP_Value -- Return the EEP_Value value
+ * 	get_IO_bmp -- Return the IO_bmp value
+ * 	get_Config_Alt_Pins -- Return the Config_Alt_Pins value
+ * 	get_IO_Default-Val_bmap -- Return the IO_Default-Val_bmap value
+ * 	get_Config_Alt_Options -- Return the Config_Alt_Options value
+ * 	get_Baud -- Return the baud rate divisor
+ * 	get_IO_Port_Val_bmap -- Return the IO_Porty_Val_bmap value
+ * 	toString -- Produce string value from the result
+ *
+ * set_clear_all_t -- Set/Clear all command
+ * 	set -- Set GPIO bits
+ * 	clear -- Clear GPIO bits
+ */
+#ifndef __MCP2200_H__
+#define __MCP2200_H__
+
+#include <string>
+#include <list>
+
+#include <cstring>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <libusb-1.0/libusb.h>
+
+// Timeout for transfers
+#define MCP2200_HID_TRANSFER_TIMEOUT 50000
+
+/*
+ * mcp2200_error_t -- Throw this when an error occurs
+ */
+class mcp2200_error_t {
+    public:
+	const char* const file;	// File name where error occurred
+	const int line;		// Line number where error occurred
+	const int usb_error;	// USB error message
+	const std::string msg;	// Error string from the suer
+    public:
+	mcp2200_error_t(const char* const _file, const int _line, const int _usb_error, const std::string& _msg):
+	    file(_file), line(_line), usb_error(_usb_error), msg(_msg) 
+	{}
+};
+
+/*
+ * mcp2200_t -- Class for handling the mcp device
+ */
+class mcp2200_t {
+    public:
+	// Product id for the USB id list
+	static const uint16_t MCP2200_VENDOR_ID	= 0x04d8;
+	static const uint16_t MCP2200_PRODUCT_ID = 0x00df;
+    private:
+	// Interfaces defined on the device
+	static const uint8_t MCP2200_CDC_INTERFACE = 1;
+	static const uint8_t MCP2200_HID_INTERFACE = 2;
+
+	static const uint8_t MCP2200_HID_ENDPOINT_IN = 0x81;
+	static const uint8_t MCP2200_HID_ENDPOINT_OUT = 0x01;
+
+	// Commands are defined by the "MCP2200 HID Interface Command Description" document
+	static const uint8_t MCP2200_HID_COMMAND_SET_CLEAR_OUTPUT = 0x08u;	// Set / Clear output bits
+	static const uint8_t MCP2200_HID_COMMAND_CONFIGURE = 	    0x10u;	// Configure the device
+	static const uint8_t MCP2200_HID_COMMAND_READ_EE = 	    0x20u;	// Read EE prom
+	static const uint8_t MCP2200_HID_COMMAND_WRITE_EE = 	    0x40u;	// Write EE prom
+	static const uint8_t MCP2200_HID_COMMAND_READ_ALL = 	    0x80u;	// Read all information
+    public:
+	// From Table 5 of the Interface Command Description
+	// Values for config_alt_pins
+	static const uint8_t ALT_SSPND = (1<<7);
+	static const uint8_t ALT_USBCFG = (1<<6);
+	static const uint8_t ALT_RxLED = (1<<3);
+	static const uint8_t ALT_TxLED = (1<<2);
+	// Value for config_alt_options
+	// From table 6 of the Interface Command Description
+	static const uint8_t ALT_OPT_RxTGL = (1<<7);
+	static const uint8_t ALT_OPT_TxTGL = (1<<6);
+	static const uint8_t ALT_OPT_LEDX = (1<<5);
+	static const uint8_t ALT_OPT_INVERT = (1<<1);
+	static const uint8_t ALT_OPT_HW_FLOW = (1<<0);
+    public:
+
+	/*------------------------------------------------------*/
+	// Configuration command data
+	class config_cmd_t {
+	    private:
+		// Table 4 in the Command Description document
+		struct config_cmd {
+		    uint8_t cmd;	// [0] Command (0x10)
+		    uint8_t dc1;	// [1] Don't care
+		    uint8_t dc2;	// [2] Don't care
+		    uint8_t dc3;	// [3] Don't care
+		    uint8_t io_bmp;	// [4] GPIO bitmap for pin assignment
+		    uint8_t config_alt_pins;	// [5] Alternate configuration pin settings
+		    uint8_t io_default_val_bmap;	//[6] Default GPIO value bitmap
+		    uint8_t config_alt_options;	//[7] Alternateve function options
+		    uint8_t baud_h;	//[8] Baud rate (high)
+		    uint8_t baud_l;	//[9] Baud rate (low)
+		    uint8_t dc10;	//[10] Don't care
+		    uint8_t dc11;	//[11] Don't care
+		    uint8_t dc12;	//[12] Don't care
+		    uint8_t dc13;	//[13] Don't care
+		    uint8_t dc14;	//[14] Don't care
+		    uint8_t dc15;	//[15] Don't care
+		};
+		// The command as a union
+		union {
+		    struct config_cmd cmd;
+		    unsigned char data[16];
+		} config_cmd;
+	    public:
+		config_cmd_t(void) {
+		    memset(&config_cmd, '\0', sizeof(config_cmd));
+		    config_cmd.cmd.cmd = 0x10;
+		    set_baud(9600);
+		}
+		// Copy constructor defaults
+		// Assignement operator defaults
+		// Destructor defaults
+	    public:
+		void set_io_bmp(const uint8_t io_bmp) {
+		    config_cmd.cmd.io_bmp = io_bmp;
+		}
+		void set_config_alt_pins(const uint8_t config_alt_pins) {
+		    config_cmd.cmd.config_alt_pins = config_alt_pins;
+		}
+		void set_io_default_val_bmap(const uint8_t io_default_val_bmap) {
+		    config_cmd.cmd.io_default_val_bmap = io_default_val_bmap;
+		}
+		void set_config_alt_options(const uint8_t config_alt_options) {
+		    config_cmd.cmd.config_alt_options = config_alt_options;
+		}
+		void set_baud(const unsigned int rate) {
+		    uint16_t rate_code = (12000000 / rate) - 1;
+		    config_cmd.cmd.baud_h = (rate_code >> 8) & 0xFF;
+		    config_cmd.cmd.baud_l = rate_code & 0xFF;
+		}
+		unsigned int get_IO_bmap(void) {
+		    return (config_cmd.cmd.io_bmp);
+		}
+		unsigned int get_Config_Alt_Pins(void) {
+		    return (config_cmd.cmd.config_alt_pins);
+		}
+		unsigned int get_IO_Default_Val_bmap(void) {
+		    return (config_cmd.cmd.io_default_val_bmap);
+		}
+		unsigned int get_Config_Alt_Options(void) {
+		    return (config_cmd.cmd.config_alt_options);
+		}
+		unsigned int get_Baud(void) {
+		    return (config_cmd.cmd.baud_h << 8 | config_cmd.cmd.baud_l);
+		}
+	    private:
+		const unsigned char* get_data(void) const {
+		    return (config_cmd.data);
+		}
+		ssize_t get_data_size(void) const {
+		    return (sizeof(config_cmd.data));
+		}
+		// Let our parent in on this
+		friend class mcp2200_t;
+	    public:
+		std::string toString(void);
+	};
+	/*------------------------------------------------------*/
+	/*------------------------------------------------------*/
+
+	// Response to the read all command
+	class read_all_response_t {
+	    private:
+		// Table 12 in the Command Description document
+		struct read_all_struct {
+		    uint8_t cmd;	// [0] Command (0x10)
+		    uint8_t eep_addr;	// [1] EEProm address
+		    uint8_t dc2;	// [2] Don't care
+		    uint8_t eep_value;	// [3] EEProm value
+		    uint8_t io_bmp;	// [4] GPIO bitmap for pin assignment
+		    uint8_t config_alt_pins;	// [5] Alternate configuration pin settings
+		    uint8_t io_default_val_bmap;	//[6] Default GPIO value bitmap
+		    uint8_t config_alt_options;	//[7] Alternateve function options
+		    uint8_t baud_h;	//[8] Baud rate (high)
+		    uint8_t baud_l;	//[9] Baud rate (low)
+		    uint8_t io_port_val_bmap;	//[10] IP Port value bitmap
+		    uint8_t dc11;	//[11] Don't care
+		    uint8_t dc12;	//[12] Don't care
+		    uint8_t dc13;	//[13] Don't care
+		    uint8_t dc14;	//[14] Don't care
+		    uint8_t dc15;	//[15] Don't care
+		};
+		// The command as a union
+		union {
+		    struct read_all_struct response;
+		    unsigned char data[16];
+		} read_all_response_data;
+	    public:
+		unsigned int get_EEP_Addr(void) const {
+		    return (read_all_response_data.response.eep_addr);
+		}
+		unsigned int get_EEP_Value(void) const {
+		    return (read_all_response_data.response.eep_value);
+		}
+		unsigned int get_IO_bmap(void) const {
+		    return (read_all_response_data.response.io_bmp);
+		}
+		unsigned int get_Config_Alt_Pins(void) const {
+		    return (read_all_response_data.response.config_alt_pins);
+		}
+		unsigned int get_IO_Default_Val_bmap(void) const {
+		    return (read_all_response_data.response.io_default_val_bmap);
+		}
+		unsigned int get_Config_Alt_Options(void) const {
+		    return (read_all_response_data.response.config_alt_options);
+		}
+		unsigned int get_Baud(void) const {
+		    return (read_all_response_data.response.baud_h << 8 | read_all_response_data.response.baud_l);
+		}
+		unsigned int get_IO_Port_Val_bmap(void) const {
+		    return (read_all_response_data.response.io_port_val_bmap);
+		}
+	    public:
+		read_all_response_t(void) {
+		    memset(&read_all_response_data, '\0', sizeof(read_all_response_data));
+		}
+		// Copy constructor defaults
+		// Assignment operator defaults
+		// Destructor defaults
+	    private:
+		const unsigned char* get_data(void) const {
+		    return (read_all_response_data.data);
+		}
+		ssize_t get_data_size(void) const {
+		    return (sizeof(read_all_response_data.data));
+		}
+		friend class mcp2200_t;
+	    public:
+		std::string toString(void);
+	};
+	/*------------------------------------------------------*/
+	/*------------------------------------------------------*/
+
+	// Data for the set / clear all command
+	class set_clear_all_t {
+	    private:
+		// Table 3 in the Command Description document
+		struct set_clear_struct {
+		    uint8_t cmd;	// [0] Command (0x08)
+		    uint8_t dc1;	// [1] Don't care
+		    uint8_t dc2;	// [2] Don't care
+		    uint8_t dc3;	// [3] Don't care
+		    uint8_t dc4;	// [4] Don't care
+		    uint8_t dc5;	// [5] Don't care
+		    uint8_t dc6;	// [6] Don't care
+		    uint8_t dc7;	// [7] Don't care
+		    uint8_t dc8;	// [8] Don't care
+		    uint8_t dc9;	// [9] Don't care
+		    uint8_t dc10;	// [10] Don't care
+		    uint8_t set_bmap;	// [11] Set bitmap
+		    uint8_t clear_bmap;	// [12] Clear bitmap
+		    uint8_t dc13;	// [13] Don't care
+		    uint8_t dc14;	// [14] Don't care
+		    uint8_t dc15;	// [15] Don't care
+		};
+		// The command as a union
+		union {
+		    struct set_clear_struct set_clear;
+		    unsigned char data[16];
+		} set_clear_data;
+	    public:
+		void set(uint8_t bits) {
+		    set_clear_data.set_clear.set_bmap |= bits;
+		    set_clear_data.set_clear.clear_bmap &= (~bits);
+		}
+		void clear(uint8_t bits) {
+		    set_clear_data.set_clear.clear_bmap |= bits;
+		    set_clear_data.set_clear.set_bmap &= (~bits);
+		}
+	    public:
+		set_clear_all_t(void) {
+		    memset(&set_clear_data, '\0', sizeof(set_clear_data));
+		    set_clear_data.set_clear.cmd = MCP2200_HID_COMMAND_SET_CLEAR_OUTPUT;
+		    set_clear_data.set_clear.clear_bmap = 0xFF;
+		    set_clear_data.set_clear.set_bmap = 0x00;
+		}
+		// Copy constructor defaults
+		// Assignment operator defaults
+		// Destructor defaults
+	    private:
+		const unsigned char* get_data(void) const {
+		    return (set_clear_data.data);
+		}
+		ssize_t get_data_size(void) const {
+		    return (sizeof(set_clear_data));
+		}
+		friend class mcp2200_t;
+	};
+	/*------------------------------------------------------*/
+	/*------------------------------------------------------*/
+
+	// Actual class begins here
+    public:
+	// Called when an asynchronous read all finishes (response is NULL on error)
+	typedef void (*read_all_done_t)(mcp2200_t& device, 
+		const read_all_response_t* const response, void* const data);
+    private:
+	libusb_device_handle *handle;	// Handle of the device we are using
+
+	// Asynchronous read all information
+	struct libusb_transfer* out_transfer;	// Transfer sending the read all command
+	struct libusb_transfer* in_transfer;	// Transfer getting the response
+	bool async_busy;			// Is an async request in progress
+	read_all_done_t async_done;		// Who to call when done
+	void* async_data;			// Data for the done function
+	read_all_response_t async_response;	// Response being filled in
+
+	// Asynchronous set / clear all
+	struct libusb_transfer* led_transfer;	// Transfer sending the set / clear
+	bool led_busy;				// Is a set / clear in flight
+	bool led_dirty;				// Is there a newer set / clear to send
+	set_clear_all_t led_sending;		// Command in flight
+	set_clear_all_t led_next;		// Command to send next
+
+	static void LIBUSB_CALL async_out_done(struct libusb_transfer* transfer);
+	static void LIBUSB_CALL async_in_done(struct libusb_transfer* transfer);
+	static void LIBUSB_CALL led_done(struct libusb_transfer* transfer);
+	void async_setup(void);
+	void async_finish(const bool ok);
+	void led_submit(void);
+    public:
+	static std::list<std::string> get_serial_list(void);
+    public:
+	mcp2200_t(const std::string& serial);
+	~mcp2200_t();
+    private:
+	mcp2200_t(const mcp2200_t&);	// No copy
+	mcp2200_t& operator = (const mcp2200_t&);	// No assignment
+    public:
+	// Configure the device
+	void configure(const config_cmd_t& config_data);
+	read_all_response_t read_all(void);
+	void set_clear_all(set_clear_all_t& set_clear_param);
+
+	// Asynchronous read all.  Events are processed by libusb_handle_events*
+	void async_read_all(read_all_done_t done, void* const data);
+	bool async_pending(void) const {
+	    return (async_busy);
+	}
+	void async_set_clear_all(const set_clear_all_t& set_clear_param);
+};
+
+/*
+ * mcp2200_sampler_t -- Decide how often to read the pins
+ *
+ * The MCP2200 can't tell us when a pin changes, so we have to ask.
+ * When the pins are changing we read back to back (one READ_ALL
+ * after another, as fast as USB will take them).  Once they have
+ * been quiet for SAMPLE_HOLD we back off, doubling the wait each
+ * time, until we are reading every SAMPLE_IDLE.
+ */
+class mcp2200_sampler_t {
+    public:
+	static const unsigned int SAMPLE_START = 2;	// First wait after backing off (ms)
+	static const unsigned int SAMPLE_IDLE = 100;	// Longest wait when nothing is going on (ms)
+	static const unsigned int SAMPLE_HOLD = 1000;	// Stay fast this long after a change (ms)
+    private:
+	unsigned int wait;		// Current wait between reads (ms, 0 = back to back)
+	unsigned int quiet;		// Time since the last change (ms, about)
+    public:
+	mcp2200_sampler_t(void): wait(0), quiet(0) {}
+	// Copy constructor defaults
+	// Assignment operator defaults
+	// Destructor defaults
+    public:
+	// Start over as if something just changed
+	void reset(void) {
+	    wait = 0;
+	    quiet = 0;
+	}
+	/*
+	 * next -- Get the time to wait before the next read
+	 *
+	 * Parameters
+	 * 	changed -- True if the last read found a change
+	 *
+	 * Returns
+	 * 	Wait in milliseconds (0 means read again right away)
+	 */
+	unsigned int next(const bool changed) {
+	    if (changed) {
+		reset();
+		return (wait);
+	    }
+	    // A back to back read takes about 2ms (one USB frame out, one in)
+	    quiet += (wait == 0) ? SAMPLE_START : wait;
+	    if (quiet < SAMPLE_HOLD)
+		return (wait);
+
+	    wait = (wait == 0) ? SAMPLE_START : wait * 2;
+	    if (wait > SAMPLE_IDLE)
+		wait = SAMPLE_IDLE;
+	    return (wait);
+	}
+};
+
+#endif // __MCP2200_H__
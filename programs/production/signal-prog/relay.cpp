@@ -1,5 +1,6 @@
 #undef RELAY_DEBUG
 #include <string>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 
@@ -12,6 +13,7 @@
 #include <poll.h>
 #include <syslog.h>
 #include <pthread.h>
+#include <assert.h>
 
 #include "relay.h"
  
@@ -23,6 +25,22 @@ static int relay_fd = -1;	// Relay fd
 
 // Mutex so we do access one operation at a time
 static pthread_mutex_t relay_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool relay_held = false;		// relay_mutex is locked
+static pthread_t relay_holder;		// Thread that has it locked
+
+// What we last told each relay to do.  Used to skip commands that
+// would not change anything (only if relay_cache(true) was called).
+// Protected by relay_mutex.
+enum class SHADOW {UNKNOWN, OFF, ON};
+static bool relay_caching = false;		// Skip commands the shadow says aren't needed
+static const int MAX_RELAYS = 16;		// Biggest board we have
+static SHADOW relay_shadow[MAX_RELAYS];	// Zero is UNKNOWN
+
+static unsigned long int relay_sent = 0;	// Relay commands sent
+static unsigned long int relay_skipped = 0;	// Relay commands not needed
+
+// Can the board set all the relays with one "relay writeall" command
+static bool relay_writeall = false;
 
 /* 
  * relay_lock -- Lock the relay system
@@ -31,15 +49,25 @@ static inline void relay_lock()
 {
     if (pthread_mutex_lock(&relay_mutex) != 0) 
 	throw relay_error("Could not lock relay system");
+    relay_holder = pthread_self();
+    relay_held = true;
 }
 /* 
  * relay_unlock -- Unlock the relay system
  */
 static inline void relay_unlock()
 {
+    relay_held = false;
     if (pthread_mutex_unlock(&relay_mutex) != 0) 
 	throw relay_error("Could not unlock relay system");
 }
+/*
+ * relay_assert_held -- Make sure the caller has the relay lock
+ */
+static inline void relay_assert_held()
+{
+    assert(relay_held && pthread_equal(relay_holder, pthread_self()));
+}
 /*
  * read_ch -- Read a single character from the relay
  * 
@@ -94,28 +122,32 @@ static void raw_relay_send(const std::string& cmd)
 }
 /*
  * raw_relay -- Do a relay command directly to the device
+ *
+ * The caller must hold the relay lock
  */
 static void raw_relay(const std::string& cmd)
 {
+    relay_assert_held();
     if (simulate) {
 	std::cout << "RAW RELAY: " << cmd << std::endl;
 	return;
     }
-    relay_lock();
     raw_relay_send(cmd);
 
     // Get the character that's a response (should be prompt)
     char ch = read_ch();
     if (ch != '>')
 	throw(relay_error("Prompt response error"));
-    relay_unlock();
 }
 /*
- * raw_relay -- Do a relay command directly to the device
+ * raw_relay_response -- Do a relay command directly to the device
+ * and get what it says
+ *
+ * The caller must hold the relay lock
  */
 static std::string raw_relay_response(const std::string& cmd)
 {
-    relay_lock();
+    relay_assert_held();
     raw_relay_send(cmd);
 
     std::string result;		// Response we expect
@@ -131,7 +163,6 @@ static std::string raw_relay_response(const std::string& cmd)
 	    ch = read_ch();
 	    if (ch != '>')
 		throw(relay_error("Prompt response error"));
-	    relay_unlock();
 #ifdef RELAY_DEBUG
 	    std::cout << "RELAY RES: " << result << std::endl;
 #endif // RELAY_DEBUG
@@ -149,7 +180,12 @@ static std::string raw_relay_response(const std::string& cmd)
  */
 void relay_reset(void)
 {
-    raw_relay("reset");// Get the version of the relay board
+    relay_lock();
+    raw_relay("reset");
+    ++relay_sent;
+    for (int i = 0; i < MAX_RELAYS; ++i)
+	relay_shadow[i] = SHADOW::OFF;
+    relay_unlock();
 
     // Sets all the GPIO pins into the read state
     for (int i = 0; i < 10; ++i) 
@@ -175,8 +211,18 @@ static const char* find_device(void)
  */
 void relay_setup(void)
 {
-    if (simulate)
+    // Real time threads share the relays with normal ones.  Don't let
+    // a normal thread holding the lock hold them up.
+    pthread_mutexattr_t attr;	// Attributes for the lock
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&relay_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    if (simulate) {
+	relay_writeall = true;	// So we can see what it would do
 	return;
+    }
 
     struct termios tio;			// Terminal settings
 
@@ -195,6 +241,9 @@ void relay_setup(void)
 
     const char* device = find_device();
 
+    // Only the 16 channel Numato board is known to do writeall
+    relay_writeall = (strcmp(device, RELAY_DEVICE2) == 0);
+
     relay_fd = open(device, O_RDWR);      
     if (relay_fd < 0) 
 	throw(relay_error("Could not open device "));
@@ -224,7 +273,9 @@ void relay_setup(void)
 	    throw(relay_error("Read error -- initial sync"));
     }
 
+    relay_lock();
     std::string ver = raw_relay_response("ver");// Get the version of the relay board
+    relay_unlock();
     if ((ver != "00000001") && (ver != "00000008"))
 	throw(relay_error("Could not get version"));
 }
@@ -242,7 +293,9 @@ std::string relay_status(const enum RELAY_NAME relay_number)
     cmd << "relay read " << std::hex << std::uppercase << relay_number << std::dec;
 
     // Send comand, get result
+    relay_lock();
     std::string result = raw_relay_response(cmd.str());
+    relay_unlock();
     return (result);
 }
 /*
@@ -261,7 +314,9 @@ std::string gpio_status(const int gpio_number)
     cmd << "gpio read " << gpio_number;
 
     // Send comand, get result
+    relay_lock();
     std::string result = raw_relay_response(cmd.str());
+    relay_unlock();
     return (result);
 }
 /*
@@ -277,17 +332,146 @@ void relay(
 	const enum RELAY_NAME relay_name, // The name of the relay
 	const enum RELAY_STATE state	// The state of the relay
 ) {
+    // The state we want as a shadow value
+    const SHADOW want = (state == RELAY_STATE::RELAY_ON) ? SHADOW::ON : SHADOW::OFF;
+    const int index = static_cast<int>(relay_name);	// Relay as an index
+
+    relay_lock();
+    if (relay_caching && (index < MAX_RELAYS) && (relay_shadow[index] == want)) {
+	// Already there, don't bother the board
+	++relay_skipped;
+	relay_unlock();
+	return;
+    }
     if (verbose) {
 	syslog(LOG_INFO, "THREAD: %s RELAY %d: STATE: %s",
-	    thread_name, static_cast<int>(relay_name),
+	    thread_name, index,
 	    (state == RELAY_STATE::RELAY_ON ? "On" : "Off"));
     }
-    if (simulate)
+    if (!simulate) {
+	std::ostringstream cmd;
+	cmd << "relay " << 
+	    (state == RELAY_STATE::RELAY_ON ? "on" : "off") << ' ' <<
+	    std::hex << std::uppercase << index << std::dec;
+	// If the command fails we don't know where the relay is
+	if (index < MAX_RELAYS)
+	    relay_shadow[index] = SHADOW::UNKNOWN;
+	raw_relay(cmd.str());
+    }
+    ++relay_sent;
+    if (index < MAX_RELAYS)
+	relay_shadow[index] = want;
+    relay_unlock();
+}
+/*
+ * relay_batch -- Set a group of relays at once
+ *
+ * If the board can do it, we are caching (relay_cache), and we know
+ * the state of every relay, the whole group is done with one "relay
+ * writeall" command.  Otherwise each change is sent by itself.  When
+ * caching, changes that would not do anything are skipped.
+ *
+ * Parameters
+ * 	thread_name -- Name of who's changing the relays
+ * 	changes -- The changes to make
+ * 	count -- Number of changes
+ */
+void relay_batch(
+	const char* const thread_name,		// Name of the thread doing the change
+	const struct relay_change* const changes,	// The changes
+	const unsigned int count		// Number of changes
+) {
+    if (!relay_caching) {
+	// Another process may have changed the relays, so the shadow
+	// can't be trusted for writeall or skipping
+	for (unsigned int i = 0; i < count; ++i)
+	    relay(thread_name, changes[i].relay, changes[i].state);
 	return;
-    std::ostringstream cmd;
-    cmd << "relay " << 
-	(state == RELAY_STATE::RELAY_ON ? "on" : "off") << ' ' <<
-	std::hex << std::uppercase << static_cast<int>(relay_name) << std::dec;
-    raw_relay(cmd.str());
+    }
+    relay_lock();
+
+    SHADOW want[MAX_RELAYS];	// The state we want
+    bool known = true;		// Do we know the state of every relay
+    for (int i = 0; i < MAX_RELAYS; ++i) {
+	want[i] = relay_shadow[i];
+	if (want[i] == SHADOW::UNKNOWN)
+	    known = false;
+    }
+    unsigned int needed = 0;	// Changes that do something
+    for (unsigned int i = 0; i < count; ++i) {
+	const int index = static_cast<int>(changes[i].relay);	// Relay as an index
+	const SHADOW state = (changes[i].state == RELAY_STATE::RELAY_ON) ? SHADOW::ON : SHADOW::OFF;
+	if ((index < MAX_RELAYS) && (want[index] == state))
+	    continue;
+	if (index < MAX_RELAYS)
+	    want[index] = state;
+	++needed;
+    }
+    if (needed == 0) {
+	relay_skipped += count;
+	relay_unlock();
+	return;
+    }
+    if (relay_writeall && known && (needed > 1)) {
+	unsigned int mask = 0;	// Bit mask of the relays that are on
+	for (int i = 0; i < MAX_RELAYS; ++i) {
+	    if (want[i] == SHADOW::ON)
+		mask |= (1 << i);
+	}
+	std::ostringstream cmd;
+	cmd << "relay writeall " << std::hex << std::uppercase << 
+	    std::setw(4) << std::setfill('0') << mask << std::dec;
+	if (verbose) 
+	    syslog(LOG_INFO, "THREAD: %s RELAYS: %04X", thread_name, mask);
+	for (int i = 0; i < MAX_RELAYS; ++i)
+	    relay_shadow[i] = SHADOW::UNKNOWN;	// Until it's done
+	raw_relay(cmd.str());
+	++relay_sent;
+	relay_skipped += count - 1;
+	for (int i = 0; i < MAX_RELAYS; ++i)
+	    relay_shadow[i] = want[i];
+	relay_unlock();
+	return;
+    }
+    relay_unlock();
+
+    // One at a time (relay skips the ones already done)
+    for (unsigned int i = 0; i < count; ++i)
+	relay(thread_name, changes[i].relay, changes[i].state);
+}
+/*
+ * relay_cache -- Turn skipping of commands that don't change anything
+ * on or off
+ *
+ * Only for a program that is the only one using the board (garden).
+ * The shadow is what this process last sent.  If another process
+ * changes or resets the relays, or the board resets itself, the
+ * shadow is wrong and commands that are needed get skipped.  Off by
+ * default.  Turning it on (again) forgets what we know.
+ *
+ * Parameters
+ * 	on -- Skip commands that are not needed
+ */
+void relay_cache(const bool on)
+{
+    relay_lock();
+    relay_caching = on;
+    for (int i = 0; i < MAX_RELAYS; ++i)
+	relay_shadow[i] = SHADOW::UNKNOWN;
+    relay_unlock();
+}
+/*
+ * relay_counts -- Get the relay traffic counts
+ *
+ * Parameters
+ * 	sent -- Number of commands sent to the board
+ * 	skipped -- Number of commands skipped because the relay was already set
+ */
+void relay_counts(unsigned long int& sent, unsigned long int& skipped)
+{
+    relay_lock();
+    sent = relay_sent;
+    skipped = relay_skipped;
+    relay_unlock();
 }
 
@@ -126,6 +126,19 @@ extern void relay(
 	const enum RELAY_STATE state	// The state of the relay
 );
 extern void relay_reset(void);
+
+// One change in a batch
+struct relay_change {
+    enum RELAY_NAME relay;	// The relay to change
+    enum RELAY_STATE state;	// The state we want
+};
+extern void relay_batch(
+	const char* const thread_name,		// Name of the thread doing the change
+	const struct relay_change* const changes,	// The changes
+	const unsigned int count		// Number of changes
+);
+extern void relay_cache(const bool on);
+extern void relay_counts(unsigned long int& sent, unsigned long int& skipped);
 extern bool verbose;	// Do we chatter
 extern bool simulate;	// Simulate relay information
 #endif // __RELAY__H__
@@ -0,0 +1,118 @@
+/*
+ * rt -- Real time support for the programs that run relays
+ */
+#include <errno.h>
+#include <malloc.h>
+#include <sched.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/mman.h>
+
+#include "rt.h"
+
+static bool enabled = false;	// Is real time mode on
+static int rt_cpu = RT_NO_CPU;	// CPU to pin to
+
+static const size_t PREFAULT_SIZE = 64 * 1024;	// Stack we touch in each thread
+
+/*
+ * prefault_stack -- Touch the stack so the pages are there before we need them
+ */
+static void prefault_stack(void)
+{
+    volatile char stack[PREFAULT_SIZE];	// Space to touch
+    memset(const_cast<char*>(stack), '\0', sizeof(stack));
+}
+
+/*
+ * rt_setup -- Turn on real time mode
+ *
+ * Call once from main before any threads are created.
+ *
+ * Parameters
+ * 	cpu -- CPU to pin the real time threads to (RT_NO_CPU for none)
+ */
+void rt_setup(const int cpu)
+{
+    enabled = true;
+    rt_cpu = cpu;
+
+    // Don't give memory back and don't use mmap for malloc.  Both
+    // would cause page faults later.
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    if (mlockall(MCL_CURRENT|MCL_FUTURE) != 0)
+	syslog(LOG_WARNING, "Real time: mlockall failed (%s) -- memory not locked", strerror(errno));
+
+    prefault_stack();
+    syslog(LOG_INFO, "Real time mode on (cpu %d)", cpu);
+}
+
+/*
+ * rt_enabled -- Is real time mode on
+ */
+bool rt_enabled(void)
+{
+    return (enabled);
+}
+
+/*
+ * rt_thread -- Make the calling thread a real time thread
+ *
+ * Parameters
+ * 	name -- Name of the thread (for the log)
+ * 	priority_offset -- Added to RT_PRIORITY (timers go above relay I/O)
+ */
+void rt_thread(const char* const name, const int priority_offset)
+{
+    if (!enabled)
+	return;
+
+    struct sched_param param;	// Our priority
+    memset(&param, '\0', sizeof(param));
+    param.sched_priority = RT_PRIORITY + priority_offset;
+
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);	// Result of the call
+    if (result != 0)
+	syslog(LOG_WARNING, "Real time: %s: SCHED_FIFO failed (%s)", name, strerror(result));
+
+    if (rt_cpu != RT_NO_CPU) {
+	cpu_set_t cpus;		// The CPU we run on
+	CPU_ZERO(&cpus);
+	CPU_SET(rt_cpu, &cpus);
+	result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	if (result != 0)
+	    syslog(LOG_WARNING, "Real time: %s: can't pin to cpu %d (%s)", name, rt_cpu, strerror(result));
+    }
+    prefault_stack();
+}
+
+/*
+ * rt_thread_create -- Create a thread
+ *
+ * In real time mode the stack is allocated and filled in now, so the
+ * thread never takes a page fault on its stack.  Otherwise this is
+ * just pthread_create.
+ *
+ * Returns
+ * 	The result of pthread_create
+ */
+int rt_thread_create(pthread_t* const thread, void* (*function)(void*), void* const arg)
+{
+    if (!enabled)
+	return (pthread_create(thread, NULL, function, arg));
+
+    // The stack (locked by mlockall, never freed)
+    void* stack = mmap(NULL, RT_STACK_SIZE, PROT_READ|PROT_WRITE,
+	    MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK|MAP_POPULATE, -1, 0);
+    if (stack == MAP_FAILED)
+	return (errno);
+
+    pthread_attr_t attr;	// Attributes of the thread
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, RT_STACK_SIZE);
+    const int result = pthread_create(thread, &attr, function, arg);	// Result of the create
+    pthread_attr_destroy(&attr);
+    return (result);
+}
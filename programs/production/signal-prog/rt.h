@@ -0,0 +1,32 @@
+/*
+ * rt -- Real time support for the programs that run relays
+ *
+ * Real time mode is opt-in (the -R<cpu> option of garden, acme, the
+ * demos and giant).  When it is on:
+ *
+ * 	All memory is locked (mlockall) so a page fault never delays a relay
+ * 	The threads that time relays run SCHED_FIFO
+ * 	Those threads are pinned to the CPU given (-1 for no pinning)
+ * 	Their stacks are allocated and touched before they start
+ *
+ * When it is off every call here does nothing, so the programs can
+ * call them all the time.
+ *
+ * SCHED_FIFO and mlockall need root (or CAP_SYS_NICE / CAP_IPC_LOCK).
+ * If we don't have them we log it and run normally.
+ */
+#ifndef __RT_H__
+#define __RT_H__
+
+#include <pthread.h>
+#include <stddef.h>
+
+static const int RT_PRIORITY = 50;			// SCHED_FIFO priority of the relay threads
+static const int RT_NO_CPU = -1;			// Don't pin to a CPU
+static const size_t RT_STACK_SIZE = 256 * 1024;		// Stack for each real time thread
+
+extern void rt_setup(const int cpu);
+extern bool rt_enabled(void);
+extern void rt_thread(const char* const name, const int priority_offset = 0);
+extern int rt_thread_create(pthread_t* const thread, void* (*function)(void*), void* const arg);
+#endif // __RT_H__